@@ -0,0 +1,199 @@
+#define _POSIX_C_SOURCE 200809L
+#include "aggregate.h"
+#include "record.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// head record of one input, ordered by (timestamp, input index) so records
+// with equal timestamps keep a stable input order
+typedef struct {
+    hub_record_t rec;
+    double values[HUB_RECORD_CHANNELS]; // channel values of rec
+    int input;
+} head_t;
+
+typedef struct {
+    char name[16];
+    unsigned long samples, alerts;
+    double min, max, sum;
+    int64_t first_ms, last_ms;
+} sensor_agg_t;
+
+static int head_less(const head_t *a, const head_t *b) {
+    if (a->rec.ms_timestamp != b->rec.ms_timestamp) return a->rec.ms_timestamp < b->rec.ms_timestamp;
+    return a->input < b->input;
+}
+
+static void sift_down(head_t *heap, int n, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && head_less(&heap[l], &heap[m])) m = l;
+        if (r < n && head_less(&heap[r], &heap[m])) m = r;
+        if (m == i) return;
+        head_t t = heap[i]; heap[i] = heap[m]; heap[m] = t;
+        i = m;
+    }
+}
+
+static void sift_up(head_t *heap, int i) {
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (!head_less(&heap[i], &heap[p])) return;
+        head_t t = heap[i]; heap[i] = heap[p]; heap[p] = t;
+        i = p;
+    }
+}
+
+// per-sensor aggregates, open addressing keyed by name; grows with the
+// number of distinct sensors only
+typedef struct {
+    sensor_agg_t *slots;
+    size_t size, used;
+} agg_table_t;
+
+static uint32_t hash_name(const char *s) {
+    uint32_t h = 2166136261u; // FNV-1a
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static sensor_agg_t *agg_lookup(agg_table_t *t, const char *name) {
+    if ((t->used + 1) * 2 > t->size) {
+        agg_table_t bigger = { calloc(t->size ? t->size * 2 : 16, sizeof(sensor_agg_t)), t->size ? t->size * 2 : 16, 0 };
+        if (!bigger.slots) return NULL;
+        for (size_t i = 0; i < t->size; ++i) {
+            if (!t->slots[i].name[0]) continue;
+            size_t h = hash_name(t->slots[i].name) & (bigger.size - 1);
+            while (bigger.slots[h].name[0]) h = (h + 1) & (bigger.size - 1);
+            bigger.slots[h] = t->slots[i];
+            bigger.used++;
+        }
+        free(t->slots);
+        *t = bigger;
+    }
+    size_t h = hash_name(name) & (t->size - 1);
+    while (t->slots[h].name[0]) {
+        if (strcmp(t->slots[h].name, name) == 0) return &t->slots[h];
+        h = (h + 1) & (t->size - 1);
+    }
+    sensor_agg_t *a = &t->slots[h];
+    strncpy(a->name, name, sizeof(a->name) - 1);
+    t->used++;
+    return a;
+}
+
+static void agg_update(sensor_agg_t *a, const hub_record_t *r) {
+    if (r->kind == REC_ALERT) {
+        a->alerts++;
+        return;
+    }
+    if (a->samples == 0) {
+        a->min = a->max = r->value;
+        a->first_ms = r->ms_timestamp;
+    }
+    if (r->value < a->min) a->min = r->value;
+    if (r->value > a->max) a->max = r->value;
+    a->sum += r->value;
+    a->last_ms = r->ms_timestamp;
+    a->samples++;
+}
+
+// next record of an input into h (values included)
+static int next_head(record_reader_t *r, head_t *h) {
+    int got = record_next(r, &h->rec);
+    if (got == 1) memcpy(h->values, record_values(r), sizeof(h->values));
+    return got;
+}
+
+static int cmp_agg_name(const void *x, const void *y) {
+    return strcmp(((const sensor_agg_t*)x)->name, ((const sensor_agg_t*)y)->name);
+}
+
+int aggregate_run(const hub_config_t *cfg) {
+    int n = cfg->num_inputs;
+    if (n == 0) {
+        fprintf(stderr, "aggregate: no input logs given\n");
+        return 2;
+    }
+    record_reader_t **readers = calloc((size_t)n, sizeof(*readers));
+    head_t *heap = calloc((size_t)n, sizeof(*heap));
+    agg_table_t table = { NULL, 0, 0 };
+    int rc = 0, heap_n = 0;
+
+    for (int i = 0; i < n; ++i) {
+        readers[i] = record_open(cfg->inputs[i]);
+        if (!readers[i]) {
+            fprintf(stderr, "aggregate: cannot open %s\n", cfg->inputs[i]);
+            rc = 1;
+            goto done;
+        }
+        heap[heap_n].input = i;
+        int got = next_head(readers[i], &heap[heap_n]);
+        if (got < 0) {
+            fprintf(stderr, "aggregate: read error in %s\n", cfg->inputs[i]);
+            rc = 1;
+            goto done;
+        }
+        if (got == 1) sift_up(heap, heap_n++);
+    }
+
+    FILE *out = strcmp(cfg->aggregate_out, "-") == 0 ? stdout : fopen(cfg->aggregate_out, "wb");
+    if (!out) {
+        fprintf(stderr, "aggregate: cannot open %s\n", cfg->aggregate_out);
+        rc = 1;
+        goto done;
+    }
+    int binary = cfg->log_format == LOG_FORMAT_BINARY;
+    unsigned long total = 0, out_of_order = 0;
+    int64_t last_ts = INT64_MIN;
+    while (heap_n > 0) {
+        head_t *top = &heap[0];
+        if (top->rec.ms_timestamp < last_ts) out_of_order++;
+        last_ts = top->rec.ms_timestamp;
+        record_write_values(out, binary, &top->rec, top->values);
+        sensor_agg_t *a = agg_lookup(&table, top->rec.type);
+        if (a) agg_update(a, &top->rec);
+        total++;
+
+        // refill from the same input, or drop it from the heap at EOF
+        int got = next_head(readers[top->input], top);
+        if (got < 0) {
+            fprintf(stderr, "aggregate: read error in %s\n", cfg->inputs[top->input]);
+            rc = 1;
+        }
+        if (got != 1) heap[0] = heap[--heap_n];
+        sift_down(heap, heap_n, 0);
+    }
+    if (out != stdout) fclose(out);
+    else fflush(out);
+
+    // global per-sensor totals, sorted by name
+    sensor_agg_t *list = calloc(table.used ? table.used : 1, sizeof(*list));
+    size_t k = 0;
+    for (size_t i = 0; i < table.size; ++i) {
+        if (table.slots[i].name[0]) list[k++] = table.slots[i];
+    }
+    qsort(list, k, sizeof(*list), cmp_agg_name);
+    fprintf(stderr, "aggregate: %lu records from %d inputs", total, n);
+    if (out_of_order) fprintf(stderr, " (%lu out of order within an input)", out_of_order);
+    fprintf(stderr, "\n");
+    for (size_t i = 0; i < k; ++i) {
+        sensor_agg_t *a = &list[i];
+        fprintf(stderr, "AGG|%s|samples=%lu|min=%.3f|max=%.3f|mean=%.3f|alerts=%lu|first=%lld|last=%lld\n",
+                a->name, a->samples, a->min, a->max, a->samples ? a->sum / a->samples : 0.0,
+                a->alerts, (long long)a->first_ms, (long long)a->last_ms);
+    }
+    free(list);
+
+done:
+    for (int i = 0; i < n; ++i) record_close(readers[i]);
+    free(readers);
+    free(heap);
+    free(table.slots);
+    return rc;
+}
@@ -0,0 +1,12 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+#include "config.h"
+
+// Aggregator mode (--aggregate): k-way merge of several hub logs (text or
+// binary, "-" for stdin) into one timestamp-ordered stream written to
+// cfg->aggregate_out in cfg->log_format, plus per-sensor totals on stderr.
+// Memory is one pending record per input plus one entry per distinct sensor.
+// Returns the process exit code.
+int aggregate_run(const hub_config_t *cfg);
+
+#endif
@@ -0,0 +1,421 @@
+#define _POSIX_C_SOURCE 200809L
+#include "backtest.h"
+#include "encoding.h"
+#include "record.h"
+#include "store.h"
+#include "sweep.h"
+#include "window.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+// samples per block; the workers replay one block while the next is read
+#define BACKTEST_BLOCK 16384
+
+typedef struct {
+    int64_t seq;            // position among the input samples
+    int64_t ms_timestamp;
+    int32_t sensor;
+    double values[HUB_MAX_CHANNELS];
+} bt_sample_t;
+
+typedef struct {
+    int64_t seq;
+    int64_t ms_timestamp;
+    int32_t sensor;
+    double metric;
+} bt_alert_t;
+
+// one block of samples, split by worker (sensor % threads) in input order
+typedef struct {
+    bt_sample_t **part;
+    int *count;
+    int total;
+} bt_block_t;
+
+// per-sensor totals, written only by the sensor's worker
+typedef struct {
+    unsigned long samples, alerts;
+    int64_t first_alert_ms, last_alert_ms;
+} bt_sensor_t;
+
+typedef struct backtest backtest_t;
+
+// --store input: one sensor's partitions, oldest day first
+typedef struct {
+    int first, num_parts, part;  // manifest parts; part = the mapped one
+    store_columns_t cols;
+    sensor_config_t schema;      // of the mapped partition
+    size_t row;
+} bt_cursor_t;
+
+typedef struct {
+    backtest_t *bt;
+    int id;
+    pthread_t thread;
+    bt_alert_t *alerts;     // alerts of the current block, in input order
+    size_t num_alerts, cap_alerts;
+    bool overflow;          // an alert could not be stored
+} bt_worker_t;
+
+struct backtest {
+    const hub_config_t *cfg;
+    int threads;
+    window_t *windows;
+    sweep_t *sweep;         // --sweep: candidate rules instead of the configured ones
+    bt_sensor_t *totals;
+    bt_block_t blocks[2];
+    const bt_block_t *current;  // block being replayed
+    bool stop;
+    pthread_barrier_t go, done;
+    bt_worker_t *workers;
+
+    // input side (main thread only)
+    record_reader_t *reader;
+    int input;
+    store_manifest_t *store;     // --store instead of logs
+    bt_cursor_t *cursors;        // per configured sensor
+    int *heap;                   // sensors with rows left, by (next timestamp, sensor)
+    int heap_len;
+    int64_t seq;
+    unsigned long records, unknown;
+};
+
+static long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+// next sample record, opening the inputs in turn; 1, 0 at the end, -1 on error
+static int next_record(backtest_t *bt, hub_record_t *rec) {
+    for (;;) {
+        if (!bt->reader) {
+            if (bt->input == bt->cfg->num_inputs) return 0;
+            const char *path = bt->cfg->inputs[bt->input++];
+            bt->reader = record_open(path);
+            if (!bt->reader) {
+                fprintf(stderr, "backtest: cannot open %s\n", path);
+                return -1;
+            }
+        }
+        int got = record_next(bt->reader, rec);
+        if (got < 0) {
+            fprintf(stderr, "backtest: read error in %s\n", bt->cfg->inputs[bt->input - 1]);
+            return -1;
+        }
+        if (got == 0) {
+            record_close(bt->reader);
+            bt->reader = NULL;
+            continue;
+        }
+        bt->records++;
+        if (rec->kind == REC_SAMPLE) return 1;
+    }
+}
+
+// map the cursor's next partition with rows; false when it has none left
+static bool cursor_advance(backtest_t *bt, bt_cursor_t *c) {
+    while (c->row == c->cols.rows) {
+        store_unmap(&c->cols);
+        c->row = 0;
+        if (c->part + 1 >= c->first + c->num_parts) return false;
+        const store_part_t *p = &bt->store->parts[++c->part];
+        if (!store_map(bt->store, p, &c->cols)) {
+            fprintf(stderr, "backtest: cannot map %s/%s/%s\n", bt->store->dir, p->day, p->name);
+            continue;
+        }
+        store_part_schema(p, &c->schema);
+    }
+    return true;
+}
+
+static bool heap_less(const backtest_t *bt, int a, int b) {
+    const bt_cursor_t *x = &bt->cursors[a], *y = &bt->cursors[b];
+    int64_t tx = x->cols.ts[x->row], ty = y->cols.ts[y->row];
+    return tx != ty ? tx < ty : a < b;
+}
+
+static void heap_down(backtest_t *bt, int i) {
+    int *h = bt->heap;
+    for (;;) {
+        int l = 2 * i + 1, m = i;
+        if (l < bt->heap_len && heap_less(bt, h[l], h[m])) m = l;
+        if (l + 1 < bt->heap_len && heap_less(bt, h[l + 1], h[m])) m = l + 1;
+        if (m == i) return;
+        int t = h[i]; h[i] = h[m]; h[m] = t;
+        i = m;
+    }
+}
+
+// a cursor per configured sensor (swept ones only under --sweep), merged by timestamp
+static bool store_input_open(backtest_t *bt) {
+    const hub_config_t *cfg = bt->cfg;
+    bt->store = store_load(cfg->store_dir);
+    if (!bt->store) return false;
+    bt->cursors = calloc((size_t)cfg->num_sensors, sizeof(*bt->cursors));
+    bt->heap = calloc((size_t)cfg->num_sensors, sizeof(*bt->heap));
+    if (!bt->cursors || !bt->heap) return false;
+    for (int i = 0; i < cfg->num_sensors; ++i) {
+        bt_cursor_t *c = &bt->cursors[i];
+        c->first = store_find(bt->store, cfg->sensors[i].name, &c->num_parts);
+        c->part = c->first - 1;
+        if (c->num_parts == 0 || (bt->sweep && !sweep_has(bt->sweep, i))) continue;
+        if (cursor_advance(bt, c)) bt->heap[bt->heap_len++] = i;
+    }
+    for (int i = bt->heap_len / 2 - 1; i >= 0; --i) heap_down(bt, i);
+    return true;
+}
+
+static void store_input_close(backtest_t *bt) {
+    for (int i = 0; bt->cursors && i < bt->cfg->num_sensors; ++i) store_unmap(&bt->cursors[i].cols);
+    free(bt->cursors);
+    free(bt->heap);
+    store_manifest_free(bt->store);
+}
+
+// next sample of a configured sensor with its physical values; as next_record
+static int next_sample(backtest_t *bt, int *sensor, int64_t *ms_timestamp, double *values) {
+    memset(values, 0, sizeof(double) * HUB_MAX_CHANNELS);
+    if (bt->store) {
+        if (bt->heap_len == 0) return 0;
+        int i = bt->heap[0];
+        bt_cursor_t *c = &bt->cursors[i];
+        *sensor = i;
+        *ms_timestamp = c->cols.ts[c->row];
+        encoding_unpack(&c->schema, c->cols.val + c->row * c->cols.row_size, values);
+        c->row++;
+        bt->records++;
+        if (!cursor_advance(bt, c)) bt->heap[0] = bt->heap[--bt->heap_len];
+        heap_down(bt, 0);
+        return 1;
+    }
+    hub_record_t rec;
+    for (;;) {
+        int got = next_record(bt, &rec);
+        if (got <= 0) return got;
+        *sensor = config_sensor_index(bt->cfg, rec.type);
+        if (*sensor >= 0) break;
+        bt->unknown++;
+    }
+    int n = rec.channels > 1 ? rec.channels : 1;
+    if (n > HUB_MAX_CHANNELS) n = HUB_MAX_CHANNELS;
+    memcpy(values, record_values(bt->reader), sizeof(double) * (size_t)n);
+    *ms_timestamp = rec.ms_timestamp;
+    return 1;
+}
+
+// read up to BACKTEST_BLOCK samples; 1 if the block is full, else as next_sample
+static int fill_block(backtest_t *bt, bt_block_t *b) {
+    b->total = 0;
+    for (int w = 0; w < bt->threads; ++w) b->count[w] = 0;
+    while (b->total < BACKTEST_BLOCK) {
+        int sensor;
+        int64_t ts;
+        double values[HUB_MAX_CHANNELS];
+        int got = next_sample(bt, &sensor, &ts, values);
+        if (got <= 0) return got;
+        int w = sensor % bt->threads;
+        bt_sample_t *s = &b->part[w][b->count[w]++];
+        s->seq = bt->seq++;
+        s->ms_timestamp = ts;
+        s->sensor = sensor;
+        memcpy(s->values, values, sizeof(s->values));
+        b->total++;
+    }
+    return 1;
+}
+
+// the processor's path for each sample: encode as submitted, then window_update()
+static void replay(bt_worker_t *wk, const bt_block_t *b) {
+    backtest_t *bt = wk->bt;
+    const hub_config_t *cfg = bt->cfg;
+    wk->num_alerts = 0;
+    for (int i = 0; i < b->count[wk->id]; ++i) {
+        const bt_sample_t *s = &b->part[wk->id][i];
+        const sensor_config_t *sc = &cfg->sensors[s->sensor];
+        unsigned char payload[HUB_MAX_CHANNELS * sizeof(double)];
+        hub_vec_t value;
+        double metric;
+        encoding_pack(sc, s->values, payload);
+        bt_sensor_t *t = &bt->totals[s->sensor];
+        t->samples++;
+        if (bt->sweep) {
+            if (sweep_has(bt->sweep, s->sensor)) sweep_push(bt->sweep, s->sensor, payload, (long)s->ms_timestamp);
+            continue;
+        }
+        if (!window_update(&bt->windows[s->sensor], sc, payload, &value, &metric)) continue;
+        if (t->alerts++ == 0) t->first_alert_ms = s->ms_timestamp;
+        t->last_alert_ms = s->ms_timestamp;
+        if (wk->num_alerts == wk->cap_alerts) {
+            size_t cap = wk->cap_alerts ? wk->cap_alerts * 2 : 1024;
+            bt_alert_t *a = realloc(wk->alerts, cap * sizeof(*a));
+            if (!a) {
+                wk->overflow = true;
+                continue;
+            }
+            wk->alerts = a;
+            wk->cap_alerts = cap;
+        }
+        wk->alerts[wk->num_alerts++] = (bt_alert_t){ s->seq, s->ms_timestamp, s->sensor, metric };
+    }
+}
+
+static void *worker_main(void *arg) {
+    bt_worker_t *wk = arg;
+    backtest_t *bt = wk->bt;
+    for (;;) {
+        pthread_barrier_wait(&bt->go);
+        if (bt->stop) break;
+        replay(wk, bt->current);
+        pthread_barrier_wait(&bt->done);
+    }
+    return NULL;
+}
+
+// merge the workers' alerts of one block back into input order
+static unsigned long write_alerts(backtest_t *bt, FILE *out, int binary) {
+    size_t pos[bt->threads];
+    memset(pos, 0, sizeof(pos));
+    unsigned long n = 0;
+    for (;;) {
+        int best = -1;
+        for (int w = 0; w < bt->threads; ++w) {
+            const bt_worker_t *wk = &bt->workers[w];
+            if (pos[w] == wk->num_alerts) continue;
+            if (best < 0 || wk->alerts[pos[w]].seq < bt->workers[best].alerts[pos[best]].seq) best = w;
+        }
+        if (best < 0) return n;
+        const bt_alert_t *a = &bt->workers[best].alerts[pos[best]++];
+        hub_record_t r;
+        record_fill(&r, REC_ALERT, bt->cfg->sensors[a->sensor].name, a->metric, (long)a->ms_timestamp);
+        record_write_values(out, binary, &r, &a->metric);
+        n++;
+    }
+}
+
+static bool block_init(bt_block_t *b, int threads) {
+    b->part = calloc((size_t)threads, sizeof(*b->part));
+    b->count = calloc((size_t)threads, sizeof(int));
+    if (!b->part || !b->count) return false;
+    for (int w = 0; w < threads; ++w) {
+        b->part[w] = malloc(sizeof(bt_sample_t) * BACKTEST_BLOCK);
+        if (!b->part[w]) return false;
+    }
+    return true;
+}
+
+static void block_free(bt_block_t *b, int threads) {
+    for (int w = 0; b->part && w < threads; ++w) free(b->part[w]);
+    free(b->part);
+    free(b->count);
+}
+
+int backtest_run(const hub_config_t *cfg) {
+    if (cfg->num_inputs == 0 && !cfg->store_dir[0]) {
+        fprintf(stderr, "backtest: no input logs or --store given\n");
+        return 2;
+    }
+    backtest_t bt = { .cfg = cfg, .threads = cfg->shards };
+    int rc = 1, started = 0;
+    FILE *out = NULL;
+    bool barriers = false;
+    bt.windows = calloc((size_t)cfg->num_sensors, sizeof(*bt.windows));
+    bt.totals = calloc((size_t)cfg->num_sensors, sizeof(*bt.totals));
+    bt.workers = calloc((size_t)bt.threads, sizeof(*bt.workers));
+    if (!bt.windows || !bt.totals || !bt.workers) goto done;
+    if (!block_init(&bt.blocks[0], bt.threads) || !block_init(&bt.blocks[1], bt.threads)) goto done;
+    for (int i = 0; i < cfg->num_sensors; ++i) {
+        if (!window_init(&bt.windows[i], &cfg->sensors[i])) goto done;
+    }
+    if (cfg->sweep_file[0] && !(bt.sweep = sweep_load(cfg, cfg->sweep_file))) goto done;
+    if (cfg->store_dir[0] && !store_input_open(&bt)) goto done;
+    out = strcmp(cfg->backtest_out, "-") == 0 ? stdout : fopen(cfg->backtest_out, "wb");
+    if (!out) {
+        fprintf(stderr, "backtest: cannot open %s\n", cfg->backtest_out);
+        goto done;
+    }
+
+    pthread_barrier_init(&bt.go, NULL, (unsigned)bt.threads + 1);
+    pthread_barrier_init(&bt.done, NULL, (unsigned)bt.threads + 1);
+    barriers = true;
+    for (int w = 0; w < bt.threads; ++w) {
+        bt.workers[w] = (bt_worker_t){ .bt = &bt, .id = w };
+        if (pthread_create(&bt.workers[w].thread, NULL, worker_main, &bt.workers[w]) != 0) {
+            // the barriers count every worker, so a missing one is fatal
+            fprintf(stderr, "backtest: cannot start worker %d\n", w);
+            abort();
+        }
+        started++;
+    }
+
+    int binary = cfg->log_format == LOG_FORMAT_BINARY;
+    unsigned long alerts = 0;
+    long t0 = monotonic_ms();
+    int got = fill_block(&bt, &bt.blocks[0]);
+    int cur = 0;
+    rc = 0;
+    while (bt.blocks[cur].total > 0) {
+        bt.current = &bt.blocks[cur];
+        pthread_barrier_wait(&bt.go);
+        if (got > 0) got = fill_block(&bt, &bt.blocks[cur ^ 1]);
+        else bt.blocks[cur ^ 1].total = 0;
+        pthread_barrier_wait(&bt.done);
+        alerts += write_alerts(&bt, out, binary);
+        cur ^= 1;
+    }
+    if (got < 0) rc = 1;
+    if (bt.sweep && !sweep_write_csv(bt.sweep, out)) rc = 1;
+    long elapsed = monotonic_ms() - t0;
+
+    for (int w = 0; w < bt.threads; ++w) {
+        if (bt.workers[w].overflow) {
+            fprintf(stderr, "backtest: out of memory, alerts are missing\n");
+            rc = 1;
+            break;
+        }
+    }
+    unsigned long samples = (unsigned long)bt.seq;
+    fprintf(stderr, "backtest: %lu records, %lu samples (%lu of unknown sensors), ", bt.records, samples, bt.unknown);
+    if (bt.sweep) fprintf(stderr, "swept");
+    else fprintf(stderr, "%lu alerts", alerts);
+    fprintf(stderr, " in %ld ms (%.0f samples/s, %d threads)\n", elapsed,
+            elapsed > 0 ? samples * 1000.0 / elapsed : 0.0, bt.threads);
+    for (int i = 0; !bt.sweep && i < cfg->num_sensors; ++i) {
+        const bt_sensor_t *t = &bt.totals[i];
+        if (!t->samples) continue;
+        fprintf(stderr, "BACKTEST|%s|samples=%lu|alerts=%lu|first=%lld|last=%lld\n", cfg->sensors[i].name,
+                t->samples, t->alerts, (long long)(t->alerts ? t->first_alert_ms : 0),
+                (long long)(t->alerts ? t->last_alert_ms : 0));
+    }
+
+done:
+    if (started) {
+        bt.stop = true;
+        pthread_barrier_wait(&bt.go);
+        for (int w = 0; w < started; ++w) pthread_join(bt.workers[w].thread, NULL);
+    }
+    if (barriers) {
+        pthread_barrier_destroy(&bt.go);
+        pthread_barrier_destroy(&bt.done);
+    }
+    if (out && out != stdout) {
+        if (fclose(out) != 0) rc = 1;
+    } else if (out) {
+        fflush(out);
+    }
+    if (bt.reader) record_close(bt.reader);
+    if (cfg->store_dir[0]) store_input_close(&bt);
+    for (int i = 0; bt.windows && i < cfg->num_sensors; ++i) window_free(&bt.windows[i]);
+    sweep_free(bt.sweep);
+    for (int w = 0; bt.workers && w < bt.threads; ++w) free(bt.workers[w].alerts);
+    block_free(&bt.blocks[0], bt.threads);
+    block_free(&bt.blocks[1], bt.threads);
+    free(bt.windows);
+    free(bt.totals);
+    free(bt.workers);
+    return rc;
+}
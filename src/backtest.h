@@ -0,0 +1,18 @@
+#ifndef BACKTEST_H
+#define BACKTEST_H
+#include "config.h"
+
+// Backtest mode (--backtest): replay the samples recorded in hub logs (text
+// or binary, read one after another as one stream, "-" for stdin) through
+// the configured sensors' windows and alert rules, the same code the
+// processor threads run (src/window.h). Sensors are partitioned over
+// cfg->shards worker threads like processor shards. The alerts that would
+// have fired go to cfg->backtest_out in cfg->log_format, in input order;
+// per-sensor totals go to stderr. Recorded alerts and samples of unknown
+// sensors are skipped; derived (spectral) sensors replay their recorded
+// band energies. With cfg->sweep_file the swept sensors' candidate rules are
+// evaluated instead and the CSV goes to cfg->backtest_out (src/sweep.h).
+// Returns the process exit code.
+int backtest_run(const hub_config_t *cfg);
+
+#endif
@@ -0,0 +1,157 @@
+#define _POSIX_C_SOURCE 200809L
+#include "checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct ckpt_file {
+    void *map;
+    size_t len;
+    const ckpt_header_t *hdr;
+    const ckpt_entry_t *entries;
+    const double *values;
+};
+
+// write header, entries and rings to f
+static bool write_all(FILE *f, const ckpt_window_t *w, int n, int64_t now_ms) {
+    ckpt_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = CKPT_MAGIC;
+    hdr.version = CKPT_VERSION;
+    hdr.num_sensors = (uint32_t)n;
+    hdr.saved_ms = now_ms;
+    for (int i = 0; i < n; ++i) hdr.total_values += (uint64_t)w[i].window * (uint64_t)w[i].channels;
+
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    uint64_t off = 0;
+    for (int i = 0; ok && i < n; ++i) {
+        ckpt_entry_t e;
+        memset(&e, 0, sizeof(e));
+        strncpy(e.name, w[i].name, sizeof(e.name) - 1);
+        e.window = w[i].window;
+        e.count = w[i].count;
+        e.idx = w[i].idx;
+        e.channels = w[i].channels;
+        e.values_offset = off;
+        off += (uint64_t)w[i].window * (uint64_t)w[i].channels;
+        ok = fwrite(&e, sizeof(e), 1, f) == 1;
+    }
+    for (int i = 0; ok && i < n; ++i) {
+        size_t len = (size_t)w[i].window * (size_t)w[i].channels;
+        ok = fwrite(w[i].values, sizeof(double), len, f) == len;
+    }
+    return ok && fflush(f) == 0;
+}
+
+bool checkpoint_write(const char *path, const ckpt_window_t *w, int n, int64_t now_ms) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return false;
+    bool ok = write_all(f, w, n, now_ms) && fsync(fileno(f)) == 0;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return false;
+    }
+    return true;
+}
+
+bool checkpoint_write_fd(int fd, const ckpt_window_t *w, int n, int64_t now_ms) {
+    int dupfd = dup(fd);
+    FILE *f = dupfd >= 0 ? fdopen(dupfd, "wb") : NULL;
+    if (!f) {
+        if (dupfd >= 0) close(dupfd);
+        return false;
+    }
+    bool ok = write_all(f, w, n, now_ms);
+    return (fclose(f) == 0) && ok;
+}
+
+ckpt_file_t *checkpoint_open(const char *path, int64_t now_ms, int64_t max_age_ms) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    ckpt_file_t *ck = checkpoint_open_fd(fd, path, now_ms, max_age_ms);
+    close(fd);
+    return ck;
+}
+
+ckpt_file_t *checkpoint_open_fd(int fd, const char *name, int64_t now_ms, int64_t max_age_ms) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ckpt_header_t)) {
+        fprintf(stderr, "checkpoint: %s is truncated, ignoring it\n", name);
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return NULL;
+
+    // the header must be checked before any of its counts are used
+    const ckpt_header_t *hdr = (const ckpt_header_t*)map;
+    size_t avail = (size_t)st.st_size - sizeof(ckpt_header_t);
+    bool valid = hdr->magic == CKPT_MAGIC && hdr->version == CKPT_VERSION &&
+                 hdr->num_sensors <= avail / sizeof(ckpt_entry_t);
+    if (valid) {
+        avail -= hdr->num_sensors * sizeof(ckpt_entry_t);
+        valid = hdr->total_values <= avail / sizeof(double) && hdr->total_values * sizeof(double) == avail;
+    }
+    if (!valid) {
+        fprintf(stderr, "checkpoint: %s is not a valid checkpoint, ignoring it\n", name);
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    ckpt_file_t *ck = calloc(1, sizeof(*ck));
+    if (!ck) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    ck->map = map;
+    ck->len = (size_t)st.st_size;
+    ck->hdr = hdr;
+    ck->entries = (const ckpt_entry_t*)(hdr + 1);
+    ck->values = (const double*)(ck->entries + hdr->num_sensors);
+    int64_t age = now_ms - ck->hdr->saved_ms;
+    if (age > max_age_ms) {
+        fprintf(stderr, "checkpoint: %s is stale (%lld s old), starting cold\n", name, (long long)(age / 1000));
+        checkpoint_close(ck);
+        return NULL;
+    }
+    return ck;
+}
+
+int checkpoint_values(const ckpt_file_t *ck, const char *name, int channels, double *out, int max) {
+    for (uint32_t i = 0; i < ck->hdr->num_sensors; ++i) {
+        const ckpt_entry_t *e = &ck->entries[i];
+        if (strncmp(e->name, name, sizeof(e->name)) != 0) continue;
+        int ch = e->channels ? e->channels : 1;
+        // the entry's ring must lie within the values array (no overflow:
+        // window and ch are positive 32-bit numbers)
+        if (ch != channels || e->window <= 0 || e->count < 0 || e->count > e->window || e->idx < 0
+            || e->idx >= e->window || e->values_offset > ck->hdr->total_values
+            || (uint64_t)e->window * (uint64_t)ch > ck->hdr->total_values - e->values_offset) {
+            return 0;
+        }
+        // oldest sample sits count slots behind the write position
+        int n = e->count < max ? e->count : max;
+        const double *ring = ck->values + e->values_offset;
+        for (int k = 0; k < n; ++k) {
+            long pos = ((long)e->idx - n + k + e->window) % e->window;
+            memcpy(out + (size_t)k * ch, ring + (size_t)pos * ch, sizeof(double) * (size_t)ch);
+        }
+        return n;
+    }
+    return 0;
+}
+
+int64_t checkpoint_saved_ms(const ckpt_file_t *ck) {
+    return ck->hdr->saved_ms;
+}
+
+void checkpoint_close(ckpt_file_t *ck) {
+    if (!ck) return;
+    munmap(ck->map, ck->len);
+    free(ck);
+}
@@ -0,0 +1,64 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <stdbool.h>
+#include <stdint.h>
+
+// Processor-state checkpoint file. Layout (native endianness, all fields
+// 8-byte aligned so the file can be mmap'ed and used in place):
+//   ckpt_header_t
+//   ckpt_entry_t[num_sensors]
+//   double values[sum of entry.window * entry.channels]
+//                                        (each entry's ring, in ring order,
+//                                         channels of one sample adjacent)
+#define CKPT_MAGIC 0x504b4348u /* "HCKP" */
+#define CKPT_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_sensors;
+    uint32_t reserved;
+    int64_t saved_ms;        // wall-clock time of the checkpoint
+    uint64_t total_values;
+} ckpt_header_t;
+
+typedef struct {
+    char name[16];
+    int32_t window;          // ring capacity
+    int32_t count;           // valid values (<= window)
+    int32_t idx;             // next write position in the ring
+    int32_t channels;        // values per sample (0 in old files = 1)
+    uint64_t values_offset;  // index into the values array
+} ckpt_entry_t;
+
+// one sensor's window as seen by the writer
+typedef struct {
+    const char *name;
+    int window, channels, count, idx;
+    const double *values;   // window * channels
+} ckpt_window_t;
+
+// write all windows to path atomically (temp file + fsync + rename)
+bool checkpoint_write(const char *path, const ckpt_window_t *w, int n, int64_t now_ms);
+
+// write to an open (e.g. memfd) descriptor at its current offset
+bool checkpoint_write_fd(int fd, const ckpt_window_t *w, int n, int64_t now_ms);
+
+// Map a checkpoint for restore. Returns NULL if it is missing, malformed or
+// older than max_age_ms (a message is printed for the last two).
+typedef struct ckpt_file ckpt_file_t;
+
+ckpt_file_t *checkpoint_open(const char *path, int64_t now_ms, int64_t max_age_ms);
+
+// same for an open descriptor; name is only used in messages
+ckpt_file_t *checkpoint_open_fd(int fd, const char *name, int64_t now_ms, int64_t max_age_ms);
+
+// Copy up to max samples (channels values each) of the named sensor, oldest
+// first; returns the number of samples copied (0 if the sensor is not in the
+// checkpoint or was saved with a different channel count).
+int checkpoint_values(const ckpt_file_t *ck, const char *name, int channels, double *out, int max);
+
+int64_t checkpoint_saved_ms(const ckpt_file_t *ck);
+void checkpoint_close(ckpt_file_t *ck);
+
+#endif
@@ -0,0 +1,582 @@
+#define _DEFAULT_SOURCE
+#include "compact.h"
+#include "config.h"
+#include "record.h"
+#include "segment.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// input bytes between throttle calls
+#define COMPACT_READ_CHUNK (256 * 1024)
+
+void compact_path(char *buf, size_t n, const char *log_path, unsigned seq) {
+    snprintf(buf, n, "%s.%06u.col", log_path, seq);
+}
+
+static void manifest_path(char *buf, size_t n, const char *log_path) {
+    snprintf(buf, n, "%s.compact", log_path);
+}
+
+static int entry_cmp(const void *a, const void *b) {
+    const compact_entry_t *x = a, *y = b;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+int compact_manifest_load(const char *log_path, compact_entry_t **entries) {
+    char path[HUB_PATH_LEN + 16];
+    manifest_path(path, sizeof(path), log_path);
+    *entries = NULL;
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    compact_entry_t *e = NULL;
+    int n = 0, cap = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            compact_entry_t *p = realloc(e, sizeof(*p) * (size_t)cap);
+            if (!p) break;
+            e = p;
+        }
+        unsigned seq;
+        unsigned long long records, raw, bytes;
+        long long lo, hi;
+        if (sscanf(line, "seg %u records=%llu raw=%llu bytes=%llu min=%lld max=%lld",
+                   &seq, &records, &raw, &bytes, &lo, &hi) != 6) {
+            fprintf(stderr, "compact: %s: invalid line\n", path);
+            fclose(f);
+            free(e);
+            return -1;
+        }
+        e[n++] = (compact_entry_t){ seq, records, raw, bytes, lo, hi };
+    }
+    fclose(f);
+    qsort(e, (size_t)n, sizeof(*e), entry_cmp);
+    *entries = e;
+    return n;
+}
+
+static bool sync_dir(const char *log_path) {
+    char dir[HUB_PATH_LEN];
+    const char *slash = strrchr(log_path, '/');
+    snprintf(dir, sizeof(dir), "%.*s", slash ? (int)(slash - log_path) + 1 : 1, slash ? log_path : ".");
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+// rewrite the manifest with add in it (atomically, via a rename)
+static bool manifest_add(const char *log_path, const compact_entry_t *add) {
+    compact_entry_t *e;
+    int n = compact_manifest_load(log_path, &e);
+    if (n < 0) return false;
+    compact_entry_t *all = realloc(e, sizeof(*all) * (size_t)(n + 1));
+    if (!all) {
+        free(e);
+        return false;
+    }
+    int k = 0;
+    while (k < n && all[k].seq != add->seq) k++;
+    all[k] = *add;
+    if (k == n) n++;
+    qsort(all, (size_t)n, sizeof(*all), entry_cmp);
+
+    char path[HUB_PATH_LEN + 16], tmp[HUB_PATH_LEN + 24];
+    manifest_path(path, sizeof(path), log_path);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        free(all);
+        return false;
+    }
+    fprintf(f, "# sensorhub compacted segments 1\n");
+    for (int i = 0; i < n; ++i) {
+        const compact_entry_t *x = &all[i];
+        fprintf(f, "seg %06u records=%llu raw=%llu bytes=%llu min=%lld max=%lld\n", x->seq,
+                (unsigned long long)x->records, (unsigned long long)x->raw_bytes,
+                (unsigned long long)x->bytes, (long long)x->min_ms, (long long)x->max_ms);
+    }
+    free(all);
+    bool ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (fclose(f) != 0) ok = false;
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) unlink(tmp);
+    return ok;
+}
+
+void compact_remove_raw(const char *log_path, unsigned seq) {
+    char seg[HUB_PATH_LEN + 16], side[HUB_PATH_LEN + 32];
+    segment_path(seg, sizeof(seg), log_path, seq);
+    snprintf(side, sizeof(side), "%s.zmap", seg);
+    unlink(side);
+    snprintf(side, sizeof(side), "%s.bloom", seg);
+    unlink(side);
+    unlink(seg);
+}
+
+int compact_lock(const char *log_path) {
+    char path[HUB_PATH_LEN + 32];
+    snprintf(path, sizeof(path), "%s.compact.lock", log_path);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void compact_unlock(int fd) {
+    if (fd < 0) return;
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+// growable output bytes
+typedef struct {
+    unsigned char *p;
+    size_t len, cap;
+    bool failed;
+} buf_t;
+
+static unsigned char *buf_room(buf_t *b, size_t n) {
+    if (b->len + n > b->cap) {
+        size_t cap = b->cap ? b->cap : 4096;
+        while (cap < b->len + n) cap *= 2;
+        unsigned char *p = realloc(b->p, cap);
+        if (!p) {
+            b->failed = true;
+            return NULL;
+        }
+        b->p = p;
+        b->cap = cap;
+    }
+    return b->p + b->len;
+}
+
+static void put_varint(buf_t *b, uint64_t v) {
+    unsigned char *p = buf_room(b, 10);
+    if (!p) return;
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char)v;
+    b->len += n;
+}
+
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static uint64_t double_bits(double v) {
+    uint64_t u;
+    memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+// one value of an XOR column
+static void put_xor(buf_t *b, uint64_t *prev, double v) {
+    uint64_t bits = double_bits(v), x = bits ^ *prev;
+    *prev = bits;
+    unsigned char *p = buf_room(b, 9);
+    if (!p) return;
+    if (!x) {
+        p[0] = 0;
+        b->len++;
+        return;
+    }
+    int tz = __builtin_ctzll(x) / 8, kept = 8 - __builtin_clzll(x) / 8 - tz;
+    p[0] = (unsigned char)(tz << 4 | kept);
+    x >>= 8 * tz;
+    for (int i = 0; i < kept; ++i) p[1 + i] = (unsigned char)(x >> (8 * i));
+    b->len += 1 + (size_t)kept;
+}
+
+typedef struct {
+    int64_t ts;
+    uint64_t seq;            // input order, for equal timestamps
+    double value;
+    double ch[HUB_RECORD_CHANNELS];
+} row_t;
+
+// records of one (sensor, kind, channels)
+typedef struct {
+    char type[16];
+    uint8_t kind, channels;
+    row_t *rows;
+    size_t n, cap;
+} group_t;
+
+typedef struct {
+    group_t *slots;
+    size_t size, used;
+    uint64_t records;
+    bool failed;
+} groups_t;
+
+static uint64_t group_hash(const char *type, int kind, int channels) {
+    uint64_t h = 14695981039346656037ull; // FNV-1a
+    for (size_t i = 0; i < 16 && type[i]; ++i) h = (h ^ (unsigned char)type[i]) * 1099511628211ull;
+    return (h ^ (uint64_t)(kind << 8 | channels)) * 1099511628211ull;
+}
+
+static group_t *group_lookup(groups_t *g, const hub_record_t *r) {
+    if ((g->used + 1) * 2 > g->size) {
+        size_t size = g->size ? g->size * 2 : 64;
+        group_t *slots = calloc(size, sizeof(*slots));
+        if (!slots) return NULL;
+        for (size_t i = 0; i < g->size; ++i) {
+            if (!g->slots[i].type[0]) continue;
+            size_t h = group_hash(g->slots[i].type, g->slots[i].kind, g->slots[i].channels) & (size - 1);
+            while (slots[h].type[0]) h = (h + 1) & (size - 1);
+            slots[h] = g->slots[i];
+        }
+        free(g->slots);
+        g->slots = slots;
+        g->size = size;
+    }
+    size_t h = group_hash(r->type, r->kind, r->channels) & (g->size - 1);
+    while (g->slots[h].type[0]) {
+        group_t *x = &g->slots[h];
+        if (x->kind == r->kind && x->channels == r->channels && strncmp(x->type, r->type, 16) == 0) return x;
+        h = (h + 1) & (g->size - 1);
+    }
+    group_t *x = &g->slots[h];
+    memcpy(x->type, r->type, strnlen(r->type, sizeof(x->type) - 1));
+    x->kind = r->kind;
+    x->channels = r->channels;
+    g->used++;
+    return x;
+}
+
+static void group_add(groups_t *g, const hub_record_t *r, const double *values) {
+    // an empty name would mark a free slot
+    if ((r->kind != REC_SAMPLE && r->kind != REC_ALERT) || !r->type[0]) return;
+    group_t *x = group_lookup(g, r);
+    if (x && x->n == x->cap) {
+        size_t cap = x->cap ? x->cap * 2 : 256;
+        row_t *rows = realloc(x->rows, sizeof(*rows) * cap);
+        if (rows) {
+            x->rows = rows;
+            x->cap = cap;
+        }
+    }
+    if (!x || x->n == x->cap) {
+        g->failed = true;
+        return;
+    }
+    row_t *row = &x->rows[x->n++];
+    row->ts = r->ms_timestamp;
+    row->seq = g->records++;
+    row->value = r->value;
+    int n = r->channels > 1 ? r->channels : 0;
+    for (int c = 0; c < n; ++c) row->ch[c] = values[c];
+}
+
+static void groups_free(groups_t *g) {
+    for (size_t i = 0; i < g->size; ++i) free(g->slots[i].rows);
+    free(g->slots);
+}
+
+// every SAMPLE/ALERT record of a mapped segment (text or binary)
+static bool read_segment(groups_t *g, const char *data, size_t size, compact_throttle_fn throttle, void *ctx) {
+    size_t charged = 0;
+    if ((unsigned char)data[0] == (HUB_RECORD_MAGIC & 0xff)) {
+        const hub_record_t *r = (const hub_record_t*)data;
+        size_t n = size / sizeof(*r);
+        for (size_t i = 0; i < n && !g->failed; ++i) {
+            if ((i + 1) * sizeof(*r) - charged >= COMPACT_READ_CHUNK) {
+                if (!throttle(ctx, (i + 1) * sizeof(*r) - charged)) return false;
+                charged = (i + 1) * sizeof(*r);
+            }
+            if (r[i].magic != HUB_RECORD_MAGIC || r[i].kind == REC_VALUES) continue;
+            hub_record_t rec = r[i];
+            rec.type[sizeof(rec.type) - 1] = '\0';
+            const double *values = &r[i].value;
+            if (rec.channels > 1) {
+                const hub_values_record_t *v = (const hub_values_record_t*)&r[i + 1];
+                if (rec.channels > HUB_RECORD_CHANNELS || i + 1 >= n || v->kind != REC_VALUES) continue;
+                values = v->values;
+            }
+            group_add(g, &rec, values);
+        }
+    } else {
+        const char *p = data, *end = data + size;
+        char line[256];
+        while (p < end && !g->failed) {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            if (!nl) break;
+            size_t len = (size_t)(nl - p);
+            if ((size_t)(nl + 1 - data) - charged >= COMPACT_READ_CHUNK) {
+                if (!throttle(ctx, (size_t)(nl + 1 - data) - charged)) return false;
+                charged = (size_t)(nl + 1 - data);
+            }
+            hub_record_t rec;
+            double values[HUB_RECORD_CHANNELS];
+            if (len < sizeof(line)) {
+                memcpy(line, p, len);
+                line[len] = '\0';
+                if (record_parse_line(line, &rec, values)) group_add(g, &rec, values);
+            }
+            p = nl + 1;
+        }
+    }
+    return !g->failed && throttle(ctx, size - charged);
+}
+
+static int row_cmp(const void *a, const void *b) {
+    const row_t *x = a, *y = b;
+    if (x->ts != y->ts) return x->ts < y->ts ? -1 : 1;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int group_cmp(const void *a, const void *b) {
+    const group_t *x = a, *y = b;
+    int c = strncmp(x->type, y->type, 16);
+    if (c) return c;
+    if (x->kind != y->kind) return x->kind - y->kind;
+    return x->channels - y->channels;
+}
+
+// the columns of rows[0..n) into b; bounds into blk
+static void encode_block(buf_t *b, const group_t *g, const row_t *rows, size_t n, compact_block_t *blk) {
+    memset(blk, 0, sizeof(*blk));
+    memcpy(blk->type, g->type, sizeof(blk->type));
+    blk->kind = g->kind;
+    blk->channels = g->channels;
+    blk->rows = (uint32_t)n;
+    blk->min_ms = rows[0].ts;
+    blk->max_ms = rows[n - 1].ts;
+    blk->min = INFINITY;
+    blk->max = -INFINITY;
+
+    unsigned char *p = buf_room(b, 8);
+    if (!p) return;
+    memcpy(p, &rows[0].ts, 8);
+    b->len += 8;
+    int64_t delta = 0;
+    for (size_t i = 1; i < n; ++i) {
+        int64_t d = rows[i].ts - rows[i - 1].ts;
+        put_varint(b, zigzag(d - delta));
+        delta = d;
+    }
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        put_xor(b, &prev, rows[i].value);
+        if (rows[i].value < blk->min) blk->min = rows[i].value;
+        if (rows[i].value > blk->max) blk->max = rows[i].value;
+    }
+    int channels = g->channels > 1 ? g->channels : 0;
+    for (int c = 0; c < channels; ++c) {
+        prev = 0;
+        for (size_t i = 0; i < n; ++i) put_xor(b, &prev, rows[i].ch[c]);
+    }
+}
+
+// write the .col file of the groups to path (via a tmp file and a rename)
+static bool write_col(const char *path, groups_t *g, compact_throttle_fn throttle, void *ctx, compact_entry_t *out) {
+    char tmp[HUB_PATH_LEN + 40];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return false;
+
+    // pack the used groups to the front, sorted
+    size_t ng = 0;
+    for (size_t i = 0; i < g->size; ++i) {
+        if (g->slots[i].type[0]) g->slots[ng++] = g->slots[i];
+    }
+    for (size_t i = ng; i < g->size; ++i) memset(&g->slots[i], 0, sizeof(g->slots[i]));
+    qsort(g->slots, ng, sizeof(*g->slots), group_cmp);
+
+    compact_header_t hdr = { COMPACT_MAGIC, COMPACT_VERSION, 0, 0, g->records, 0 };
+    compact_block_t *index = NULL;
+    size_t cap = 0;
+    buf_t b = { 0 };
+    uint64_t offset = sizeof(hdr);
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    out->min_ms = INT64_MAX;
+    out->max_ms = INT64_MIN;
+    for (size_t i = 0; ok && i < ng; ++i) {
+        group_t *x = &g->slots[i];
+        qsort(x->rows, x->n, sizeof(*x->rows), row_cmp);
+        for (size_t r = 0; ok && r < x->n; r += COMPACT_BLOCK_ROWS) {
+            size_t n = x->n - r < COMPACT_BLOCK_ROWS ? x->n - r : COMPACT_BLOCK_ROWS;
+            if (hdr.num_blocks == cap) {
+                cap = cap ? cap * 2 : 256;
+                compact_block_t *p = realloc(index, sizeof(*p) * cap);
+                if (!p) {
+                    ok = false;
+                    break;
+                }
+                index = p;
+            }
+            compact_block_t *blk = &index[hdr.num_blocks++];
+            b.len = 0;
+            encode_block(&b, x, x->rows + r, n, blk);
+            blk->offset = offset;
+            blk->length = b.len;
+            offset += b.len;
+            if (blk->min_ms < out->min_ms) out->min_ms = blk->min_ms;
+            if (blk->max_ms > out->max_ms) out->max_ms = blk->max_ms;
+            ok = !b.failed && fwrite(b.p, 1, b.len, f) == b.len && throttle(ctx, b.len);
+        }
+    }
+    free(b.p);
+    // the index is read in place: align it
+    static const unsigned char pad[8];
+    size_t npad = (8 - offset % 8) % 8;
+    if (ok && npad) ok = fwrite(pad, 1, npad, f) == npad;
+    hdr.index_offset = offset + npad;
+    if (ok) ok = fwrite(index, sizeof(*index), hdr.num_blocks, f) == hdr.num_blocks;
+    free(index);
+    if (ok) ok = fseek(f, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    if (ok) ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (fclose(f) != 0) ok = false;
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) {
+        unlink(tmp);
+        return false;
+    }
+    out->records = hdr.records;
+    out->bytes = hdr.index_offset + sizeof(compact_block_t) * hdr.num_blocks;
+    return true;
+}
+
+bool compact_segment(const char *log_path, unsigned seq, compact_throttle_fn throttle, void *ctx,
+                     compact_entry_t *out) {
+    char seg[HUB_PATH_LEN + 16], col[HUB_PATH_LEN + 32];
+    segment_path(seg, sizeof(seg), log_path, seq);
+    compact_path(col, sizeof(col), log_path, seq);
+    memset(out, 0, sizeof(*out));
+    out->seq = seq;
+
+    int fd = open(seg, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat sb;
+    const char *data = NULL;
+    if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+        data = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) data = NULL;
+        else madvise((void*)data, (size_t)sb.st_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    if (!data && sb.st_size > 0) return false;
+    out->raw_bytes = (uint64_t)sb.st_size;
+
+    groups_t g = { 0 };
+    bool ok = !data || read_segment(&g, data, (size_t)sb.st_size, throttle, ctx);
+    if (data) munmap((void*)data, (size_t)sb.st_size);
+    if (ok) ok = write_col(col, &g, throttle, ctx, out);
+    groups_free(&g);
+    if (!ok) return false;
+    if (!out->records) out->min_ms = out->max_ms = 0;
+
+    // the manifest is the switch: before it the raw segment counts, after it the .col file
+    if (!sync_dir(log_path) || !manifest_add(log_path, out)) {
+        unlink(col);
+        return false;
+    }
+    compact_remove_raw(log_path, seq);
+    sync_dir(log_path);
+    return true;
+}
+
+// reader
+
+compact_file_t *compact_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat sb;
+    const unsigned char *data = NULL;
+    if (fstat(fd, &sb) == 0 && (size_t)sb.st_size >= sizeof(compact_header_t)) {
+        data = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) data = NULL;
+    }
+    close(fd);
+    if (!data) return NULL;
+    size_t size = (size_t)sb.st_size;
+    const compact_header_t *hdr = (const compact_header_t*)data;
+    if (hdr->magic != COMPACT_MAGIC || hdr->version != COMPACT_VERSION || hdr->index_offset > size ||
+        (size - hdr->index_offset) / sizeof(compact_block_t) < hdr->num_blocks || hdr->index_offset % 8) {
+        munmap((void*)data, size);
+        return NULL;
+    }
+    compact_file_t *f = malloc(sizeof(*f));
+    if (!f) {
+        munmap((void*)data, size);
+        return NULL;
+    }
+    *f = (compact_file_t){ hdr, (const compact_block_t*)(data + hdr->index_offset), data, size };
+    return f;
+}
+
+void compact_close(compact_file_t *f) {
+    if (!f) return;
+    munmap((void*)f->data, f->size);
+    free(f);
+}
+
+typedef struct {
+    const unsigned char *p, *end;
+} cursor_t;
+
+static bool get_varint(cursor_t *c, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; c->p < c->end && shift < 64; shift += 7) {
+        unsigned char byte = *c->p++;
+        *v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// one XOR column of n values, stride apart in out
+static bool get_xor(cursor_t *c, size_t n, double *out, size_t stride) {
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (c->p >= c->end) return false;
+        unsigned ctl = *c->p++, tz = ctl >> 4, kept = ctl & 15;
+        if (ctl && (kept == 0 || tz + kept > 8 || (size_t)(c->end - c->p) < kept)) return false;
+        uint64_t x = 0;
+        for (unsigned k = 0; k < kept; ++k) x |= (uint64_t)c->p[k] << (8 * k);
+        c->p += kept;
+        prev ^= x << (8 * tz);
+        memcpy(&out[i * stride], &prev, sizeof(prev));
+    }
+    return true;
+}
+
+bool compact_decode(const compact_file_t *f, const compact_block_t *b, int64_t *ts, double *values, double *channels) {
+    if (b->offset > f->hdr->index_offset || b->length > f->hdr->index_offset - b->offset || b->rows == 0) return false;
+    cursor_t c = { f->data + b->offset, f->data + b->offset + b->length };
+    size_t n = b->rows;
+    if (c.end - c.p < 8) return false;
+    memcpy(&ts[0], c.p, 8);
+    c.p += 8;
+    int64_t delta = 0;
+    for (size_t i = 1; i < n; ++i) {
+        uint64_t z;
+        if (!get_varint(&c, &z)) return false;
+        delta += (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+        ts[i] = ts[i - 1] + delta;
+    }
+    if (!get_xor(&c, n, values, 1)) return false;
+    int ch = b->channels > 1 ? b->channels : 0;
+    if (ch > HUB_RECORD_CHANNELS) return false;
+    for (int k = 0; k < ch; ++k) {
+        if (!get_xor(&c, n, channels + k, (size_t)ch)) return false;
+    }
+    return c.p == c.end;
+}
@@ -0,0 +1,102 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Compacted log segments (--compact): a background thread rewrites each
+// closed segment "<log>.NNNNNN" into "<log>.NNNNNN.col". The records are
+// grouped by sensor and kind, sorted by timestamp and cut into blocks of at
+// most COMPACT_BLOCK_ROWS rows, one compressed column after the other:
+//
+//   timestamps  the first as int64, then zigzag varints of delta-of-delta
+//   values      XOR with the previous value (0 before the first); byte 0 if
+//               equal, else (trailing zero bytes << 4 | bytes kept) and the
+//               kept bytes of the XOR, low byte first
+//   channels    multi-channel samples: one such column per channel
+//
+// The file is a header, the blocks and, at index_offset, the index of all
+// blocks (sensor, kind, rows, time and value bounds, position), sorted by
+// sensor, kind and time. Queries read the index and decode only the blocks
+// that can match.
+//
+// "<log>.compact" (the manifest) lists the compacted segments. It is
+// replaced atomically once the .col file is on disk; only then are the raw
+// segment, its zone map and its Bloom filter deleted. Readers take a listed
+// segment from its .col file even while the raw files are still there.
+
+#define COMPACT_MAGIC 0x43435348u   /* "HSCC" little-endian */
+#define COMPACT_VERSION 1
+#define COMPACT_BLOCK_ROWS 4096
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_blocks;
+    uint32_t reserved;
+    uint64_t records;        // samples and alerts
+    uint64_t index_offset;   // num_blocks compact_block_t
+} compact_header_t;
+
+typedef struct {
+    char type[16];
+    uint8_t kind;            // REC_SAMPLE or REC_ALERT
+    uint8_t channels;        // as in hub_record_t
+    uint8_t reserved[2];
+    uint32_t rows;
+    int64_t min_ms, max_ms;
+    double min, max;         // of the record value (magnitude, alert metric)
+    uint64_t offset, length; // of the encoded columns
+} compact_block_t;
+
+_Static_assert(sizeof(compact_header_t) == 32, "compact_header_t layout changed");
+_Static_assert(sizeof(compact_block_t) == 72, "compact_block_t layout changed");
+
+// one line of the manifest
+typedef struct {
+    unsigned seq;
+    uint64_t records;
+    uint64_t raw_bytes, bytes;   // segment and .col sizes
+    int64_t min_ms, max_ms;
+} compact_entry_t;
+
+// "<log>.NNNNNN.col"
+void compact_path(char *buf, size_t n, const char *log_path, unsigned seq);
+
+// entries of the manifest sorted by seq (caller frees); 0 without one, -1 if invalid
+int compact_manifest_load(const char *log_path, compact_entry_t **entries);
+
+// Called with the bytes read or written so far in between; returns false to
+// abandon the segment (nothing is changed then).
+typedef bool (*compact_throttle_fn)(void *ctx, size_t bytes);
+
+// Compact closed segment seq of log_path, add it to the manifest and delete
+// the raw files. The caller excludes other compactors (see compact_lock).
+bool compact_segment(const char *log_path, unsigned seq, compact_throttle_fn throttle, void *ctx,
+                     compact_entry_t *out);
+
+// delete the raw files of a segment the manifest already lists
+void compact_remove_raw(const char *log_path, unsigned seq);
+
+// exclusive lock "<log>.compact.lock" held until compact_unlock; -1 if
+// another compactor holds it
+int compact_lock(const char *log_path);
+void compact_unlock(int fd);
+
+// reader: a .col file, memory-mapped
+typedef struct {
+    const compact_header_t *hdr;
+    const compact_block_t *blocks;
+    const unsigned char *data;
+    size_t size;
+} compact_file_t;
+
+// NULL if missing or invalid
+compact_file_t *compact_open(const char *path);
+void compact_close(compact_file_t *f);
+
+// decode a block: rows timestamps and values, and for multi-channel samples
+// rows * channels channel values (row by row); false if it is corrupt
+bool compact_decode(const compact_file_t *f, const compact_block_t *b, int64_t *ts, double *values, double *channels);
+
+#endif
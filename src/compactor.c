@@ -0,0 +1,150 @@
+#define _GNU_SOURCE
+#include "compactor.h"
+#include "compact.h"
+#include "segment.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
+static const hub_config_t *conf;
+static pthread_t compactor_thread_id;
+static bool thread_started = false;
+static bool running = false;          // under lock
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+
+static long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+// sleep up to ms unless compactor_stop() comes first; false once stopping
+static bool pause_ms(long ms) {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ms / 1000;
+    until.tv_nsec += (ms % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&lock);
+    while (running && ms > 0 && pthread_cond_timedwait(&wake, &lock, &until) == 0) {}
+    bool go = running;
+    pthread_mutex_unlock(&lock);
+    return go;
+}
+
+// pacing: bytes so far may not run ahead of rate * elapsed
+typedef struct {
+    long start_ms;
+    unsigned long long bytes;
+} pace_t;
+
+static bool throttle(void *ctx, size_t bytes) {
+    pace_t *p = ctx;
+    p->bytes += bytes;
+    long due = p->start_ms + (long)(p->bytes * 1000 / conf->compact_rate);
+    long now = monotonic_ms();
+    return due > now ? pause_ms(due - now) : pause_ms(0);
+}
+
+static unsigned seq_of(const char *path) {
+    const char *dot = strrchr(path, '.');
+    return dot ? (unsigned)strtoul(dot + 1, NULL, 10) : 0;
+}
+
+static bool listed(const compact_entry_t *e, int n, unsigned seq) {
+    for (int i = 0; i < n; ++i) {
+        if (e[i].seq == seq) return true;
+    }
+    return false;
+}
+
+// one closed segment: compact it if it is old enough; false once stopping
+static bool compact_one(const char *seg, const compact_entry_t *done, int ndone, time_t now) {
+    unsigned seq = seq_of(seg);
+    struct stat sb;
+    if (listed(done, ndone, seq)) {
+        // stopped between the manifest swap and the deletion
+        compact_remove_raw(conf->log_path, seq);
+    } else if (stat(seg, &sb) == 0 && now - sb.st_mtime >= conf->compact_age_s) {
+        pace_t pace = { monotonic_ms(), 0 };
+        compact_entry_t e;
+        if (compact_segment(conf->log_path, seq, throttle, &pace, &e)) {
+            printf("compactor: %s: %llu records, %llu -> %llu bytes in %ld ms\n", seg,
+                   (unsigned long long)e.records, (unsigned long long)e.raw_bytes,
+                   (unsigned long long)e.bytes, monotonic_ms() - pace.start_ms);
+        } else if (pause_ms(0)) {
+            fprintf(stderr, "compactor: cannot compact %s\n", seg);
+        }
+    }
+    return pause_ms(0);
+}
+
+// compact every closed segment old enough, oldest first; false if the
+// manifest is unreadable (compacting would lose its entries)
+static bool compact_pass(void) {
+    int lock_fd = compact_lock(conf->log_path);
+    if (lock_fd < 0) return true;
+    compact_entry_t *done;
+    int ndone = compact_manifest_load(conf->log_path, &done);
+    if (ndone < 0) {
+        fprintf(stderr, "compactor: not compacting %s until its manifest is fixed\n", conf->log_path);
+        compact_unlock(lock_fd);
+        return false;
+    }
+    char **segs;
+    int n = segment_list(conf->log_path, &segs);
+    time_t now = time(NULL);
+    bool go = true;
+    for (int i = 0; i < n; ++i) {
+        if (go) go = compact_one(segs[i], done, ndone, now);
+        free(segs[i]);
+    }
+    if (n > 0) free(segs);
+    free(done);
+    compact_unlock(lock_fd);
+    return true;
+}
+
+static void *compactor_main(void *arg) {
+    (void)arg;
+    // below the processors: lowest CPU priority and idle-class I/O for this thread
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, (id_t)tid, 19);
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+    while (compact_pass() && pause_ms(1000)) {}
+    return NULL;
+}
+
+bool compactor_start(const hub_config_t *cfg) {
+    conf = cfg;
+    pthread_mutex_lock(&lock);
+    running = true;
+    pthread_mutex_unlock(&lock);
+    if (pthread_create(&compactor_thread_id, NULL, compactor_main, NULL) != 0) return false;
+    thread_started = true;
+    return true;
+}
+
+void compactor_stop(void) {
+    if (!thread_started) return;
+    pthread_mutex_lock(&lock);
+    running = false;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(compactor_thread_id, NULL);
+    thread_started = false;
+}
@@ -0,0 +1,17 @@
+#ifndef COMPACTOR_H
+#define COMPACTOR_H
+#include <stdbool.h>
+#include "config.h"
+
+// Background compaction of closed log segments (--compact, src/compact.h).
+// One low-priority thread per process checks the segments of
+// cfg->log_path every second and compacts those older than
+// cfg->compact_age_s, reading and writing at most cfg->compact_rate bytes
+// per second. A lock file keeps two processes (e.g. both sides of a
+// handover) from compacting the same log.
+bool compactor_start(const hub_config_t *cfg);
+
+// stop the thread; a segment being compacted is abandoned unchanged
+void compactor_stop(void);
+
+#endif
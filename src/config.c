@@ -0,0 +1,705 @@
+#define _POSIX_C_SOURCE 200809L
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+
+// sensors used when no --sensors file is given (matches tools/check_log.py)
+static const sensor_config_t default_sensors[] = {
+    { "TEMP",  500,  22.0,  15, 5, 28.0,   1, ALERT_MEAN, ENC_F64, 1.0, 0.0, { 0 } },
+    { "HUM",   700,  40.0,  56, 5, 80.0,   1, ALERT_MEAN, ENC_F64, 1.0, 0.0, { 0 } },
+    { "PRESS", 1200, 995.0, 26, 5, 1015.0, 1, ALERT_MEAN, ENC_F64, 1.0, 0.0, { 0 } },
+};
+
+void config_usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --config FILE            read options from FILE (key = value per line)\n"
+        "  --test-duration S        run S seconds then exit (default: until Ctrl+C)\n"
+        "  --log PATH               log file (default data/hub.log)\n"
+        "  --log-format text|binary record format (default text)\n"
+        "  --log-segment-mb N       close the log into numbered segments of N MiB (default 0 = off)\n"
+        "  --durability none|flush|fsync\n"
+        "                           per-record log durability (default flush)\n"
+        "  --queue-size N           queue slots per processor shard (default 1024)\n"
+        "  --shards N               processor threads (default 1)\n"
+        "  --pin-cpus LIST          pin processor shards to CPUs, e.g. 0,2,3\n"
+        "  --sensors FILE           sensor definitions (default TEMP/HUM/PRESS)\n"
+        "  --metrics-socket PATH    serve queue statistics on a Unix socket\n"
+        "  --ingest-socket PATH     accept samples from external producers (Unix datagrams)\n"
+        "  --handover-socket PATH   accept a successor process for zero-downtime upgrades\n"
+        "  --takeover               take over sockets and state from the hub on --handover-socket\n"
+        "  --benchmark              sensors run at full rate, stats printed on exit\n"
+        "  --checkpoint PATH        save/restore processor windows (warm restart)\n"
+        "  --checkpoint-interval S  periodic checkpoint interval (default 10, 0 = shutdown only)\n"
+        "  --checkpoint-max-age S   ignore older checkpoints on restore (default 300)\n"
+        "  --history N              processed samples kept in memory per sensor (default 1024)\n"
+        "  --rollup-slots N         buckets kept per sensor for each rollup tier (default 120)\n"
+        "  --frames LIST            align these sensors into fixed-rate frames, e.g. TEMP,HUM,PRESS\n"
+        "  --frame-ms N             frame period (default 1000)\n"
+        "  --frame-mode hold|linear last value or linear interpolation (default hold)\n"
+        "  --frame-len N            frames kept in memory (default 1024)\n"
+        "  --zone-map               index the log in LOG.zmap (per-block value/time bounds)\n"
+        "  --zone-block KIB         log bytes per zone map block (default 256)\n"
+        "  --store DIR              also store samples in per-sensor, per-day column files\n"
+        "  --compact                compact closed log segments into compressed column files\n"
+        "  --compact-age S          only segments closed at least S seconds ago (default 3600)\n"
+        "  --compact-rate KIB       compactor I/O per second (default 8192)\n"
+        "  --egress-socket PATH     stream log records to subscribers on a Unix socket\n"
+        "  --egress-port N          same on 127.0.0.1:N (TCP)\n"
+        "  --egress-buffer KIB      send buffer per subscriber (default 256)\n"
+        "  --http-port N            serve history and rollups over HTTP on 127.0.0.1:N\n"
+        "  --alert-webhook URL      POST alert batches to http://HOST[:PORT]/PATH\n"
+        "  --alert-command CMD      run CMD (sh -c) with each alert batch on stdin\n"
+        "  --alert-queue N          alerts waiting for delivery (default 1024)\n"
+        "  --alert-workers N        delivery threads (default 2)\n"
+        "  --alert-batch N          most alerts per delivery (default 64)\n"
+        "  --alert-linger MS        wait for more alerts before sending a batch (default 100)\n"
+        "  --alert-retries N        retries of a failed delivery (default 5)\n"
+        "  --alert-backoff MS       first retry delay, doubled for each next one (default 200)\n"
+        "\n"
+        "aggregator mode: %s --aggregate [--aggregate-out PATH] [--log-format F] LOG...\n"
+        "  merges hub logs by timestamp into one stream (default stdout)\n"
+        "backtest mode: %s --backtest [--sensors FILE] [--shards N] [--backtest-out PATH] [--log-format F] LOG...\n"
+        "           or: %s --backtest --store DIR [options]\n"
+        "  replays the logs' samples through the sensors' alert rules, one thread per shard,\n"
+        "  and writes the alerts that would have fired (default stdout); with --sweep FILE it\n"
+        "  evaluates the candidate thresholds/windows/hysteresis in FILE and writes CSV instead;\n"
+        "  with --store it reads the column store instead of logs\n",
+        prog, prog, prog, prog);
+}
+
+static bool copy_str(char *dst, size_t n, const char *src, const char *key) {
+    if (strlen(src) >= n) {
+        fprintf(stderr, "config: value for %s is too long\n", key);
+        return false;
+    }
+    strcpy(dst, src);
+    return true;
+}
+
+static bool parse_long(const char *s, long min, long max, long *out, const char *key) {
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (*s == '\0' || *end != '\0' || v < min || v > max) {
+        fprintf(stderr, "config: invalid value '%s' for %s\n", s, key);
+        return false;
+    }
+    *out = v;
+    return true;
+}
+
+static bool parse_double(const char *s, double *out, const char *key) {
+    char *end;
+    double v = strtod(s, &end);
+    if (*s == '\0' || *end != '\0' || isnan(v)) {
+        fprintf(stderr, "config: invalid value '%s' for %s\n", s, key);
+        return false;
+    }
+    *out = v;
+    return true;
+}
+
+static bool parse_bool(const char *s, bool *out, const char *key) {
+    if (!strcasecmp(s, "1") || !strcasecmp(s, "true") || !strcasecmp(s, "yes") || !strcasecmp(s, "on")) {
+        *out = true;
+    } else if (!strcasecmp(s, "0") || !strcasecmp(s, "false") || !strcasecmp(s, "no") || !strcasecmp(s, "off")) {
+        *out = false;
+    } else {
+        fprintf(stderr, "config: invalid value '%s' for %s\n", s, key);
+        return false;
+    }
+    return true;
+}
+
+static bool parse_cpu_list(hub_config_t *cfg, const char *s) {
+    char buf[HUB_PATH_LEN];
+    if (!copy_str(buf, sizeof(buf), s, "pin-cpus")) return false;
+    cfg->num_pin_cpus = 0;
+    for (char *save = NULL, *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        long cpu;
+        if (cfg->num_pin_cpus == HUB_MAX_CPUS || !parse_long(tok, 0, 4095, &cpu, "pin-cpus")) return false;
+        cfg->pin_cpus[cfg->num_pin_cpus++] = (int)cpu;
+    }
+    return true;
+}
+
+static const char *const option_keys[] = {
+    "test-duration", "log", "log-format", "log-segment-mb", "durability", "queue-size", "shards",
+    "pin-cpus", "sensors", "metrics-socket", "benchmark", "aggregate", "aggregate-out",
+    "backtest", "backtest-out", "sweep",
+    "checkpoint", "checkpoint-interval", "checkpoint-max-age",
+    "ingest-socket", "handover-socket", "takeover", "history", "rollup-slots",
+    "frames", "frame-ms", "frame-mode", "frame-len", "zone-map", "zone-block",
+    "store", "compact", "compact-age", "compact-rate",
+    "egress-socket", "egress-port", "egress-buffer", "http-port",
+    "alert-webhook", "alert-command", "alert-queue", "alert-workers", "alert-batch",
+    "alert-linger", "alert-retries", "alert-backoff",
+};
+
+static bool is_option(const char *key) {
+    for (size_t i = 0; i < sizeof(option_keys) / sizeof(option_keys[0]); ++i) {
+        if (strcmp(key, option_keys[i]) == 0) return true;
+    }
+    return false;
+}
+
+// options that take no value on the command line
+static bool is_flag(const char *key) {
+    return strcmp(key, "benchmark") == 0 || strcmp(key, "aggregate") == 0 || strcmp(key, "takeover") == 0 ||
+           strcmp(key, "backtest") == 0 || strcmp(key, "zone-map") == 0 || strcmp(key, "compact") == 0;
+}
+
+// apply one option; keys are the long option names without "--"
+static bool apply_option(hub_config_t *cfg, const char *key, const char *val) {
+    long n;
+    if (strcmp(key, "test-duration") == 0) {
+        if (!parse_long(val, 0, 1000000, &n, key)) return false;
+        cfg->test_duration_s = (int)n;
+    } else if (strcmp(key, "log") == 0) {
+        return copy_str(cfg->log_path, sizeof(cfg->log_path), val, key);
+    } else if (strcmp(key, "log-format") == 0) {
+        if (strcmp(val, "text") == 0) cfg->log_format = LOG_FORMAT_TEXT;
+        else if (strcmp(val, "binary") == 0) cfg->log_format = LOG_FORMAT_BINARY;
+        else { fprintf(stderr, "config: log-format must be text or binary\n"); return false; }
+    } else if (strcmp(key, "durability") == 0) {
+        if (strcmp(val, "none") == 0) cfg->durability = DURABILITY_NONE;
+        else if (strcmp(val, "flush") == 0) cfg->durability = DURABILITY_FLUSH;
+        else if (strcmp(val, "fsync") == 0) cfg->durability = DURABILITY_FSYNC;
+        else { fprintf(stderr, "config: durability must be none, flush or fsync\n"); return false; }
+    } else if (strcmp(key, "queue-size") == 0) {
+        if (!parse_long(val, 2, 1L << 24, &n, key)) return false;
+        cfg->queue_size = (size_t)n;
+    } else if (strcmp(key, "shards") == 0) {
+        if (!parse_long(val, 1, 256, &n, key)) return false;
+        cfg->shards = (int)n;
+    } else if (strcmp(key, "pin-cpus") == 0) {
+        return parse_cpu_list(cfg, val);
+    } else if (strcmp(key, "sensors") == 0) {
+        return copy_str(cfg->sensor_file, sizeof(cfg->sensor_file), val, key);
+    } else if (strcmp(key, "metrics-socket") == 0) {
+        return copy_str(cfg->metrics_socket, sizeof(cfg->metrics_socket), val, key);
+    } else if (strcmp(key, "benchmark") == 0) {
+        return parse_bool(val, &cfg->benchmark, key);
+    } else if (strcmp(key, "aggregate") == 0) {
+        return parse_bool(val, &cfg->aggregate, key);
+    } else if (strcmp(key, "ingest-socket") == 0) {
+        return copy_str(cfg->ingest_socket, sizeof(cfg->ingest_socket), val, key);
+    } else if (strcmp(key, "handover-socket") == 0) {
+        return copy_str(cfg->handover_socket, sizeof(cfg->handover_socket), val, key);
+    } else if (strcmp(key, "takeover") == 0) {
+        return parse_bool(val, &cfg->takeover, key);
+    } else if (strcmp(key, "checkpoint") == 0) {
+        return copy_str(cfg->checkpoint_path, sizeof(cfg->checkpoint_path), val, key);
+    } else if (strcmp(key, "checkpoint-interval") == 0) {
+        if (!parse_long(val, 0, 86400, &n, key)) return false;
+        cfg->checkpoint_interval_s = (int)n;
+    } else if (strcmp(key, "checkpoint-max-age") == 0) {
+        if (!parse_long(val, 0, 365L * 86400, &n, key)) return false;
+        cfg->checkpoint_max_age_s = (int)n;
+    } else if (strcmp(key, "history") == 0) {
+        if (!parse_long(val, 1, 1L << 24, &n, key)) return false;
+        cfg->history_len = (size_t)n;
+    } else if (strcmp(key, "rollup-slots") == 0) {
+        if (!parse_long(val, 1, 1L << 20, &n, key)) return false;
+        cfg->rollup_slots = (size_t)n;
+    } else if (strcmp(key, "frames") == 0) {
+        return copy_str(cfg->frames, sizeof(cfg->frames), val, key);
+    } else if (strcmp(key, "frame-ms") == 0) {
+        if (!parse_long(val, 1, 86400000, &n, key)) return false;
+        cfg->frame_ms = n;
+    } else if (strcmp(key, "frame-mode") == 0) {
+        if (strcmp(val, "hold") == 0) cfg->frame_mode = RESAMPLE_HOLD;
+        else if (strcmp(val, "linear") == 0) cfg->frame_mode = RESAMPLE_LINEAR;
+        else { fprintf(stderr, "config: frame-mode must be hold or linear\n"); return false; }
+    } else if (strcmp(key, "frame-len") == 0) {
+        if (!parse_long(val, 1, 1L << 24, &n, key)) return false;
+        cfg->frame_len = (size_t)n;
+    } else if (strcmp(key, "log-segment-mb") == 0) {
+        if (!parse_long(val, 0, 1L << 20, &n, key)) return false;
+        cfg->log_segment_bytes = (size_t)n << 20;
+    } else if (strcmp(key, "zone-map") == 0) {
+        return parse_bool(val, &cfg->zone_map, key);
+    } else if (strcmp(key, "zone-block") == 0) {
+        if (!parse_long(val, 1, 1L << 20, &n, key)) return false;
+        cfg->zone_block = (size_t)n * 1024;
+    } else if (strcmp(key, "compact") == 0) {
+        return parse_bool(val, &cfg->compact, key);
+    } else if (strcmp(key, "compact-age") == 0) {
+        if (!parse_long(val, 0, 1L << 30, &n, key)) return false;
+        cfg->compact_age_s = (int)n;
+    } else if (strcmp(key, "compact-rate") == 0) {
+        if (!parse_long(val, 1, 1L << 30, &n, key)) return false;
+        cfg->compact_rate = (size_t)n * 1024;
+    } else if (strcmp(key, "egress-socket") == 0) {
+        return copy_str(cfg->egress_socket, sizeof(cfg->egress_socket), val, key);
+    } else if (strcmp(key, "egress-port") == 0) {
+        if (!parse_long(val, 0, 65535, &n, key)) return false;
+        cfg->egress_port = (int)n;
+    } else if (strcmp(key, "egress-buffer") == 0) {
+        if (!parse_long(val, 1, 1L << 20, &n, key)) return false;
+        cfg->egress_buffer = (size_t)n * 1024;
+    } else if (strcmp(key, "http-port") == 0) {
+        if (!parse_long(val, 0, 65535, &n, key)) return false;
+        cfg->http_port = (int)n;
+    } else if (strcmp(key, "alert-webhook") == 0) {
+        if (strncmp(val, "http://", 7) != 0) {
+            fprintf(stderr, "config: alert-webhook must be an http:// URL\n");
+            return false;
+        }
+        return copy_str(cfg->alert_webhook, sizeof(cfg->alert_webhook), val, key);
+    } else if (strcmp(key, "alert-command") == 0) {
+        return copy_str(cfg->alert_command, sizeof(cfg->alert_command), val, key);
+    } else if (strcmp(key, "alert-queue") == 0) {
+        if (!parse_long(val, 1, 1L << 24, &n, key)) return false;
+        cfg->alert_queue = (size_t)n;
+    } else if (strcmp(key, "alert-workers") == 0) {
+        if (!parse_long(val, 1, 64, &n, key)) return false;
+        cfg->alert_workers = (int)n;
+    } else if (strcmp(key, "alert-batch") == 0) {
+        if (!parse_long(val, 1, 4096, &n, key)) return false;
+        cfg->alert_batch = (int)n;
+    } else if (strcmp(key, "alert-linger") == 0) {
+        if (!parse_long(val, 0, 60000, &n, key)) return false;
+        cfg->alert_linger_ms = (int)n;
+    } else if (strcmp(key, "alert-retries") == 0) {
+        if (!parse_long(val, 0, 100, &n, key)) return false;
+        cfg->alert_retries = (int)n;
+    } else if (strcmp(key, "alert-backoff") == 0) {
+        if (!parse_long(val, 1, 60000, &n, key)) return false;
+        cfg->alert_backoff_ms = (int)n;
+    } else if (strcmp(key, "store") == 0) {
+        return copy_str(cfg->store_dir, sizeof(cfg->store_dir), val, key);
+    } else if (strcmp(key, "aggregate-out") == 0) {
+        return copy_str(cfg->aggregate_out, sizeof(cfg->aggregate_out), val, key);
+    } else if (strcmp(key, "backtest") == 0) {
+        return parse_bool(val, &cfg->backtest, key);
+    } else if (strcmp(key, "backtest-out") == 0) {
+        return copy_str(cfg->backtest_out, sizeof(cfg->backtest_out), val, key);
+    } else if (strcmp(key, "sweep") == 0) {
+        return copy_str(cfg->sweep_file, sizeof(cfg->sweep_file), val, key);
+    } else {
+        fprintf(stderr, "config: unknown option '%s'\n", key);
+        return false;
+    }
+    return true;
+}
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1])) *--e = '\0';
+    return s;
+}
+
+// config file: "key = value" (or "key value") per line, '#' starts a comment
+static bool load_config_file(hub_config_t *cfg, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "config: cannot open %s\n", path);
+        return false;
+    }
+    char line[512];
+    int lineno = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *key = trim(line);
+        if (*key == '\0') continue;
+        char *val = key + strcspn(key, "= \t");
+        if (*val) {
+            *val++ = '\0';
+            val = trim(val);
+            if (*val == '=') val = trim(val + 1);
+        }
+        if (*val == '\0' && is_flag(key)) val = "true";
+        if (!apply_option(cfg, key, val)) {
+            fprintf(stderr, "config: %s:%d\n", path, lineno);
+            ok = false;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// sensor file: "NAME key=value ..." per line, keys: interval base span window threshold
+// channels alert encoding scale offset, spectral sources: fft hop spectrum rate,
+// derived band sensors: source band
+static bool parse_sensor_line(char *line, sensor_config_t *s) {
+    char *save = NULL;
+    char *name = strtok_r(line, " \t", &save);
+    memset(s, 0, sizeof(*s));
+    if (!copy_str(s->name, sizeof(s->name), name, "sensor name")) return false;
+    // the name is also a file name in --store-dir partitions
+    if (s->name[0] == '.' || strchr(s->name, '/')) {
+        fprintf(stderr, "config: sensor name '%s' must not start with '.' or contain '/'\n", s->name);
+        return false;
+    }
+    s->interval_ms = 1000;
+    s->span = 1;
+    s->window = 5;
+    s->threshold = HUGE_VAL;
+    s->channels = 1;
+    s->alert = ALERT_MEAN;
+    s->encoding = ENC_F64;
+    s->scale = 1.0;
+    for (char *tok = strtok_r(NULL, " \t", &save); tok; tok = strtok_r(NULL, " \t", &save)) {
+        char *eq = strchr(tok, '=');
+        if (!eq) {
+            fprintf(stderr, "config: expected key=value, got '%s'\n", tok);
+            return false;
+        }
+        *eq = '\0';
+        const char *key = tok;
+        char *val = eq + 1;
+        long n;
+        if (strcmp(key, "interval") == 0) {
+            if (!parse_long(val, 0, 86400000, &n, key)) return false;
+            s->interval_ms = (int)n;
+        } else if (strcmp(key, "base") == 0) {
+            if (!parse_double(val, &s->base, key)) return false;
+        } else if (strcmp(key, "span") == 0) {
+            if (!parse_long(val, 1, 1000000, &n, key)) return false;
+            s->span = (int)n;
+        } else if (strcmp(key, "window") == 0) {
+            if (!parse_long(val, 1, 1000000, &n, key)) return false;
+            s->window = (int)n;
+        } else if (strcmp(key, "threshold") == 0) {
+            if (!parse_double(val, &s->threshold, key)) return false;
+        } else if (strcmp(key, "channels") == 0) {
+            if (!parse_long(val, 1, HUB_MAX_CHANNELS, &n, key)) return false;
+            s->channels = (int)n;
+        } else if (strcmp(key, "alert") == 0) {
+            if (strcmp(val, "mean") == 0) s->alert = ALERT_MEAN;
+            else if (strcmp(val, "magnitude") == 0) s->alert = ALERT_MAGNITUDE;
+            else if (strcmp(val, "median") == 0) s->alert = ALERT_MEDIAN;
+            else if (strcmp(val, "mad") == 0) s->alert = ALERT_MAD;
+            else { fprintf(stderr, "config: alert must be mean, magnitude, median or mad\n"); return false; }
+        } else if (strcmp(key, "encoding") == 0) {
+            if (strcmp(val, "f64") == 0) s->encoding = ENC_F64;
+            else if (strcmp(val, "f32") == 0) s->encoding = ENC_F32;
+            else if (strcmp(val, "i32") == 0) s->encoding = ENC_I32;
+            else if (strcmp(val, "i16") == 0) s->encoding = ENC_I16;
+            else { fprintf(stderr, "config: encoding must be f64, f32, i32 or i16\n"); return false; }
+        } else if (strcmp(key, "scale") == 0) {
+            if (!parse_double(val, &s->scale, key)) return false;
+            if (!(s->scale > 0)) {
+                fprintf(stderr, "config: scale must be positive\n");
+                return false;
+            }
+        } else if (strcmp(key, "offset") == 0) {
+            if (!parse_double(val, &s->offset, key)) return false;
+        } else if (strcmp(key, "fft") == 0) {
+            if (!parse_long(val, 4, 65536, &n, key)) return false;
+            if (n & (n - 1)) {
+                fprintf(stderr, "config: fft must be a power of two\n");
+                return false;
+            }
+            s->spectral.fft = (int)n;
+        } else if (strcmp(key, "hop") == 0) {
+            if (!parse_long(val, 1, 1000000, &n, key)) return false;
+            s->spectral.hop = (int)n;
+        } else if (strcmp(key, "spectrum") == 0) {
+            if (strcmp(val, "block") == 0) s->spectral.sliding = false;
+            else if (strcmp(val, "sliding") == 0) s->spectral.sliding = true;
+            else { fprintf(stderr, "config: spectrum must be block or sliding\n"); return false; }
+        } else if (strcmp(key, "rate") == 0) {
+            if (!parse_double(val, &s->spectral.rate, key)) return false;
+            if (!(s->spectral.rate > 0)) {
+                fprintf(stderr, "config: rate must be positive\n");
+                return false;
+            }
+        } else if (strcmp(key, "source") == 0) {
+            if (!copy_str(s->spectral.source, sizeof(s->spectral.source), val, key)) return false;
+        } else if (strcmp(key, "band") == 0) {
+            // LO-HI in Hz
+            char *dash = strchr(val, '-');
+            if (!dash || dash == val) {
+                fprintf(stderr, "config: band must be LO-HI\n");
+                return false;
+            }
+            *dash = '\0';
+            if (!parse_double(val, &s->spectral.band_lo, key) ||
+                !parse_double(dash + 1, &s->spectral.band_hi, key)) return false;
+            if (s->spectral.band_lo < 0 || s->spectral.band_hi < s->spectral.band_lo) {
+                fprintf(stderr, "config: band needs 0 <= LO <= HI\n");
+                return false;
+            }
+        } else {
+            fprintf(stderr, "config: unknown sensor key '%s'\n", key);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool add_sensor(hub_config_t *cfg, const sensor_config_t *s, int *cap) {
+    if (config_sensor_index(cfg, s->name) >= 0) {
+        fprintf(stderr, "config: duplicate sensor %s\n", s->name);
+        return false;
+    }
+    if (cfg->num_sensors == *cap) {
+        *cap = *cap ? *cap * 2 : 8;
+        sensor_config_t *p = realloc(cfg->sensors, sizeof(*p) * (size_t)*cap);
+        if (!p) return false;
+        cfg->sensors = p;
+    }
+    cfg->sensors[cfg->num_sensors++] = *s;
+    return true;
+}
+
+static bool load_sensor_file(hub_config_t *cfg, const char *path, int *cap) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "config: cannot open sensor file %s\n", path);
+        return false;
+    }
+    char line[512];
+    int lineno = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *p = trim(line);
+        if (*p == '\0') continue;
+        sensor_config_t s;
+        ok = parse_sensor_line(p, &s) && add_sensor(cfg, &s, cap);
+        if (!ok) fprintf(stderr, "config: %s:%d\n", path, lineno);
+    }
+    fclose(f);
+    if (ok && cfg->num_sensors == 0) {
+        fprintf(stderr, "config: %s defines no sensors\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+static uint32_t hash_name(const char *s) {
+    uint32_t h = 2166136261u; // FNV-1a
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// built once all sensors are known; lookups before that fall back to a scan
+static bool rebuild_name_map(hub_config_t *cfg) {
+    size_t size = 16;
+    while (size < (size_t)cfg->num_sensors * 2) size <<= 1;
+    int *map = malloc(sizeof(int) * size);
+    if (!map) return false;
+    for (size_t i = 0; i < size; ++i) map[i] = -1;
+    for (int i = 0; i < cfg->num_sensors; ++i) {
+        size_t h = hash_name(cfg->sensors[i].name) & (size - 1);
+        while (map[h] >= 0) h = (h + 1) & (size - 1);
+        map[h] = i;
+    }
+    free(cfg->name_map);
+    cfg->name_map = map;
+    cfg->name_map_size = size;
+    return true;
+}
+
+// fill spectral defaults and check that every band sensor has a spectral source
+static bool check_spectra(hub_config_t *cfg) {
+    for (int i = 0; i < cfg->num_sensors; ++i) {
+        spectral_config_t *sp = &cfg->sensors[i].spectral;
+        if (sp->fft == 0) continue;
+        if (sp->hop == 0) sp->hop = sp->fft;
+        if (sp->rate == 0) {
+            if (cfg->sensors[i].interval_ms <= 0) {
+                fprintf(stderr, "config: %s: fft needs rate= or an interval\n", cfg->sensors[i].name);
+                return false;
+            }
+            sp->rate = 1000.0 / cfg->sensors[i].interval_ms;
+        }
+    }
+    for (int i = 0; i < cfg->num_sensors; ++i) {
+        const sensor_config_t *s = &cfg->sensors[i];
+        if (!s->spectral.source[0]) continue;
+        int src = config_sensor_index(cfg, s->spectral.source);
+        if (src < 0 || cfg->sensors[src].spectral.fft == 0 || cfg->sensors[src].spectral.source[0]) {
+            fprintf(stderr, "config: %s: source %s is not a sensor with fft=\n", s->name, s->spectral.source);
+            return false;
+        }
+        if (s->channels != 1 || s->spectral.band_hi > cfg->sensors[src].spectral.rate / 2) {
+            fprintf(stderr, "config: %s: band sensors have 1 channel and bands up to rate/2\n", s->name);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool config_add_sensor(hub_config_t *cfg, const sensor_config_t *s) {
+    int cap = cfg->num_sensors; // exact size: the next add reallocates
+    return add_sensor(cfg, s, &cap) && rebuild_name_map(cfg) && check_spectra(cfg);
+}
+
+int config_sensor_index(const hub_config_t *cfg, const char *name) {
+    if (!cfg->name_map) {
+        // map not built yet (while loading): linear scan
+        for (int i = 0; i < cfg->num_sensors; ++i) {
+            if (strcmp(cfg->sensors[i].name, name) == 0) return i;
+        }
+        return -1;
+    }
+    size_t mask = cfg->name_map_size - 1;
+    for (size_t h = hash_name(name) & mask;; h = (h + 1) & mask) {
+        int i = cfg->name_map[h];
+        if (i < 0) return -1;
+        if (strcmp(cfg->sensors[i].name, name) == 0) return i;
+    }
+}
+
+bool config_defaults(hub_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    strcpy(cfg->log_path, "data/hub.log");
+    strcpy(cfg->aggregate_out, "-");
+    strcpy(cfg->backtest_out, "-");
+    cfg->checkpoint_interval_s = 10;
+    cfg->checkpoint_max_age_s = 300;
+    cfg->history_len = 1024;
+    cfg->rollup_slots = 120;
+    cfg->frame_ms = 1000;
+    cfg->frame_mode = RESAMPLE_HOLD;
+    cfg->frame_len = 1024;
+    cfg->zone_block = 256 * 1024;
+    cfg->compact_age_s = 3600;
+    cfg->compact_rate = 8192 * 1024;
+    cfg->egress_buffer = 256 * 1024;
+    cfg->alert_queue = 1024;
+    cfg->alert_workers = 2;
+    cfg->alert_batch = 64;
+    cfg->alert_linger_ms = 100;
+    cfg->alert_retries = 5;
+    cfg->alert_backoff_ms = 200;
+    cfg->log_format = LOG_FORMAT_TEXT;
+    cfg->durability = DURABILITY_FLUSH;
+    cfg->queue_size = 1024;
+    cfg->shards = 1;
+    int n = (int)(sizeof(default_sensors) / sizeof(default_sensors[0]));
+    cfg->sensors = malloc(sizeof(default_sensors));
+    if (!cfg->sensors) return false;
+    memcpy(cfg->sensors, default_sensors, sizeof(default_sensors));
+    cfg->num_sensors = n;
+    return rebuild_name_map(cfg);
+}
+
+bool config_load(hub_config_t *cfg, int argc, char **argv) {
+    if (!config_defaults(cfg)) return false;
+
+    // the config file is applied first so command-line options override it
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--config") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "config: --config needs a value\n");
+                return false;
+            }
+            if (!load_config_file(cfg, argv[++i])) return false;
+        }
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--config") == 0) {
+            i++;
+            continue;
+        }
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            config_usage(argv[0]);
+            return false;
+        }
+        if (strncmp(argv[i], "--", 2) != 0 || strcmp(argv[i], "-") == 0) {
+            // positional arguments are aggregator / backtest inputs
+            if (!cfg->inputs) cfg->inputs = calloc((size_t)argc, sizeof(char*));
+            if (!cfg->inputs) return false;
+            cfg->inputs[cfg->num_inputs++] = argv[i];
+            continue;
+        }
+        const char *key = argv[i] + 2;
+        if (!is_option(key)) {
+            fprintf(stderr, "config: unknown option '%s'\n", argv[i]);
+            config_usage(argv[0]);
+            return false;
+        }
+        if (is_flag(key)) {
+            if (!apply_option(cfg, key, "true")) return false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "config: --%s needs a value\n", key);
+            return false;
+        }
+        if (!apply_option(cfg, key, argv[++i])) return false;
+    }
+
+    if (cfg->sensor_file[0]) {
+        int cap = 0;
+        free(cfg->sensors);
+        free(cfg->name_map);
+        cfg->sensors = NULL;
+        cfg->name_map = NULL;
+        cfg->num_sensors = 0;
+        if (!load_sensor_file(cfg, cfg->sensor_file, &cap)) return false;
+        if (!rebuild_name_map(cfg) || !check_spectra(cfg)) return false;
+    }
+    if (cfg->takeover && !cfg->handover_socket[0]) {
+        fprintf(stderr, "config: --takeover needs --handover-socket\n");
+        return false;
+    }
+    if (cfg->aggregate && cfg->backtest) {
+        fprintf(stderr, "config: --aggregate and --backtest are exclusive\n");
+        return false;
+    }
+    if (cfg->sweep_file[0] && !cfg->backtest) {
+        fprintf(stderr, "config: --sweep needs --backtest\n");
+        return false;
+    }
+    if (cfg->backtest && cfg->store_dir[0] && cfg->num_inputs > 0) {
+        fprintf(stderr, "config: --backtest reads either --store or logs\n");
+        return false;
+    }
+    if (cfg->aggregate && cfg->store_dir[0]) {
+        fprintf(stderr, "config: --aggregate does not read --store\n");
+        return false;
+    }
+    if (cfg->num_inputs > 0 && !cfg->aggregate && !cfg->backtest) {
+        fprintf(stderr, "config: unexpected argument '%s'\n", cfg->inputs[0]);
+        return false;
+    }
+    if (cfg->shards > cfg->num_sensors) cfg->shards = cfg->num_sensors;
+    return true;
+}
+
+void config_free(hub_config_t *cfg) {
+    free(cfg->inputs);
+    cfg->inputs = NULL;
+    cfg->num_inputs = 0;
+    free(cfg->sensors);
+    free(cfg->name_map);
+    cfg->sensors = NULL;
+    cfg->name_map = NULL;
+    cfg->num_sensors = 0;
+}
+
+hub_config_t *config_new(int argc, char **argv) {
+    hub_config_t *cfg = calloc(1, sizeof(*cfg));
+    if (!cfg) return NULL;
+    if (!config_load(cfg, argc, argv)) {
+        config_delete(cfg);
+        return NULL;
+    }
+    return cfg;
+}
+
+void config_delete(hub_config_t *cfg) {
+    if (!cfg) return;
+    config_free(cfg);
+    free(cfg);
+}
@@ -0,0 +1,145 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HUB_NAME_LEN 16
+#define HUB_PATH_LEN 256
+#define HUB_MAX_CPUS 64
+#define HUB_MAX_CHANNELS 4   // values per sample (e.g. 3-axis accelerometer)
+
+typedef enum { LOG_FORMAT_TEXT = 0, LOG_FORMAT_BINARY = 1 } log_format_t;
+
+// none: stdio buffering only, flush: fflush every record, fsync: fflush + fdatasync
+typedef enum { DURABILITY_NONE = 0, DURABILITY_FLUSH = 1, DURABILITY_FSYNC = 2 } durability_t;
+
+// mean: alert when the window mean of any channel exceeds the threshold
+// magnitude: alert when the window mean of the per-sample vector magnitude does
+// median/mad: alert when the window median / median absolute deviation of the
+// sample value (magnitude for multi-channel sensors) does; robust to spikes
+typedef enum { ALERT_MEAN = 0, ALERT_MAGNITUDE = 1, ALERT_MEDIAN = 2, ALERT_MAD = 3 } alert_rule_t;
+
+// how frames are filled between a sensor's samples (--frame-mode)
+typedef enum { RESAMPLE_HOLD = 0, RESAMPLE_LINEAR = 1 } resample_mode_t;
+
+// how a sensor's values are stored in queues, windows and history rings.
+// Integer encodings hold round((value - offset) / scale); their window sums
+// are exact integers.
+typedef enum { ENC_F64 = 0, ENC_F32 = 1, ENC_I32 = 2, ENC_I16 = 3 } value_encoding_t;
+
+// spectral operator (src/spectrum.h): a source sensor (fft > 0) feeds derived
+// sensors that each carry the energy of one frequency band of its samples
+typedef struct {
+    int fft;            // source: window in samples (power of two), 0 = none
+    int hop;            // source: band energies every hop samples (default fft)
+    bool sliding;       // source: sliding DFT per sample instead of block FFTs
+    double rate;        // source: sample rate in Hz (default 1000 / interval)
+    char source[HUB_NAME_LEN]; // derived: the source sensor, "" = not derived
+    double band_lo, band_hi;   // derived: band in Hz
+} spectral_config_t;
+
+// one simulated sensor; channel c produces base + ((n + c) % span) every interval_ms.
+// Derived sensors (spectral.source set) are not simulated; the hub feeds them.
+typedef struct {
+    char name[HUB_NAME_LEN];
+    int interval_ms;
+    double base;
+    int span;
+    int window;        // moving-average window (samples)
+    double threshold;  // alert when the full window's average exceeds this
+    int channels;      // values per sample, 1..HUB_MAX_CHANNELS
+    alert_rule_t alert;
+    value_encoding_t encoding;
+    double scale, offset;  // integer encodings: value = raw * scale + offset
+    spectral_config_t spectral;
+} sensor_config_t;
+
+// Runtime configuration. Filled once by config_load() before any thread starts
+// and only read afterwards, so subsystems access it without locking.
+typedef struct {
+    char log_path[HUB_PATH_LEN];
+    log_format_t log_format;
+    size_t log_segment_bytes; // rotate the log into numbered segments (0 = never)
+    durability_t durability;
+    size_t queue_size;        // slots per processor shard
+    int shards;               // processor threads; sensors are split across them
+    int pin_cpus[HUB_MAX_CPUS];
+    int num_pin_cpus;         // 0 = no pinning; shard i runs on pin_cpus[i % n]
+    char sensor_file[HUB_PATH_LEN];
+    char metrics_socket[HUB_PATH_LEN];
+    char ingest_socket[HUB_PATH_LEN];   // datagram socket for external producers
+    char handover_socket[HUB_PATH_LEN]; // listen here for a successor process
+    bool takeover;            // take over from the hub listening on handover_socket
+    bool benchmark;           // sensors produce at full rate, stats printed on exit
+    int test_duration_s;      // 0 = run until SIGINT
+    char checkpoint_path[HUB_PATH_LEN]; // "" = no checkpoints
+    int checkpoint_interval_s; // periodic checkpoints (0 = only at shutdown)
+    int checkpoint_max_age_s;  // older checkpoints are ignored on restore
+    size_t history_len;       // processed samples kept per sensor (history ring)
+    size_t rollup_slots;      // buckets kept per sensor and rollup tier
+    char frames[HUB_PATH_LEN]; // sensors aligned into frames, comma-separated ("" = off)
+    long frame_ms;            // frame period
+    resample_mode_t frame_mode;
+    size_t frame_len;         // frames kept in memory
+    bool zone_map;            // write "<log>.zmap" (src/zonemap.h)
+    size_t zone_block;        // target zone map block size in bytes
+    char store_dir[HUB_PATH_LEN]; // column store (src/store.h), "" = off
+    bool compact;             // compact closed log segments (src/compactor.h)
+    int compact_age_s;        // segments closed at least this long ago
+    size_t compact_rate;      // compactor I/O, bytes per second
+    char egress_socket[HUB_PATH_LEN]; // record stream (src/egress.h), "" = off
+    int egress_port;          // same on loopback TCP, 0 = off
+    size_t egress_buffer;     // send buffer per subscriber, bytes
+    int http_port;            // query API (src/http.h) on loopback, 0 = off
+    char alert_webhook[HUB_PATH_LEN]; // alert delivery (src/dispatch.h), "" = off
+    char alert_command[HUB_PATH_LEN]; // same to a shell command, "" = off
+    size_t alert_queue;       // alerts waiting for the batcher
+    int alert_workers;        // delivery threads
+    int alert_batch;          // most alerts per delivery
+    int alert_linger_ms;      // a batch is sent this long after its first alert
+    int alert_retries;        // failed deliveries retried this often
+    int alert_backoff_ms;     // before the first retry, doubled for each next one
+
+    // aggregator mode: merge the positional input logs instead of running a hub
+    bool aggregate;
+    char aggregate_out[HUB_PATH_LEN]; // "-" = stdout
+
+    // backtest mode: replay the input logs' samples through the alert rules
+    bool backtest;
+    char backtest_out[HUB_PATH_LEN];  // alerts that would have fired, "-" = stdout
+    char sweep_file[HUB_PATH_LEN];    // candidate rules to evaluate instead (CSV out)
+    char **inputs;            // points into argv (aggregator and backtest inputs)
+    int num_inputs;
+
+    sensor_config_t *sensors;
+    int num_sensors;
+
+    // name -> sensor index, open addressing (see config_sensor_index)
+    int *name_map;
+    size_t name_map_size;
+} hub_config_t;
+
+// Fill defaults, then apply --config FILE (if given), then the remaining
+// command-line options, then load the sensor file. Prints a message and
+// returns false on any error.
+bool config_load(hub_config_t *cfg, int argc, char **argv);
+
+// Defaults only (used by the test and benchmark drivers)
+bool config_defaults(hub_config_t *cfg);
+
+void config_free(hub_config_t *cfg);
+
+// Heap-allocated config_load() for library bindings, which cannot embed the
+// struct; argv[0] is ignored as usual. NULL on error.
+hub_config_t *config_new(int argc, char **argv);
+void config_delete(hub_config_t *cfg);
+
+// append a sensor after loading (drivers and bindings); false if the name is taken
+bool config_add_sensor(hub_config_t *cfg, const sensor_config_t *s);
+
+// -1 if the name is not a configured sensor
+int config_sensor_index(const hub_config_t *cfg, const char *name);
+
+void config_usage(const char *prog);
+
+#endif
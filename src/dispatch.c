@@ -0,0 +1,504 @@
+#define _GNU_SOURCE
+#include "dispatch.h"
+#include "hub.h"
+#include "record.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define MAX_DESTS 2             // one webhook, one command
+#define MAX_BATCHES 32          // closed batches waiting per destination
+#define MAX_BACKOFF_MS 10000
+#define DELIVERY_TIMEOUT_MS 5000 // per request or command run
+#define STOP_FLUSH_MS 3000
+#define NAME_JSON_MAX (2 + 15 * 6) // a 15-character name, every character as \u00XX
+// longest JSON object of one alert: keys and punctuation, name, value, timestamp
+#define ALERT_JSON_MAX (64 + NAME_JSON_MAX + 24 + 20)
+
+extern char **environ;
+
+typedef enum { DEST_WEBHOOK, DEST_COMMAND } dest_kind_t;
+
+typedef struct {
+    hub_record_t *alerts;     // cfg->alert_batch slots
+    int n;
+    int attempt;              // failed deliveries so far
+    long not_before;          // monotonic ms of the next attempt
+} batch_t;
+
+typedef struct {
+    dest_kind_t kind;
+    const char *target;       // URL or command, for messages
+    char host[128], port[8], path[HUB_PATH_LEN];  // webhook
+    char *body;               // JSON of one batch, used by the delivering worker
+
+    // the batch being filled; batcher only
+    hub_record_t *open;
+    int open_len;
+    long open_deadline;
+
+    // closed batches, oldest first; guarded by lock
+    batch_t ready[MAX_BATCHES];
+    int ready_head, ready_len;
+    bool busy;                // a worker is delivering ready[ready_head]
+    bool overflowing;         // batches are being dropped (reported once)
+    unsigned long delivered, failed, retries;
+} dest_t;
+
+static hub_t *source = NULL;
+static const hub_config_t *config = NULL;
+static dest_t dests[MAX_DESTS];
+static int num_dests = 0;
+
+// single producer (the hook runs under the hub's log lock), single consumer
+// (the batcher)
+static hub_record_t *queue = NULL;
+static atomic_size_t q_head, q_tail;
+static atomic_ulong q_dropped;
+static sem_t q_posted;          // one post per queued alert
+
+static pthread_t batcher_id;
+static pthread_t *worker_ids = NULL;
+static int num_workers = 0;
+static atomic_int dispatch_running = 0;
+static bool started = false;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work;     // CLOCK_MONOTONIC; a batch is ready or a destination is free
+static bool stopping = false;   // no more batches will be closed
+static long stop_deadline;
+
+static long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static struct timespec monotonic_at(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    return ts;
+}
+
+static void dispatch_hook(void *ctx, const hub_record_t *r) {
+    (void)ctx;
+    size_t tail = atomic_load_explicit(&q_tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&q_head, memory_order_acquire) == config->alert_queue) {
+        atomic_fetch_add_explicit(&q_dropped, 1, memory_order_relaxed);
+        return;
+    }
+    queue[tail % config->alert_queue] = *r;
+    atomic_store_explicit(&q_tail, tail + 1, memory_order_release);
+    sem_post(&q_posted);
+}
+
+// http://HOST[:PORT][/PATH]
+static bool parse_url(dest_t *d, const char *url) {
+    if (strncmp(url, "http://", 7) != 0) return false;
+    const char *p = url + 7;
+    size_t n = strcspn(p, ":/");
+    if (n == 0 || n >= sizeof(d->host)) return false;
+    memcpy(d->host, p, n);
+    d->host[n] = '\0';
+    p += n;
+    strcpy(d->port, "80");
+    if (*p == ':') {
+        n = strcspn(++p, "/");
+        if (n == 0 || n >= sizeof(d->port) || strspn(p, "0123456789") != n) return false;
+        memcpy(d->port, p, n);
+        d->port[n] = '\0';
+        p += n;
+    }
+    if (strlen(p) >= sizeof(d->path)) return false;
+    strcpy(d->path, *p ? p : "/");
+    return true;
+}
+
+// the sensor name as a quoted JSON string: names are not validated, so
+// quotes, backslashes and control characters are escaped
+static void json_name(char out[NAME_JSON_MAX + 1], const char *type) {
+    size_t n = 0;
+    out[n++] = '"';
+    for (size_t i = 0; i < 15 && type[i]; ++i) {
+        unsigned char ch = (unsigned char)type[i];
+        if (ch == '"' || ch == '\\') {
+            out[n++] = '\\';
+            out[n++] = (char)ch;
+        } else if (ch < 0x20) {
+            n += (size_t)sprintf(out + n, "\\u%04x", ch);
+        } else {
+            out[n++] = (char)ch;
+        }
+    }
+    out[n++] = '"';
+    out[n] = '\0';
+}
+
+static size_t batch_json(char *out, const batch_t *b) {
+    size_t len = (size_t)sprintf(out, "{\"alerts\":[");
+    for (int i = 0; i < b->n; ++i) {
+        const hub_record_t *r = &b->alerts[i];
+        char value[32], name[NAME_JSON_MAX + 1];
+        if (isfinite(r->value)) snprintf(value, sizeof(value), "%.17g", r->value);
+        else strcpy(value, "null");
+        json_name(name, r->type);
+        len += (size_t)snprintf(out + len, ALERT_JSON_MAX + 1, "%s{\"sensor\":%s,\"value\":%s,\"ms_timestamp\":%lld}",
+                                i ? "," : "", name, value, (long long)r->ms_timestamp);
+    }
+    len += (size_t)sprintf(out + len, "]}\n");
+    return len;
+}
+
+static bool send_all(int fd, const char *p, size_t n, int flags) {
+    while (n > 0) {
+        ssize_t w = send(fd, p, n, flags | MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// one POST per batch on a fresh connection; true on a 2xx status
+static bool post_webhook(const dest_t *d, const char *body, size_t len) {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *ai;
+    if (getaddrinfo(d->host, d->port, &hints, &ai) != 0) return false;
+    int fd = socket(ai->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool ok = false;
+    if (fd >= 0) {
+        // also bounds connect()
+        struct timeval tv = { DELIVERY_TIMEOUT_MS / 1000, (DELIVERY_TIMEOUT_MS % 1000) * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        char hdr[HUB_PATH_LEN + 256];
+        int n = snprintf(hdr, sizeof(hdr),
+                         "POST %s HTTP/1.1\r\nHost: %s:%s\r\nContent-Type: application/json\r\n"
+                         "Content-Length: %zu\r\nConnection: close\r\n\r\n", d->path, d->host, d->port, len);
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0 && send_all(fd, hdr, (size_t)n, MSG_MORE) &&
+            send_all(fd, body, len, 0)) {
+            // the status line is all we need
+            char resp[64];
+            size_t got = 0;
+            while (got < sizeof(resp) - 1) {
+                ssize_t r = recv(fd, resp + got, sizeof(resp) - 1 - got, 0);
+                if (r < 0 && errno == EINTR) continue;
+                if (r <= 0) break;
+                got += (size_t)r;
+                if (memchr(resp, '\n', got)) break;
+            }
+            resp[got] = '\0';
+            int status = 0;
+            ok = sscanf(resp, "HTTP/1.%*d %d", &status) == 1 && status >= 200 && status < 300;
+        }
+        close(fd);
+    }
+    freeaddrinfo(ai);
+    return ok;
+}
+
+// /bin/sh -c CMD with the batch on stdin; true on exit status 0
+static bool run_command(const dest_t *d, const char *body, size_t len, int count) {
+    // a memfd as stdin: nothing to write while the command runs, and a
+    // command that ignores its input cannot block us
+    int in = memfd_create("sensorhub-alerts", MFD_CLOEXEC);
+    if (in < 0) return false;
+    bool ok = (size_t)write(in, body, len) == len && lseek(in, 0, SEEK_SET) == 0;
+
+    int nenv = 0;
+    while (environ[nenv]) nenv++;
+    char **env = malloc(sizeof(char*) * (size_t)(nenv + 2));
+    char count_var[48];
+    snprintf(count_var, sizeof(count_var), "SENSORHUB_ALERTS=%d", count);
+    pid_t pid = -1;
+    if (ok && env) {
+        int k = 0;
+        for (int i = 0; i < nenv; ++i) {
+            if (strncmp(environ[i], "SENSORHUB_ALERTS=", 17) != 0) env[k++] = environ[i];
+        }
+        env[k++] = count_var;
+        env[k] = NULL;
+        posix_spawn_file_actions_t fa;
+        posix_spawnattr_t attr;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_adddup2(&fa, in, 0);
+        // the hub's sockets and log stay out of the command
+        posix_spawn_file_actions_addclosefrom_np(&fa, 3);
+        posix_spawnattr_init(&attr);
+        // its own process group: a timeout kills whatever the shell started
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attr, 0);
+        char *argv[] = { "sh", "-c", (char*)d->target, NULL };
+        if (posix_spawn(&pid, "/bin/sh", &fa, &attr, argv, env) != 0) pid = -1;
+        posix_spawnattr_destroy(&attr);
+        posix_spawn_file_actions_destroy(&fa);
+    }
+    free(env);
+    close(in);
+    if (pid < 0) return false;
+
+    long deadline = monotonic_ms() + DELIVERY_TIMEOUT_MS;
+    int status;
+    for (;;) {
+        pid_t r = waitpid(pid, &status, WNOHANG);
+        if (r == pid) break;
+        if (r < 0 && errno != EINTR) return false;
+        if (monotonic_ms() >= deadline) {
+            kill(-pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            return false;
+        }
+        struct timespec ts = { 0, 5 * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool deliver(dest_t *d, const batch_t *b) {
+    size_t len = batch_json(d->body, b);
+    if (d->kind == DEST_WEBHOOK) return post_webhook(d, d->body, len);
+    return run_command(d, d->body, len, b->n);
+}
+
+// hand the open batch to the workers
+static void close_batch(dest_t *d) {
+    pthread_mutex_lock(&lock);
+    if (d->ready_len == MAX_BATCHES) {
+        d->failed += (unsigned long)d->open_len;
+        if (!d->overflowing) fprintf(stderr, "alerts: %s: %d batches waiting, dropping new ones\n", d->target, MAX_BATCHES);
+        d->overflowing = true;
+    } else {
+        d->overflowing = false;
+        batch_t *b = &d->ready[(d->ready_head + d->ready_len) % MAX_BATCHES];
+        memcpy(b->alerts, d->open, sizeof(*d->open) * (size_t)d->open_len);
+        b->n = d->open_len;
+        b->attempt = 0;
+        b->not_before = 0;
+        d->ready_len++;
+        pthread_cond_signal(&work);
+    }
+    pthread_mutex_unlock(&lock);
+    d->open_len = 0;
+}
+
+static void *batcher_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        // the hook is removed before dispatch_running is cleared, so the
+        // queue is complete once this sees it cleared
+        bool stop = !atomic_load(&dispatch_running);
+        long now = monotonic_ms();
+        if (!stop) {
+            long until = now + 200;
+            for (int i = 0; i < num_dests; ++i) {
+                if (dests[i].open_len && dests[i].open_deadline < until) until = dests[i].open_deadline;
+            }
+            struct timespec ts = monotonic_at(until);
+            if (until > now) sem_clockwait(&q_posted, CLOCK_MONOTONIC, &ts);
+            while (sem_trywait(&q_posted) == 0) {}
+            now = monotonic_ms();
+        }
+        size_t head = atomic_load_explicit(&q_head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&q_tail, memory_order_acquire);
+        for (; head != tail; ++head) {
+            const hub_record_t *r = &queue[head % config->alert_queue];
+            for (int i = 0; i < num_dests; ++i) {
+                dest_t *d = &dests[i];
+                if (d->open_len == 0) d->open_deadline = now + config->alert_linger_ms;
+                d->open[d->open_len++] = *r;
+                if (d->open_len == config->alert_batch) close_batch(d);
+            }
+            atomic_store_explicit(&q_head, head + 1, memory_order_release);
+        }
+        for (int i = 0; i < num_dests; ++i) {
+            if (dests[i].open_len && (stop || now >= dests[i].open_deadline)) close_batch(&dests[i]);
+        }
+        if (stop) break;
+    }
+    return NULL;
+}
+
+static long backoff_ms(int attempt) {
+    long ms = config->alert_backoff_ms;
+    for (int i = 1; i < attempt && ms < MAX_BACKOFF_MS; ++i) ms *= 2;
+    return ms < MAX_BACKOFF_MS ? ms : MAX_BACKOFF_MS;
+}
+
+static void *worker_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        long now = monotonic_ms();
+        long next = now + 1000;
+        bool pending = false;
+        dest_t *d = NULL;
+        for (int i = 0; i < num_dests && !d; ++i) {
+            dest_t *e = &dests[i];
+            if (e->ready_len == 0) continue;
+            pending = true;
+            if (e->busy) continue;
+            long at = e->ready[e->ready_head].not_before;
+            if (at <= now) d = e;
+            else if (at < next) next = at;
+        }
+        if (stopping && (!pending || now >= stop_deadline)) break;
+        if (!d) {
+            if (stopping && stop_deadline < next) next = stop_deadline;
+            struct timespec ts = monotonic_at(next);
+            pthread_cond_timedwait(&work, &lock, &ts);
+            continue;
+        }
+
+        d->busy = true;
+        batch_t *b = &d->ready[d->ready_head];
+        pthread_mutex_unlock(&lock);
+        bool ok = deliver(d, b);
+        pthread_mutex_lock(&lock);
+        d->busy = false;
+        bool retry = !ok && b->attempt < config->alert_retries;
+        if (ok) {
+            d->delivered += (unsigned long)b->n;
+        } else if (retry) {
+            b->not_before = monotonic_ms() + backoff_ms(++b->attempt);
+            d->retries++;
+        } else {
+            d->failed += (unsigned long)b->n;
+            fprintf(stderr, "alerts: %s: %d alerts not delivered after %d attempts\n", d->target, b->n, b->attempt + 1);
+        }
+        if (!retry) {
+            d->ready_head = (d->ready_head + 1) % MAX_BATCHES;
+            d->ready_len--;
+        }
+        // the destination is free again
+        pthread_cond_broadcast(&work);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static void free_dests(void) {
+    for (int i = 0; i < num_dests; ++i) {
+        dest_t *d = &dests[i];
+        free(d->open);
+        free(d->body);
+        for (int k = 0; k < MAX_BATCHES; ++k) free(d->ready[k].alerts);
+    }
+    num_dests = 0;
+}
+
+static bool add_dest(dest_kind_t kind, const char *target) {
+    dest_t *d = &dests[num_dests++];
+    memset(d, 0, sizeof(*d));
+    d->kind = kind;
+    d->target = target;
+    if (kind == DEST_WEBHOOK && !parse_url(d, target)) {
+        fprintf(stderr, "alerts: bad webhook URL '%s' (expected http://HOST[:PORT]/PATH)\n", target);
+        return false;
+    }
+    size_t n = (size_t)config->alert_batch;
+    d->open = malloc(sizeof(*d->open) * n);
+    d->body = malloc(n * ALERT_JSON_MAX + 32);
+    if (!d->open || !d->body) return false;
+    for (int k = 0; k < MAX_BATCHES; ++k) {
+        d->ready[k].alerts = malloc(sizeof(hub_record_t) * n);
+        if (!d->ready[k].alerts) return false;
+    }
+    return true;
+}
+
+bool dispatch_start(hub_t *hub, const hub_config_t *cfg) {
+    if (started) return false;
+    source = hub;
+    config = cfg;
+    num_dests = 0;
+    bool ok = (!cfg->alert_webhook[0] || add_dest(DEST_WEBHOOK, cfg->alert_webhook)) &&
+              (!cfg->alert_command[0] || add_dest(DEST_COMMAND, cfg->alert_command));
+    queue = ok ? malloc(sizeof(*queue) * cfg->alert_queue) : NULL;
+    worker_ids = ok ? calloc((size_t)cfg->alert_workers, sizeof(*worker_ids)) : NULL;
+    if (!queue || !worker_ids || num_dests == 0) {
+        free(queue);
+        free(worker_ids);
+        queue = NULL;
+        worker_ids = NULL;
+        free_dests();
+        return false;
+    }
+    atomic_store(&q_head, 0);
+    atomic_store(&q_tail, 0);
+    atomic_store(&q_dropped, 0);
+    sem_init(&q_posted, 0, 0);
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&work, &ca);
+    pthread_condattr_destroy(&ca);
+    stopping = false;
+
+    atomic_store(&dispatch_running, 1);
+    if (pthread_create(&batcher_id, NULL, batcher_main, NULL) != 0) {
+        atomic_store(&dispatch_running, 0);
+        free(queue);
+        free(worker_ids);
+        queue = NULL;
+        worker_ids = NULL;
+        free_dests();
+        return false;
+    }
+    num_workers = 0;
+    while (num_workers < cfg->alert_workers &&
+           pthread_create(&worker_ids[num_workers], NULL, worker_main, NULL) == 0) {
+        num_workers++;
+    }
+    started = true;
+    hub_set_alert_hook(hub, dispatch_hook, NULL);
+    if (num_workers == 0) {
+        dispatch_stop();
+        return false;
+    }
+    return true;
+}
+
+void dispatch_stop(void) {
+    if (!started) return;
+    hub_set_alert_hook(source, NULL, NULL);
+    atomic_store(&dispatch_running, 0);
+    sem_post(&q_posted);
+    pthread_join(batcher_id, NULL);
+
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    stop_deadline = monotonic_ms() + STOP_FLUSH_MS;
+    pthread_cond_broadcast(&work);
+    pthread_mutex_unlock(&lock);
+    for (int i = 0; i < num_workers; ++i) pthread_join(worker_ids[i], NULL);
+
+    unsigned long dropped = atomic_load(&q_dropped);
+    if (dropped) printf("Alerts: %lu dropped (queue full)\n", dropped);
+    for (int i = 0; i < num_dests; ++i) {
+        dest_t *d = &dests[i];
+        // out of time: what still waits is lost
+        for (int k = 0; k < d->ready_len; ++k) d->failed += (unsigned long)d->ready[(d->ready_head + k) % MAX_BATCHES].n;
+        printf("Alerts to %s: %lu delivered, %lu failed, %lu retries\n", d->target, d->delivered, d->failed, d->retries);
+    }
+
+    free_dests();
+    free(queue);
+    free(worker_ids);
+    queue = NULL;
+    worker_ids = NULL;
+    pthread_cond_destroy(&work);
+    sem_destroy(&q_posted);
+    started = false;
+}
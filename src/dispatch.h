@@ -0,0 +1,38 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+#include <stdbool.h>
+#include "config.h"
+#include "hub.h"
+
+// Alert delivery to a local webhook (--alert-webhook http://HOST:PORT/PATH)
+// and/or a command (--alert-command CMD, run with /bin/sh -c). Both receive
+// batches of alerts as one JSON document:
+//
+//   {"alerts":[{"sensor":"TEMP","value":28.4,"ms_timestamp":1700000000000},...]}
+//
+// the webhook as the body of a POST (any 2xx status is success), the command
+// on stdin with SENSORHUB_ALERTS=<count> in its environment (exit status 0
+// is success).
+//
+// The processors hand alerts over through the hub's alert hook into a
+// bounded lock-free queue of cfg->alert_queue entries; when it is full the
+// alert is dropped and counted, so a processor never waits for delivery.
+// One batcher thread groups the queued alerts per destination into batches
+// of up to cfg->alert_batch, closing a batch cfg->alert_linger_ms after its
+// first alert. A pool of cfg->alert_workers threads delivers them. A failed
+// batch is retried up to cfg->alert_retries times, waiting
+// cfg->alert_backoff_ms and doubling that each time (up to 10 s); until it
+// succeeds or is given up, the destination's later batches wait behind it,
+// so each destination receives alerts in log order and one that is down or
+// slow only holds up its own alerts.
+//
+// One per process, like the egress. Returns false if a webhook URL cannot
+// be parsed or the threads cannot start.
+bool dispatch_start(hub_t *hub, const hub_config_t *cfg);
+
+// Stop taking alerts, deliver what is queued (for at most 3 s, retries
+// included), stop the threads and print per-destination counts. Call it
+// after the processors have stopped, before the hub is destroyed.
+void dispatch_stop(void);
+
+#endif
@@ -0,0 +1,404 @@
+#define _GNU_SOURCE
+#include "egress.h"
+#include "hub.h"
+#include "record.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define RING_SLOTS 16384        // records between the hub and the egress thread
+#define MAX_SUBSCRIBERS 64
+#define CONTROL_LEN 256         // longest control line
+#define STOP_FLUSH_MS 500
+
+// one record as sent (the values record only for multi-channel samples) and
+// the records the ring had no room for just before it
+typedef struct {
+    hub_record_t r;
+    hub_values_record_t v;
+    unsigned long lost_before;
+} frame_t;
+
+typedef struct {
+    int fd;
+    bool all;                 // no SUB filter
+    unsigned char *want;      // per sensor, when !all
+    long long credit;         // records that may still be sent
+    unsigned long lost;       // dropped since the last REC_DROPPED
+    unsigned char *buf;       // circular, config->egress_buffer bytes
+    size_t head, len;
+    char in[CONTROL_LEN];     // partial control line
+    size_t in_len;
+    bool eof;                 // no more control lines (it may still read)
+} subscriber_t;
+
+static hub_t *source = NULL;
+static const hub_config_t *config = NULL;
+static int unix_listen = -1, tcp_listen = -1;
+static char sock_path[HUB_PATH_LEN];
+static int wake_fd = -1;
+static pthread_t egress_thread_id;
+static atomic_int egress_running = 0;
+static bool thread_started = false;
+
+// single producer (the tap runs under the hub's log lock), single consumer
+static frame_t ring[RING_SLOTS];
+static atomic_size_t ring_head, ring_tail;
+static unsigned long ring_lost;   // since the last push; tap only
+static int64_t last_ms;           // of the last record dispatched
+static atomic_int sleeping;   // the thread is (about to be) in poll()
+
+static subscriber_t subs[MAX_SUBSCRIBERS];
+static int num_subs = 0;
+static atomic_int listening;  // num_subs > 0: without subscribers the tap does nothing
+
+static long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static void egress_tap(void *ctx, const hub_record_t *r, const double *values) {
+    (void)ctx;
+    if (!atomic_load_explicit(&listening, memory_order_relaxed)) return;
+    size_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&ring_head, memory_order_acquire) == RING_SLOTS) {
+        ring_lost++;
+        return;
+    }
+    frame_t *f = &ring[tail % RING_SLOTS];
+    f->r = *r;
+    f->lost_before = ring_lost;
+    ring_lost = 0;
+    if (r->channels > 1) {
+        memset(&f->v, 0, sizeof(f->v));
+        f->v.magic = HUB_RECORD_MAGIC;
+        f->v.kind = REC_VALUES;
+        f->v.channels = r->channels;
+        memcpy(f->v.values, values, sizeof(double) * r->channels);
+    }
+    atomic_store(&ring_tail, tail + 1);
+    // only a sleeping thread needs the syscall
+    if (atomic_exchange(&sleeping, 0)) {
+        uint64_t one = 1;
+        ssize_t w = write(wake_fd, &one, sizeof(one));
+        (void)w;
+    }
+}
+
+static void close_subscriber(int i) {
+    close(subs[i].fd);
+    free(subs[i].want);
+    free(subs[i].buf);
+    subs[i] = subs[--num_subs];
+    atomic_store(&listening, num_subs > 0);
+}
+
+static void accept_subscribers(int listen_fd, bool tcp) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        if (num_subs == MAX_SUBSCRIBERS) {
+            close(fd);
+            continue;
+        }
+        subscriber_t *s = &subs[num_subs];
+        memset(s, 0, sizeof(*s));
+        s->fd = fd;
+        s->all = true;
+        s->want = calloc((size_t)hub_sensor_count(source) + 1, 1);
+        s->buf = malloc(config->egress_buffer);
+        if (!s->want || !s->buf) {
+            free(s->want);
+            free(s->buf);
+            close(fd);
+            continue;
+        }
+        if (tcp) {
+            // batches are written whole; don't let Nagle hold back the last one
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        num_subs++;
+        atomic_store(&listening, 1);
+    }
+}
+
+static void control_line(subscriber_t *s, char *line) {
+    if (strncmp(line, "SUB ", 4) == 0) {
+        char *list = line + 4, *save = NULL;
+        s->all = strcmp(list, "*") == 0;
+        memset(s->want, 0, (size_t)hub_sensor_count(source));
+        if (s->all) return;
+        // unknown names match nothing
+        for (char *name = strtok_r(list, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+            int i = hub_sensor_index(source, name);
+            if (i >= 0) s->want[i] = 1;
+        }
+    } else if (strncmp(line, "CREDIT ", 7) == 0) {
+        long long n = strtoll(line + 7, NULL, 10);
+        if (n > 0) s->credit = n > LLONG_MAX - s->credit ? LLONG_MAX : s->credit + n;
+    }
+}
+
+// false if the subscriber sent a line too long
+static bool read_control(subscriber_t *s) {
+    for (;;) {
+        ssize_t n = read(s->fd, s->in + s->in_len, sizeof(s->in) - 1 - s->in_len);
+        if (n == 0) {
+            // half-closed: keep streaming until a write fails or it hangs up
+            s->eof = true;
+            return true;
+        }
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        s->in_len += (size_t)n;
+        s->in[s->in_len] = '\0';
+        char *line = s->in, *nl;
+        while ((nl = strchr(line, '\n'))) {
+            *nl = '\0';
+            if (nl > line && nl[-1] == '\r') nl[-1] = '\0';
+            control_line(s, line);
+            line = nl + 1;
+        }
+        s->in_len -= (size_t)(line - s->in);
+        memmove(s->in, line, s->in_len);
+        if (s->in_len == sizeof(s->in) - 1) return false;
+    }
+}
+
+static void put(subscriber_t *s, const void *data, size_t n) {
+    size_t size = config->egress_buffer;
+    size_t tail = (s->head + s->len) % size;
+    size_t first = n < size - tail ? n : size - tail;
+    memcpy(s->buf + tail, data, first);
+    memcpy(s->buf, (const unsigned char*)data + first, n - first);
+    s->len += n;
+}
+
+static void put_dropped(subscriber_t *s, int64_t ms) {
+    hub_record_t d;
+    record_fill(&d, REC_DROPPED, "", (double)s->lost, (long)ms);
+    put(s, &d, sizeof(d));
+    s->lost = 0;
+}
+
+static void deliver(subscriber_t *s, const frame_t *f, size_t n) {
+    size_t need = n + (s->lost ? sizeof(hub_record_t) : 0);
+    if (s->credit <= 0 || config->egress_buffer - s->len < need) {
+        s->lost++;
+        return;
+    }
+    if (s->lost) put_dropped(s, f->r.ms_timestamp);
+    put(s, f, n);
+    s->credit--;
+}
+
+// move everything in the ring into the subscribers' buffers
+static void dispatch(void) {
+    size_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    for (; head != tail; ++head) {
+        const frame_t *f = &ring[head % RING_SLOTS];
+        if (f->lost_before) {
+            // lost before filtering: counted against every subscriber
+            for (int i = 0; i < num_subs; ++i) subs[i].lost += f->lost_before;
+        }
+        int sensor = hub_sensor_index(source, f->r.type);
+        size_t n = f->r.channels > 1 ? sizeof(hub_record_t) + sizeof(hub_values_record_t) : sizeof(hub_record_t);
+        for (int i = 0; i < num_subs; ++i) {
+            subscriber_t *s = &subs[i];
+            if (s->all || (sensor >= 0 && s->want[sensor])) deliver(s, f, n);
+        }
+        last_ms = f->r.ms_timestamp;
+    }
+    atomic_store_explicit(&ring_head, head, memory_order_release);
+}
+
+// one gathered write of the whole buffer (both halves when it wraps);
+// false if the subscriber is gone
+static bool flush(subscriber_t *s) {
+    if (s->len == 0) return true;
+    size_t size = config->egress_buffer;
+    size_t first = s->len < size - s->head ? s->len : size - s->head;
+    struct iovec iov[2] = { { s->buf + s->head, first }, { s->buf, s->len - first } };
+    // sendmsg rather than writev: no SIGPIPE when the subscriber has gone
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = s->len > first ? 2 : 1;
+    ssize_t w = sendmsg(s->fd, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (w < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    s->head = (s->head + (size_t)w) % size;
+    s->len -= (size_t)w;
+    return true;
+}
+
+static void flush_all(void) {
+    for (int i = num_subs - 1; i >= 0; --i) {
+        if (!flush(&subs[i])) close_subscriber(i);
+    }
+}
+
+static void *egress_main(void *arg) {
+    (void)arg;
+    struct pollfd pfd[3 + MAX_SUBSCRIBERS];
+    while (atomic_load(&egress_running)) {
+        int n = 0;
+        pfd[n++] = (struct pollfd){ .fd = wake_fd, .events = POLLIN };
+        pfd[n++] = (struct pollfd){ .fd = unix_listen, .events = POLLIN };
+        pfd[n++] = (struct pollfd){ .fd = tcp_listen, .events = POLLIN };
+        for (int i = 0; i < num_subs; ++i) {
+            short ev = (short)((subs[i].eof ? 0 : POLLIN) | (subs[i].len ? POLLOUT : 0));
+            pfd[n++] = (struct pollfd){ .fd = subs[i].fd, .events = ev };
+        }
+        // announce the sleep before the last look at the ring, so a record
+        // pushed in between is seen here or wakes the poll; the timeout
+        // notices egress_detach()/egress_stop()
+        atomic_store(&sleeping, 1);
+        bool idle = atomic_load(&ring_tail) == atomic_load_explicit(&ring_head, memory_order_relaxed);
+        int ready = poll(pfd, (nfds_t)n, idle ? 100 : 0);
+        atomic_store(&sleeping, 0);
+        if (ready > 0) {
+            uint64_t count;
+            if (pfd[0].revents & POLLIN) {
+                ssize_t r = read(wake_fd, &count, sizeof(count));
+                (void)r;
+            }
+            // subscribers are matched to their pollfd before any is added or closed
+            for (int i = num_subs - 1; i >= 0; --i) {
+                short rev = pfd[3 + i].revents;
+                if ((rev & (POLLHUP | POLLERR)) || ((rev & POLLIN) && !read_control(&subs[i]))) close_subscriber(i);
+            }
+            if (pfd[1].revents & POLLIN) accept_subscribers(unix_listen, false);
+            if (pfd[2].revents & POLLIN) accept_subscribers(tcp_listen, true);
+        }
+        dispatch();
+        flush_all();
+    }
+    return NULL;
+}
+
+static bool start_thread(void) {
+    atomic_store(&egress_running, 1);
+    if (pthread_create(&egress_thread_id, NULL, egress_main, NULL) != 0) return false;
+    thread_started = true;
+    return true;
+}
+
+static void stop_thread(void) {
+    if (!thread_started) return;
+    atomic_store(&egress_running, 0);
+    pthread_join(egress_thread_id, NULL);
+    thread_started = false;
+}
+
+static int listen_unix(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    unlink(path); // stale socket from a previous run
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int listen_tcp(int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void close_listeners(void) {
+    if (unix_listen >= 0) {
+        close(unix_listen);
+        unlink(sock_path);
+    }
+    if (tcp_listen >= 0) close(tcp_listen);
+    if (wake_fd >= 0) close(wake_fd);
+    unix_listen = tcp_listen = wake_fd = -1;
+}
+
+bool egress_start(hub_t *hub, const hub_config_t *cfg, int unix_fd, int tcp_fd) {
+    source = hub;
+    config = cfg;
+    snprintf(sock_path, sizeof(sock_path), "%s", cfg->egress_socket);
+    unix_listen = unix_fd >= 0 || !cfg->egress_socket[0] ? unix_fd : listen_unix(cfg->egress_socket);
+    tcp_listen = tcp_fd >= 0 || !cfg->egress_port ? tcp_fd : listen_tcp(cfg->egress_port);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((cfg->egress_socket[0] && unix_listen < 0) || (cfg->egress_port && tcp_listen < 0) || wake_fd < 0) {
+        close_listeners();
+        return false;
+    }
+    hub_set_record_tap(hub, egress_tap, NULL);
+    return start_thread();
+}
+
+void egress_detach(int *unix_fd, int *tcp_fd) {
+    // the tap stays: records pile up in the ring (and overflow) meanwhile
+    stop_thread();
+    *unix_fd = unix_listen;
+    *tcp_fd = tcp_listen;
+}
+
+void egress_resume(void) {
+    if (wake_fd >= 0 && !thread_started) start_thread();
+}
+
+void egress_stop(void) {
+    if (wake_fd < 0) return;
+    stop_thread();
+    hub_set_record_tap(source, NULL, NULL);
+    dispatch();
+    // what was dropped after the last record each subscriber received
+    for (int i = 0; i < num_subs; ++i) {
+        subscriber_t *s = &subs[i];
+        s->lost += ring_lost;
+        if (s->lost && config->egress_buffer - s->len >= sizeof(hub_record_t)) put_dropped(s, last_ms);
+    }
+    ring_lost = 0;
+    long deadline = monotonic_ms() + STOP_FLUSH_MS;
+    for (;;) {
+        flush_all();
+        struct pollfd pfd[MAX_SUBSCRIBERS];
+        int n = 0;
+        for (int i = 0; i < num_subs; ++i) {
+            if (subs[i].len) pfd[n++] = (struct pollfd){ .fd = subs[i].fd, .events = POLLOUT };
+        }
+        long left = deadline - monotonic_ms();
+        if (n == 0 || left <= 0) break;
+        poll(pfd, (nfds_t)n, (int)left);
+    }
+    while (num_subs > 0) close_subscriber(num_subs - 1);
+    close_listeners();
+}
@@ -0,0 +1,43 @@
+#ifndef EGRESS_H
+#define EGRESS_H
+#include <stdbool.h>
+#include "config.h"
+#include "hub.h"
+
+// Record stream for local subscribers on a Unix stream socket
+// (--egress-socket PATH) and/or 127.0.0.1:N (--egress-port N). Every record
+// the hub logs is sent in the binary log format (src/record.h): a
+// hub_record_t, followed by its hub_values_record_t for multi-channel
+// samples, whatever --log-format says.
+//
+// Subscribers control their stream with text lines:
+//   SUB NAME,NAME,...   only these sensors ("SUB *" = all, the default)
+//   CREDIT N            N more records may be sent (none before the first)
+// e.g. printf 'SUB TEMP,HUM\nCREDIT 1000000\n' | socat -t 60 - UNIX-CONNECT:PATH
+//
+// One thread serves all subscribers. Each has its own send buffer of
+// cfg->egress_buffer bytes, written with one gathered write per wakeup as
+// far as its socket accepts. A record that finds no credit or no room left
+// is dropped for that subscriber alone; the next record it does receive is
+// preceded by a REC_DROPPED record holding the number it missed (and one
+// more follows its last record at shutdown). The hub hands records over
+// through a lock-free ring and never waits for the thread; records lost
+// when the ring overflows are reported the same way to every subscriber,
+// whatever its filter.
+//
+// One egress per process, like ingest and metrics. unix_fd / tcp_fd are
+// listening sockets received during a handover, -1 = open them.
+bool egress_start(hub_t *hub, const hub_config_t *cfg, int unix_fd, int tcp_fd);
+
+// stop the thread but keep the listening sockets and the subscribers;
+// returns the listening fds for a handover (-1 = not open)
+void egress_detach(int *unix_fd, int *tcp_fd);
+
+// restart the thread after egress_detach() (aborted handover)
+void egress_resume(void);
+
+// send what the subscribers are still owed (for at most half a second),
+// then close everything and unlink the socket
+void egress_stop(void);
+
+#endif
@@ -0,0 +1,86 @@
+#include "encoding.h"
+#include <math.h>
+#include <string.h>
+
+size_t encoding_width(value_encoding_t enc) {
+    switch (enc) {
+    case ENC_F32: return sizeof(float);
+    case ENC_I32: return sizeof(int32_t);
+    case ENC_I16: return sizeof(int16_t);
+    default: return sizeof(double);
+    }
+}
+
+const char *encoding_name(value_encoding_t enc) {
+    static const char *const names[] = { "f64", "f32", "i32", "i16" };
+    return enc >= ENC_F64 && enc <= ENC_I16 ? names[enc] : "?";
+}
+
+static int64_t quantize(const sensor_config_t *sc, double v, int64_t lo, int64_t hi) {
+    double q = nearbyint((v - sc->offset) / sc->scale);
+    if (!(q >= (double)lo)) return lo; // also maps NaN to lo
+    if (q > (double)hi) return hi;
+    return (int64_t)q;
+}
+
+// packed arrays are only byte-aligned inside queue slots, hence the memcpy
+void encoding_pack(const sensor_config_t *sc, const double *values, void *out) {
+    unsigned char *p = out;
+    for (int c = 0; c < sc->channels; ++c) {
+        switch (sc->encoding) {
+        case ENC_F32: {
+            float f = (float)values[c];
+            memcpy(p, &f, sizeof(f));
+            p += sizeof(f);
+            break;
+        }
+        case ENC_I32: {
+            int32_t i = (int32_t)quantize(sc, values[c], INT32_MIN, INT32_MAX);
+            memcpy(p, &i, sizeof(i));
+            p += sizeof(i);
+            break;
+        }
+        case ENC_I16: {
+            int16_t i = (int16_t)quantize(sc, values[c], INT16_MIN, INT16_MAX);
+            memcpy(p, &i, sizeof(i));
+            p += sizeof(i);
+            break;
+        }
+        default:
+            memcpy(p, &values[c], sizeof(double));
+            p += sizeof(double);
+        }
+    }
+}
+
+void encoding_unpack_raw(const sensor_config_t *sc, const void *in, int64_t *out) {
+    const unsigned char *p = in;
+    for (int c = 0; c < sc->channels; ++c) {
+        if (sc->encoding == ENC_I32) {
+            int32_t i;
+            memcpy(&i, p + c * sizeof(i), sizeof(i));
+            out[c] = i;
+        } else {
+            int16_t i;
+            memcpy(&i, p + c * sizeof(i), sizeof(i));
+            out[c] = i;
+        }
+    }
+}
+
+void encoding_unpack(const sensor_config_t *sc, const void *in, double *out) {
+    const unsigned char *p = in;
+    if (encoding_is_integer(sc->encoding)) {
+        int64_t raw[HUB_MAX_CHANNELS];
+        encoding_unpack_raw(sc, in, raw);
+        for (int c = 0; c < sc->channels; ++c) out[c] = (double)raw[c] * sc->scale + sc->offset;
+    } else if (sc->encoding == ENC_F32) {
+        for (int c = 0; c < sc->channels; ++c) {
+            float f;
+            memcpy(&f, p + c * sizeof(f), sizeof(f));
+            out[c] = f;
+        }
+    } else {
+        memcpy(out, in, sizeof(double) * (size_t)sc->channels);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Per-sensor value encodings (sensor_config_t.encoding). A sample's channels
+// are packed back to back; float encodings store the value itself, integer
+// encodings round((value - offset) / scale), saturated to the type's range.
+
+// bytes per channel value
+size_t encoding_width(value_encoding_t enc);
+
+static inline int encoding_is_integer(value_encoding_t enc) {
+    return enc == ENC_I32 || enc == ENC_I16;
+}
+
+// pack sc->channels values into out (channels * width bytes)
+void encoding_pack(const sensor_config_t *sc, const double *values, void *out);
+
+// decode sc->channels packed values to physical values
+void encoding_unpack(const sensor_config_t *sc, const void *in, double *out);
+
+// integer encodings only: the raw integers
+void encoding_unpack_raw(const sensor_config_t *sc, const void *in, int64_t *out);
+
+// "f64", "f32", "i32", "i16"
+const char *encoding_name(value_encoding_t enc);
+
+#endif
@@ -0,0 +1,144 @@
+#define _GNU_SOURCE
+#include "handover.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define HANDOVER_MAGIC 0x52564f48u /* "HOVR" */
+#define MAX_FDS 7
+
+typedef struct {
+    uint32_t magic;
+    int32_t slot[MAX_FDS]; // position of each handover_fds_t member in the fd array, -1 = absent
+} handover_msg_t;
+
+static bool fill_addr(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) return false;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+static bool wait_readable(int fd, int timeout_ms) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    return poll(&pfd, 1, timeout_ms) == 1;
+}
+
+int handover_listen(const char *path) {
+    struct sockaddr_un addr;
+    if (!fill_addr(&addr, path)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int handover_accept(int listen_fd) {
+    int conn = accept(listen_fd, NULL, NULL);
+    if (conn < 0) return -1;
+    char req[8];
+    if (!wait_readable(conn, 1000) || read(conn, req, sizeof(req)) != (ssize_t)sizeof(req)
+        || memcmp(req, "TAKEOVER", sizeof(req)) != 0) {
+        close(conn);
+        return -1;
+    }
+    return conn;
+}
+
+bool handover_send(int conn, const handover_fds_t *fds) {
+    const int in[MAX_FDS] = { fds->listen_fd, fds->ingest_fd, fds->metrics_fd, fds->snapshot_fd,
+                               fds->egress_fd, fds->egress_tcp_fd, fds->http_fd };
+    handover_msg_t msg;
+    int out[MAX_FDS], n = 0;
+    msg.magic = HANDOVER_MAGIC;
+    for (int i = 0; i < MAX_FDS; ++i) {
+        msg.slot[i] = in[i] >= 0 ? n : -1;
+        if (in[i] >= 0) out[n++] = in[i];
+    }
+
+    struct iovec iov = { &msg, sizeof(msg) };
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+        struct cmsghdr align;
+    } ctl;
+    memset(&ctl, 0, sizeof(ctl));
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if (n > 0) {
+        mh.msg_control = ctl.buf;
+        mh.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)n);
+        struct cmsghdr *c = CMSG_FIRSTHDR(&mh);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int) * (size_t)n);
+        memcpy(CMSG_DATA(c), out, sizeof(int) * (size_t)n);
+    }
+    return sendmsg(conn, &mh, MSG_NOSIGNAL) == (ssize_t)sizeof(msg);
+}
+
+bool handover_wait_ack(int conn, int timeout_ms) {
+    char ack[2];
+    return wait_readable(conn, timeout_ms) && read(conn, ack, sizeof(ack)) == 2 && memcmp(ack, "OK", 2) == 0;
+}
+
+int handover_connect(const char *path) {
+    struct sockaddr_un addr;
+    if (!fill_addr(&addr, path)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+        || write(fd, "TAKEOVER", 8) != 8) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool handover_receive(int conn, handover_fds_t *out, int timeout_ms) {
+    *out = (handover_fds_t){ -1, -1, -1, -1, -1, -1, -1 };
+    if (!wait_readable(conn, timeout_ms)) return false;
+
+    handover_msg_t msg;
+    struct iovec iov = { &msg, sizeof(msg) };
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+        struct cmsghdr align;
+    } ctl;
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = ctl.buf;
+    mh.msg_controllen = sizeof(ctl.buf);
+    if (recvmsg(conn, &mh, MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(msg) || msg.magic != HANDOVER_MAGIC) return false;
+
+    int fds[MAX_FDS], n = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(&mh, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+            n = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            memcpy(fds, CMSG_DATA(c), sizeof(int) * (size_t)n);
+        }
+    }
+    int *dst[MAX_FDS] = { &out->listen_fd, &out->ingest_fd, &out->metrics_fd, &out->snapshot_fd,
+                             &out->egress_fd, &out->egress_tcp_fd, &out->http_fd };
+    for (int i = 0; i < MAX_FDS; ++i) {
+        if (msg.slot[i] >= 0 && msg.slot[i] < n) *dst[i] = fds[msg.slot[i]];
+    }
+    return true;
+}
+
+bool handover_ack(int conn) {
+    return write(conn, "OK", 2) == 2;
+}
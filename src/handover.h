@@ -0,0 +1,36 @@
+#ifndef HANDOVER_H
+#define HANDOVER_H
+#include <stdbool.h>
+
+// Zero-downtime handover between an old and a new hub process over a Unix
+// stream socket. The old process listens (--handover-socket PATH); a new one
+// started with --takeover connects, receives the old process's open sockets
+// and a window snapshot via SCM_RIGHTS, and acknowledges; the old one exits.
+//
+// protocol: new -> old  "TAKEOVER"
+//           old -> new  handover_msg_t + fds (SCM_RIGHTS)
+//           new -> old  "OK"
+
+// fds passed from the old process; -1 = not present
+typedef struct {
+    int listen_fd;    // the handover socket itself, for the next upgrade
+    int ingest_fd;    // --ingest-socket datagram socket
+    int metrics_fd;   // --metrics-socket listening socket
+    int snapshot_fd;  // memfd holding a checkpoint of the processor windows
+    int egress_fd;    // --egress-socket listening socket
+    int egress_tcp_fd; // --egress-port listening socket
+    int http_fd;      // --http-port listening socket
+} handover_fds_t;
+
+// old side
+int handover_listen(const char *path);
+int handover_accept(int listen_fd);                 // -1 if nobody is waiting
+bool handover_send(int conn, const handover_fds_t *fds);
+bool handover_wait_ack(int conn, int timeout_ms);
+
+// new side
+int handover_connect(const char *path);
+bool handover_receive(int conn, handover_fds_t *out, int timeout_ms);
+bool handover_ack(int conn);
+
+#endif
@@ -0,0 +1,63 @@
+#include "history.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const long tier_width_ms[HUB_ROLLUP_TIERS] = { 1000L, 60 * 1000L, 3600 * 1000L };
+
+long history_tier_width_ms(int tier) {
+    return tier >= 0 && tier < HUB_ROLLUP_TIERS ? tier_width_ms[tier] : 0;
+}
+
+bool history_init(history_t *h, size_t capacity, size_t slots, size_t row_size) {
+    h->capacity = capacity;
+    h->slots = slots;
+    h->row_size = row_size;
+    atomic_init(&h->written, 0);
+    h->points = calloc(capacity, sizeof(hub_point_t));
+    h->raw = calloc(capacity, row_size);
+    if (!h->points || !h->raw) return false;
+    for (int t = 0; t < HUB_ROLLUP_TIERS; ++t) {
+        atomic_init(&h->opened[t], 0);
+        h->buckets[t] = calloc(slots, sizeof(hub_bucket_t));
+        if (!h->buckets[t]) return false;
+    }
+    return true;
+}
+
+void history_free(history_t *h) {
+    free(h->points);
+    free(h->raw);
+    h->points = NULL;
+    h->raw = NULL;
+    for (int t = 0; t < HUB_ROLLUP_TIERS; ++t) {
+        free(h->buckets[t]);
+        h->buckets[t] = NULL;
+    }
+}
+
+static void rollup_push(history_t *h, int tier, long ms, double value) {
+    long width = tier_width_ms[tier];
+    int64_t start = ms - ((ms % width) + width) % width;
+    uint64_t n = atomic_load_explicit(&h->opened[tier], memory_order_relaxed);
+    hub_bucket_t *b = n > 0 ? &h->buckets[tier][(n - 1) % h->slots] : NULL;
+    // late samples fold into the open bucket rather than reopening an old one
+    if (!b || start > b->start_ms) {
+        b = &h->buckets[tier][n % h->slots];
+        *b = (hub_bucket_t){ start, 1, value, value, value };
+        atomic_store_explicit(&h->opened[tier], n + 1, memory_order_release);
+        return;
+    }
+    b->count++;
+    b->sum += value;
+    if (value < b->min) b->min = value;
+    if (value > b->max) b->max = value;
+}
+
+void history_push(history_t *h, long ms_timestamp, double value, const void *row) {
+    uint64_t n = atomic_load_explicit(&h->written, memory_order_relaxed);
+    size_t slot = n % h->capacity;
+    h->points[slot] = (hub_point_t){ ms_timestamp, value };
+    memcpy(h->raw + slot * h->row_size, row, h->row_size);
+    atomic_store_explicit(&h->written, n + 1, memory_order_release);
+    for (int t = 0; t < HUB_ROLLUP_TIERS; ++t) rollup_push(h, t, ms_timestamp, value);
+}
@@ -0,0 +1,55 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Per-sensor in-memory history: a ring of the most recent processed samples
+// plus rollup tiers (fixed-width time buckets). Points and rollups hold the
+// sample value, or the vector magnitude for multi-channel sensors; the
+// channel values are kept in a parallel ring in the sensor's encoding. Only the shard processor that
+// owns the sensor writes; readers access the arrays in place without locking.
+// The layouts below are part of the library ABI (see tools/sensorhub.py).
+
+typedef struct {
+    int64_t ms_timestamp;
+    double value;
+} hub_point_t;
+
+// one rollup bucket covering [start_ms, start_ms + width)
+typedef struct {
+    int64_t start_ms;
+    int64_t count;
+    double min;
+    double max;
+    double sum;
+} hub_bucket_t;
+
+#define HUB_ROLLUP_TIERS 3
+
+// bucket width of each tier: 1 s, 1 min, 1 h
+long history_tier_width_ms(int tier);
+
+typedef struct {
+    hub_point_t *points;
+    size_t capacity;
+    // number of points ever written; the newest is points[(written - 1) % capacity].
+    // Stored (release) after the point itself.
+    _Atomic uint64_t written;
+    unsigned char *raw;      // capacity rows of row_size bytes (encoded channels)
+    size_t row_size;
+
+    hub_bucket_t *buckets[HUB_ROLLUP_TIERS];
+    size_t slots;
+    // number of buckets ever opened per tier; the open one is the newest
+    _Atomic uint64_t opened[HUB_ROLLUP_TIERS];
+} history_t;
+
+bool history_init(history_t *h, size_t capacity, size_t slots, size_t row_size);
+void history_free(history_t *h);
+
+// record one processed sample (single writer); row holds row_size bytes
+void history_push(history_t *h, long ms_timestamp, double value, const void *row);
+
+#endif
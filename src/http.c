@@ -0,0 +1,733 @@
+#define _GNU_SOURCE
+#include "http.h"
+#include "encoding.h"
+#include "hub.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#define MAX_CONNS 256
+#define REQUEST_MAX 4096        // request line and headers
+#define IDLE_MS 30000           // keep-alive connections without a request
+#define DEFAULT_POINTS 100
+#define LISTEN_ID UINT32_MAX    // epoll data of the listening socket
+#define READ_TRIES 3            // reads of a range the processor keeps overwriting
+
+typedef struct {
+    char *p;
+    size_t len, cap;
+} text_t;
+
+typedef struct {
+    int fd;
+    char in[REQUEST_MAX + 1];
+    size_t in_len;
+    text_t body;              // response body being built (reused)
+    text_t out;               // response bytes the socket has not taken yet
+    size_t out_off;
+    bool keep_alive;          // of the current request
+    bool closing;             // close once out is sent
+    long last_ms;
+} conn_t;
+
+// query string of a request
+typedef struct {
+    char sensor[HUB_PATH_LEN];   // comma-separated names, "" = not given
+    long long n;                 // -1 = not given
+    int64_t from, to;
+    bool ranged;                 // from or to given
+    int tier;
+    bool binary;
+} params_t;
+
+// a sensor's history ring
+typedef struct {
+    int sensor;
+    const sensor_config_t *sc;
+    const hub_point_t *points;
+    const unsigned char *raw;
+    size_t cap, row;
+} ring_t;
+
+// a ring as the server reads it: entry k in slot k % cap, stride bytes each
+typedef struct {
+    const void *base;
+    size_t stride, cap;
+    int sensor;
+    int tier;                 // rollup tier, -1 = the history ring
+} view_t;
+
+static hub_t *source = NULL;
+static const hub_config_t *config = NULL;
+static int listen_fd = -1, epoll_fd = -1;
+static pthread_t http_thread_id;
+static atomic_int http_running = 0;
+static bool thread_started = false;
+static conn_t *conns[MAX_CONNS];
+
+static long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static bool text_reserve(text_t *t, size_t n) {
+    if (t->len + n <= t->cap) return true;
+    size_t cap = t->cap ? t->cap : 4096;
+    while (cap < t->len + n) cap *= 2;
+    char *p = realloc(t->p, cap);
+    if (!p) return false;
+    t->p = p;
+    t->cap = cap;
+    return true;
+}
+
+static void text_append(text_t *t, const void *data, size_t n) {
+    if (!text_reserve(t, n)) return;
+    memcpy(t->p + t->len, data, n);
+    t->len += n;
+}
+
+static void text_puts(text_t *t, const char *s) {
+    text_append(t, s, strlen(s));
+}
+
+__attribute__((format(printf, 2, 3)))
+static void text_printf(text_t *t, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n < 0 || !text_reserve(t, (size_t)n + 1)) return;
+    va_start(ap, fmt);
+    vsnprintf(t->p + t->len, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    t->len += (size_t)n;
+}
+
+static void json_number(text_t *t, double v) {
+    if (isfinite(v)) text_printf(t, "%.15g", v);
+    else text_puts(t, "null");
+}
+
+// quoted, with '"', '\\' and control characters escaped: sensor names are
+// not restricted to characters that are safe in JSON
+static void json_string(text_t *t, const char *s) {
+    text_puts(t, "\"");
+    for (; *s; ++s) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') text_printf(t, "\\%c", ch);
+        else if (ch < 0x20) text_printf(t, "\\u%04x", ch);
+        else text_append(t, s, 1);
+    }
+    text_puts(t, "\"");
+}
+
+static const char *status_text(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 431: return "Request Header Fields Too Large";
+    case 503: return "Service Unavailable";
+    default: return "Error";
+    }
+}
+
+// Send the header and body pieces with one gathered write; what the socket
+// does not take now is copied to c->out and sent on EPOLLOUT, since body
+// pieces may point into the rings.
+static void respond(conn_t *c, int status, const char *type, const struct iovec *body, int n) {
+    char hdr[256];
+    struct iovec iov[4];
+    size_t len = 0;
+    for (int i = 0; i < n; ++i) len += body[i].iov_len;
+    int h = snprintf(hdr, sizeof(hdr), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s\r\n",
+                     status, status_text(status), type, len, c->keep_alive ? "" : "Connection: close\r\n");
+    iov[0] = (struct iovec){ hdr, (size_t)h };
+    for (int i = 0; i < n; ++i) iov[i + 1] = body[i];
+
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = (size_t)n + 1;
+    ssize_t w = sendmsg(c->fd, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+    size_t skip = w > 0 ? (size_t)w : 0;
+    for (int i = 0; i <= n; ++i) {
+        if (skip >= iov[i].iov_len) {
+            skip -= iov[i].iov_len;
+            continue;
+        }
+        text_append(&c->out, (const char*)iov[i].iov_base + skip, iov[i].iov_len - skip);
+        skip = 0;
+    }
+    if (!c->keep_alive) c->closing = true;
+}
+
+// a response already handed to the socket turned out torn: reset the
+// connection so the client sees an error rather than wrong data
+static void abort_conn(conn_t *c) {
+    struct linger lg = { 1, 0 };
+    setsockopt(c->fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    c->out.len = c->out_off = 0;
+    c->closing = true;
+}
+
+static void respond_json(conn_t *c, int status) {
+    struct iovec body = { c->body.p, c->body.len };
+    respond(c, status, "application/json", &body, 1);
+}
+
+static void respond_error(conn_t *c, int status, const char *msg) {
+    c->body.len = 0;
+    text_printf(&c->body, "{\"error\":\"%s\"}", msg);
+    respond_json(c, status);
+}
+
+static void url_decode(char *s) {
+    char *o = s;
+    for (; *s; ++s) {
+        if (*s == '%' && isxdigit((unsigned char)s[1]) && isxdigit((unsigned char)s[2])) {
+            char hex[3] = { s[1], s[2], '\0' };
+            *o++ = (char)strtol(hex, NULL, 16);
+            s += 2;
+        } else {
+            *o++ = *s == '+' ? ' ' : *s;
+        }
+    }
+    *o = '\0';
+}
+
+static bool parse_int(const char *s, long long *out) {
+    char *end;
+    errno = 0;
+    *out = strtoll(s, &end, 10);
+    return *s != '\0' && *end == '\0' && errno == 0;
+}
+
+// NULL on success, else the error message
+static const char *parse_params(char *query, params_t *p) {
+    *p = (params_t){ .n = -1, .from = INT64_MIN, .to = INT64_MAX };
+    char *save = NULL;
+    for (char *kv = query ? strtok_r(query, "&", &save) : NULL; kv; kv = strtok_r(NULL, "&", &save)) {
+        char *val = strchr(kv, '=');
+        if (!val) continue;
+        *val++ = '\0';
+        url_decode(val);
+        long long v;
+        if (strcmp(kv, "sensor") == 0) {
+            if (strlen(val) >= sizeof(p->sensor)) return "sensor list too long";
+            strcpy(p->sensor, val);
+        } else if (strcmp(kv, "n") == 0) {
+            if (!parse_int(val, &p->n) || p->n < 0) return "invalid n";
+        } else if (strcmp(kv, "from") == 0 || strcmp(kv, "to") == 0) {
+            if (!parse_int(val, &v)) return "invalid time";
+            *(kv[0] == 'f' ? &p->from : &p->to) = v;
+            p->ranged = true;
+        } else if (strcmp(kv, "tier") == 0) {
+            if (!parse_int(val, &v) || v < 0 || v >= hub_rollup_tiers()) return "invalid tier";
+            p->tier = (int)v;
+        } else if (strcmp(kv, "format") == 0) {
+            if (strcmp(val, "binary") != 0 && strcmp(val, "json") != 0) return "format must be json or binary";
+            p->binary = val[0] == 'b';
+        }
+    }
+    return NULL;
+}
+
+// points written, or buckets opened
+static uint64_t view_total(const view_t *v) {
+    return v->tier < 0 ? hub_history_written(source, v->sensor) : hub_rollup_opened(source, v->sensor, v->tier);
+}
+
+// The processor stores entry n into slot n % cap, over entry n - cap, before
+// it counts it, so after total entries the oldest one it cannot be
+// overwriting is total - cap + 1.
+static uint64_t first_intact(uint64_t total, size_t cap) {
+    return total >= cap ? total - cap + 1 : 0;
+}
+
+// Entries from k on, read before this call: were they intact throughout?
+// The fence keeps those reads before the counter is read again.
+static bool still_intact(const view_t *v, uint64_t k) {
+    atomic_thread_fence(memory_order_acquire);
+    return first_intact(view_total(v), v->cap) <= k;
+}
+
+static int64_t ts_at(const view_t *v, uint64_t k) {
+    return *(const int64_t*)((const char*)v->base + (k % v->cap) * v->stride);
+}
+
+// first k in [a, b) whose timestamp is >= t (after: > t); entries are in
+// ascending timestamp order
+static uint64_t search(const view_t *v, uint64_t a, uint64_t b, int64_t t, bool after) {
+    while (a < b) {
+        uint64_t m = a + (b - a) / 2;
+        int64_t ts = ts_at(v, m);
+        if (after ? ts <= t : ts < t) a = m + 1;
+        else b = m;
+    }
+    return a;
+}
+
+// Entries [*lo, *hi) out of [a, b), narrowed to timestamps (the first member
+// of an entry) in [from, to], then to the newest n. The search reads the
+// ring, so the result only counts if still_intact(*lo) holds afterwards: a
+// probe of an overwritten entry sees a newer timestamp and pulls *lo down
+// to it at most.
+static void select_entries(const view_t *v, uint64_t a, uint64_t b, const params_t *p, int64_t from,
+                           uint64_t *lo, uint64_t *hi) {
+    if (b < a) b = a;
+    if (p->ranged) {
+        a = search(v, a, b, from, false);
+        b = search(v, a, b, p->to, true);
+    }
+    if (p->n >= 0 && b - a > (uint64_t)p->n) a = b - (uint64_t)p->n;
+    *lo = a;
+    *hi = b;
+}
+
+// [lo, hi) of a ring as at most two iovecs, oldest first
+static int ring_iov(const view_t *v, uint64_t lo, uint64_t hi, struct iovec *iov) {
+    if (lo == hi) return 0;
+    size_t first = (size_t)(lo % v->cap), n = (size_t)(hi - lo);
+    size_t k = n < v->cap - first ? n : v->cap - first;
+    iov[0] = (struct iovec){ (char*)v->base + first * v->stride, k * v->stride };
+    if (k == n) return 1;
+    iov[1] = (struct iovec){ (void*)v->base, (n - k) * v->stride };
+    return 2;
+}
+
+// Binary body of entries [lo, hi), selected at total. Those within half a
+// ring of the overwrite frontier are copied first and checked; the rest go
+// to the socket straight from the ring. False (nothing sent) if the copied
+// ones were overwritten meanwhile. Should the processor get to the others
+// during the send after all, the connection is reset instead.
+static bool send_entries(conn_t *c, const view_t *v, uint64_t total, uint64_t lo, uint64_t hi) {
+    uint64_t split = first_intact(total, v->cap) + v->cap / 2;
+    if (split < lo) split = lo;
+    if (split > hi) split = hi;
+    struct iovec body[3];
+    int n = ring_iov(v, lo, split, body);
+    c->body.len = 0;
+    for (int i = 0; i < n; ++i) text_append(&c->body, body[i].iov_base, body[i].iov_len);
+    if (!still_intact(v, lo)) return false;
+    body[0] = (struct iovec){ c->body.p, c->body.len };
+    n = 1 + ring_iov(v, split, hi, body + 1);
+    respond(c, 200, "application/octet-stream", body, n);
+    if (!still_intact(v, split)) abort_conn(c);
+    return true;
+}
+
+static bool open_ring(int s, ring_t *r) {
+    int channels;
+    r->sensor = s;
+    r->sc = &config->sensors[s];
+    r->points = hub_history_points(source, s, &r->cap);
+    r->raw = hub_history_raw(source, s, &r->cap, &channels);
+    r->row = (size_t)channels * encoding_width(r->sc->encoding);
+    return r->points && r->raw;
+}
+
+static void json_point(text_t *t, const ring_t *r, uint64_t k) {
+    size_t slot = (size_t)(k % r->cap);
+    const hub_point_t *pt = &r->points[slot];
+    text_printf(t, "[%lld,", (long long)pt->ms_timestamp);
+    json_number(t, pt->value);
+    if (r->sc->channels > 1) {
+        double v[HUB_MAX_CHANNELS];
+        encoding_unpack(r->sc, r->raw + slot * r->row, v);
+        for (int c = 0; c < r->sc->channels; ++c) {
+            text_puts(t, ",");
+            json_number(t, v[c]);
+        }
+    }
+    text_puts(t, "]");
+}
+
+// sensor index for a name from the query, -1 (and a 404) if unknown
+static int lookup(conn_t *c, const char *name) {
+    int s = hub_sensor_index(source, name);
+    if (s < 0) respond_error(c, 404, "unknown sensor");
+    return s;
+}
+
+static void serve_sensors(conn_t *c) {
+    text_t *t = &c->body;
+    text_puts(t, "{\"tiers\":[");
+    for (int k = 0; k < hub_rollup_tiers(); ++k) text_printf(t, k ? ",%ld" : "%ld", hub_rollup_width_ms(k));
+    text_puts(t, "],\"sensors\":[");
+    for (int s = 0; s < config->num_sensors; ++s) {
+        text_puts(t, s ? ",{\"name\":" : "{\"name\":");
+        json_string(t, config->sensors[s].name);
+        text_printf(t, ",\"channels\":%d,\"samples\":%llu}", config->sensors[s].channels,
+                    (unsigned long long)hub_history_written(source, s));
+    }
+    text_puts(t, "]}");
+    respond_json(c, 200);
+}
+
+static void serve_latest(conn_t *c, params_t *p) {
+    int idx[HUB_PATH_LEN / 2], n = 0;
+    if (p->sensor[0]) {
+        char *save = NULL;
+        for (char *name = strtok_r(p->sensor, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+            if ((idx[n] = lookup(c, name)) < 0) return;
+            n++;
+        }
+    }
+    bool all = n == 0;
+    int count = all ? config->num_sensors : n;
+    text_t *t = &c->body;
+    if (!p->binary) text_puts(t, "{");
+    for (int i = 0; i < count; ++i) {
+        int s = all ? i : idx[i];
+        ring_t r;
+        if (!open_ring(s, &r)) continue;
+        view_t v = { r.points, sizeof(hub_point_t), r.cap, s, -1 };
+        size_t mark = t->len;
+        int tries = 0;
+        for (;; ++tries) {
+            if (tries == READ_TRIES) {
+                respond_error(c, 503, "history overwritten while reading, try again");
+                return;
+            }
+            t->len = mark;
+            uint64_t total = view_total(&v);
+            if (p->binary) {
+                hub_point_t none = { 0, 0.0 };
+                text_append(t, total ? &r.points[(total - 1) % r.cap] : &none, sizeof(hub_point_t));
+            } else {
+                if (i) text_puts(t, ",");
+                json_string(t, r.sc->name);
+                text_puts(t, ":");
+                if (total) json_point(t, &r, total - 1);
+                else text_puts(t, "null");
+            }
+            if (!total || still_intact(&v, total - 1)) break;
+        }
+    }
+    if (p->binary) {
+        struct iovec body = { t->p, t->len };
+        respond(c, 200, "application/octet-stream", &body, 1);
+        return;
+    }
+    text_puts(t, "}");
+    respond_json(c, 200);
+}
+
+static void serve_history(conn_t *c, params_t *p) {
+    if (!p->sensor[0] || strchr(p->sensor, ',')) {
+        respond_error(c, 400, "history needs one sensor");
+        return;
+    }
+    int s = lookup(c, p->sensor);
+    ring_t r;
+    if (s < 0 || !open_ring(s, &r)) return;
+    if (p->n < 0 && !p->ranged) p->n = DEFAULT_POINTS;
+    view_t v = { r.points, sizeof(hub_point_t), r.cap, s, -1 };
+    text_t *t = &c->body;
+    // the processor may overrun the range while it is read: read it again
+    for (int tries = 0; tries < READ_TRIES; ++tries) {
+        uint64_t total = view_total(&v), lo, hi;
+        select_entries(&v, first_intact(total, r.cap), total, p, p->from, &lo, &hi);
+        if (p->binary) {
+            if (send_entries(c, &v, total, lo, hi)) return;
+            continue;
+        }
+        t->len = 0;
+        text_puts(t, "{\"sensor\":");
+        json_string(t, r.sc->name);
+        text_puts(t, ",\"points\":[");
+        for (uint64_t k = lo; k < hi; ++k) {
+            if (k > lo) text_puts(t, ",");
+            json_point(t, &r, k);
+        }
+        text_puts(t, "]}");
+        if (still_intact(&v, lo)) {
+            respond_json(c, 200);
+            return;
+        }
+    }
+    respond_error(c, 503, "history overwritten while reading, try again");
+}
+
+static void serve_rollup(conn_t *c, params_t *p) {
+    if (!p->sensor[0] || strchr(p->sensor, ',')) {
+        respond_error(c, 400, "rollup needs one sensor");
+        return;
+    }
+    int s = lookup(c, p->sensor);
+    if (s < 0) return;
+    size_t slots;
+    const hub_bucket_t *b = hub_rollup_buckets(source, s, p->tier, &slots);
+    long width = hub_rollup_width_ms(p->tier);
+    // the bucket holding from overlaps the range
+    int64_t from = p->from;
+    if (from > INT64_MIN + width) from -= ((from % width) + width) % width;
+    view_t v = { b, sizeof(hub_bucket_t), slots, s, p->tier };
+    text_t *t = &c->body;
+    for (int tries = 0; tries < READ_TRIES; ++tries) {
+        // the newest bucket is still being updated: closed ones only
+        uint64_t opened = view_total(&v), lo, hi;
+        select_entries(&v, first_intact(opened, slots), opened ? opened - 1 : 0, p, from, &lo, &hi);
+        if (p->binary) {
+            if (send_entries(c, &v, opened, lo, hi)) return;
+            continue;
+        }
+        t->len = 0;
+        text_puts(t, "{\"sensor\":");
+        json_string(t, config->sensors[s].name);
+        text_printf(t, ",\"tier\":%d,\"width_ms\":%ld,\"buckets\":[", p->tier, width);
+        for (uint64_t k = lo; k < hi; ++k) {
+            const hub_bucket_t *e = &b[k % slots];
+            text_printf(t, "%s[%lld,%lld,", k > lo ? "," : "", (long long)e->start_ms, (long long)e->count);
+            json_number(t, e->min);
+            text_puts(t, ",");
+            json_number(t, e->max);
+            text_puts(t, ",");
+            json_number(t, e->count ? e->sum / (double)e->count : NAN);
+            text_puts(t, "]");
+        }
+        text_puts(t, "]}");
+        if (still_intact(&v, lo)) {
+            respond_json(c, 200);
+            return;
+        }
+    }
+    respond_error(c, 503, "rollup overwritten while reading, try again");
+}
+
+// one request (NUL-terminated, without the blank line)
+static void handle_request(conn_t *c, char *req) {
+    char *eol = strstr(req, "\r\n");
+    char *headers = eol ? eol + 2 : req + strlen(req);
+    if (eol) *eol = '\0';
+    char *target = strchr(req, ' ');
+    char *version = target ? strchr(target + 1, ' ') : NULL;
+    c->keep_alive = false;
+    c->body.len = 0;
+    if (!version) {
+        respond_error(c, 400, "malformed request line");
+        return;
+    }
+    *target++ = '\0';
+    *version++ = '\0';
+    c->keep_alive = strcmp(version, "HTTP/1.1") == 0;
+    char *conn = strcasestr(headers, "connection:");
+    if (conn) {
+        char *end = strstr(conn, "\r\n");
+        if (end) *end = '\0';
+        if (strcasestr(conn, "close")) c->keep_alive = false;
+        else if (strcasestr(conn, "keep-alive")) c->keep_alive = true;
+    }
+    if (strcmp(req, "GET") != 0) {
+        // a body may follow; don't try to find the next request after it
+        c->keep_alive = false;
+        respond_error(c, 405, "only GET is supported");
+        return;
+    }
+
+    char *query = strchr(target, '?');
+    if (query) *query++ = '\0';
+    params_t p;
+    const char *err = parse_params(query, &p);
+    if (err) respond_error(c, 400, err);
+    else if (strcmp(target, "/sensors") == 0) serve_sensors(c);
+    else if (strcmp(target, "/latest") == 0) serve_latest(c, &p);
+    else if (strcmp(target, "/history") == 0) serve_history(c, &p);
+    else if (strcmp(target, "/rollup") == 0) serve_rollup(c, &p);
+    else respond_error(c, 404, "unknown path");
+}
+
+static void close_conn(uint32_t id) {
+    conn_t *c = conns[id];
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->body.p);
+    free(c->out.p);
+    free(c);
+    conns[id] = NULL;
+}
+
+// answer the complete requests in c->in, one at a time: the next is only
+// read once the previous response is out. False if c was closed.
+static bool process(uint32_t id) {
+    conn_t *c = conns[id];
+    while (c->out.len == 0 && !c->closing) {
+        c->in[c->in_len] = '\0';
+        char *end = strstr(c->in, "\r\n\r\n");
+        if (!end) {
+            if (c->in_len == REQUEST_MAX) {
+                c->keep_alive = false;
+                respond_error(c, 431, "request too large");
+            }
+            break;
+        }
+        size_t used = (size_t)(end + 4 - c->in);
+        *end = '\0';
+        handle_request(c, c->in);
+        memmove(c->in, c->in + used, c->in_len - used);
+        c->in_len -= used;
+    }
+    if (c->out.len == 0 && c->closing) {
+        close_conn(id);
+        return false;
+    }
+    struct epoll_event ev = { .events = c->out.len ? EPOLLOUT : EPOLLIN, .data.u32 = id };
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    return true;
+}
+
+static void on_readable(uint32_t id) {
+    conn_t *c = conns[id];
+    for (;;) {
+        ssize_t n = read(c->fd, c->in + c->in_len, REQUEST_MAX - c->in_len);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close_conn(id);
+            return;
+        }
+        if (n < 0) break;
+        c->in_len += (size_t)n;
+        if (c->in_len == REQUEST_MAX) break;
+    }
+    c->last_ms = monotonic_ms();
+    process(id);
+}
+
+static void on_writable(uint32_t id) {
+    conn_t *c = conns[id];
+    ssize_t w = send(c->fd, c->out.p + c->out_off, c->out.len - c->out_off, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        close_conn(id);
+        return;
+    }
+    if (w > 0) c->out_off += (size_t)w;
+    c->last_ms = monotonic_ms();
+    if (c->out_off < c->out.len) return;
+    c->out.len = c->out_off = 0;
+    // requests that arrived meanwhile
+    process(id);
+}
+
+static void accept_conns(void) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        uint32_t id = 0;
+        while (id < MAX_CONNS && conns[id]) id++;
+        conn_t *c = id < MAX_CONNS ? calloc(1, sizeof(*c)) : NULL;
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = id };
+        if (!c || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->last_ms = monotonic_ms();
+        conns[id] = c;
+    }
+}
+
+static void *http_main(void *arg) {
+    (void)arg;
+    // queries yield to the processors and producers
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+    struct epoll_event ev[64];
+    while (atomic_load(&http_running)) {
+        // wake up periodically to notice http_detach()/http_stop() and idle connections
+        int n = epoll_wait(epoll_fd, ev, 64, 200);
+        for (int i = 0; i < n; ++i) {
+            uint32_t id = ev[i].data.u32;
+            if (id == LISTEN_ID) accept_conns();
+            else if (!conns[id]) continue;
+            else if (ev[i].events & EPOLLOUT) on_writable(id);
+            else on_readable(id);
+        }
+        long now = monotonic_ms();
+        for (uint32_t id = 0; id < MAX_CONNS; ++id) {
+            if (conns[id] && now - conns[id]->last_ms > IDLE_MS) close_conn(id);
+        }
+    }
+    return NULL;
+}
+
+static bool start_thread(void) {
+    atomic_store(&http_running, 1);
+    if (pthread_create(&http_thread_id, NULL, http_main, NULL) != 0) return false;
+    thread_started = true;
+    return true;
+}
+
+static void stop_thread(void) {
+    if (!thread_started) return;
+    atomic_store(&http_running, 0);
+    pthread_join(http_thread_id, NULL);
+    thread_started = false;
+}
+
+static int listen_tcp(int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool http_start(hub_t *hub, const hub_config_t *cfg, int fd) {
+    source = hub;
+    config = cfg;
+    listen_fd = fd >= 0 ? fd : listen_tcp(cfg->http_port);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = LISTEN_ID };
+    if (listen_fd < 0 || epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) != 0) {
+        http_stop();
+        return false;
+    }
+    return start_thread();
+}
+
+int http_detach(void) {
+    stop_thread();
+    return listen_fd;
+}
+
+void http_resume(void) {
+    if (epoll_fd >= 0 && !thread_started) start_thread();
+}
+
+void http_stop(void) {
+    stop_thread();
+    for (uint32_t id = 0; id < MAX_CONNS; ++id) {
+        if (conns[id]) close_conn(id);
+    }
+    if (listen_fd >= 0) close(listen_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+    listen_fd = epoll_fd = -1;
+}
@@ -0,0 +1,44 @@
+#ifndef HTTP_H
+#define HTTP_H
+#include <stdbool.h>
+#include "config.h"
+#include "hub.h"
+
+// Read-only HTTP/1.1 API over the history rings and rollup tiers
+// (--http-port N, bound to 127.0.0.1). GET only, keep-alive by default:
+//
+//   /sensors                      names, channels, samples seen, tier widths
+//   /latest[?sensor=A,B]          newest point of each sensor (null if none)
+//   /history?sensor=S             last n points (n=100 by default), or those
+//            [&n=N][&from=T][&to=T]  with from <= ms_timestamp <= to (newest n)
+//   /rollup?sensor=S[&tier=K]     closed buckets of tier K (0 = 1 s,
+//            [&n=N][&from=T][&to=T]  1 = 1 min, 2 = 1 h) overlapping [from, to]
+//
+// JSON by default: points are [ms, value] ([ms, value, v1, v2, ...] for
+// multi-channel sensors), buckets [start_ms, count, min, max, mean]. With
+// format=binary the body is the ring entries themselves, hub_point_t or
+// hub_bucket_t (src/history.h) oldest first; /history and /rollup send them
+// straight from the rings without copying unless the socket stalls.
+//
+// The rings are read without locks (see hub.h) while the processors keep
+// writing them, possibly a whole ring's worth in the meantime. A response
+// is only sent once the ring's counter, read again after the entries were
+// read, shows none of them can have been overwritten; otherwise the range
+// is selected and read again, and after a few tries the answer is 503.
+// Binary entries sent straight from a ring are checked after the send, and
+// a response found torn then is cut off with a connection reset. The open
+// rollup bucket, which the processor updates in place, is never served.
+// One epoll thread at reduced CPU priority serves all connections; one per
+// process, like the other endpoints. fd is a listening socket received
+// during a handover (-1 = open one).
+bool http_start(hub_t *hub, const hub_config_t *cfg, int fd);
+
+// stop the thread but keep the sockets; returns the listening fd for a handover
+int http_detach(void);
+
+// restart the thread after http_detach() (aborted handover)
+void http_resume(void);
+
+void http_stop(void);
+
+#endif
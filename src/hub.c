@@ -1,179 +1,799 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include "hub.h"
+#include "checkpoint.h"
+#include "encoding.h"
+#include "record.h"
+#include "resample.h"
+#include "segment.h"
+#include "store.h"
+#include "spec.h"
+#include "spectrum.h"
+#include "vec.h"
+#include "window.h"
+#include "zonemap.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <sched.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <errno.h>
+#include <sys/stat.h>
 
-#define QUEUE_SIZE 1024
-#define WINDOW_SIZE 5
-#define MAX_TYPE_LEN 16
-#define NUM_SENSOR_TYPES 3
-
-// thresholds for moving-average alerts
-static const double THRESHOLD_TEMP = 28.0;
-static const double THRESHOLD_HUM  = 80.0;
-static const double THRESHOLD_PRESS = 1015.0;
+// one queued sample; sensor is an index into cfg->sensors (-1 = unknown type).
+// The channels follow in the sensor's encoding, so a shard's slot size is set
+// by the widest sensor it owns (e.g. 16 bytes for scalar i16/f32 sensors).
+typedef struct {
+    int64_t ms_timestamp;
+    int32_t sensor;
+    unsigned char payload[];
+} slot_t;
 
-// sensor type mapping
-enum sensor_id { SENSOR_TEMP = 0, SENSOR_HUM = 1, SENSOR_PRESS = 2 };
+// processor shard: its own queue, lock and thread; sensor i belongs to shard i % shards
+// (sensors place readings into the queue and the shard's processor extracts them)
+typedef struct {
+    struct hub *hub;
+    unsigned char *queue;   // queue_size slots of slot_size bytes
+    size_t slot_size;
+    size_t q_head, q_tail;
+    pthread_mutex_t qlock;
+    pthread_cond_t qcond;
+    // guards the windows of this shard's sensors against hub_checkpoint()
+    pthread_mutex_t wlock;
+    // accounting counters and running flag (protected by qlock)
+    unsigned long n_submitted, n_enqueued, n_dropped, n_processed;
+    int processor_running;
+    int drain;   // finish queued samples before stopping
+    bool started;
+    pthread_t processor_thread_id;
+    int id;
+} shard_t;
 
-// struct for sample readings
+// spectral operator of a source sensor; band b feeds sensor derived[b].
+// Only the processor of the shard that owns the source touches it.
 typedef struct {
-    char type[MAX_TYPE_LEN]; /* "TEMP", "HUM", "PRESS" */
-    double value;
-    long ms_timestamp;
-} sample_t;
-
-// queue (sensors will place readings into this and hub processor will extract readings from here)
-static sample_t queue[QUEUE_SIZE];
-static size_t q_head = 0, q_tail = 0;
-static pthread_mutex_t qlock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t qcond = PTHREAD_COND_INITIALIZER;
-
-// logging
-static FILE *logf = NULL;
-static pthread_mutex_t loglock = PTHREAD_MUTEX_INITIALIZER;
-
-// current time in ms
+    spectrum_t sp;
+    int *derived;       // NULL = not a source
+    double *energies;
+} spectral_t;
+
+// one hub instance: everything below is owned by it, so independent hubs in
+// one process share no locks
+struct hub {
+    const hub_config_t *cfg;
+    const hub_spec_t *spec;   // generated processor, NULL = runtime dispatch
+    shard_t *shards;
+    window_t *windows;
+    // position of each sensor's ring in a flat snapshot buffer (for checkpoints)
+    long *window_offset;
+    long total_window_slots;
+    history_t *history;   // per sensor, written by the owning shard
+    spectral_t *spectra;  // per sensor
+    resampler_t *frames;  // NULL = no frame stream
+    int *frame_column;    // per sensor, -1 = not in the frames
+    int *frame_sensor;    // per column
+
+    // logging
+    FILE *logf;
+    zonemap_writer_t *zmap;   // NULL = no zone map
+    segment_names_t *seg_names; // names in the active segment, NULL = no rotation
+    uint64_t log_bytes;       // size of the active segment
+    bool log_synced;          // log_bytes and the zone map offset are current
+    pthread_mutex_t loglock;
+    hub_record_fn tap;        // hub_set_record_tap(), guarded by loglock
+    void *tap_ctx;
+    hub_alert_fn alert_hook;  // hub_set_alert_hook(), guarded by loglock
+    void *alert_ctx;
+    store_t *store;           // --store, NULL = off
+};
+
+static shard_t *shard_for(hub_t *h, int sensor) {
+    return &h->shards[sensor < 0 ? 0 : sensor % h->cfg->shards];
+}
+
 static long now_ms(void) {
     struct timespec ts;
     clock_gettime(CLOCK_REALTIME, &ts);
     return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
 }
 
+static slot_t *slot_at(shard_t *sh, size_t i) {
+    return (slot_t*)(sh->queue + i * sh->slot_size);
+}
+
+// warm restart: refill windows from a checkpoint (oldest value first)
+static void restore_windows(hub_t *h, ckpt_file_t *ck, const char *name) {
+    const hub_config_t *cfg = h->cfg;
+    int restored = 0;
+    for (int i = 0; i < cfg->num_sensors; ++i) {
+        const sensor_config_t *sc = &cfg->sensors[i];
+        double *tmp = malloc(sizeof(double) * (size_t)sc->window * (size_t)sc->channels);
+        if (!tmp) break;
+        int n = checkpoint_values(ck, sc->name, sc->channels, tmp, sc->window);
+        for (int k = 0; k < n; ++k) {
+            // re-encode: values saved from an integer window land on the same raw values
+            unsigned char payload[HUB_MAX_CHANNELS * sizeof(double)];
+            double phys[HUB_MAX_CHANNELS];
+            hub_vec_t v;
+            encoding_pack(sc, tmp + (size_t)k * sc->channels, payload);
+            encoding_unpack(sc, payload, phys);
+            vec_load(&v, phys, sc->channels);
+            window_push(&h->windows[i], sc, payload, &v);
+        }
+        if (n > 0) restored++;
+        free(tmp);
+    }
+    fprintf(stderr, "checkpoint: restored %d/%d sensor windows from %s (%ld ms old)\n",
+            restored, cfg->num_sensors, name, now_ms() - (long)checkpoint_saved_ms(ck));
+}
+
+bool hub_restore_fd(hub_t *h, int fd) {
+    ckpt_file_t *ck = checkpoint_open_fd(fd, "handover snapshot", now_ms(), h->cfg->checkpoint_max_age_s * 1000L);
+    if (!ck) return false;
+    restore_windows(h, ck, "handover snapshot");
+    checkpoint_close(ck);
+    return true;
+}
+
+// copy every window into cw (rings stored in copy); one shard at a time so
+// processors are blocked only briefly
+static bool snapshot_windows(hub_t *h, ckpt_window_t **cw_out, double **copy_out) {
+    const hub_config_t *cfg = h->cfg;
+    ckpt_window_t *cw = calloc((size_t)cfg->num_sensors, sizeof(*cw));
+    double *copy = calloc(1, sizeof(double) * (size_t)h->total_window_slots);
+    if (!cw || !copy) {
+        free(cw);
+        free(copy);
+        return false;
+    }
+    for (int s = 0; s < cfg->shards; ++s) {
+        pthread_mutex_lock(&h->shards[s].wlock);
+        for (int i = s; i < cfg->num_sensors; i += cfg->shards) {
+            const sensor_config_t *sc = &cfg->sensors[i];
+            window_t *w = &h->windows[i];
+            double *dst = copy + h->window_offset[i];
+            for (int k = 0; k < sc->window; ++k) window_slot(w, sc, k, dst + (size_t)k * sc->channels);
+            cw[i] = (ckpt_window_t){ sc->name, sc->window, sc->channels, w->count, w->idx, dst };
+        }
+        pthread_mutex_unlock(&h->shards[s].wlock);
+    }
+    *cw_out = cw;
+    *copy_out = copy;
+    return true;
+}
+
+bool hub_checkpoint_fd(hub_t *h, int fd) {
+    ckpt_window_t *cw;
+    double *copy;
+    if (!snapshot_windows(h, &cw, &copy)) return false;
+    bool ok = checkpoint_write_fd(fd, cw, h->cfg->num_sensors, now_ms());
+    free(cw);
+    free(copy);
+    return ok;
+}
+
+bool hub_checkpoint(hub_t *h) {
+    const hub_config_t *cfg = h->cfg;
+    if (!cfg->checkpoint_path[0]) return true;
+    ckpt_window_t *cw;
+    double *copy;
+    if (!snapshot_windows(h, &cw, &copy)) return false;
+    bool ok = checkpoint_write(cfg->checkpoint_path, cw, cfg->num_sensors, now_ms());
+    if (!ok) fprintf(stderr, "checkpoint: cannot write %s\n", cfg->checkpoint_path);
+    free(cw);
+    free(copy);
+    return ok;
+}
+
+// apply the durability mode after a record was written (caller holds loglock)
+static void log_commit(hub_t *h) {
+    if (h->cfg->durability == DURABILITY_NONE) return;
+    fflush(h->logf);
+    if (h->cfg->durability == DURABILITY_FSYNC) fdatasync(fileno(h->logf));
+}
+
+// open the active log (and its zone map); append = continue an existing log
+static bool open_log(hub_t *h, bool append) {
+    const hub_config_t *cfg = h->cfg;
+    char zpath[HUB_PATH_LEN + 8];
+    h->logf = fopen(cfg->log_path, append ? "a" : "w");
+    if (!h->logf) return false;
+    h->log_synced = false;
+    if (!cfg->zone_map) return true;
+    if (!append) {
+        snprintf(zpath, sizeof(zpath), "%s.zmap", cfg->log_path);
+        remove(zpath);
+    }
+    h->zmap = zonemap_open(cfg->log_path, cfg->zone_block, cfg->log_format == LOG_FORMAT_TEXT);
+    if (!h->zmap) fprintf(stderr, "hub: cannot open zone map for %s\n", cfg->log_path);
+    return h->zmap != NULL;
+}
+
+// before the first record after opening or draining: another process may
+// have appended since, so take size, zone map offset and the names already
+// in the segment (for its Bloom filter) from the file (caller holds loglock)
+static void sync_log(hub_t *h) {
+    const hub_config_t *cfg = h->cfg;
+    struct stat st, at_path;
+    fflush(h->logf);
+    // it may also have rotated the log after we opened it: the handle is then
+    // a closed segment, so reopen the log at the path
+    if (fstat(fileno(h->logf), &st) == 0 &&
+        (stat(cfg->log_path, &at_path) != 0 || st.st_dev != at_path.st_dev || st.st_ino != at_path.st_ino)) {
+        if (h->zmap) zonemap_close(h->zmap);
+        h->zmap = NULL;
+        fclose(h->logf);
+        if (!open_log(h, true) && !h->logf) {
+            fprintf(stderr, "hub: cannot reopen %s, logging stopped\n", cfg->log_path);
+            return;
+        }
+    }
+    h->log_bytes = fstat(fileno(h->logf), &st) == 0 ? (uint64_t)st.st_size : 0;
+    if (h->zmap) zonemap_start(h->zmap, h->log_bytes);
+    if (h->seg_names && h->log_bytes) {
+        record_reader_t *rd = record_open(cfg->log_path);
+        hub_record_t r;
+        segment_names_clear(h->seg_names);
+        while (rd && record_next(rd, &r) == 1) segment_names_add(h->seg_names, r.type);
+        record_close(rd);
+    }
+    h->log_synced = true;
+}
+
+// close the active log as the next numbered segment with its Bloom filter
+// and start an empty one (caller holds loglock)
+static void rotate_log(hub_t *h) {
+    const hub_config_t *cfg = h->cfg;
+    char seg[HUB_PATH_LEN + 16], from[HUB_PATH_LEN + 8], to[HUB_PATH_LEN + 24];
+    if (h->zmap) zonemap_close(h->zmap);
+    h->zmap = NULL;
+    fclose(h->logf);
+    h->logf = NULL;
+
+    segment_path(seg, sizeof(seg), cfg->log_path, segment_next_seq(cfg->log_path));
+    // the filter goes first: a segment without one would be read by every lookup
+    if (!segment_names_complete(h->seg_names))
+        fprintf(stderr, "hub: names of %s incomplete, writing no filter\n", seg);
+    else if (!bloom_write(seg, h->seg_names))
+        fprintf(stderr, "hub: cannot write %s.bloom\n", seg);
+    if (cfg->zone_map) {
+        snprintf(from, sizeof(from), "%s.zmap", cfg->log_path);
+        snprintf(to, sizeof(to), "%s.zmap", seg);
+        rename(from, to);
+    }
+    if (rename(cfg->log_path, seg) != 0) fprintf(stderr, "hub: cannot rename %s to %s\n", cfg->log_path, seg);
+    segment_names_clear(h->seg_names);
+    if (!open_log(h, false)) fprintf(stderr, "hub: cannot reopen %s, logging stopped\n", cfg->log_path);
+}
+
+// write one record (with its channel values, if any) in the configured format
+static void log_record(hub_t *h, const hub_record_t *r, const double *values) {
+    pthread_mutex_lock(&h->loglock);
+    if (h->logf && !h->log_synced) sync_log(h);
+    if (h->logf) {
+        size_t n = record_write_values(h->logf, h->cfg->log_format == LOG_FORMAT_BINARY, r, values);
+        if (h->zmap) zonemap_add(h->zmap, r->type, r->kind, r->value, r->ms_timestamp, n);
+        log_commit(h);
+        h->log_bytes += n;
+        if (h->seg_names) {
+            segment_names_add(h->seg_names, r->type);
+            if (h->log_bytes >= h->cfg->log_segment_bytes) rotate_log(h);
+        }
+    }
+    if (h->tap) h->tap(h->tap_ctx, r, values);
+    if (h->alert_hook && r->kind == REC_ALERT) h->alert_hook(h->alert_ctx, r);
+    pthread_mutex_unlock(&h->loglock);
+}
+
+void hub_set_record_tap(hub_t *h, hub_record_fn fn, void *ctx) {
+    pthread_mutex_lock(&h->loglock);
+    h->tap = fn;
+    h->tap_ctx = ctx;
+    pthread_mutex_unlock(&h->loglock);
+}
+
+void hub_set_alert_hook(hub_t *h, hub_alert_fn fn, void *ctx) {
+    pthread_mutex_lock(&h->loglock);
+    h->alert_hook = fn;
+    h->alert_ctx = ctx;
+    pthread_mutex_unlock(&h->loglock);
+}
+
+static void log_alert(hub_t *h, const char *type, double value, long ms_timestamp) {
+    hub_record_t r;
+    record_fill(&r, REC_ALERT, type, value, ms_timestamp);
+    log_record(h, &r, &value);
+}
+
+bool hub_submit(hub_t *h, const char *type, double value, long ms_timestamp) {
+    return hub_submit_vector(h, type, &value, 1, ms_timestamp);
+}
+
+static bool submit_sensor(hub_t *h, int sensor, const char *type, const double *values, int channels, long ms_timestamp);
+
 // enqueue (called by sensors)
-void hub_submit_sample(const char *type, double value, long ms_timestamp) {
-    pthread_mutex_lock(&qlock);
-    size_t next = (q_tail + 1) % QUEUE_SIZE;
-    if (next == q_head) {
+bool hub_submit_vector(hub_t *h, const char *type, const double *values, int channels, long ms_timestamp) {
+    if (channels < 1) return false;
+    if (channels > HUB_MAX_CHANNELS) channels = HUB_MAX_CHANNELS;
+    int sensor = h->spec ? h->spec->sensor_index(type) : config_sensor_index(h->cfg, type);
+    return submit_sensor(h, sensor, type, values, channels, ms_timestamp);
+}
+
+// enqueue one sample of a resolved sensor (-1 = unknown type)
+static bool submit_sensor(hub_t *h, int sensor, const char *type, const double *values, int channels, long ms_timestamp) {
+    // encode once; the log shows the values as the processors will see them.
+    // Channels beyond the sensor's configured count are logged but not processed.
+    double logged[HUB_MAX_CHANNELS] = { 0 };
+    unsigned char payload[HUB_MAX_CHANNELS * sizeof(double)];
+    memcpy(logged, values, sizeof(double) * (size_t)channels);
+    if (sensor >= 0) {
+        const sensor_config_t *sc = &h->cfg->sensors[sensor];
+        encoding_pack(sc, logged, payload);
+        encoding_unpack(sc, payload, logged);
+    }
+    shard_t *sh = shard_for(h, sensor);
+
+    pthread_mutex_lock(&sh->qlock);
+    sh->n_submitted++;
+    size_t next = (sh->q_tail + 1) % h->cfg->queue_size;
+    if (next == sh->q_head) {
         // drop the sample if the queue is full
-        pthread_mutex_unlock(&qlock);
-        return;
+        sh->n_dropped++;
+        pthread_mutex_unlock(&sh->qlock);
+        return false;
     }
-    strncpy(queue[q_tail].type, type, MAX_TYPE_LEN-1);
-    queue[q_tail].type[MAX_TYPE_LEN-1] = '\0';
-    queue[q_tail].value = value;
-    queue[q_tail].ms_timestamp = ms_timestamp;
-    q_tail = next;
-    pthread_cond_signal(&qcond);
-    pthread_mutex_unlock(&qlock);
+    slot_t *slot = slot_at(sh, sh->q_tail);
+    slot->sensor = sensor;
+    slot->ms_timestamp = ms_timestamp;
+    if (sensor >= 0) memcpy(slot->payload, payload, h->cfg->sensors[sensor].channels * encoding_width(h->cfg->sensors[sensor].encoding));
+    sh->q_tail = next;
+    sh->n_enqueued++;
+    pthread_cond_signal(&sh->qcond);
+    pthread_mutex_unlock(&sh->qlock);
 
     // also write raw sample line to log for trace
-    pthread_mutex_lock(&loglock);
-    if (logf) {
-        fprintf(logf, "SAMPLE|%s|%.3f|%ld\n", type, value, ms_timestamp);
-        fflush(logf);
+    hub_record_t r;
+    record_fill_values(&r, type, logged, channels, ms_timestamp);
+    log_record(h, &r, logged);
+    return true;
+}
+
+// create the parent directories of path (like mkdir -p $(dirname path))
+static bool make_parent_dirs(const char *path) {
+    char buf[HUB_PATH_LEN];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char *p = buf + 1; *p; ++p) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(buf, 0755) != 0 && errno != EEXIST) return false;
+        *p = '/';
+    }
+    return true;
+}
+
+// the fields a generated processor bakes in must match for every sensor
+static bool spec_matches(const hub_spec_t *spec, const hub_config_t *cfg) {
+    if (spec->num_sensors != cfg->num_sensors) return false;
+    for (int i = 0; i < cfg->num_sensors; ++i) {
+        const sensor_config_t *a = &spec->sensors[i], *b = &cfg->sensors[i];
+        if (strcmp(a->name, b->name) != 0 || a->window != b->window || a->threshold != b->threshold ||
+            a->channels != b->channels || a->alert != b->alert || a->encoding != b->encoding) return false;
+        if (encoding_is_integer(a->encoding) && (a->scale != b->scale || a->offset != b->offset)) return false;
+    }
+    return true;
+}
+
+// a spectrum per source sensor, with one band per derived sensor in config order
+static bool init_spectra(hub_t *h) {
+    const hub_config_t *cfg = h->cfg;
+    for (int i = 0; i < cfg->num_sensors; ++i) {
+        const spectral_config_t *sp = &cfg->sensors[i].spectral;
+        if (sp->fft == 0) continue;
+        int nb = 0;
+        double (*bands)[2] = malloc(sizeof(*bands) * (size_t)cfg->num_sensors);
+        h->spectra[i].derived = malloc(sizeof(int) * (size_t)cfg->num_sensors);
+        h->spectra[i].energies = malloc(sizeof(double) * (size_t)cfg->num_sensors);
+        if (!bands || !h->spectra[i].derived || !h->spectra[i].energies) {
+            free(bands);
+            return false;
+        }
+        for (int d = 0; d < cfg->num_sensors; ++d) {
+            const spectral_config_t *dp = &cfg->sensors[d].spectral;
+            if (strcmp(dp->source, cfg->sensors[i].name) != 0) continue;
+            bands[nb][0] = dp->band_lo;
+            bands[nb][1] = dp->band_hi;
+            h->spectra[i].derived[nb++] = d;
+        }
+        bool ok = spectrum_init(&h->spectra[i].sp, sp->fft, sp->hop, sp->sliding, sp->rate, (const double (*)[2])bands, nb);
+        free(bands);
+        if (!ok) return false;
     }
-    pthread_mutex_unlock(&loglock);
+    return true;
 }
 
-bool hub_init(const char *logpath) {
-    logf = fopen(logpath, "w");
-    if (!logf) return false;
+// resolve --frames into columns; unknown or repeated names are an error
+static bool init_frames(hub_t *h) {
+    const hub_config_t *cfg = h->cfg;
+    h->frame_column = malloc(sizeof(int) * (size_t)cfg->num_sensors);
+    if (!h->frame_column) return false;
+    for (int i = 0; i < cfg->num_sensors; ++i) h->frame_column[i] = -1;
+    if (!cfg->frames[0]) return true;
+
+    char list[HUB_PATH_LEN];
+    strcpy(list, cfg->frames);
+    h->frame_sensor = malloc(sizeof(int) * (size_t)cfg->num_sensors);
+    if (!h->frame_sensor) return false;
+    int columns = 0;
+    char *save = NULL;
+    for (char *name = strtok_r(list, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        int s = config_sensor_index(cfg, name);
+        if (s < 0 || h->frame_column[s] >= 0) {
+            fprintf(stderr, "hub: frames: unknown or repeated sensor '%s'\n", name);
+            return false;
+        }
+        h->frame_column[s] = columns;
+        h->frame_sensor[columns++] = s;
+    }
+    if (columns == 0) return true;
+    h->frames = malloc(sizeof(*h->frames));
+    if (!h->frames) return false;
+    if (!resampler_init(h->frames, columns, cfg->frame_ms, cfg->frame_mode, cfg->frame_len)) {
+        free(h->frames);
+        h->frames = NULL;
+        return false;
+    }
     return true;
 }
 
-void hub_shutdown(void) {
-    pthread_mutex_lock(&qlock);
-    pthread_cond_broadcast(&qcond);
-    pthread_mutex_unlock(&qlock);
+hub_t *hub_create(const hub_config_t *cfg) {
+    return hub_create_spec(cfg, NULL);
+}
+
+hub_t *hub_create_spec(const hub_config_t *cfg, const hub_spec_t *spec) {
+    hub_t *h = calloc(1, sizeof(*h));
+    if (!h) return NULL;
+    h->cfg = cfg;
+    if (spec && !spec_matches(spec, cfg)) {
+        fprintf(stderr, "hub: sensors differ from schema %s, using the runtime processor\n", spec->schema);
+        spec = NULL;
+    }
+    h->spec = spec;
+    pthread_mutex_init(&h->loglock, NULL);
+
+    h->shards = calloc((size_t)cfg->shards, sizeof(*h->shards));
+    h->windows = calloc((size_t)cfg->num_sensors, sizeof(*h->windows));
+    h->window_offset = calloc((size_t)cfg->num_sensors, sizeof(*h->window_offset));
+    h->history = calloc((size_t)cfg->num_sensors, sizeof(*h->history));
+    h->spectra = calloc((size_t)cfg->num_sensors, sizeof(*h->spectra));
+    if (!h->shards || !h->windows || !h->window_offset || !h->history || !h->spectra) goto fail;
+    for (int i = 0; i < cfg->shards; ++i) {
+        shard_t *sh = &h->shards[i];
+        sh->hub = h;
+        sh->id = i;
+        pthread_mutex_init(&sh->qlock, NULL);
+        pthread_cond_init(&sh->qcond, NULL);
+        pthread_mutex_init(&sh->wlock, NULL);
+        // header plus the widest payload among this shard's sensors, 8-byte aligned
+        size_t payload = 0;
+        for (int s = i; s < cfg->num_sensors; s += cfg->shards) {
+            size_t n = (size_t)cfg->sensors[s].channels * encoding_width(cfg->sensors[s].encoding);
+            if (n > payload) payload = n;
+        }
+        sh->slot_size = (offsetof(slot_t, payload) + payload + 7) & ~(size_t)7;
+        if (sh->slot_size < sizeof(slot_t)) sh->slot_size = sizeof(slot_t);
+        sh->queue = calloc(cfg->queue_size, sh->slot_size);
+        if (!sh->queue) goto fail;
+    }
+    for (int i = 0; i < cfg->num_sensors; ++i) {
+        const sensor_config_t *sc = &cfg->sensors[i];
+        if (!window_init(&h->windows[i], sc)) goto fail;
+        h->window_offset[i] = h->total_window_slots;
+        if (!history_init(&h->history[i], cfg->history_len, cfg->rollup_slots,
+                          (size_t)sc->channels * encoding_width(sc->encoding))) goto fail;
+        h->total_window_slots += (long)sc->window * sc->channels;
+    }
 
-    if (logf) {
-        fclose(logf);
-        logf = NULL;
+    if (!init_spectra(h)) goto fail;
+    if (!init_frames(h)) goto fail;
+
+    if (!make_parent_dirs(cfg->log_path)) goto fail;
+    // a successor appends to the log its predecessor is still draining into
+    if (!open_log(h, cfg->takeover)) goto fail;
+    if (cfg->log_segment_bytes) {
+        h->seg_names = segment_names_new();
+        if (!h->seg_names) goto fail;
     }
+    if (cfg->store_dir[0] && !(h->store = store_open(cfg))) goto fail;
+
+    if (cfg->checkpoint_path[0] && !cfg->takeover) {
+        ckpt_file_t *ck = checkpoint_open(cfg->checkpoint_path, now_ms(), cfg->checkpoint_max_age_s * 1000L);
+        if (ck) {
+            restore_windows(h, ck, cfg->checkpoint_path);
+            checkpoint_close(ck);
+        }
+    }
+    return h;
+
+fail:
+    hub_destroy(h);
+    return NULL;
 }
 
-// processor thread: consumes samples, maintains moving average window per sensor 
-static pthread_t processor_thread_id;
-static volatile int processor_running = 1;
+void hub_destroy(hub_t *h) {
+    if (!h) return;
+    hub_stop(h);
 
-static int sensor_index_for_type(const char *type) {
-    if (strcmp(type, "TEMP") == 0) return SENSOR_TEMP;
-    if (strcmp(type, "HUM") == 0) return SENSOR_HUM;
-    if (strcmp(type, "PRESS") == 0) return SENSOR_PRESS;
-    return -1;
+    // producers may still be logging, so close under loglock
+    pthread_mutex_lock(&h->loglock);
+    if (h->logf) {
+        fclose(h->logf);
+        h->logf = NULL;
+    }
+    zonemap_close(h->zmap);
+    h->zmap = NULL;
+    pthread_mutex_unlock(&h->loglock);
+    segment_names_free(h->seg_names);
+    store_close(h->store);
+
+    const hub_config_t *cfg = h->cfg;
+    for (int i = 0; h->shards && i < cfg->shards; ++i) {
+        shard_t *sh = &h->shards[i];
+        if (!sh->hub) break; // never initialised
+        pthread_mutex_destroy(&sh->qlock);
+        pthread_cond_destroy(&sh->qcond);
+        pthread_mutex_destroy(&sh->wlock);
+        free(sh->queue);
+    }
+    for (int i = 0; h->windows && i < cfg->num_sensors; ++i) window_free(&h->windows[i]);
+    for (int i = 0; h->history && i < cfg->num_sensors; ++i) history_free(&h->history[i]);
+    for (int i = 0; h->spectra && i < cfg->num_sensors; ++i) {
+        if (h->spectra[i].sp.n) spectrum_free(&h->spectra[i].sp);
+        free(h->spectra[i].derived);
+        free(h->spectra[i].energies);
+    }
+    if (h->frames) resampler_free(h->frames);
+    free(h->frames);
+    free(h->frame_column);
+    free(h->frame_sensor);
+    pthread_mutex_destroy(&h->loglock);
+    free(h->shards);
+    free(h->windows);
+    free(h->window_offset);
+    free(h->history);
+    free(h->spectra);
+    free(h);
 }
 
-static void log_alert(const char *type, double avg, long ms_timestamp) {
-    pthread_mutex_lock(&loglock);
-    if (logf) {
-        fprintf(logf, "ALERT|%s|%.3f|%ld|THRESHOLD_EXCEEDED\n", type, avg, ms_timestamp);
-        fflush(logf);
+void hub_get_stats(hub_t *h, hub_stats_t *out) {
+    const hub_config_t *cfg = h->cfg;
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < cfg->shards; ++i) {
+        shard_t *sh = &h->shards[i];
+        pthread_mutex_lock(&sh->qlock);
+        out->submitted += sh->n_submitted;
+        out->dropped += sh->n_dropped;
+        out->enqueued += sh->n_enqueued;
+        out->processed += sh->n_processed;
+        out->pending += (sh->q_tail + cfg->queue_size - sh->q_head) % cfg->queue_size;
+        pthread_mutex_unlock(&sh->qlock);
     }
-    pthread_mutex_unlock(&loglock);
 }
 
+// processor thread: consumes samples of one shard, maintains moving average window per sensor
 static void *processor_main(void *arg) {
-    (void)arg;
-    // circular windows
-    double windows[NUM_SENSOR_TYPES][WINDOW_SIZE];
-    int win_counts[NUM_SENSOR_TYPES] = {0};
-    int win_idx[NUM_SENSOR_TYPES] = {0};
-    double win_sums[NUM_SENSOR_TYPES] = {0.0};
-    memset(windows, 0, sizeof(windows));
-
-    while (processor_running) {
+    shard_t *sh = (shard_t*)arg;
+    hub_t *h = sh->hub;
+    const hub_config_t *cfg = h->cfg;
+
+    for (;;) {
         // pop one sample (wait if empty)
-        pthread_mutex_lock(&qlock);
-        while (q_head == q_tail && processor_running) {
-            pthread_cond_wait(&qcond, &qlock);
+        pthread_mutex_lock(&sh->qlock);
+        while (sh->q_head == sh->q_tail && sh->processor_running) {
+            pthread_cond_wait(&sh->qcond, &sh->qlock);
         }
-        if (!processor_running) {
-            pthread_mutex_unlock(&qlock);
+        if (!sh->processor_running && (!sh->drain || sh->q_head == sh->q_tail)) {
+            pthread_mutex_unlock(&sh->qlock);
             break;
         }
-        sample_t s = queue[q_head];
-        q_head = (q_head + 1) % QUEUE_SIZE;
-        pthread_mutex_unlock(&qlock);
+        const slot_t *slot = slot_at(sh, sh->q_head);
+        int idx = slot->sensor;
+        long ts = (long)slot->ms_timestamp;
+        unsigned char payload[HUB_MAX_CHANNELS * sizeof(double)];
+        if (idx >= 0) {
+            memcpy(payload, slot->payload, cfg->sensors[idx].channels * encoding_width(cfg->sensors[idx].encoding));
+        }
+        sh->q_head = (sh->q_head + 1) % cfg->queue_size;
+        sh->n_processed++;
+        pthread_mutex_unlock(&sh->qlock);
 
-        int idx = sensor_index_for_type(s.type);
         if (idx < 0) continue;
-
-        // update moving window
-        if (win_counts[idx] < WINDOW_SIZE) {
-            // just add if window is not full yet
-            windows[idx][win_idx[idx]] = s.value;
-            win_sums[idx] += s.value;
-            win_counts[idx]++;
-            win_idx[idx] = (win_idx[idx] + 1) % WINDOW_SIZE;
+        const sensor_config_t *sc = &cfg->sensors[idx];
+        window_t *w = &h->windows[idx];
+        hub_vec_t value;
+        double metric = 0;
+        bool alert;
+        if (h->spec) {
+            pthread_mutex_lock(&sh->wlock);
+            alert = h->spec->process(w, idx, payload, &value, &metric);
+            pthread_mutex_unlock(&sh->wlock);
         } else {
-            // window is full: subtract oldest and add new 
-            double old = windows[idx][win_idx[idx]];
-            win_sums[idx] -= old;
-            windows[idx][win_idx[idx]] = s.value;
-            win_sums[idx] += s.value;
-            win_idx[idx] = (win_idx[idx] + 1) % WINDOW_SIZE;
+            // update moving window and check the threshold
+            pthread_mutex_lock(&sh->wlock);
+            alert = window_update(w, sc, payload, &value, &metric);
+            pthread_mutex_unlock(&sh->wlock);
         }
+        double scalar = sc->channels > 1 ? vec_norm(&value) : value[0];
+        history_push(&h->history[idx], ts, scalar, payload);
+        if (h->store) store_append(h->store, idx, ts, payload);
+        if (h->frame_column[idx] >= 0) resampler_push(h->frames, h->frame_column[idx], ts, scalar);
 
-        double avg = win_sums[idx] / (win_counts[idx] > 0 ? win_counts[idx] : 1);
+        // log an alert if necessary
+        if (alert) log_alert(h, sc->name, metric, ts);
 
-        // check thresholds and log an alert if necessary
-        if (idx == SENSOR_TEMP && win_counts[idx] == WINDOW_SIZE && avg > THRESHOLD_TEMP) {
-            log_alert("TEMP", avg, s.ms_timestamp);
-        } else if (idx == SENSOR_HUM && win_counts[idx] == WINDOW_SIZE && avg > THRESHOLD_HUM) {
-            log_alert("HUM", avg, s.ms_timestamp);
-        } else if (idx == SENSOR_PRESS && win_counts[idx] == WINDOW_SIZE && avg > THRESHOLD_PRESS) {
-            log_alert("PRESS", avg, s.ms_timestamp);
+        // band energies enter the hub as samples of the derived sensors
+        spectral_t *sx = &h->spectra[idx];
+        if (sx->derived && spectrum_push(&sx->sp, scalar, sx->energies)) {
+            for (int b = 0; b < sx->sp.num_bands; ++b) {
+                int d = sx->derived[b];
+                submit_sensor(h, d, cfg->sensors[d].name, &sx->energies[b], 1, ts);
+            }
         }
-
     }
     return NULL;
 }
 
-void start_hub_processor(void) {
-    processor_running = 1;
-    pthread_create(&processor_thread_id, NULL, processor_main, NULL);
+bool hub_start(hub_t *h) {
+    const hub_config_t *cfg = h->cfg;
+    for (int i = 0; i < cfg->shards; ++i) {
+        shard_t *sh = &h->shards[i];
+        if (sh->started) continue;
+        pthread_mutex_lock(&sh->qlock);
+        sh->processor_running = 1;
+        sh->drain = 0;
+        pthread_mutex_unlock(&sh->qlock);
+        if (pthread_create(&sh->processor_thread_id, NULL, processor_main, sh) != 0) return false;
+        sh->started = true;
+        if (cfg->num_pin_cpus > 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cfg->pin_cpus[i % cfg->num_pin_cpus], &set);
+            if (pthread_setaffinity_np(sh->processor_thread_id, sizeof(set), &set) != 0) {
+                fprintf(stderr, "hub: cannot pin shard %d to cpu %d\n", i, cfg->pin_cpus[i % cfg->num_pin_cpus]);
+            }
+        }
+    }
+    return true;
+}
+
+static void stop_processors(hub_t *h, int drain) {
+    for (int i = 0; h->shards && i < h->cfg->shards; ++i) {
+        shard_t *sh = &h->shards[i];
+        if (!sh->started) continue;
+        pthread_mutex_lock(&sh->qlock);
+        sh->processor_running = 0;
+        sh->drain = drain;
+        pthread_cond_broadcast(&sh->qcond);
+        pthread_mutex_unlock(&sh->qlock);
+        pthread_join(sh->processor_thread_id, NULL);
+        sh->started = false;
+    }
+}
+
+// request processor stop (used on shutdown); queued samples stay pending
+void hub_stop(hub_t *h) {
+    stop_processors(h, 0);
+}
+
+void hub_drain(hub_t *h) {
+    stop_processors(h, 1);
+    // a successor may append next: put the log and its zone map on disk
+    pthread_mutex_lock(&h->loglock);
+    if (h->logf) fflush(h->logf);
+    if (h->zmap) zonemap_flush(h->zmap);
+    h->log_synced = false;
+    pthread_mutex_unlock(&h->loglock);
+    if (h->store) store_flush(h->store);
+}
+
+int hub_sensor_count(hub_t *h) {
+    return h->cfg->num_sensors;
+}
+
+int hub_sensor_index(hub_t *h, const char *name) {
+    return config_sensor_index(h->cfg, name);
+}
+
+const char *hub_sensor_name(hub_t *h, int sensor) {
+    if (sensor < 0 || sensor >= h->cfg->num_sensors) return NULL;
+    return h->cfg->sensors[sensor].name;
+}
+
+const void *hub_history_raw(hub_t *h, int sensor, size_t *capacity, int *channels) {
+    if (sensor < 0 || sensor >= h->cfg->num_sensors) {
+        *capacity = 0;
+        *channels = 0;
+        return NULL;
+    }
+    *capacity = h->history[sensor].capacity;
+    *channels = h->cfg->sensors[sensor].channels;
+    return h->history[sensor].raw;
+}
+
+int hub_sensor_encoding(hub_t *h, int sensor, double *scale, double *offset) {
+    if (sensor < 0 || sensor >= h->cfg->num_sensors) return -1;
+    const sensor_config_t *sc = &h->cfg->sensors[sensor];
+    *scale = encoding_is_integer(sc->encoding) ? sc->scale : 1.0;
+    *offset = encoding_is_integer(sc->encoding) ? sc->offset : 0.0;
+    return (int)sc->encoding;
+}
+
+const hub_point_t *hub_history_points(hub_t *h, int sensor, size_t *capacity) {
+    if (sensor < 0 || sensor >= h->cfg->num_sensors) {
+        *capacity = 0;
+        return NULL;
+    }
+    *capacity = h->history[sensor].capacity;
+    return h->history[sensor].points;
+}
+
+uint64_t hub_history_written(hub_t *h, int sensor) {
+    if (sensor < 0 || sensor >= h->cfg->num_sensors) return 0;
+    return atomic_load_explicit(&h->history[sensor].written, memory_order_acquire);
+}
+
+const hub_bucket_t *hub_rollup_buckets(hub_t *h, int sensor, int tier, size_t *slots) {
+    if (sensor < 0 || sensor >= h->cfg->num_sensors || tier < 0 || tier >= HUB_ROLLUP_TIERS) {
+        *slots = 0;
+        return NULL;
+    }
+    *slots = h->history[sensor].slots;
+    return h->history[sensor].buckets[tier];
+}
+
+uint64_t hub_rollup_opened(hub_t *h, int sensor, int tier) {
+    if (sensor < 0 || sensor >= h->cfg->num_sensors || tier < 0 || tier >= HUB_ROLLUP_TIERS) return 0;
+    return atomic_load_explicit(&h->history[sensor].opened[tier], memory_order_acquire);
+}
+
+int hub_rollup_tiers(void) {
+    return HUB_ROLLUP_TIERS;
+}
+
+long hub_rollup_width_ms(int tier) {
+    return history_tier_width_ms(tier);
+}
+
+int hub_frame_columns(hub_t *h, long *period_ms) {
+    if (!h->frames) return 0;
+    *period_ms = h->frames->period_ms;
+    return h->frames->columns;
+}
+
+int hub_frame_sensor(hub_t *h, int column) {
+    if (!h->frames || column < 0 || column >= h->frames->columns) return -1;
+    return h->frame_sensor[column];
+}
+
+const int64_t *hub_frame_times(hub_t *h, size_t *capacity) {
+    if (!h->frames) return NULL;
+    *capacity = h->frames->capacity;
+    return h->frames->times;
+}
+
+const double *hub_frame_values(hub_t *h, size_t *capacity) {
+    if (!h->frames) return NULL;
+    *capacity = h->frames->capacity;
+    return h->frames->values;
+}
+
+uint64_t hub_frames_written(hub_t *h) {
+    if (!h->frames) return 0;
+    return atomic_load_explicit(&h->frames->written, memory_order_acquire);
 }
 
-// Function to request processor stop (used on shutdown)
-void hub_processor_stop(void) {
-    processor_running = 0;
-    pthread_cond_broadcast(&qcond);
-    pthread_join(processor_thread_id, NULL);
+int hub_api_version(void) {
+    return HUB_API_VERSION;
 }
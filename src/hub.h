@@ -1,17 +1,106 @@
 #ifndef HUB_H
 #define HUB_H
 #include <stdbool.h>
+#include "config.h"
+#include "history.h"
+#include "record.h"
 
-bool hub_init(const char *logpath);
-void hub_shutdown(void);
+// bumped on incompatible changes to this header or history.h (libsensorhub ABI)
+#define HUB_API_VERSION 1
+int hub_api_version(void);
 
-// API used by sensors
-void hub_submit_sample(const char *type, double value, long ms_timestamp);
+// One hub instance: its own queues, processor threads, windows and log.
+// Several hubs can run side by side in one process.
+typedef struct hub hub_t;
 
-// Start processor thread
-void start_hub_processor(void);
+// Allocate queues and windows, open the log and restore a checkpoint if one
+// is configured. cfg must stay valid (and unchanged) until hub_destroy().
+hub_t *hub_create(const hub_config_t *cfg);
 
-// Stop processor thread
-void hub_processor_stop(void);
+// Start processor threads (one per shard)
+bool hub_start(hub_t *h);
 
-#endif
\ No newline at end of file
+// API used by sensors; returns false if the sample was dropped (queue full)
+bool hub_submit(hub_t *h, const char *type, double value, long ms_timestamp);
+
+// multi-channel sample (1..HUB_MAX_CHANNELS values, one queue slot and one
+// log record); channels beyond the sensor's configured count are only logged
+bool hub_submit_vector(hub_t *h, const char *type, const double *values, int channels, long ms_timestamp);
+
+// Stop processor threads; queued samples stay pending
+void hub_stop(hub_t *h);
+
+// Stop processor threads after they have processed everything already queued
+void hub_drain(hub_t *h);
+
+// Stop (if running), close the log and free everything. Producers must be
+// stopped first.
+void hub_destroy(hub_t *h);
+
+// Record tap: fn sees every record as it is logged (samples from the
+// producers, alerts from the processors) with its channel values
+// (max(1, channels)), in log order. It runs under the log lock, so it must
+// not block or call into the hub. NULL removes the tap.
+typedef void (*hub_record_fn)(void *ctx, const hub_record_t *r, const double *values);
+void hub_set_record_tap(hub_t *h, hub_record_fn fn, void *ctx);
+
+// Alert hook: fn sees each alert record right after the tap, on the
+// processor that raised it and under the log lock, with the same rules.
+// NULL removes the hook.
+typedef void (*hub_alert_fn)(void *ctx, const hub_record_t *r);
+void hub_set_alert_hook(hub_t *h, hub_alert_fn fn, void *ctx);
+
+// Queue accounting: submitted == enqueued + dropped, enqueued == processed + pending
+typedef struct {
+    unsigned long submitted;
+    unsigned long enqueued;
+    unsigned long dropped;   // rejected because the queue was full
+    unsigned long processed; // consumed by the processor threads
+    unsigned long pending;   // still in the queues
+} hub_stats_t;
+
+void hub_get_stats(hub_t *h, hub_stats_t *out);
+
+// Write all per-sensor window state to cfg->checkpoint_path (no-op if unset).
+// Safe to call while processors run; hub_create() restores from the same file.
+bool hub_checkpoint(hub_t *h);
+
+// Same snapshot written to / restored from an open descriptor (handover)
+bool hub_checkpoint_fd(hub_t *h, int fd);
+bool hub_restore_fd(hub_t *h, int fd);
+
+// Sensors by index (0 .. count-1); hub_sensor_index() is -1 for unknown names
+int hub_sensor_count(hub_t *h);
+int hub_sensor_index(hub_t *h, const char *name);
+const char *hub_sensor_name(hub_t *h, int sensor);
+
+// Zero-copy views of a sensor's history ring and rollup tiers. The arrays are
+// written in place by the processors and stay valid until hub_destroy().
+// An unknown sensor or tier gives NULL with the sizes set to 0.
+// Counters are totals: entry k lives in slot k % capacity and the last
+// min(n, capacity) entries are valid. Readers do not lock, so the newest
+// bucket and the slot about to be overwritten may change while being read.
+const hub_point_t *hub_history_points(hub_t *h, int sensor, size_t *capacity);
+uint64_t hub_history_written(hub_t *h, int sensor);
+// per-channel values of the same ring, as stored: capacity rows of *channels
+// values in the sensor's encoding (value = raw * scale + offset)
+const void *hub_history_raw(hub_t *h, int sensor, size_t *capacity, int *channels);
+// value_encoding_t of the sensor (-1 if unknown); scale/offset are 1/0 for floats
+int hub_sensor_encoding(hub_t *h, int sensor, double *scale, double *offset);
+const hub_bucket_t *hub_rollup_buckets(hub_t *h, int sensor, int tier, size_t *slots);
+uint64_t hub_rollup_opened(hub_t *h, int sensor, int tier);
+int hub_rollup_tiers(void);
+long hub_rollup_width_ms(int tier);
+
+// Frame stream (--frames): the listed sensors resampled onto one grid of
+// period_ms. Column c of the ring is values[c * capacity .. +capacity) and
+// holds sensor hub_frame_sensor(c); frame k is times[k % capacity] and row
+// k % capacity of every column. Same ring and reader rules as the history.
+// hub_frame_columns() is 0 when no frames are configured.
+int hub_frame_columns(hub_t *h, long *period_ms);
+int hub_frame_sensor(hub_t *h, int column);
+const int64_t *hub_frame_times(hub_t *h, size_t *capacity);
+const double *hub_frame_values(hub_t *h, size_t *capacity);
+uint64_t hub_frames_written(hub_t *h);
+
+#endif
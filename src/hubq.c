@@ -0,0 +1,291 @@
+#define _POSIX_C_SOURCE 200809L
+#include "compact.h"
+#include "config.h"
+#include "query.h"
+#include "record.h"
+#include "segment.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+// hubq: filter hub logs and their closed segments by sensor, kind, time and
+// value, printing the matching records as text log lines or count/min/max/avg
+// per sensor and time bucket. See src/query.h for how files are read and
+// src/compact.h for compacted segments.
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s [options] LOG...\n"
+        "  each LOG is read after its closed segments (LOG.000001, ...), oldest first;\n"
+        "  compacted segments (LOG.000001.col) come out in time order\n"
+        "  --sensor LIST    only these sensors (comma-separated)\n"
+        "  --kind K         sample, alert or all (default all)\n"
+        "  --from T         first timestamp; T is epoch ms, now, or -N[ms|s|m|h|d] before now\n"
+        "  --to T           last timestamp\n"
+        "  --min V          smallest value (vector magnitude, alert metric)\n"
+        "  --max V          largest value\n"
+        "  --bucket MS      print bucket_ms,sensor,count,min,max,avg per sensor and bucket\n"
+        "                   instead of records (0 = one bucket for the whole range)\n"
+        "  --limit N        stop after N matching records\n"
+        "  --explain        print files and blocks skipped and bytes scanned to stderr\n",
+        prog);
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool parse_time(const char *s, int64_t *out) {
+    if (strcmp(s, "now") == 0) {
+        *out = now_ms();
+        return true;
+    }
+    char *end;
+    long long n = strtoll(s, &end, 10);
+    if (end == s) return false;
+    if (*s != '-') {
+        *out = n;
+        return *end == '\0';
+    }
+    // relative to now
+    static const struct { const char *unit; int64_t ms; } units[] = {
+        { "", 1 }, { "ms", 1 }, { "s", 1000 }, { "m", 60000 }, { "h", 3600000 }, { "d", 86400000 },
+    };
+    for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); ++i) {
+        if (strcmp(end, units[i].unit) == 0) {
+            *out = now_ms() + n * units[i].ms;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_double(const char *s, double *out) {
+    char *end;
+    *out = strtod(s, &end);
+    return end != s && *end == '\0';
+}
+
+// per (sensor, bucket) aggregates, open addressing
+typedef struct {
+    char type[16];
+    int64_t bucket;
+    unsigned long count;
+    double min, max, sum;
+    bool used;
+} agg_t;
+
+typedef struct {
+    agg_t *slots;
+    size_t size, used;
+    int64_t bucket_ms;
+    unsigned long long limit, printed;
+} output_t;
+
+static uint64_t agg_hash(const char *type, int64_t bucket) {
+    uint64_t h = 14695981039346656037ull; // FNV-1a
+    for (size_t i = 0; i < 16 && type[i]; ++i) h = (h ^ (unsigned char)type[i]) * 1099511628211ull;
+    return (h ^ (uint64_t)bucket) * 1099511628211ull;
+}
+
+static agg_t *agg_lookup(output_t *o, const char *type, int64_t bucket) {
+    if ((o->used + 1) * 2 > o->size) {
+        size_t size = o->size ? o->size * 2 : 1024;
+        agg_t *slots = calloc(size, sizeof(*slots));
+        if (!slots) return NULL;
+        for (size_t i = 0; i < o->size; ++i) {
+            if (!o->slots[i].used) continue;
+            size_t h = agg_hash(o->slots[i].type, o->slots[i].bucket) & (size - 1);
+            while (slots[h].used) h = (h + 1) & (size - 1);
+            slots[h] = o->slots[i];
+        }
+        free(o->slots);
+        o->slots = slots;
+        o->size = size;
+    }
+    size_t h = agg_hash(type, bucket) & (o->size - 1);
+    while (o->slots[h].used) {
+        agg_t *a = &o->slots[h];
+        if (a->bucket == bucket && strncmp(a->type, type, 16) == 0) return a;
+        h = (h + 1) & (o->size - 1);
+    }
+    agg_t *a = &o->slots[h];
+    a->used = true;
+    memcpy(a->type, type, strnlen(type, sizeof(a->type) - 1));
+    a->bucket = bucket;
+    a->min = INFINITY;
+    a->max = -INFINITY;
+    o->used++;
+    return a;
+}
+
+static bool emit_record(void *ctx, const hub_record_t *r, const double *values) {
+    output_t *o = ctx;
+    if (o->bucket_ms < 0) {
+        record_write_values(stdout, 0, r, values);
+    } else {
+        int64_t b = 0;
+        if (o->bucket_ms > 0) {
+            b = r->ms_timestamp / o->bucket_ms;
+            if (r->ms_timestamp % o->bucket_ms < 0) b--;
+            b *= o->bucket_ms;
+        }
+        agg_t *a = agg_lookup(o, r->type, b);
+        if (!a) return false;
+        a->count++;
+        if (r->value < a->min) a->min = r->value;
+        if (r->value > a->max) a->max = r->value;
+        a->sum += r->value;
+    }
+    return ++o->printed < o->limit;
+}
+
+static int agg_cmp(const void *x, const void *y) {
+    const agg_t *a = x, *b = y;
+    if (a->bucket != b->bucket) return a->bucket < b->bucket ? -1 : 1;
+    return strncmp(a->type, b->type, 16);
+}
+
+static void print_aggregates(output_t *o) {
+    size_t n = 0;
+    for (size_t i = 0; i < o->size; ++i) {
+        if (o->slots[i].used) o->slots[n++] = o->slots[i];
+    }
+    qsort(o->slots, n, sizeof(*o->slots), agg_cmp);
+    printf("bucket_ms,sensor,count,min,max,avg\n");
+    for (size_t i = 0; i < n; ++i) {
+        const agg_t *a = &o->slots[i];
+        printf("%lld,%s,%lu,%.3f,%.3f,%.3f\n", (long long)a->bucket, a->type, a->count, a->min, a->max,
+               a->sum / (double)a->count);
+    }
+}
+
+static unsigned seq_of(const char *path) {
+    const char *dot = strrchr(path, '.');
+    return dot ? (unsigned)strtoul(dot + 1, NULL, 10) : 0;
+}
+
+// the closed segments of log, oldest first, then log itself; a segment the
+// compaction manifest lists is read from its .col file. Segments are listed
+// before the manifest is loaded: the compactor updates the manifest before
+// it deletes a raw segment, so every segment is in at least one of them.
+static int query_log(const query_t *q, const char *log, output_t *o, query_stats_t *st) {
+    char **segs;
+    int n = segment_list(log, &segs);
+    compact_entry_t *done;
+    int ndone = compact_manifest_load(log, &done);
+    if (ndone < 0) {
+        fprintf(stderr, "hubq: invalid compaction manifest for %s\n", log);
+        for (int j = 0; j < n; ++j) free(segs[j]);
+        free(segs);
+        return -1;
+    }
+    int rc = 1, i = 0, k = 0;
+    while (rc == 1 && (i < n || k < ndone)) {
+        unsigned seq = i < n ? seq_of(segs[i]) : ~0u;
+        if (k < ndone && done[k].seq <= seq) {
+            char path[HUB_PATH_LEN + 32];
+            compact_path(path, sizeof(path), log, done[k].seq);
+            rc = query_compact(q, path, &done[k], emit_record, o, st);
+            if (rc < 0) fprintf(stderr, "hubq: cannot read %s\n", path);
+            if (done[k++].seq == seq) i++;   // raw copy not deleted yet
+        } else {
+            rc = query_file(q, segs[i], emit_record, o, st);
+            if (rc < 0) fprintf(stderr, "hubq: cannot read %s\n", segs[i]);
+            i++;
+        }
+    }
+    for (int j = 0; j < n; ++j) free(segs[j]);
+    free(segs);
+    free(done);
+    struct stat sb;
+    if (rc == 1 && ((n <= 0 && ndone == 0) || stat(log, &sb) == 0)) {
+        rc = query_file(q, log, emit_record, o, st);
+        if (rc < 0) fprintf(stderr, "hubq: cannot read %s\n", log);
+    }
+    return rc;
+}
+
+int main(int argc, char **argv) {
+    query_t q;
+    query_init(&q);
+    output_t out = { NULL, 0, 0, -1, ~0ull, 0 };
+    bool explain = false;
+    int first_log = argc;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        if (strncmp(a, "--", 2) != 0) {
+            first_log = i;
+            break;
+        }
+        if (strcmp(a, "--explain") == 0) {
+            explain = true;
+            continue;
+        }
+        if (strcmp(a, "--help") == 0 || i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *v = argv[++i];
+        bool ok = true;
+        double d;
+        if (strcmp(a, "--sensor") == 0) {
+            char buf[1024];
+            snprintf(buf, sizeof(buf), "%s", v);
+            char *save = NULL;
+            for (char *t = strtok_r(buf, ",", &save); t && ok; t = strtok_r(NULL, ",", &save)) {
+                ok = query_add_sensor(&q, t);
+            }
+        } else if (strcmp(a, "--kind") == 0) {
+            if (strcmp(v, "sample") == 0) q.kind = REC_SAMPLE;
+            else if (strcmp(v, "alert") == 0) q.kind = REC_ALERT;
+            else ok = strcmp(v, "all") == 0;
+        } else if (strcmp(a, "--from") == 0) {
+            ok = parse_time(v, &q.t0);
+        } else if (strcmp(a, "--to") == 0) {
+            ok = parse_time(v, &q.t1);
+        } else if (strcmp(a, "--min") == 0) {
+            ok = parse_double(v, &q.v0);
+        } else if (strcmp(a, "--max") == 0) {
+            ok = parse_double(v, &q.v1);
+        } else if (strcmp(a, "--bucket") == 0) {
+            ok = parse_double(v, &d) && d >= 0;
+            out.bucket_ms = (int64_t)d;
+        } else if (strcmp(a, "--limit") == 0) {
+            ok = parse_double(v, &d) && d >= 1;
+            out.limit = (unsigned long long)d;
+        } else {
+            fprintf(stderr, "hubq: unknown option '%s'\n", a);
+            usage(argv[0]);
+            return 2;
+        }
+        if (!ok) {
+            fprintf(stderr, "hubq: invalid value '%s' for %s\n", v, a);
+            return 2;
+        }
+    }
+    if (first_log >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    query_stats_t st = { 0 };
+    int rc = 1;
+    for (int i = first_log; i < argc && rc == 1; ++i) rc = query_log(&q, argv[i], &out, &st);
+    if (out.bucket_ms >= 0) print_aggregates(&out);
+    free(out.slots);
+    fflush(stdout);
+
+    if (explain) {
+        fprintf(stderr, "hubq: files %lu (%lu skipped by Bloom filter or time range), blocks %lu (%lu skipped by index), "
+                "scanned %llu of %llu bytes, %llu matched\n", st.files, st.files_skipped, st.blocks,
+                st.blocks_skipped, st.bytes_scanned, st.bytes, st.matched);
+    }
+    return rc < 0 ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ingest.h"
+#include "hub.h"
+#include "record.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static int ingest_fd = -1;
+static char sock_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static pthread_t ingest_thread_id;
+static atomic_int ingest_running = 0;
+static bool thread_started = false;
+static hub_t *target = NULL;
+
+static void handle_datagram(const char *buf, size_t n) {
+    // binary: one record, or a multi-channel record plus its REC_VALUES record
+    if (n == sizeof(hub_record_t) || n == 2 * sizeof(hub_record_t)) {
+        hub_record_t r;
+        memcpy(&r, buf, sizeof(r));
+        if (r.magic == HUB_RECORD_MAGIC && r.kind == REC_SAMPLE) {
+            r.type[sizeof(r.type) - 1] = '\0';
+            if (n == sizeof(r) && r.channels <= 1) {
+                hub_submit(target, r.type, r.value, (long)r.ms_timestamp);
+                return;
+            }
+            hub_values_record_t v;
+            memcpy(&v, buf + sizeof(r), sizeof(v));
+            if (n == 2 * sizeof(r) && v.kind == REC_VALUES && v.channels == r.channels
+                && r.channels <= HUB_RECORD_CHANNELS) {
+                hub_submit_vector(target, r.type, v.values, r.channels, (long)r.ms_timestamp);
+            }
+            return;
+        }
+    }
+    char line[128], type[16], vals[96];
+    double values[HUB_RECORD_CHANNELS];
+    long long ts;
+    if (n >= sizeof(line)) return;
+    memcpy(line, buf, n);
+    line[n] = '\0';
+    const char *p = strncmp(line, "SAMPLE|", 7) == 0 ? line + 7 : line;
+    if (sscanf(p, "%15[^|]|%95[^|]|%lld", type, vals, &ts) == 3) {
+        int nv = record_parse_values(vals, values);
+        if (nv > 0) hub_submit_vector(target, type, values, nv, (long)ts);
+    }
+}
+
+static void *ingest_main(void *arg) {
+    (void)arg;
+    char buf[256];
+    struct pollfd pfd = { .fd = ingest_fd, .events = POLLIN };
+    while (atomic_load(&ingest_running)) {
+        // wake up periodically to notice ingest_detach()/ingest_stop()
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        ssize_t n = recv(ingest_fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0) handle_datagram(buf, (size_t)n);
+    }
+    return NULL;
+}
+
+static bool start_thread(void) {
+    atomic_store(&ingest_running, 1);
+    if (pthread_create(&ingest_thread_id, NULL, ingest_main, NULL) != 0) return false;
+    thread_started = true;
+    return true;
+}
+
+static void stop_thread(void) {
+    if (!thread_started) return;
+    atomic_store(&ingest_running, 0);
+    pthread_join(ingest_thread_id, NULL);
+    thread_started = false;
+}
+
+bool ingest_open(hub_t *hub, const char *socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0) return false;
+    unlink(socket_path); // stale socket from a previous run
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return false;
+    }
+    return ingest_adopt(hub, fd, socket_path);
+}
+
+bool ingest_adopt(hub_t *hub, int fd, const char *socket_path) {
+    target = hub;
+    ingest_fd = fd;
+    snprintf(sock_path, sizeof(sock_path), "%s", socket_path);
+    return start_thread();
+}
+
+int ingest_detach(void) {
+    stop_thread();
+    return ingest_fd;
+}
+
+void ingest_resume(void) {
+    if (ingest_fd >= 0 && !thread_started) start_thread();
+}
+
+void ingest_stop(void) {
+    if (ingest_fd < 0) return;
+    stop_thread();
+    close(ingest_fd);
+    ingest_fd = -1;
+    unlink(sock_path);
+}
@@ -0,0 +1,27 @@
+#ifndef INGEST_H
+#define INGEST_H
+#include <stdbool.h>
+#include "hub.h"
+
+// Local ingestion endpoint for external producers: a Unix datagram socket.
+// Each datagram is one sample, either a text line "TYPE|value|ms_timestamp"
+// (an optional "SAMPLE|" prefix is accepted; multi-channel values are
+// comma-separated) or a binary hub_record_t, followed by its
+// hub_values_record_t for multi-channel samples.
+// One endpoint per process; samples go to hub.
+bool ingest_open(hub_t *hub, const char *socket_path);
+
+// use an already bound socket (received during a handover)
+bool ingest_adopt(hub_t *hub, int fd, const char *socket_path);
+
+// stop the reader thread but keep the socket open; returns its fd so it can
+// be handed over (datagrams queue up in the kernel meanwhile)
+int ingest_detach(void);
+
+// restart the reader on the detached socket (aborted handover)
+void ingest_resume(void);
+
+// stop, close and unlink
+void ingest_stop(void);
+
+#endif
@@ -1,69 +1,252 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <unistd.h>
 #include <string.h>
-#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
 
+#include "aggregate.h"
+#include "backtest.h"
+#include "compactor.h"
+#include "config.h"
+#include "dispatch.h"
+#include "egress.h"
+#include "handover.h"
+#include "http.h"
 #include "hub.h"
+#include "ingest.h"
+#include "metrics.h"
 #include "sensor.h"
+#ifdef HUB_SPEC
+#include "spec.h"
+#endif
 
-static volatile int keep_running = 1;
+#define HANDOVER_TIMEOUT_MS 5000
+
+static volatile sig_atomic_t keep_running = 1;
 void sigint_handler(int sig) { (void)sig; keep_running = 0; }
 
-// watcher which stops after specified duration
-static void *watcher(void *arg) {
-    int ms = *(int*)arg;
-    free(arg);
-    usleep(ms * 1000);
-    keep_running = 0;
-    return NULL;
+// parsed once; every subsystem reads this without locking
+static hub_config_t cfg;
+static hub_t *hub;
+
+static long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+// old side of a handover: stop producing, pass sockets and drained state to
+// the successor on conn. Returns true once the successor has acknowledged;
+// on failure everything is resumed and this process keeps running.
+static bool hand_over(int conn, int listen_fd) {
+    printf("Handing over to a new process...\n");
+    stop_sensors();
+    compactor_stop();
+    // external producers keep sending; datagrams queue in the shared socket
+    handover_fds_t fds = { listen_fd, ingest_detach(), metrics_detach(), -1, -1, -1, http_detach() };
+    // subscribers stay connected to this process until it exits, then reconnect
+    egress_detach(&fds.egress_fd, &fds.egress_tcp_fd);
+    hub_drain(hub);
+
+    int snap = memfd_create("sensorhub-snapshot", MFD_CLOEXEC);
+    if (snap >= 0 && !hub_checkpoint_fd(hub, snap)) {
+        close(snap);
+        snap = -1;
+    }
+    fds.snapshot_fd = snap;
+    bool ok = handover_send(conn, &fds) && handover_wait_ack(conn, HANDOVER_TIMEOUT_MS);
+    if (snap >= 0) close(snap);
+    close(conn);
+
+    if (!ok) {
+        fprintf(stderr, "handover failed, resuming\n");
+        hub_start(hub);
+        ingest_resume();
+        metrics_resume();
+        egress_resume();
+        http_resume();
+        if (cfg.compact) compactor_start(&cfg);
+        start_sensors(hub, &cfg);
+    }
+    return ok;
+}
+
+// close whatever a failed start received from the predecessor
+static void close_inherited(handover_fds_t *fds) {
+    int *all[] = { &fds->listen_fd, &fds->ingest_fd, &fds->metrics_fd, &fds->snapshot_fd,
+                   &fds->egress_fd, &fds->egress_tcp_fd, &fds->http_fd };
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); ++i) {
+        if (*all[i] >= 0) close(*all[i]);
+        *all[i] = -1;
+    }
 }
 
 int main(int argc, char **argv) {
     signal(SIGINT, sigint_handler);
 
-    int test_duration_ms = 0;
-    for (int i = 1; i < argc; ++i) {
-        if (strcmp(argv[i], "--test-duration") == 0 && i+1 < argc) {
-            test_duration_ms = atoi(argv[i+1]) * 1000; // arg is in seconds
-            i++;
+    if (!config_load(&cfg, argc, argv)) {
+        return 2;
+    }
+
+    if (cfg.aggregate) {
+        int rc = aggregate_run(&cfg);
+        config_free(&cfg);
+        return rc;
+    }
+    if (cfg.backtest) {
+        int rc = backtest_run(&cfg);
+        config_free(&cfg);
+        return rc;
+    }
+
+#ifdef HUB_SPEC
+    // built with make spec: processor generated from the sensor schema
+    hub = hub_create_spec(&cfg, &hub_generated_spec);
+#else
+    hub = hub_create(&cfg);
+#endif
+    if (!hub) {
+        fprintf(stderr, "hub_create failed\n");
+        config_free(&cfg);
+        return 1;
+    }
+
+    // new side of a handover: receive sockets and window state first
+    handover_fds_t inherited = { -1, -1, -1, -1, -1, -1, -1 };
+    int takeover_conn = -1;
+    if (cfg.takeover) {
+        takeover_conn = handover_connect(cfg.handover_socket);
+        if (takeover_conn < 0 || !handover_receive(takeover_conn, &inherited, HANDOVER_TIMEOUT_MS)) {
+            fprintf(stderr, "cannot take over from %s\n", cfg.handover_socket);
+            if (takeover_conn >= 0) close(takeover_conn);
+            close_inherited(&inherited);
+            hub_destroy(hub);
+            config_free(&cfg);
+            return 1;
+        }
+        if (inherited.snapshot_fd >= 0) {
+            hub_restore_fd(hub, inherited.snapshot_fd);
+            close(inherited.snapshot_fd);
+            inherited.snapshot_fd = -1;
         }
     }
 
-    if (!hub_init("data/hub.log")) {
-        fprintf(stderr, "hub_init failed\n");
+    if (!hub_start(hub)) {
+        fprintf(stderr, "cannot start processors\n");
+        // the predecessor times out waiting for the ack and resumes
+        if (takeover_conn >= 0) close(takeover_conn);
+        close_inherited(&inherited);
+        hub_destroy(hub);
+        config_free(&cfg);
         return 1;
     }
 
-    start_hub_processor();
+    if (cfg.metrics_socket[0]) {
+        bool ok = inherited.metrics_fd >= 0 ? metrics_adopt(hub, inherited.metrics_fd, cfg.metrics_socket)
+                                            : metrics_start(hub, cfg.metrics_socket);
+        if (!ok) fprintf(stderr, "cannot open metrics socket %s\n", cfg.metrics_socket);
+    } else if (inherited.metrics_fd >= 0) {
+        close(inherited.metrics_fd);
+    }
+    if (cfg.ingest_socket[0]) {
+        bool ok = inherited.ingest_fd >= 0 ? ingest_adopt(hub, inherited.ingest_fd, cfg.ingest_socket)
+                                           : ingest_open(hub, cfg.ingest_socket);
+        if (!ok) fprintf(stderr, "cannot open ingest socket %s\n", cfg.ingest_socket);
+    } else if (inherited.ingest_fd >= 0) {
+        close(inherited.ingest_fd);
+    }
+    if (cfg.egress_socket[0] || cfg.egress_port) {
+        if (!egress_start(hub, &cfg, inherited.egress_fd, inherited.egress_tcp_fd))
+            fprintf(stderr, "cannot open egress sockets\n");
+    } else {
+        if (inherited.egress_fd >= 0) close(inherited.egress_fd);
+        if (inherited.egress_tcp_fd >= 0) close(inherited.egress_tcp_fd);
+    }
+    if (cfg.http_port) {
+        if (!http_start(hub, &cfg, inherited.http_fd)) fprintf(stderr, "cannot open HTTP port %d\n", cfg.http_port);
+    } else if (inherited.http_fd >= 0) {
+        close(inherited.http_fd);
+    }
+    if ((cfg.alert_webhook[0] || cfg.alert_command[0]) && !dispatch_start(hub, &cfg))
+        fprintf(stderr, "cannot start alert delivery\n");
+    if (cfg.compact && !compactor_start(&cfg)) fprintf(stderr, "cannot start the compactor\n");
+    int handover_fd = -1;
+    if (cfg.handover_socket[0]) {
+        handover_fd = inherited.listen_fd >= 0 ? inherited.listen_fd : handover_listen(cfg.handover_socket);
+        if (handover_fd < 0) fprintf(stderr, "cannot open handover socket %s\n", cfg.handover_socket);
+    }
 
-    //sensor sampling rates (in milliseconds)
-    start_temp_sensor(500);     
-    start_hum_sensor(700);
-    start_pressure_sensor(1200);
+    long start = monotonic_ms();
+    start_sensors(hub, &cfg);
 
-    pthread_t watcher_id = 0;
-    if (test_duration_ms > 0) {
-        int *p = malloc(sizeof(int));
-        *p = test_duration_ms;
-        pthread_create(&watcher_id, NULL, watcher, p);
+    if (takeover_conn >= 0) {
+        // the predecessor exits once it sees this
+        handover_ack(takeover_conn);
+        close(takeover_conn);
     }
 
     printf("The sensor hub is running. Press Ctrl+C to stop.\n");
-    while (keep_running) {
-        sleep(1);
+    // stop after the specified duration (if any)
+    long deadline = cfg.test_duration_s > 0 ? start + cfg.test_duration_s * 1000L : 0;
+    long next_checkpoint = start + cfg.checkpoint_interval_s * 1000L;
+    bool handed_over = false;
+    while (keep_running && (deadline == 0 || monotonic_ms() < deadline)) {
+        struct timespec ts = { 0, 100 * 1000000L };
+        nanosleep(&ts, NULL);
+        if (cfg.checkpoint_interval_s > 0 && monotonic_ms() >= next_checkpoint) {
+            hub_checkpoint(hub);
+            next_checkpoint += cfg.checkpoint_interval_s * 1000L;
+        }
+        if (handover_fd >= 0) {
+            int conn = handover_accept(handover_fd);
+            if (conn >= 0 && hand_over(conn, handover_fd)) {
+                handed_over = true;
+                break;
+            }
+        }
+    }
+
+    if (handed_over) {
+        // the successor owns the sockets, their paths and the checkpoint now
+        printf("Handed over.\n");
+        dispatch_stop(); // alerts of the drained samples
+        hub_destroy(hub);
+        config_free(&cfg);
+        printf("Exited.\n");
+        return 0;
     }
 
     printf("Shutting down...\n");
-    hub_processor_stop(); // cleanly stop processor thread
-    hub_shutdown();
+    stop_sensors();
+    long elapsed = monotonic_ms() - start;
+    ingest_stop();
+    compactor_stop();
+    hub_stop(hub); // cleanly stop processor threads
+    egress_stop(); // after the last record
+    dispatch_stop(); // after the last alert
+    http_stop();
+    metrics_stop();
+    hub_checkpoint(hub); // final state for the next start
+    if (handover_fd >= 0) {
+        close(handover_fd);
+        unlink(cfg.handover_socket);
+    }
 
-    if (test_duration_ms > 0) {
-        pthread_join(watcher_id, NULL);
+    if (cfg.benchmark) {
+        hub_stats_t st;
+        hub_get_stats(hub, &st);
+        printf("{\"elapsed_ms\": %ld, \"submitted\": %lu, \"dropped\": %lu, \"processed\": %lu, "
+               "\"throughput\": %.1f}\n",
+               elapsed, st.submitted, st.dropped, st.processed,
+               elapsed > 0 ? st.processed * 1000.0 / elapsed : 0.0);
     }
 
+    hub_destroy(hub);
+    config_free(&cfg);
+
     printf("Exited.\n");
     return 0;
 }
@@ -0,0 +1,192 @@
+#include "median.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define NIL (-1)
+#define MEDIAN_MAX_LEVELS 32
+
+// total order on (value, slot); NaN sorts after every number
+static bool key_less(double a, int ia, double b, int ib) {
+    if (a == b || (isnan(a) && isnan(b))) return ia < ib;
+    if (isnan(a) || isnan(b)) return isnan(b);
+    return a < b;
+}
+
+static int *next_of(const median_window_t *m, int node) {
+    return m->next + (size_t)node * m->levels;
+}
+
+static int *width_of(const median_window_t *m, int node) {
+    return m->width + (size_t)node * m->levels;
+}
+
+bool median_window_init(median_window_t *m, int capacity) {
+    int levels = 1;
+    while (levels < MEDIAN_MAX_LEVELS && (1L << (levels - 1)) < capacity) levels++;
+    *m = (median_window_t){ .capacity = capacity, .levels = levels, .rng = 2463534242u };
+    size_t nodes = (size_t)capacity + 1;
+    m->value = calloc(nodes, sizeof(double));
+    m->height = calloc(nodes, sizeof(uint8_t));
+    m->next = malloc(nodes * (size_t)levels * sizeof(int));
+    m->width = malloc(nodes * (size_t)levels * sizeof(int));
+    if (!m->value || !m->height || !m->next || !m->width) {
+        median_window_free(m);
+        return false;
+    }
+    // empty list: the head links straight to the end, one position away
+    int head = capacity;
+    m->height[head] = (uint8_t)levels;
+    for (int l = 0; l < levels; ++l) {
+        next_of(m, head)[l] = NIL;
+        width_of(m, head)[l] = 1;
+    }
+    return true;
+}
+
+void median_window_free(median_window_t *m) {
+    free(m->value);
+    free(m->height);
+    free(m->next);
+    free(m->width);
+    m->value = NULL;
+    m->height = NULL;
+    m->next = NULL;
+    m->width = NULL;
+}
+
+// geometric node height, P(h > k) = 2^-k
+static int random_height(median_window_t *m) {
+    uint32_t x = m->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    m->rng = x;
+    int h = 1;
+    while (h < m->levels && (x & 1)) {
+        h++;
+        x >>= 1;
+    }
+    return h;
+}
+
+static void unlink_node(median_window_t *m, int node) {
+    int chain[MEDIAN_MAX_LEVELS];
+    int x = m->capacity;
+    double v = m->value[node];
+    for (int l = m->levels - 1; l >= 0; --l) {
+        int nx;
+        while ((nx = next_of(m, x)[l]) != NIL && key_less(m->value[nx], nx, v, node)) x = nx;
+        chain[l] = x;
+    }
+    int h = m->height[node];
+    for (int l = 0; l < m->levels; ++l) {
+        int *w = &width_of(m, chain[l])[l];
+        if (l < h) {
+            *w += width_of(m, node)[l] - 1;
+            next_of(m, chain[l])[l] = next_of(m, node)[l];
+        } else {
+            *w -= 1;
+        }
+    }
+}
+
+static void link_node(median_window_t *m, int node, double v) {
+    int chain[MEDIAN_MAX_LEVELS], steps[MEDIAN_MAX_LEVELS];
+    int x = m->capacity;
+    for (int l = m->levels - 1; l >= 0; --l) {
+        int nx;
+        steps[l] = 0;
+        while ((nx = next_of(m, x)[l]) != NIL && key_less(m->value[nx], nx, v, node)) {
+            steps[l] += width_of(m, x)[l];
+            x = nx;
+        }
+        chain[l] = x;
+    }
+    int h = random_height(m);
+    m->value[node] = v;
+    m->height[node] = (uint8_t)h;
+    // steps = positions between chain[l] and the new node
+    int dist = 0;
+    for (int l = 0; l < m->levels; ++l) {
+        int *w = &width_of(m, chain[l])[l];
+        if (l < h) {
+            next_of(m, node)[l] = next_of(m, chain[l])[l];
+            next_of(m, chain[l])[l] = node;
+            width_of(m, node)[l] = *w - dist;
+            *w = dist + 1;
+            dist += steps[l];
+        } else {
+            *w += 1;
+        }
+    }
+}
+
+void median_window_push(median_window_t *m, double v) {
+    if (m->count == m->capacity) unlink_node(m, m->idx);
+    else m->count++;
+    link_node(m, m->idx, v);
+    m->idx = (m->idx + 1) % m->capacity;
+}
+
+double median_window_select(const median_window_t *m, int k) {
+    int x = m->capacity;
+    int i = k + 1; // positions are 1-based from the head
+    for (int l = m->levels - 1; l >= 0; --l) {
+        while (next_of(m, x)[l] != NIL && width_of(m, x)[l] <= i) {
+            i -= width_of(m, x)[l];
+            x = next_of(m, x)[l];
+        }
+    }
+    return m->value[x];
+}
+
+double median_window_median(const median_window_t *m) {
+    int n = m->count;
+    if (n == 0) return NAN;
+    if (n % 2) return median_window_select(m, n / 2);
+    return (median_window_select(m, n / 2 - 1) + median_window_select(m, n / 2)) / 2;
+}
+
+// number of values below v
+static int rank_below(const median_window_t *m, double v) {
+    int x = m->capacity, rank = 0;
+    for (int l = m->levels - 1; l >= 0; --l) {
+        int nx;
+        while ((nx = next_of(m, x)[l]) != NIL && m->value[nx] < v) {
+            rank += width_of(m, x)[l];
+            x = nx;
+        }
+    }
+    return rank;
+}
+
+// The deviations from med form two ascending runs: below[j] = med - x(p-1-j)
+// and above[j] = x(p+j) - med, where p values are below med. The k-th
+// smallest deviation is found by binary search on how many of the first
+// k+1 come from below.
+static double kth_deviation(const median_window_t *m, double med, int p, int k) {
+    int na = m->count - p;
+    int lo = k + 1 - na > 0 ? k + 1 - na : 0;
+    int hi = k + 1 < p ? k + 1 : p;
+    while (lo < hi) {
+        int a = (lo + hi) / 2, b = k + 1 - a;
+        double below = med - median_window_select(m, p - 1 - a);
+        double above = median_window_select(m, p + b - 1) - med;
+        if (b > 0 && below < above) lo = a + 1;
+        else hi = a;
+    }
+    int a = lo, b = k + 1 - a;
+    double d = -INFINITY;
+    if (a > 0) d = med - median_window_select(m, p - a);
+    if (b > 0) d = fmax(d, median_window_select(m, p + b - 1) - med);
+    return d;
+}
+
+double median_window_mad(const median_window_t *m) {
+    int n = m->count;
+    if (n == 0) return NAN;
+    double med = median_window_median(m);
+    int p = rank_below(m, med);
+    if (n % 2) return kth_deviation(m, med, p, n / 2);
+    return (kth_deviation(m, med, p, n / 2 - 1) + kth_deviation(m, med, p, n / 2)) / 2;
+}
@@ -0,0 +1,40 @@
+#ifndef MEDIAN_H
+#define MEDIAN_H
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sliding-window order statistics over the last `capacity` values: median
+// and median absolute deviation (MAD), robust against single-sample spikes.
+// The values are kept in an indexable skiplist ordered by (value, ring
+// slot): every link records how many values it skips, so inserting,
+// removing and selecting the k-th smallest value are O(log n). The median
+// is one or two selections, the MAD O(log^2 n). Node k holds ring slot k;
+// the extra node `capacity` is the list head.
+typedef struct {
+    int capacity;
+    int levels;
+    int count;
+    int idx;          // next ring slot to overwrite
+    double *value;    // per node
+    uint8_t *height;  // per node, 1..levels
+    int *next;        // [node * levels + level], -1 = end of list
+    int *width;       // [node * levels + level], values skipped by that link
+    uint32_t rng;     // level draws (xorshift32)
+} median_window_t;
+
+bool median_window_init(median_window_t *m, int capacity);
+void median_window_free(median_window_t *m);
+
+// add a value; once full it replaces the oldest one
+void median_window_push(median_window_t *m, double v);
+
+// k-th smallest value in the window, 0 <= k < count
+double median_window_select(const median_window_t *m, int k);
+
+// median (mean of the two middle values for even counts); NAN when empty
+double median_window_median(const median_window_t *m);
+
+// median of |x - median| over the window; NAN when empty
+double median_window_mad(const median_window_t *m);
+
+#endif
@@ -0,0 +1,103 @@
+#define _POSIX_C_SOURCE 200809L
+#include "metrics.h"
+#include "hub.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static int listen_fd = -1;
+static char sock_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static pthread_t metrics_thread_id;
+static atomic_int metrics_running = 0;
+static bool thread_started = false;
+static hub_t *source = NULL;
+
+static void serve_client(int fd) {
+    hub_stats_t st;
+    hub_get_stats(source, &st);
+    char buf[512];
+    int n = snprintf(buf, sizeof(buf),
+                     "submitted %lu\nenqueued %lu\ndropped %lu\nprocessed %lu\npending %lu\n",
+                     st.submitted, st.enqueued, st.dropped, st.processed, st.pending);
+    // best effort: a client that disconnects early just misses the reply
+    ssize_t off = 0;
+    while (off < n) {
+        ssize_t w = write(fd, buf + off, (size_t)(n - off));
+        if (w <= 0) break;
+        off += w;
+    }
+}
+
+static void *metrics_main(void *arg) {
+    (void)arg;
+    struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+    while (atomic_load(&metrics_running)) {
+        // wake up periodically to notice metrics_stop()
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        serve_client(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static bool start_thread(void) {
+    atomic_store(&metrics_running, 1);
+    if (pthread_create(&metrics_thread_id, NULL, metrics_main, NULL) != 0) return false;
+    thread_started = true;
+    return true;
+}
+
+static void stop_thread(void) {
+    if (!thread_started) return;
+    atomic_store(&metrics_running, 0);
+    pthread_join(metrics_thread_id, NULL);
+    thread_started = false;
+}
+
+bool metrics_start(hub_t *hub, const char *socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    unlink(socket_path); // stale socket from a previous run
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return false;
+    }
+    return metrics_adopt(hub, fd, socket_path);
+}
+
+bool metrics_adopt(hub_t *hub, int fd, const char *socket_path) {
+    source = hub;
+    listen_fd = fd;
+    snprintf(sock_path, sizeof(sock_path), "%s", socket_path);
+    return start_thread();
+}
+
+int metrics_detach(void) {
+    stop_thread();
+    return listen_fd;
+}
+
+void metrics_resume(void) {
+    if (listen_fd >= 0 && !thread_started) start_thread();
+}
+
+void metrics_stop(void) {
+    if (listen_fd < 0) return;
+    stop_thread();
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(sock_path);
+}
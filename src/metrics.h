@@ -0,0 +1,22 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <stdbool.h>
+#include "hub.h"
+
+// Serve the statistics of hub on a Unix stream socket: every connection receives
+// one "key value" line per counter and is then closed, e.g.
+//   socat - UNIX-CONNECT:/tmp/hub.sock
+bool metrics_start(hub_t *hub, const char *socket_path);
+
+// serve on an already listening socket (received during a handover)
+bool metrics_adopt(hub_t *hub, int fd, const char *socket_path);
+
+// stop serving but keep the socket open; returns its fd for a handover
+int metrics_detach(void);
+
+// serve again on the detached socket (aborted handover)
+void metrics_resume(void);
+
+void metrics_stop(void);
+
+#endif
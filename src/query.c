@@ -0,0 +1,357 @@
+#define _POSIX_C_SOURCE 200809L
+#include "query.h"
+#include "segment.h"
+#include "zonemap.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// four records' fields side by side (GCC vector extension, see src/vec.h)
+typedef double lanes_d __attribute__((vector_size(4 * sizeof(double))));
+typedef int64_t lanes_i __attribute__((vector_size(4 * sizeof(int64_t))));
+
+// the query with its sensor names as the two 8-byte words of a record's
+// zero-padded type field
+typedef struct {
+    const query_t *q;
+    uint64_t keys[QUERY_MAX_SENSORS][2];
+    bool values;             // value range set (otherwise NaN values match too)
+    query_emit_fn emit;
+    void *ctx;
+    query_stats_t *st;
+} scan_t;
+
+void query_init(query_t *q) {
+    memset(q, 0, sizeof(*q));
+    q->t0 = INT64_MIN;
+    q->t1 = INT64_MAX;
+    q->v0 = -INFINITY;
+    q->v1 = INFINITY;
+}
+
+bool query_add_sensor(query_t *q, const char *name) {
+    if (q->num_sensors == QUERY_MAX_SENSORS || !*name) return false;
+    strncpy(q->sensors[q->num_sensors++], name, 15);
+    return true;
+}
+
+static bool match_one(const scan_t *s, const hub_record_t *r) {
+    const query_t *q = s->q;
+    if (q->kind ? r->kind != q->kind : (r->kind != REC_SAMPLE && r->kind != REC_ALERT)) return false;
+    if (r->ms_timestamp < q->t0 || r->ms_timestamp > q->t1) return false;
+    if (s->values && !(r->value >= q->v0 && r->value <= q->v1)) return false;
+    if (!q->num_sensors) return true;
+    for (int i = 0; i < q->num_sensors; ++i) {
+        if (strncmp(r->type, q->sensors[i], 16) == 0) return true;
+    }
+    return false;
+}
+
+// emit record i of a binary range with its channel values
+static bool emit_binary(scan_t *s, const hub_record_t *r, size_t i, size_t n) {
+    const double *values = &r[i].value;
+    if (r[i].channels > 1 && i + 1 < n && r[i + 1].kind == REC_VALUES) {
+        values = ((const hub_values_record_t*)&r[i + 1])->values;
+    }
+    s->st->matched++;
+    return s->emit(s->ctx, &r[i], values);
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// The vector kernel compares four records per step. It needs AVX2 for the
+// 64-bit lanes (SSE2 emulates those compares and loses to the scalar loop),
+// so it is compiled for AVX2 and chosen at run time.
+#define QUERY_VECTOR_SCAN 1
+#define VECTOR_TARGET __attribute__((target("avx2")))
+
+// bitmask of the matching records among r[0..3]
+VECTOR_TARGET static unsigned match_four(const scan_t *s, const hub_record_t *r) {
+    const query_t *q = s->q;
+    lanes_i t = { r[0].ms_timestamp, r[1].ms_timestamp, r[2].ms_timestamp, r[3].ms_timestamp };
+    lanes_i k = { r[0].kind, r[1].kind, r[2].kind, r[3].kind };
+    lanes_i m = (t >= q->t0) & (t <= q->t1);
+    m &= q->kind ? (k == q->kind) : ((k == REC_SAMPLE) | (k == REC_ALERT));
+    if (s->values) {
+        lanes_d v = { r[0].value, r[1].value, r[2].value, r[3].value };
+        m &= (v >= q->v0) & (v <= q->v1);
+    }
+    if (q->num_sensors) {
+        uint64_t w[8];
+        for (int i = 0; i < 4; ++i) memcpy(&w[2 * i], r[i].type, 16);
+        lanes_i a = { (int64_t)w[0], (int64_t)w[2], (int64_t)w[4], (int64_t)w[6] };
+        lanes_i b = { (int64_t)w[1], (int64_t)w[3], (int64_t)w[5], (int64_t)w[7] };
+        lanes_i any = { 0 };
+        for (int i = 0; i < q->num_sensors; ++i) {
+            any |= (a == (int64_t)s->keys[i][0]) & (b == (int64_t)s->keys[i][1]);
+        }
+        m &= any;
+    }
+    return (unsigned)((m[0] & 1) | (m[1] & 2) | (m[2] & 4) | (m[3] & 8));
+}
+
+VECTOR_TARGET static size_t scan_binary_vector(scan_t *s, const hub_record_t *r, size_t n, bool *go) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (unsigned bits = match_four(s, r + i); bits; bits &= bits - 1) {
+            if (!emit_binary(s, r, i + (size_t)__builtin_ctz(bits), n)) {
+                *go = false;
+                return n;
+            }
+        }
+    }
+    return i;
+}
+#endif
+
+static bool scan_binary(scan_t *s, const char *data, size_t len) {
+    const hub_record_t *r = (const hub_record_t*)data;
+    size_t n = len / sizeof(*r), i = 0;
+    bool go = true;
+#ifdef QUERY_VECTOR_SCAN
+    if (__builtin_cpu_supports("avx2")) i = scan_binary_vector(s, r, n, &go);
+#endif
+    for (; go && i < n; ++i) {
+        if (match_one(s, &r[i]) && !emit_binary(s, r, i, n)) go = false;
+    }
+    return go;
+}
+
+// the sensor name of a text line is checked before the line is parsed
+static bool line_may_match(const scan_t *s, const char *p, size_t len) {
+    const query_t *q = s->q;
+    size_t skip;
+    if (len > 7 && memcmp(p, "SAMPLE|", 7) == 0) {
+        if (q->kind && q->kind != REC_SAMPLE) return false;
+        skip = 7;
+    } else if (len > 6 && memcmp(p, "ALERT|", 6) == 0) {
+        if (q->kind && q->kind != REC_ALERT) return false;
+        skip = 6;
+    } else {
+        return false;
+    }
+    if (!q->num_sensors) return true;
+    const char *name = p + skip, *bar = memchr(name, '|', len - skip);
+    if (!bar) return false;
+    size_t nlen = (size_t)(bar - name);
+    for (int i = 0; i < q->num_sensors; ++i) {
+        if (strnlen(q->sensors[i], 16) == nlen && memcmp(q->sensors[i], name, nlen) == 0) return true;
+    }
+    return false;
+}
+
+static bool scan_text(scan_t *s, const char *data, size_t len) {
+    const char *p = data, *end = data + len;
+    char line[256];
+    while (p < end) {
+        // a line without its newline is still being written
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) break;
+        size_t n = (size_t)(nl - p);
+        if (n < sizeof(line) && line_may_match(s, p, n)) {
+            hub_record_t r;
+            double values[HUB_RECORD_CHANNELS];
+            memcpy(line, p, n);
+            line[n] = '\0';
+            if (record_parse_line(line, &r, values) && match_one(s, &r)) {
+                s->st->matched++;
+                if (!s->emit(s->ctx, &r, values)) return false;
+            }
+        }
+        p = nl + 1;
+    }
+    return true;
+}
+
+// false if the segment's Bloom filter rules out every sensor of the query
+static bool segment_may_match(const query_t *q, const char *path) {
+    if (!q->num_sensors) return true;
+    bloom_t *b = bloom_load(path);
+    if (!b) return true;
+    bool any = false;
+    for (int i = 0; i < q->num_sensors && !any; ++i) any = bloom_may_contain(b, q->sensors[i]);
+    bloom_free(b);
+    return any;
+}
+
+static bool block_may_match(const query_t *q, const zonemap_view_t *b) {
+    if (!q->num_sensors) return zonemap_may_match(b, NULL, q->kind, q->t0, q->t1, q->v0, q->v1);
+    for (int i = 0; i < q->num_sensors; ++i) {
+        if (zonemap_may_match(b, q->sensors[i], q->kind, q->t0, q->t1, q->v0, q->v1)) return true;
+    }
+    return false;
+}
+
+int query_file(const query_t *q, const char *path, query_emit_fn emit, void *ctx, query_stats_t *st) {
+    struct stat sb;
+    if (stat(path, &sb) != 0) return -1;
+    st->files++;
+    st->bytes += (unsigned long long)sb.st_size;
+    if (!segment_may_match(q, path)) {
+        st->files_skipped++;
+        return 1;
+    }
+    if (sb.st_size == 0) return 1;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    size_t size = (size_t)sb.st_size;
+    const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+
+    scan_t s = { q, { { 0 } }, q->v0 > -INFINITY || q->v1 < INFINITY, emit, ctx, st };
+    for (int i = 0; i < q->num_sensors; ++i) memcpy(s.keys[i], q->sensors[i], 16);
+    bool binary = (unsigned char)data[0] == (HUB_RECORD_MAGIC & 0xff);
+    bool (*scan)(scan_t *, const char *, size_t) = binary ? scan_binary : scan_text;
+
+    // blocks of the zone map, then the part of the file it does not cover yet
+    zonemap_t *zm = zonemap_load(path);
+    size_t done = 0;
+    bool go = true;
+    for (size_t i = 0; zm && go && i < zm->num_blocks; ++i) {
+        const zonemap_view_t *b = &zm->blocks[i];
+        if (b->hdr.offset != done || b->hdr.offset + b->hdr.length > size) break;
+        st->blocks++;
+        if (block_may_match(q, b)) {
+            st->bytes_scanned += b->hdr.length;
+            go = scan(&s, data + b->hdr.offset, b->hdr.length);
+        } else {
+            st->blocks_skipped++;
+        }
+        done += b->hdr.length;
+    }
+    zonemap_free(zm);
+    if (go && done < size) {
+        st->bytes_scanned += size - done;
+        go = scan(&s, data + done, size - done);
+    }
+    munmap((void*)data, size);
+    return go ? 1 : 0;
+}
+
+// a decoded compacted block being merged
+typedef struct {
+    const compact_block_t *b;
+    int64_t *ts;
+    double *values, *channels;
+    size_t row;
+} merge_t;
+
+static bool merge_less(const merge_t *x, const merge_t *y) {
+    int64_t a = x->ts[x->row], b = y->ts[y->row];
+    return a != b ? a < b : x->b < y->b;
+}
+
+static void merge_down(merge_t *h, size_t n, size_t i) {
+    for (;;) {
+        size_t l = 2 * i + 1, m = i;
+        if (l < n && merge_less(&h[l], &h[m])) m = l;
+        if (l + 1 < n && merge_less(&h[l + 1], &h[m])) m = l + 1;
+        if (m == i) return;
+        merge_t t = h[i]; h[i] = h[m]; h[m] = t;
+        i = m;
+    }
+}
+
+static void merge_up(merge_t *h, size_t i) {
+    while (i > 0 && merge_less(&h[i], &h[(i - 1) / 2])) {
+        merge_t t = h[i]; h[i] = h[(i - 1) / 2]; h[(i - 1) / 2] = t;
+        i = (i - 1) / 2;
+    }
+}
+
+static void merge_free(merge_t *m) {
+    free(m->ts);
+    free(m->values);
+    free(m->channels);
+}
+
+static bool compact_block_may_match(const scan_t *s, const compact_block_t *b) {
+    const query_t *q = s->q;
+    if (q->kind && b->kind != q->kind) return false;
+    if (b->max_ms < q->t0 || b->min_ms > q->t1) return false;
+    if (s->values && (b->max < q->v0 || b->min > q->v1)) return false;
+    if (!q->num_sensors) return true;
+    for (int i = 0; i < q->num_sensors; ++i) {
+        if (strncmp(b->type, q->sensors[i], 16) == 0) return true;
+    }
+    return false;
+}
+
+static int by_min_ms(const void *x, const void *y) {
+    const compact_block_t *a = *(const compact_block_t *const *)x, *b = *(const compact_block_t *const *)y;
+    if (a->min_ms != b->min_ms) return a->min_ms < b->min_ms ? -1 : 1;
+    return a < b ? -1 : a > b;
+}
+
+int query_compact(const query_t *q, const char *path, const compact_entry_t *e, query_emit_fn emit, void *ctx,
+                  query_stats_t *st) {
+    struct stat sb;
+    if (stat(path, &sb) != 0) return -1;
+    st->files++;
+    st->bytes += (unsigned long long)sb.st_size;
+    if (e && e->records && (e->max_ms < q->t0 || e->min_ms > q->t1)) {
+        st->files_skipped++;
+        return 1;
+    }
+    compact_file_t *f = compact_open(path);
+    if (!f) return -1;
+
+    scan_t s = { q, { { 0 } }, q->v0 > -INFINITY || q->v1 < INFINITY, emit, ctx, st };
+    uint32_t nb = f->hdr->num_blocks, nc = 0;
+    const compact_block_t **cand = malloc(sizeof(*cand) * (nb + 1));
+    merge_t *heap = malloc(sizeof(*heap) * (nb + 1));
+    int rc = cand && heap ? 1 : -1;
+    for (uint32_t i = 0; rc == 1 && i < nb; ++i) {
+        st->blocks++;
+        if (compact_block_may_match(&s, &f->blocks[i])) cand[nc++] = &f->blocks[i];
+        else st->blocks_skipped++;
+    }
+    if (rc == 1) qsort(cand, nc, sizeof(*cand), by_min_ms);
+
+    // decode a block once the merge reaches its first timestamp
+    size_t n = 0;
+    uint32_t next = 0;
+    while (rc == 1 && (n > 0 || next < nc)) {
+        if (next < nc && (n == 0 || cand[next]->min_ms <= heap[0].ts[heap[0].row])) {
+            const compact_block_t *b = cand[next++];
+            int ch = b->channels > 1 ? b->channels : 0;
+            merge_t m = { b, malloc(sizeof(int64_t) * b->rows), malloc(sizeof(double) * b->rows),
+                          ch ? malloc(sizeof(double) * b->rows * (size_t)ch) : NULL, 0 };
+            if (!m.ts || !m.values || (ch && !m.channels) || !compact_decode(f, b, m.ts, m.values, m.channels)) {
+                merge_free(&m);
+                rc = -1;
+                break;
+            }
+            st->bytes_scanned += b->length;
+            heap[n] = m;
+            merge_up(heap, n++);
+            continue;
+        }
+        merge_t *m = &heap[0];
+        const compact_block_t *b = m->b;
+        hub_record_t r;
+        record_fill(&r, b->kind, b->type, m->values[m->row], (long)m->ts[m->row]);
+        r.channels = b->channels;
+        const double *values = b->channels > 1 ? &m->channels[m->row * b->channels] : &r.value;
+        if (match_one(&s, &r)) {
+            st->matched++;
+            if (!emit(ctx, &r, values)) rc = 0;
+        }
+        if (++m->row == b->rows) {
+            merge_free(m);
+            heap[0] = heap[--n];
+        }
+        merge_down(heap, n, 0);
+    }
+    for (size_t i = 0; heap && i < n; ++i) merge_free(&heap[i]);
+    free(heap);
+    free(cand);
+    compact_close(f);
+    return rc;
+}
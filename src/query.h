@@ -0,0 +1,59 @@
+#ifndef QUERY_H
+#define QUERY_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "compact.h"
+#include "record.h"
+
+// Record filter over hub logs and log segments (used by hubq). A record
+// matches when its sensor is one of `sensors` (none = any), its kind is
+// `kind` (0 = samples and alerts), its timestamp is in [t0, t1] and its
+// value (the magnitude for vector samples, the metric for alerts) is in
+// [v0, v1].
+//
+// query_file() maps the file and reads only what can match: a segment
+// whose Bloom filter has none of the sensors is skipped unopened, zone map
+// blocks whose bounds cannot match are skipped, and the rest (including the
+// unindexed tail) is scanned. Binary logs are scanned four records at a
+// time with vector compares; text lines are checked on the sensor name
+// before their numbers are parsed.
+//
+// query_compact() reads a compacted segment (src/compact.h): it decodes
+// only the blocks whose index entry can match and merges them by
+// timestamp, so its records come out in time order (sensor order for equal
+// timestamps) rather than in the order they were logged.
+#define QUERY_MAX_SENSORS 64
+
+typedef struct {
+    char sensors[QUERY_MAX_SENSORS][16];
+    int num_sensors;
+    int kind;                // enum record_kind, 0 = REC_SAMPLE and REC_ALERT
+    int64_t t0, t1;
+    double v0, v1;
+} query_t;
+
+typedef struct {
+    unsigned long files, files_skipped;     // skipped = by Bloom filter or time range
+    unsigned long blocks, blocks_skipped;   // zone map or compacted blocks
+    unsigned long long bytes, bytes_scanned;
+    unsigned long long matched;
+} query_stats_t;
+
+// called per matching record with its channel values (max(1, channels));
+// return false to stop the query
+typedef bool (*query_emit_fn)(void *ctx, const hub_record_t *r, const double *values);
+
+// all sensors, both kinds, all times and values
+void query_init(query_t *q);
+bool query_add_sensor(query_t *q, const char *name);
+
+// 1 when the file is done, 0 when emit stopped, -1 on I/O errors (a
+// missing file is an error)
+int query_file(const query_t *q, const char *path, query_emit_fn emit, void *ctx, query_stats_t *st);
+
+// same for a compacted segment; e (its manifest entry, may be NULL) lets a
+// file outside the time range be skipped unopened
+int query_compact(const query_t *q, const char *path, const compact_entry_t *e, query_emit_fn emit, void *ctx,
+                  query_stats_t *st);
+
+#endif
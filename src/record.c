@@ -0,0 +1,141 @@
+#define _POSIX_C_SOURCE 200809L
+#include "record.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+struct record_reader {
+    FILE *f;
+    int binary;
+    char line[256];
+    double values[HUB_RECORD_CHANNELS]; // of the last record
+};
+
+record_reader_t *record_open(const char *path) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (!f) return NULL;
+    record_reader_t *r = calloc(1, sizeof(*r));
+    if (!r) {
+        if (f != stdin) fclose(f);
+        return NULL;
+    }
+    r->f = f;
+    // binary logs start with the record magic, text logs with "SAMPLE"/"ALERT"
+    int c = getc(f);
+    if (c != EOF) {
+        ungetc(c, f);
+        r->binary = (c == (HUB_RECORD_MAGIC & 0xff));
+    }
+    return r;
+}
+
+int record_parse_values(const char *s, double *out) {
+    int n = 0;
+    for (;;) {
+        char *end;
+        if (n == HUB_RECORD_CHANNELS) return 0;
+        out[n++] = strtod(s, &end);
+        if (end == s) return 0;
+        if (*end != ',') return n;
+        s = end + 1;
+    }
+}
+
+static double magnitude(const double *v, int n) {
+    double s = 0;
+    for (int c = 0; c < n; ++c) s += v[c] * v[c];
+    return sqrt(s);
+}
+
+int record_parse_line(const char *line, hub_record_t *out, double *values) {
+    char kind[8], type[sizeof(out->type)], vals[128];
+    long long ts;
+    if (sscanf(line, "%7[^|]|%15[^|]|%127[^|]|%lld", kind, type, vals, &ts) != 4) return 0;
+    int n = record_parse_values(vals, values);
+    if (n == 0) return 0;
+    if (strcmp(kind, "SAMPLE") == 0) record_fill_values(out, type, values, n, (long)ts);
+    else if (strcmp(kind, "ALERT") == 0 && n == 1) record_fill(out, REC_ALERT, type, values[0], (long)ts);
+    else return 0;
+    return 1;
+}
+
+int record_next(record_reader_t *r, hub_record_t *out) {
+    if (r->binary) {
+        size_t n = fread(out, sizeof(*out), 1, r->f);
+        if (n != 1) return ferror(r->f) ? -1 : 0;
+        if (out->magic != HUB_RECORD_MAGIC || out->kind == REC_VALUES) return -1;
+        out->type[sizeof(out->type) - 1] = '\0';
+        r->values[0] = out->value;
+        if (out->channels > 1) {
+            hub_values_record_t v;
+            if (out->channels > HUB_RECORD_CHANNELS || fread(&v, sizeof(v), 1, r->f) != 1
+                || v.magic != HUB_RECORD_MAGIC || v.kind != REC_VALUES || v.channels != out->channels) {
+                return -1;
+            }
+            memcpy(r->values, v.values, sizeof(r->values));
+        }
+        return 1;
+    }
+    // text: skip lines that are not SAMPLE/ALERT records
+    while (fgets(r->line, sizeof(r->line), r->f)) {
+        if (record_parse_line(r->line, out, r->values)) return 1;
+    }
+    return ferror(r->f) ? -1 : 0;
+}
+
+const double *record_values(const record_reader_t *r) {
+    return r->values;
+}
+
+void record_close(record_reader_t *r) {
+    if (!r) return;
+    if (r->f != stdin) fclose(r->f);
+    free(r);
+}
+
+size_t record_write(FILE *f, int binary, const hub_record_t *r) {
+    int n;
+    if (binary) {
+        return fwrite(r, sizeof(*r), 1, f) * sizeof(*r);
+    } else if (r->kind == REC_SAMPLE) {
+        n = fprintf(f, "SAMPLE|%s|%.3f|%lld\n", r->type, r->value, (long long)r->ms_timestamp);
+    } else {
+        n = fprintf(f, "ALERT|%s|%.3f|%lld|THRESHOLD_EXCEEDED\n", r->type, r->value, (long long)r->ms_timestamp);
+    }
+    return n > 0 ? (size_t)n : 0;
+}
+
+size_t record_write_values(FILE *f, int binary, const hub_record_t *r, const double *values) {
+    if (r->channels <= 1) return record_write(f, binary, r);
+    if (binary) {
+        hub_values_record_t v;
+        memset(&v, 0, sizeof(v));
+        v.magic = HUB_RECORD_MAGIC;
+        v.kind = REC_VALUES;
+        v.channels = r->channels;
+        memcpy(v.values, values, sizeof(double) * r->channels);
+        size_t n = fwrite(r, sizeof(*r), 1, f);
+        n += fwrite(&v, sizeof(v), 1, f);
+        return n * sizeof(*r);
+    }
+    int n = fprintf(f, "SAMPLE|%s|", r->type);
+    for (int c = 0; c < r->channels; ++c) n += fprintf(f, c ? ",%.3f" : "%.3f", values[c]);
+    n += fprintf(f, "|%lld\n", (long long)r->ms_timestamp);
+    return n > 0 ? (size_t)n : 0;
+}
+
+void record_fill_values(hub_record_t *r, const char *type, const double *values, int n, long ms_timestamp) {
+    if (n > HUB_RECORD_CHANNELS) n = HUB_RECORD_CHANNELS;
+    record_fill(r, REC_SAMPLE, type, n > 1 ? magnitude(values, n) : values[0], ms_timestamp);
+    r->channels = (uint8_t)(n > 1 ? n : 0);
+}
+
+void record_fill(hub_record_t *r, int kind, const char *type, double value, long ms_timestamp) {
+    memset(r, 0, sizeof(*r));
+    r->magic = HUB_RECORD_MAGIC;
+    r->kind = (uint8_t)kind;
+    memcpy(r->type, type, strnlen(type, sizeof(r->type) - 1));
+    r->value = value;
+    r->ms_timestamp = ms_timestamp;
+}
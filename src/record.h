@@ -0,0 +1,73 @@
+#ifndef RECORD_H
+#define RECORD_H
+#include <stdint.h>
+#include <stdio.h>
+
+// Binary log record (--log-format binary). Fixed size and 8-byte aligned so a
+// log can be mmap'ed and scanned as an array. Text logs carry the same
+// fields as "SAMPLE|type|value|ts" and "ALERT|type|value|ts|THRESHOLD_EXCEEDED".
+//
+// Multi-channel samples (channels > 1) store the vector magnitude in value.
+// In binary logs the record is followed by one REC_VALUES record holding the
+// channel values; text logs write them comma-separated: "SAMPLE|ACC|1,2,3|ts".
+#define HUB_RECORD_MAGIC 0x42485348u /* "HSHB" little-endian */
+#define HUB_RECORD_CHANNELS 4
+
+// REC_DROPPED never appears in logs: the egress stream (src/egress.h) sends
+// it with value = records a subscriber missed
+enum record_kind { REC_SAMPLE = 1, REC_ALERT = 2, REC_VALUES = 3, REC_DROPPED = 4 };
+
+typedef struct {
+    uint32_t magic;
+    uint8_t kind;        // enum record_kind
+    uint8_t channels;    // 0 or 1 = scalar sample
+    uint8_t reserved[2];
+    char type[16];       // NUL-terminated sensor name
+    double value;        // sample value (or magnitude), or the alert metric
+    int64_t ms_timestamp;
+} hub_record_t;
+
+// continuation of a multi-channel REC_SAMPLE in binary logs
+typedef struct {
+    uint32_t magic;
+    uint8_t kind;        // REC_VALUES
+    uint8_t channels;
+    uint8_t reserved[2];
+    double values[HUB_RECORD_CHANNELS];
+} hub_values_record_t;
+
+_Static_assert(sizeof(hub_record_t) == 40, "hub_record_t layout changed");
+_Static_assert(sizeof(hub_values_record_t) == sizeof(hub_record_t), "records must have one size");
+
+void record_fill(hub_record_t *r, int kind, const char *type, double value, long ms_timestamp);
+
+// sample record for n channel values (n == 1 is a plain scalar sample)
+void record_fill_values(hub_record_t *r, const char *type, const double *values, int n, long ms_timestamp);
+
+// write one scalar record as a text line or a binary record; returns the bytes written
+size_t record_write(FILE *f, int binary, const hub_record_t *r);
+
+// write a record together with its channel values (r->channels of them); returns the bytes written
+size_t record_write_values(FILE *f, int binary, const hub_record_t *r, const double *values);
+
+// parse "v1,v2,..." into out (at most HUB_RECORD_CHANNELS); returns the
+// number of values, 0 if malformed
+int record_parse_values(const char *s, double *out);
+
+// parse one text log line into out and its channel values; 0 if it is not
+// a SAMPLE/ALERT record
+int record_parse_line(const char *line, hub_record_t *out, double *values);
+
+// Sequential reader for text or binary logs (format detected from the first
+// byte; "-" reads stdin). record_next returns 1 per record, 0 at EOF, -1 on error.
+typedef struct record_reader record_reader_t;
+
+record_reader_t *record_open(const char *path);
+int record_next(record_reader_t *r, hub_record_t *out);
+
+// channel values of the record last returned by record_next (max(1,
+// channels) of them; for scalar records just the value)
+const double *record_values(const record_reader_t *r);
+void record_close(record_reader_t *r);
+
+#endif
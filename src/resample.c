@@ -0,0 +1,112 @@
+#include "resample.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool resampler_init(resampler_t *r, int columns, long period_ms, resample_mode_t mode, size_t capacity) {
+    *r = (resampler_t){ .columns = columns, .period_ms = period_ms, .mode = mode, .capacity = capacity };
+    atomic_init(&r->written, 0);
+    pthread_mutex_init(&r->lock, NULL);
+    r->times = calloc(capacity, sizeof(int64_t));
+    r->values = calloc(capacity * (size_t)columns, sizeof(double));
+    r->pending = calloc((size_t)columns, sizeof(resample_column_t));
+    if (!r->times || !r->values || !r->pending) {
+        resampler_free(r);
+        return false;
+    }
+    return true;
+}
+
+void resampler_free(resampler_t *r) {
+    free(r->times);
+    free(r->values);
+    free(r->pending);
+    r->times = NULL;
+    r->values = NULL;
+    r->pending = NULL;
+    pthread_mutex_destroy(&r->lock);
+}
+
+static int64_t newest(const resample_column_t *c) {
+    return c->ts[c->count - 1];
+}
+
+// index of the last sample at or before t (0 if the older ones were dropped)
+static int sample_before(const resample_column_t *c, int64_t t) {
+    int j = c->count - 1;
+    while (j > 0 && c->ts[j] > t) j--;
+    return j;
+}
+
+static double value_at(const resampler_t *r, const resample_column_t *c, int64_t t) {
+    int j = sample_before(c, t);
+    if (r->mode == RESAMPLE_HOLD || c->ts[j] >= t || j == c->count - 1) return c->value[j];
+    double f = (double)(t - c->ts[j]) / (double)(c->ts[j + 1] - c->ts[j]);
+    return c->value[j] + (c->value[j + 1] - c->value[j]) * f;
+}
+
+// earliest frame time once every column has a sample
+static bool start_grid(resampler_t *r) {
+    int64_t first = INT64_MIN;
+    for (int c = 0; c < r->columns; ++c) {
+        if (r->pending[c].count == 0) return false;
+        if (r->pending[c].ts[0] > first) first = r->pending[c].ts[0];
+    }
+    int64_t p = r->period_ms;
+    int64_t rem = ((first % p) + p) % p;
+    r->next_ms = rem ? first - rem + p : first;
+    r->started = true;
+    return true;
+}
+
+static void emit_frames(resampler_t *r) {
+    int64_t ready = INT64_MAX;
+    for (int c = 0; c < r->columns; ++c) {
+        int64_t t = newest(&r->pending[c]);
+        if (t < ready) ready = t;
+    }
+    if (ready < r->next_ms) return;
+    // after a long gap only the last capacity frames can be kept anyway
+    int64_t behind = (ready - r->next_ms) / r->period_ms;
+    if ((uint64_t)behind >= r->capacity) r->next_ms += (behind - (int64_t)r->capacity + 1) * r->period_ms;
+
+    uint64_t n = atomic_load_explicit(&r->written, memory_order_relaxed);
+    for (; r->next_ms <= ready; r->next_ms += r->period_ms) {
+        size_t row = n % r->capacity;
+        r->times[row] = r->next_ms;
+        for (int c = 0; c < r->columns; ++c) {
+            r->values[(size_t)c * r->capacity + row] = value_at(r, &r->pending[c], r->next_ms);
+        }
+        atomic_store_explicit(&r->written, ++n, memory_order_release);
+    }
+    // keep what the next frame can still need: the last sample before it onwards
+    for (int c = 0; c < r->columns; ++c) {
+        resample_column_t *pc = &r->pending[c];
+        int j = sample_before(pc, r->next_ms);
+        if (j == 0) continue;
+        pc->count -= j;
+        memmove(pc->ts, pc->ts + j, sizeof(int64_t) * (size_t)pc->count);
+        memmove(pc->value, pc->value + j, sizeof(double) * (size_t)pc->count);
+    }
+}
+
+void resampler_push(resampler_t *r, int column, long ms_timestamp, double value) {
+    pthread_mutex_lock(&r->lock);
+    resample_column_t *c = &r->pending[column];
+    if (c->count && ms_timestamp <= newest(c)) {
+        // a repeated timestamp replaces the value, an older one is ignored
+        if (ms_timestamp == newest(c)) c->value[c->count - 1] = value;
+        pthread_mutex_unlock(&r->lock);
+        return;
+    }
+    if (c->count == RESAMPLE_PENDING) {
+        // a column is far ahead of a stalled one: drop its oldest sample
+        c->count--;
+        memmove(c->ts, c->ts + 1, sizeof(int64_t) * (size_t)c->count);
+        memmove(c->value, c->value + 1, sizeof(double) * (size_t)c->count);
+    }
+    c->ts[c->count] = ms_timestamp;
+    c->value[c->count] = value;
+    c->count++;
+    if (r->started || start_grid(r)) emit_frames(r);
+    pthread_mutex_unlock(&r->lock);
+}
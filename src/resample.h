@@ -0,0 +1,52 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Alignment of several sensors onto one fixed-rate time grid. Each sensor is
+// a column; frame T (a multiple of period_ms) holds every column's value at
+// time T, by last-value hold or by linear interpolation between the samples
+// on either side of T. A frame is emitted once every column has a sample at
+// or after T, so frames are final when written. The grid starts at the first
+// multiple of the period at which every column has a value.
+//
+// Frames go to a columnar ring: times[row] and values[c * capacity + row]
+// for frame k in row k % capacity, so a column of the ring is one
+// contiguous array. Columns are fed by different shard processors, hence
+// the lock; readers use the ring in place like the history rings.
+
+#define RESAMPLE_PENDING 256   // samples kept per column while waiting for the others
+
+typedef struct {
+    int64_t ts[RESAMPLE_PENDING];
+    double value[RESAMPLE_PENDING];
+    int count;
+} resample_column_t;
+
+typedef struct {
+    int columns;
+    long period_ms;
+    resample_mode_t mode;
+    size_t capacity;
+    int64_t *times;
+    double *values;
+    // frames ever written; stored (release) after the frame itself
+    _Atomic uint64_t written;
+
+    pthread_mutex_t lock;
+    resample_column_t *pending;
+    bool started;
+    int64_t next_ms;           // time of the next frame once started
+} resampler_t;
+
+bool resampler_init(resampler_t *r, int columns, long period_ms, resample_mode_t mode, size_t capacity);
+void resampler_free(resampler_t *r);
+
+// add one sample of a column; samples older than the column's newest are ignored
+void resampler_push(resampler_t *r, int column, long ms_timestamp, double value);
+
+#endif
@@ -0,0 +1,238 @@
+#define _POSIX_C_SOURCE 200809L
+#include "segment.h"
+#include "config.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void segment_path(char *buf, size_t n, const char *log_path, unsigned seq) {
+    snprintf(buf, n, "%s.%06u", log_path, seq);
+}
+
+// split log_path into its directory and file name
+static void split_path(const char *log_path, char *dir, size_t n, const char **base) {
+    const char *slash = strrchr(log_path, '/');
+    if (!slash) {
+        snprintf(dir, n, ".");
+        *base = log_path;
+    } else {
+        snprintf(dir, n, "%.*s", slash == log_path ? 1 : (int)(slash - log_path), log_path);
+        *base = slash + 1;
+    }
+}
+
+// "<base>.<digits>" -> seq, 0 if the name is not a segment of base
+static unsigned segment_seq(const char *name, const char *base) {
+    size_t len = strlen(base);
+    if (strncmp(name, base, len) != 0 || name[len] != '.') return 0;
+    const char *d = name + len + 1;
+    if (strlen(d) < 6 || strspn(d, "0123456789") != strlen(d)) return 0;
+    return (unsigned)strtoul(d, NULL, 10);
+}
+
+typedef struct {
+    unsigned seq;
+    char *path;
+} seg_entry_t;
+
+static int seg_cmp(const void *a, const void *b) {
+    const seg_entry_t *x = a, *y = b;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+int segment_list(const char *log_path, char ***paths) {
+    char dir[HUB_PATH_LEN];
+    const char *base;
+    split_path(log_path, dir, sizeof(dir), &base);
+    *paths = NULL;
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    seg_entry_t *segs = NULL;
+    int n = 0, cap = 0;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        unsigned seq = segment_seq(e->d_name, base);
+        if (seq == 0) continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 16;
+            seg_entry_t *s = realloc(segs, sizeof(*s) * (size_t)cap);
+            if (!s) break;
+            segs = s;
+        }
+        segs[n].seq = seq;
+        segs[n].path = malloc(HUB_PATH_LEN + 16);
+        if (!segs[n].path) break;
+        segment_path(segs[n].path, HUB_PATH_LEN + 16, log_path, seq);
+        n++;
+    }
+    closedir(d);
+    if (n) qsort(segs, (size_t)n, sizeof(*segs), seg_cmp);
+    char **out = n ? malloc(sizeof(char*) * (size_t)n) : NULL;
+    for (int i = 0; i < n; ++i) {
+        if (out) out[i] = segs[i].path;
+        else free(segs[i].path);
+    }
+    free(segs);
+    if (n && !out) return -1;
+    *paths = out;
+    return n;
+}
+
+unsigned segment_next_seq(const char *log_path) {
+    char dir[HUB_PATH_LEN];
+    const char *base;
+    split_path(log_path, dir, sizeof(dir), &base);
+    unsigned last = 0;
+    DIR *d = opendir(dir);
+    if (!d) return 1;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        // compacted segments ("<log>.NNNNNN.col", src/compact.h) keep their number
+        char name[256];
+        snprintf(name, sizeof(name), "%s", e->d_name);
+        size_t len = strlen(name);
+        if (len > 4 && strcmp(name + len - 4, ".col") == 0) name[len - 4] = '\0';
+        unsigned seq = segment_seq(name, base);
+        if (seq > last) last = seq;
+    }
+    closedir(d);
+    return last + 1;
+}
+
+// 64-bit FNV-1a of the name as logged (15 characters at most); the probes
+// are h1 + i * h2 (double hashing)
+static uint64_t hash_name(const char *type) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < 15 && type[i]; ++i) {
+        h ^= (unsigned char)type[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// open addressing over hashed names; names are at most 15 characters
+struct segment_names {
+    char (*slots)[16];
+    size_t size, used;
+    bool lost;   // a name could not be added since the last clear
+};
+
+segment_names_t *segment_names_new(void) {
+    return calloc(1, sizeof(segment_names_t));
+}
+
+bool segment_names_add(segment_names_t *s, const char *type) {
+    if ((s->used + 1) * 2 > s->size) {
+        size_t size = s->size ? s->size * 2 : 64;
+        char (*slots)[16] = calloc(size, sizeof(*slots));
+        if (!slots) {
+            s->lost = true;
+            return false;
+        }
+        for (size_t i = 0; i < s->size; ++i) {
+            if (!s->slots[i][0]) continue;
+            size_t h = hash_name(s->slots[i]) & (size - 1);
+            while (slots[h][0]) h = (h + 1) & (size - 1);
+            memcpy(slots[h], s->slots[i], sizeof(slots[h]));
+        }
+        free(s->slots);
+        s->slots = slots;
+        s->size = size;
+    }
+    size_t h = hash_name(type) & (s->size - 1);
+    while (s->slots[h][0]) {
+        if (strncmp(s->slots[h], type, 15) == 0) return true;
+        h = (h + 1) & (s->size - 1);
+    }
+    strncpy(s->slots[h], type, 15);
+    s->used++;
+    return true;
+}
+
+void segment_names_clear(segment_names_t *s) {
+    if (s->slots) memset(s->slots, 0, s->size * sizeof(*s->slots));
+    s->used = 0;
+    s->lost = false;
+}
+
+bool segment_names_complete(const segment_names_t *s) {
+    return !s->lost;
+}
+
+size_t segment_names_count(const segment_names_t *s) {
+    return s->used;
+}
+
+void segment_names_free(segment_names_t *s) {
+    if (!s) return;
+    free(s->slots);
+    free(s);
+}
+
+static uint64_t probe_bit(uint64_t h, uint32_t i, uint64_t bits) {
+    uint64_t h1 = (uint32_t)h, h2 = (h >> 32) | 1;
+    return (h1 + i * h2) % bits;
+}
+
+bool bloom_write(const char *segment_path, const segment_names_t *names) {
+    bloom_header_t hdr = { BLOOM_MAGIC, BLOOM_VERSION, BLOOM_PROBES, (uint32_t)names->used, 0 };
+    hdr.bits = ((names->used * BLOOM_BITS_PER_NAME + 63) / 64) * 64;
+    if (hdr.bits == 0) hdr.bits = 64;
+    uint64_t *words = calloc(hdr.bits / 64, sizeof(uint64_t));
+    if (!words) return false;
+    for (size_t i = 0; i < names->size; ++i) {
+        if (!names->slots[i][0]) continue;
+        uint64_t h = hash_name(names->slots[i]);
+        for (uint32_t p = 0; p < hdr.probes; ++p) {
+            uint64_t bit = probe_bit(h, p, hdr.bits);
+            words[bit / 64] |= 1ull << (bit % 64);
+        }
+    }
+    char path[HUB_PATH_LEN + 32], tmp[HUB_PATH_LEN + 32];
+    snprintf(path, sizeof(path), "%s.bloom", segment_path);
+    snprintf(tmp, sizeof(tmp), "%s.bloom.tmp", segment_path);
+    FILE *f = fopen(tmp, "wb");
+    bool ok = f && fwrite(&hdr, sizeof(hdr), 1, f) == 1 && fwrite(words, sizeof(uint64_t), hdr.bits / 64, f) == hdr.bits / 64;
+    if (f && fclose(f) != 0) ok = false;
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok) remove(tmp);
+    free(words);
+    return ok;
+}
+
+bloom_t *bloom_load(const char *segment_path) {
+    char path[HUB_PATH_LEN + 32];
+    snprintf(path, sizeof(path), "%s.bloom", segment_path);
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    bloom_t *b = calloc(1, sizeof(*b));
+    bool ok = b && fread(&b->hdr, sizeof(b->hdr), 1, f) == 1 && b->hdr.magic == BLOOM_MAGIC &&
+              b->hdr.version == BLOOM_VERSION && b->hdr.bits % 64 == 0 && b->hdr.bits > 0 &&
+              b->hdr.bits <= ((uint64_t)1 << 36);
+    if (ok) {
+        b->words = malloc(b->hdr.bits / 8);
+        ok = b->words && fread(b->words, sizeof(uint64_t), b->hdr.bits / 64, f) == b->hdr.bits / 64;
+    }
+    fclose(f);
+    if (!ok) {
+        bloom_free(b);
+        return NULL;
+    }
+    return b;
+}
+
+bool bloom_may_contain(const bloom_t *b, const char *type) {
+    uint64_t h = hash_name(type);
+    for (uint32_t p = 0; p < b->hdr.probes; ++p) {
+        uint64_t bit = probe_bit(h, p, b->hdr.bits);
+        if (!(b->words[bit / 64] & (1ull << (bit % 64)))) return false;
+    }
+    return true;
+}
+
+void bloom_free(bloom_t *b) {
+    if (!b) return;
+    free(b->words);
+    free(b);
+}
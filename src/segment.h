@@ -0,0 +1,66 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Log segments (--log-segment-mb): the hub writes to the log path as usual
+// and, once it has grown past the segment size, renames it (and its zone
+// map) to "<log>.NNNNNN" and starts a new one. Closed segments are numbered
+// from 000001 up, oldest first; the active log is the newest data.
+//
+// Each closed segment gets "<segment>.bloom", a Bloom filter of the sensor
+// names it contains, sized for that segment (about 10 bits per name, 7
+// probes: ~1% false positives). A lookup for one sensor loads the filters
+// and opens only the segments that may contain it.
+
+#define BLOOM_MAGIC 0x46425348u     /* "HSBF" little-endian */
+#define BLOOM_VERSION 1
+#define BLOOM_BITS_PER_NAME 10
+#define BLOOM_PROBES 7
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t probes;
+    uint32_t names;          // distinct names added
+    uint64_t bits;           // filter size, a multiple of 64
+} bloom_header_t;            // followed by bits / 64 uint64_t words
+
+// path of closed segment seq of log_path
+void segment_path(char *buf, size_t n, const char *log_path, unsigned seq);
+
+// closed segments of log_path, oldest first (caller frees each and the
+// array); -1 on error
+int segment_list(const char *log_path, char ***paths);
+
+// sequence number for the next closed segment (after compacted ones too)
+unsigned segment_next_seq(const char *log_path);
+
+// distinct sensor names written to the open segment
+typedef struct segment_names segment_names_t;
+
+segment_names_t *segment_names_new(void);
+// false if out of memory: the set then misses a name until it is cleared
+bool segment_names_add(segment_names_t *s, const char *type);
+void segment_names_clear(segment_names_t *s);
+// false if a name was lost since the last clear; such a set must not be
+// written as a filter, or lookups would skip a segment holding that name
+bool segment_names_complete(const segment_names_t *s);
+size_t segment_names_count(const segment_names_t *s);
+void segment_names_free(segment_names_t *s);
+
+// write "<segment_path>.bloom" for the names (atomically, via a rename)
+bool bloom_write(const char *segment_path, const segment_names_t *names);
+
+typedef struct {
+    bloom_header_t hdr;
+    uint64_t *words;
+} bloom_t;
+
+// NULL if the segment has no (valid) filter: treat it as "may contain"
+bloom_t *bloom_load(const char *segment_path);
+bool bloom_may_contain(const bloom_t *b, const char *type);
+void bloom_free(bloom_t *b);
+
+#endif
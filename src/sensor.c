@@ -1,21 +1,27 @@
 #define _POSIX_C_SOURCE 200809L
 #include "hub.h"
+#include "sensor.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdatomic.h>
 #include <pthread.h>
-#include <unistd.h>
 #include <time.h>
 #include <string.h>
 
-typedef struct {
-    int ms;
-    int sensor_id; // 0=temp, 1=hum, 2=press
-} sensor_arg_t;
-
-static pthread_t t_temp, t_hum, t_press;
+static pthread_t *sensor_threads = NULL;
+static int num_sensor_threads = 0;
+static atomic_int sensors_running = 0;
+static bool full_rate = false;
+static hub_t *target = NULL;
 
+// sleeps in short slices so stop_sensors() does not wait out long intervals
 static void sleep_ms(int ms) {
-    usleep(ms * 1000);
+    while (ms > 0 && atomic_load_explicit(&sensors_running, memory_order_relaxed)) {
+        int step = ms < 100 ? ms : 100;
+        struct timespec ts = { 0, step * 1000000L };
+        nanosleep(&ts, NULL);
+        ms -= step;
+    }
 }
 static long now_ms(void) {
     struct timespec ts;
@@ -23,70 +29,43 @@ static long now_ms(void) {
     return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
 }
 
-// get deterministic sequences of data using counters
-static void *temp_thread(void *arg) {
-    sensor_arg_t *a = (sensor_arg_t*)arg;
-    int ms = a->ms;
-    free(a);
+// get deterministic sequences of data using counters:
+// value cycles through base, base+1, ..., base+span-1, channel c shifted by c
+// (defaults: TEMP 22-36 C, HUM 40-95 %, PRESS 995-1020 mb)
+static void *sensor_thread(void *arg) {
+    const sensor_config_t *s = (const sensor_config_t*)arg;
     int cnt = 0;
-    while (1) {
-        // deterministic sequence: cycles from 22 to 36 degrees Celsius
-        double v = 22.0 + (cnt % 15);
+    while (atomic_load_explicit(&sensors_running, memory_order_relaxed)) {
+        double v[HUB_MAX_CHANNELS];
+        for (int c = 0; c < s->channels; ++c) v[c] = s->base + ((cnt + c) % s->span);
         long t = now_ms();
-        hub_submit_sample("TEMP", v, t);
+        hub_submit_vector(target, s->name, v, s->channels, t);
         cnt++;
-        sleep_ms(ms);
+        if (!full_rate) sleep_ms(s->interval_ms);
     }
     return NULL;
 }
 
-static void *hum_thread(void *arg) {
-    sensor_arg_t *a = (sensor_arg_t*)arg;
-    int ms = a->ms;
-    free(a);
-    int cnt = 0;
-    while (1) {
-        // deterministic sequence: cycles from 40 to 95 percent humidity
-        double v = 40.0 + (cnt % 56);
-        long t = now_ms();
-        hub_submit_sample("HUM", v, t);
-        cnt++;
-        sleep_ms(ms);
+// create a thread for each configured sensor
+void start_sensors(hub_t *hub, const hub_config_t *cfg) {
+    target = hub;
+    full_rate = cfg->benchmark;
+    atomic_store(&sensors_running, 1);
+    sensor_threads = calloc((size_t)cfg->num_sensors, sizeof(pthread_t));
+    for (int i = 0; i < cfg->num_sensors; ++i) {
+        if (cfg->sensors[i].spectral.source[0]) continue; // fed by the hub
+        if (pthread_create(&sensor_threads[num_sensor_threads], NULL, sensor_thread, &cfg->sensors[i]) != 0) {
+            fprintf(stderr, "sensor: cannot start %s\n", cfg->sensors[i].name);
+            break;
+        }
+        num_sensor_threads++;
     }
-    return NULL;
-}
-
-static void *press_thread(void *arg) {
-    sensor_arg_t *a = (sensor_arg_t*)arg;
-    int ms = a->ms;
-    free(a);
-    int cnt = 0;
-    while (1) {
-        // deterministic sequence: cycles from 995 to 1020 mb pressure
-        double v = 995.0 + (cnt % 26);
-        long t = now_ms();
-        hub_submit_sample("PRESS", v, t);
-        cnt++;
-        sleep_ms(ms);
-    }
-    return NULL;
-}
-
-// create a thread for each measurement
-void start_temp_sensor(int ms) {
-    sensor_arg_t *a = malloc(sizeof(*a));
-    a->ms = ms; a->sensor_id = 0;
-    pthread_create(&t_temp, NULL, temp_thread, a);
-}
-
-void start_hum_sensor(int ms) {
-    sensor_arg_t *a = malloc(sizeof(*a));
-    a->ms = ms; a->sensor_id = 1;
-    pthread_create(&t_hum, NULL, hum_thread, a);
 }
 
-void start_pressure_sensor(int ms) {
-    sensor_arg_t *a = malloc(sizeof(*a));
-    a->ms = ms; a->sensor_id = 2;
-    pthread_create(&t_press, NULL, press_thread, a);
+void stop_sensors(void) {
+    atomic_store(&sensors_running, 0);
+    for (int i = 0; i < num_sensor_threads; ++i) pthread_join(sensor_threads[i], NULL);
+    free(sensor_threads);
+    sensor_threads = NULL;
+    num_sensor_threads = 0;
 }
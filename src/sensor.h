@@ -1,8 +1,13 @@
 #ifndef SENSOR_H
 #define SENSOR_H
+#include "config.h"
+#include "hub.h"
 
-void start_temp_sensor(int ms);
-void start_hum_sensor(int ms);
-void start_pressure_sensor(int ms);
+// start one thread per configured sensor, submitting into hub; in benchmark
+// mode intervals are ignored
+void start_sensors(hub_t *hub, const hub_config_t *cfg);
 
-#endif
\ No newline at end of file
+// stop and join all sensor threads
+void stop_sensors(void);
+
+#endif
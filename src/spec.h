@@ -0,0 +1,29 @@
+#ifndef SPEC_H
+#define SPEC_H
+#include "hub.h"
+#include "window.h"
+
+// A processor specialized for one sensor schema, emitted as a C file by
+// tools/gen_processor.py. Sensor lookup, window sizes, thresholds, channel
+// counts and encodings are compile-time constants in the generated code.
+// The schema is a sensor file (config/sensors.conf format).
+typedef struct hub_spec {
+    const char *schema;               // file it was generated from
+    const sensor_config_t *sensors;   // as parsed from the schema (no spectral fields)
+    int num_sensors;
+    // config_sensor_index() for the schema's sensors
+    int (*sensor_index)(const char *type);
+    // one packed sample through a sensor's window: decodes it into *value and
+    // returns true when the full window's metric exceeds the threshold
+    bool (*process)(window_t *w, int sensor, const void *payload, hub_vec_t *value, double *metric);
+} hub_spec_t;
+
+// hub_create() with a generated processor. It is only used when cfg has
+// exactly the schema's sensors (processing fields); otherwise the hub
+// prints a warning and runs the runtime-configured processor.
+hub_t *hub_create_spec(const hub_config_t *cfg, const hub_spec_t *spec);
+
+// the processor linked into builds made with -DHUB_SPEC (make spec)
+extern const hub_spec_t hub_generated_spec;
+
+#endif
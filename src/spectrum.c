@@ -0,0 +1,210 @@
+#define _GNU_SOURCE
+#include "spectrum.h"
+#include <math.h>
+#include <stdlib.h>
+
+bool rfft_init(rfft_plan_t *p, int n) {
+    *p = (rfft_plan_t){ .n = n };
+    if (n < 4 || (n & (n - 1))) return false;
+    int half = n / 2;
+    p->twr = malloc(sizeof(double) * (size_t)half);
+    p->twi = malloc(sizeof(double) * (size_t)half);
+    p->rev = malloc(sizeof(int) * (size_t)half);
+    p->zr = malloc(sizeof(double) * (size_t)half);
+    p->zi = malloc(sizeof(double) * (size_t)half);
+    if (!p->twr || !p->twi || !p->rev || !p->zr || !p->zi) {
+        rfft_free(p);
+        return false;
+    }
+    for (int j = 0; j < half; ++j) {
+        p->twr[j] = cos(2 * M_PI * j / n);
+        p->twi[j] = -sin(2 * M_PI * j / n);
+    }
+    int bits = 0;
+    while ((1 << bits) < half) bits++;
+    for (int j = 0; j < half; ++j) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b) r |= ((j >> b) & 1) << (bits - 1 - b);
+        p->rev[j] = r;
+    }
+    return true;
+}
+
+void rfft_free(rfft_plan_t *p) {
+    free(p->twr);
+    free(p->twi);
+    free(p->rev);
+    free(p->zr);
+    free(p->zi);
+    p->twr = p->twi = p->zr = p->zi = NULL;
+    p->rev = NULL;
+}
+
+void rfft(rfft_plan_t *p, const double *x, double *re, double *im) {
+    int n = p->n, half = n / 2;
+    double *zr = p->zr, *zi = p->zi;
+    // pack even/odd samples as one complex sequence, in bit-reversed order
+    for (int j = 0; j < half; ++j) {
+        zr[p->rev[j]] = x[2 * j];
+        zi[p->rev[j]] = x[2 * j + 1];
+    }
+    // radix-2 butterflies; e^(-2 pi i j / len) = tw[j * n / len]
+    for (int len = 2; len <= half; len <<= 1) {
+        int step = n / len;
+        for (int i = 0; i < half; i += len) {
+            for (int j = 0; j < len / 2; ++j) {
+                double wr = p->twr[j * step], wi = p->twi[j * step];
+                int a = i + j, b = a + len / 2;
+                double tr = zr[b] * wr - zi[b] * wi;
+                double ti = zr[b] * wi + zi[b] * wr;
+                zr[b] = zr[a] - tr;
+                zi[b] = zi[a] - ti;
+                zr[a] += tr;
+                zi[a] += ti;
+            }
+        }
+    }
+    // split: X[k] = E[k] + e^(-2 pi i k / n) O[k], where E/O are the spectra
+    // of the even/odd samples: E = (Z[k] + conj Z[-k]) / 2, O = (Z[k] - conj Z[-k]) / 2i
+    for (int k = 0; k <= half; ++k) {
+        int a = k % half, b = (half - k) % half;
+        double er = (zr[a] + zr[b]) / 2, ei = (zi[a] - zi[b]) / 2;
+        double or_ = (zi[a] + zi[b]) / 2, oi = -(zr[a] - zr[b]) / 2;
+        double wr = k < half ? p->twr[k] : -1.0, wi = k < half ? p->twi[k] : 0.0;
+        re[k] = er + or_ * wr - oi * wi;
+        im[k] = ei + or_ * wi + oi * wr;
+    }
+}
+
+bool spectrum_init(spectrum_t *s, int n, int hop, bool sliding, double rate_hz,
+                   const double (*bands)[2], int num_bands) {
+    *s = (spectrum_t){ .n = n, .hop = hop, .sliding = sliding, .num_bands = num_bands };
+    s->band_lo = malloc(sizeof(int) * (size_t)num_bands);
+    s->band_hi = malloc(sizeof(int) * (size_t)num_bands);
+    s->ring = calloc((size_t)n, sizeof(double));
+    if (!s->band_lo || !s->band_hi || !s->ring) goto fail;
+    bool *used = calloc((size_t)n / 2 + 1, sizeof(bool));
+    if (!used) goto fail;
+    for (int b = 0; b < num_bands; ++b) {
+        int lo = (int)ceil(bands[b][0] * n / rate_hz), hi = (int)floor(bands[b][1] * n / rate_hz);
+        s->band_lo[b] = lo < 0 ? 0 : lo;
+        s->band_hi[b] = hi > n / 2 ? n / 2 : hi;
+        for (int k = s->band_lo[b]; k <= s->band_hi[b]; ++k) {
+            if (!used[k]) s->num_bins++;
+            used[k] = true;
+        }
+    }
+    if (sliding) {
+        s->bins = malloc(sizeof(int) * (size_t)(s->num_bins + 1));
+        s->xr = calloc((size_t)s->num_bins + 1, sizeof(double));
+        s->xi = calloc((size_t)s->num_bins + 1, sizeof(double));
+        s->cw = malloc(sizeof(double) * (size_t)(s->num_bins + 1));
+        s->sw = malloc(sizeof(double) * (size_t)(s->num_bins + 1));
+        if (!s->bins || !s->xr || !s->xi || !s->cw || !s->sw) {
+            free(used);
+            goto fail;
+        }
+        int m = 0;
+        for (int k = 0; k <= n / 2; ++k) {
+            if (!used[k]) continue;
+            s->bins[m] = k;
+            s->cw[m] = cos(2 * M_PI * k / n);
+            s->sw[m] = sin(2 * M_PI * k / n);
+            m++;
+        }
+    } else {
+        s->frame = malloc(sizeof(double) * (size_t)n);
+        s->re = malloc(sizeof(double) * (size_t)(n / 2 + 1));
+        s->im = malloc(sizeof(double) * (size_t)(n / 2 + 1));
+        if (!s->frame || !s->re || !s->im || !rfft_init(&s->plan, n)) {
+            free(used);
+            goto fail;
+        }
+    }
+    free(used);
+    return true;
+
+fail:
+    spectrum_free(s);
+    return false;
+}
+
+void spectrum_free(spectrum_t *s) {
+    free(s->band_lo);
+    free(s->band_hi);
+    free(s->ring);
+    free(s->bins);
+    free(s->xr);
+    free(s->xi);
+    free(s->cw);
+    free(s->sw);
+    free(s->frame);
+    free(s->re);
+    free(s->im);
+    if (s->plan.twr) rfft_free(&s->plan);
+    *s = (spectrum_t){ 0 };
+}
+
+// exact X[k] of the current window (oldest sample first): Goertzel
+// recurrence s[j] = y[j] + 2 cos(w) s[j-1] - s[j-2], then
+// X[k] = cos(w) s1 - s2 + i sin(w) s1
+static void goertzel_resync(spectrum_t *s) {
+    for (int m = 0; m < s->num_bins; ++m) {
+        double coef = 2 * s->cw[m], s1 = 0, s2 = 0;
+        for (int j = 0; j < s->n; ++j) {
+            double s0 = s->ring[(s->idx + j) % s->n] + coef * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        s->xr[m] = s->cw[m] * s1 - s2;
+        s->xi[m] = s->sw[m] * s1;
+    }
+}
+
+static double bin_weight(const spectrum_t *s, int k) {
+    double nn = (double)s->n * s->n;
+    return k == 0 || k == s->n / 2 ? 1 / nn : 2 / nn;
+}
+
+bool spectrum_push(spectrum_t *s, double x, double *energies) {
+    double oldest = s->ring[s->idx];
+    s->ring[s->idx] = x;
+    s->idx = (s->idx + 1) % s->n;
+    s->seen++;
+    if (s->sliding) {
+        if (s->seen % s->n == 0) {
+            goertzel_resync(s);
+        } else {
+            // slide by one sample: X'[k] = (X[k] - oldest + x) e^(2 pi i k / n)
+            for (int m = 0; m < s->num_bins; ++m) {
+                double a = s->xr[m] - oldest + x, b = s->xi[m];
+                s->xr[m] = a * s->cw[m] - b * s->sw[m];
+                s->xi[m] = a * s->sw[m] + b * s->cw[m];
+            }
+        }
+    }
+    if (s->seen < s->n || (s->seen - s->n) % s->hop != 0) return false;
+
+    if (s->sliding) {
+        for (int b = 0; b < s->num_bands; ++b) {
+            double e = 0;
+            for (int m = 0; m < s->num_bins; ++m) {
+                int k = s->bins[m];
+                if (k < s->band_lo[b] || k > s->band_hi[b]) continue;
+                e += (s->xr[m] * s->xr[m] + s->xi[m] * s->xi[m]) * bin_weight(s, k);
+            }
+            energies[b] = e;
+        }
+    } else {
+        for (int j = 0; j < s->n; ++j) s->frame[j] = s->ring[(s->idx + j) % s->n];
+        rfft(&s->plan, s->frame, s->re, s->im);
+        for (int b = 0; b < s->num_bands; ++b) {
+            double e = 0;
+            for (int k = s->band_lo[b]; k <= s->band_hi[b]; ++k) {
+                e += (s->re[k] * s->re[k] + s->im[k] * s->im[k]) * bin_weight(s, k);
+            }
+            energies[b] = e;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+#include <stdbool.h>
+
+// Real FFT of n points (n a power of two, >= 4): a radix-2 complex FFT of
+// n/2 points over the even/odd samples packed as re/im, then split into
+// the n/2 + 1 non-redundant bins. Twiddles and the bit-reversal order are
+// computed once per plan.
+typedef struct {
+    int n;
+    double *twr, *twi;   // e^(-2 pi i j / n), j < n/2
+    int *rev;            // bit reversal of n/2 indices
+    double *zr, *zi;     // work buffers, n/2 each
+} rfft_plan_t;
+
+bool rfft_init(rfft_plan_t *p, int n);
+void rfft_free(rfft_plan_t *p);
+// re/im get bins 0..n/2 of X[k] = sum x[j] e^(-2 pi i j k / n)
+void rfft(rfft_plan_t *p, const double *x, double *re, double *im);
+
+// Band energies over the last n samples of a stream, computed every hop
+// samples once n samples have been seen. The energy of a band is
+// (2 / n^2) * sum |X[k]|^2 over its bins (bins 0 and n/2 count once), the
+// mean power of the band's components: a sine of amplitude A gives A^2 / 2.
+// No window function is applied.
+//
+// Block mode runs rfft() over the window at each emission (O(n log n)
+// per hop). Sliding mode keeps a sliding DFT of only the bins the bands
+// cover, updated every sample in O(bins), and recomputes them exactly with
+// the Goertzel recurrence every n samples so rounding cannot drift.
+typedef struct {
+    int n, hop;
+    bool sliding;
+    int num_bands;
+    int *band_lo, *band_hi;   // bin ranges, inclusive
+    double *ring;             // last n samples, ring[idx] is the oldest
+    int idx;
+    long seen;
+
+    // block mode
+    rfft_plan_t plan;
+    double *frame, *re, *im;
+
+    // sliding mode: the union of the bands' bins
+    int num_bins;
+    int *bins;
+    double *xr, *xi;          // X[k] of the current window
+    double *cw, *sw;          // cos / sin(2 pi k / n)
+} spectrum_t;
+
+// bands[b] = { lo_hz, hi_hz } at sample rate rate_hz
+bool spectrum_init(spectrum_t *s, int n, int hop, bool sliding, double rate_hz,
+                   const double (*bands)[2], int num_bands);
+void spectrum_free(spectrum_t *s);
+
+// add one sample; true when energies[num_bands] were computed
+bool spectrum_push(spectrum_t *s, double x, double *energies);
+
+#endif
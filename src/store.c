@@ -0,0 +1,425 @@
+#define _POSIX_C_SOURCE 200809L
+#include "store.h"
+#include "encoding.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DAY_MS 86400000LL
+
+// one configured sensor's open partition; written by its processor only,
+// the counters are read by whichever thread rewrites the manifest
+typedef struct {
+    FILE *ts, *val;          // NULL = not storing (no partition or schema mismatch)
+    int64_t day;             // days since the epoch of the open partition
+    int part;                // index in store.parts, -1 = none
+    size_t row_size;
+    _Atomic uint64_t rows;
+    _Atomic int64_t min_ms, max_ms;
+} column_t;
+
+struct store {
+    const hub_config_t *cfg;
+    column_t *columns;       // per configured sensor
+    pthread_mutex_t lock;    // parts and the manifest file
+    store_part_t *parts;     // every partition known, open ones included
+    int num_parts, cap_parts;
+    bool loaded;             // parts are current (see load_parts)
+};
+
+static void day_name(int64_t day, char out[11]) {
+    time_t t = (time_t)(day * 86400);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(out, 11, "%Y-%m-%d", &tm);
+}
+
+static void column_path(char *buf, size_t n, const char *dir, const char *day, const char *name, const char *ext) {
+    snprintf(buf, n, "%s/%s/%s.%s", dir, day, name, ext);
+}
+
+static int part_cmp(const void *a, const void *b) {
+    const store_part_t *x = a, *y = b;
+    int c = strcmp(x->name, y->name);
+    return c ? c : strcmp(x->day, y->day);
+}
+
+static bool parse_part(const char *line, store_part_t *p) {
+    char enc[8];
+    unsigned long long rows;
+    long long lo, hi;
+    memset(p, 0, sizeof(*p));
+    if (sscanf(line, "part %10s %15s channels=%d encoding=%7s scale=%lf offset=%lf rows=%llu min=%lld max=%lld",
+               p->day, p->name, &p->channels, enc, &p->scale, &p->offset, &rows, &lo, &hi) != 9) return false;
+    if (p->channels < 1 || p->channels > HUB_MAX_CHANNELS) return false;
+    for (int e = ENC_F64; e <= ENC_I16; ++e) {
+        if (strcmp(enc, encoding_name((value_encoding_t)e)) != 0) continue;
+        p->encoding = (value_encoding_t)e;
+        p->rows = rows;
+        p->min_ms = lo;
+        p->max_ms = hi;
+        return true;
+    }
+    return false;
+}
+
+store_manifest_t *store_load(const char *dir) {
+    char path[HUB_PATH_LEN + 16];
+    snprintf(path, sizeof(path), "%s/MANIFEST", dir);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "store: cannot open %s\n", path);
+        return NULL;
+    }
+    store_manifest_t *m = calloc(1, sizeof(*m));
+    if (!m) {
+        fclose(f);
+        return NULL;
+    }
+    snprintf(m->dir, sizeof(m->dir), "%s", dir);
+    char line[512];
+    int cap = 0, lineno = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (m->num_parts == cap) {
+            cap = cap ? cap * 2 : 64;
+            store_part_t *p = realloc(m->parts, sizeof(*p) * (size_t)cap);
+            if (!p) {
+                ok = false;
+                break;
+            }
+            m->parts = p;
+        }
+        if (!parse_part(line, &m->parts[m->num_parts])) {
+            fprintf(stderr, "store: %s:%d: invalid line\n", path, lineno);
+            ok = false;
+            break;
+        }
+        m->num_parts++;
+    }
+    fclose(f);
+    if (!ok) {
+        store_manifest_free(m);
+        return NULL;
+    }
+    qsort(m->parts, (size_t)m->num_parts, sizeof(*m->parts), part_cmp);
+    return m;
+}
+
+void store_manifest_free(store_manifest_t *m) {
+    if (!m) return;
+    free(m->parts);
+    free(m);
+}
+
+int store_find(const store_manifest_t *m, const char *name, int *n) {
+    int first = -1;
+    *n = 0;
+    for (int i = 0; i < m->num_parts; ++i) {
+        if (strcmp(m->parts[i].name, name) != 0) continue;
+        if (first < 0) first = i;
+        (*n)++;
+    }
+    return first;
+}
+
+void store_part_schema(const store_part_t *p, sensor_config_t *sc) {
+    memset(sc, 0, sizeof(*sc));
+    snprintf(sc->name, sizeof(sc->name), "%s", p->name);
+    sc->channels = p->channels;
+    sc->encoding = p->encoding;
+    sc->scale = p->scale;
+    sc->offset = p->offset;
+}
+
+static const void *map_file(const char *path, size_t *len) {
+    *len = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat sb;
+    const void *p = NULL;
+    if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+        p = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) p = NULL;
+        else *len = (size_t)sb.st_size;
+    }
+    close(fd);
+    return p;
+}
+
+bool store_map(const store_manifest_t *m, const store_part_t *p, store_columns_t *out) {
+    char path[HUB_PATH_LEN + 64];
+    memset(out, 0, sizeof(*out));
+    out->row_size = (size_t)p->channels * encoding_width(p->encoding);
+    column_path(path, sizeof(path), m->dir, p->day, p->name, "ts");
+    out->ts = map_file(path, &out->ts_len);
+    column_path(path, sizeof(path), m->dir, p->day, p->name, "val");
+    out->val = map_file(path, &out->val_len);
+    if ((p->rows && !out->ts) || (out->ts && !out->val)) {
+        store_unmap(out);
+        return false;
+    }
+    out->rows = out->ts_len / sizeof(int64_t);
+    if (out->val_len / out->row_size < out->rows) out->rows = out->val_len / out->row_size;
+    return true;
+}
+
+void store_unmap(store_columns_t *c) {
+    if (c->ts) munmap((void*)c->ts, c->ts_len);
+    if (c->val) munmap((void*)c->val, c->val_len);
+    memset(c, 0, sizeof(*c));
+}
+
+// writer
+
+// rewrite DIR/MANIFEST from the parts, open ones with their live counters
+// (caller holds st->lock)
+static void write_manifest(store_t *st) {
+    const char *dir = st->cfg->store_dir;
+    char path[HUB_PATH_LEN + 16], tmp[HUB_PATH_LEN + 16];
+    snprintf(path, sizeof(path), "%s/MANIFEST", dir);
+    snprintf(tmp, sizeof(tmp), "%s/MANIFEST.tmp", dir);
+    for (int i = 0; i < st->cfg->num_sensors; ++i) {
+        column_t *c = &st->columns[i];
+        if (c->part < 0) continue;
+        store_part_t *p = &st->parts[c->part];
+        p->rows = atomic_load_explicit(&c->rows, memory_order_relaxed);
+        p->min_ms = atomic_load_explicit(&c->min_ms, memory_order_relaxed);
+        p->max_ms = atomic_load_explicit(&c->max_ms, memory_order_relaxed);
+    }
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        fprintf(stderr, "store: cannot write %s\n", tmp);
+        return;
+    }
+    // the reader's order; the parts themselves keep theirs (columns index them)
+    int *order = malloc(sizeof(int) * (size_t)(st->num_parts + 1));
+    if (!order) {
+        fclose(f);
+        return;
+    }
+    for (int i = 0; i < st->num_parts; ++i) order[i] = i;
+    for (int i = 1; i < st->num_parts; ++i) {
+        for (int k = i; k > 0 && part_cmp(&st->parts[order[k - 1]], &st->parts[order[k]]) > 0; --k) {
+            int t = order[k]; order[k] = order[k - 1]; order[k - 1] = t;
+        }
+    }
+    fprintf(f, "# sensorhub column store 1\n");
+    for (int i = 0; i < st->num_parts; ++i) {
+        const store_part_t *p = &st->parts[order[i]];
+        fprintf(f, "part %s %s channels=%d encoding=%s scale=%.17g offset=%.17g rows=%llu min=%lld max=%lld\n",
+                p->day, p->name, p->channels, encoding_name(p->encoding), p->scale, p->offset,
+                (unsigned long long)p->rows, (long long)p->min_ms, (long long)p->max_ms);
+    }
+    free(order);
+    if (fclose(f) != 0 || rename(tmp, path) != 0) fprintf(stderr, "store: cannot replace %s\n", path);
+}
+
+static void close_column(store_t *st, column_t *c) {
+    if (c->ts) fclose(c->ts);
+    if (c->val) fclose(c->val);
+    c->ts = c->val = NULL;
+    if (c->part >= 0) {
+        store_part_t *p = &st->parts[c->part];
+        p->rows = atomic_load_explicit(&c->rows, memory_order_relaxed);
+        p->min_ms = atomic_load_explicit(&c->min_ms, memory_order_relaxed);
+        p->max_ms = atomic_load_explicit(&c->max_ms, memory_order_relaxed);
+    }
+    c->part = -1;
+}
+
+static bool same_schema(const store_part_t *p, const sensor_config_t *sc) {
+    if (p->channels != sc->channels || p->encoding != sc->encoding) return false;
+    return !encoding_is_integer(sc->encoding) || (p->scale == sc->scale && p->offset == sc->offset);
+}
+
+// open (or continue) the partition of sensor i for day; caller holds st->lock
+static void open_column(store_t *st, int i, int64_t day) {
+    const sensor_config_t *sc = &st->cfg->sensors[i];
+    column_t *c = &st->columns[i];
+    char dname[11], path[HUB_PATH_LEN + 64];
+    day_name(day, dname);
+    c->day = day;
+
+    int k = 0;
+    while (k < st->num_parts && (strcmp(st->parts[k].name, sc->name) != 0 || strcmp(st->parts[k].day, dname) != 0)) k++;
+    if (k < st->num_parts && !same_schema(&st->parts[k], sc)) {
+        fprintf(stderr, "store: %s changed channels or encoding, not stored until after %s\n", sc->name, dname);
+        return;
+    }
+    if (k == st->num_parts) {
+        if (st->num_parts == st->cap_parts) {
+            int cap = st->cap_parts ? st->cap_parts * 2 : 64;
+            store_part_t *p = realloc(st->parts, sizeof(*p) * (size_t)cap);
+            if (!p) return;
+            st->parts = p;
+            st->cap_parts = cap;
+        }
+        store_part_t *p = &st->parts[st->num_parts++];
+        memset(p, 0, sizeof(*p));
+        memcpy(p->day, dname, sizeof(p->day));
+        snprintf(p->name, sizeof(p->name), "%s", sc->name);
+        p->channels = sc->channels;
+        p->encoding = sc->encoding;
+        p->scale = sc->scale;
+        p->offset = sc->offset;
+        p->min_ms = INT64_MAX;
+        p->max_ms = INT64_MIN;
+    }
+    store_part_t *p = &st->parts[k];
+
+    snprintf(path, sizeof(path), "%s/%s", st->cfg->store_dir, dname);
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "store: cannot create %s\n", path);
+        return;
+    }
+    column_path(path, sizeof(path), st->cfg->store_dir, dname, sc->name, "ts");
+    c->ts = fopen(path, "ab");
+    int tfd = open(path, O_RDONLY);
+    column_path(path, sizeof(path), st->cfg->store_dir, dname, sc->name, "val");
+    c->val = fopen(path, "ab");
+    if (!c->ts || !c->val || tfd < 0) {
+        fprintf(stderr, "store: cannot open the columns of %s for %s\n", sc->name, dname);
+        if (c->ts) fclose(c->ts);
+        if (c->val) fclose(c->val);
+        if (tfd >= 0) close(tfd);
+        c->ts = c->val = NULL;
+        return;
+    }
+    // rows both columns hold completely; a torn row from a crash is cut off
+    struct stat ts_st, val_st;
+    fstat(fileno(c->ts), &ts_st);
+    fstat(fileno(c->val), &val_st);
+    uint64_t rows = (uint64_t)ts_st.st_size / sizeof(int64_t);
+    if ((uint64_t)val_st.st_size / c->row_size < rows) rows = (uint64_t)val_st.st_size / c->row_size;
+    if (ftruncate(fileno(c->ts), (off_t)(rows * sizeof(int64_t))) != 0 ||
+        ftruncate(fileno(c->val), (off_t)(rows * c->row_size)) != 0) {
+        fprintf(stderr, "store: cannot truncate the columns of %s for %s\n", sc->name, dname);
+    }
+    // rows the manifest has not counted yet widen the time bounds
+    if (p->rows > rows) p->rows = rows;
+    for (uint64_t r = p->rows; r < rows; ++r) {
+        int64_t ts;
+        if (pread(tfd, &ts, sizeof(ts), (off_t)(r * sizeof(ts))) != (ssize_t)sizeof(ts)) break;
+        if (ts < p->min_ms) p->min_ms = ts;
+        if (ts > p->max_ms) p->max_ms = ts;
+    }
+    close(tfd);
+    p->rows = rows;
+    c->part = k;
+    atomic_store_explicit(&c->rows, rows, memory_order_relaxed);
+    atomic_store_explicit(&c->min_ms, p->min_ms, memory_order_relaxed);
+    atomic_store_explicit(&c->max_ms, p->max_ms, memory_order_relaxed);
+}
+
+// Read the manifest when the first partition opens rather than in
+// store_open: a successor hub opens the store while its predecessor is
+// still writing, and starts appending only after the predecessor's final
+// flush. Caller holds st->lock; every column is closed.
+static void load_parts(store_t *st) {
+    char path[HUB_PATH_LEN + 16];
+    st->num_parts = 0;
+    st->loaded = true;
+    snprintf(path, sizeof(path), "%s/MANIFEST", st->cfg->store_dir);
+    if (access(path, F_OK) != 0) return;
+    store_manifest_t *m = store_load(st->cfg->store_dir);
+    if (!m) return;
+    free(st->parts);
+    st->parts = m->parts;
+    st->num_parts = st->cap_parts = m->num_parts;
+    m->parts = NULL;
+    store_manifest_free(m);
+}
+
+store_t *store_open(const hub_config_t *cfg) {
+    char dir[HUB_PATH_LEN];
+    snprintf(dir, sizeof(dir), "%s", cfg->store_dir);
+    for (char *p = dir + 1; ; ++p) {
+        if (*p != '/' && *p != '\0') continue;
+        char c = *p;
+        *p = '\0';
+        if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+            fprintf(stderr, "store: cannot create %s\n", dir);
+            return NULL;
+        }
+        if (!(*p = c)) break;
+    }
+    // refuse a manifest we could not continue rather than replace it
+    char path[HUB_PATH_LEN + 16];
+    snprintf(path, sizeof(path), "%s/MANIFEST", cfg->store_dir);
+    if (access(path, F_OK) == 0) {
+        store_manifest_t *m = store_load(cfg->store_dir);
+        if (!m) return NULL;
+        store_manifest_free(m);
+    }
+    store_t *st = calloc(1, sizeof(*st));
+    if (!st) return NULL;
+    st->cfg = cfg;
+    pthread_mutex_init(&st->lock, NULL);
+    st->columns = calloc((size_t)cfg->num_sensors, sizeof(*st->columns));
+    if (!st->columns) {
+        store_close(st);
+        return NULL;
+    }
+    for (int i = 0; i < cfg->num_sensors; ++i) {
+        column_t *c = &st->columns[i];
+        c->day = INT64_MIN;
+        c->part = -1;
+        c->row_size = (size_t)cfg->sensors[i].channels * encoding_width(cfg->sensors[i].encoding);
+    }
+    return st;
+}
+
+void store_append(store_t *st, int sensor, int64_t ms_timestamp, const void *payload) {
+    column_t *c = &st->columns[sensor];
+    int64_t day = ms_timestamp / DAY_MS - (ms_timestamp % DAY_MS < 0);
+    if (day != c->day) {
+        pthread_mutex_lock(&st->lock);
+        close_column(st, c);
+        if (!st->loaded) load_parts(st);
+        open_column(st, sensor, day);
+        write_manifest(st);
+        pthread_mutex_unlock(&st->lock);
+    }
+    if (!c->ts) return;
+    fwrite(&ms_timestamp, sizeof(ms_timestamp), 1, c->ts);
+    fwrite(payload, c->row_size, 1, c->val);
+    // single writer: plain load/store pairs, atomic only for the manifest's readers
+    atomic_store_explicit(&c->rows, atomic_load_explicit(&c->rows, memory_order_relaxed) + 1, memory_order_relaxed);
+    if (ms_timestamp < atomic_load_explicit(&c->min_ms, memory_order_relaxed)) {
+        atomic_store_explicit(&c->min_ms, ms_timestamp, memory_order_relaxed);
+    }
+    if (ms_timestamp > atomic_load_explicit(&c->max_ms, memory_order_relaxed)) {
+        atomic_store_explicit(&c->max_ms, ms_timestamp, memory_order_relaxed);
+    }
+}
+
+void store_flush(store_t *st) {
+    pthread_mutex_lock(&st->lock);
+    for (int i = 0; i < st->cfg->num_sensors; ++i) {
+        close_column(st, &st->columns[i]);
+        st->columns[i].day = INT64_MIN;
+    }
+    if (st->loaded) write_manifest(st);
+    st->loaded = false;
+    pthread_mutex_unlock(&st->lock);
+}
+
+void store_close(store_t *st) {
+    if (!st) return;
+    if (st->columns) store_flush(st);
+    pthread_mutex_destroy(&st->lock);
+    free(st->columns);
+    free(st->parts);
+    free(st);
+}
@@ -0,0 +1,79 @@
+#ifndef STORE_H
+#define STORE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Column store (--store DIR): the processors append every processed sample
+// to its sensor's own column files, in one directory per UTC day of the
+// sample time:
+//
+//   DIR/2026-10-16/TEMP.ts    int64 ms timestamps, one per row
+//   DIR/2026-10-16/TEMP.val   the row's channels in the sensor's encoding
+//
+// so reading one sensor reads only its bytes. Rows are in processing order
+// (arrival order per sensor). DIR/MANIFEST is a text file, replaced
+// atomically, with one line per partition and its schema:
+//
+//   part 2026-10-16 TEMP channels=1 encoding=i16 scale=0.01 offset=0 rows=86400 min=1760572800000 max=1760659199000
+//
+// It is rewritten when a partition is opened or closed and when the hub
+// flushes the store (drain, stop). Rows written since then are in the files
+// but not yet counted: readers take the rows both column files hold. A
+// partition keeps the schema it was created with; if the sensor's channels
+// or encoding change, its samples are not stored until the next day.
+// Samples of unknown sensors and dropped samples are not stored.
+
+typedef struct store store_t;
+
+// NULL (with a message) if DIR cannot be used
+store_t *store_open(const hub_config_t *cfg);
+// one processed sample; only the processor owning the sensor calls this
+void store_append(store_t *st, int sensor, int64_t ms_timestamp, const void *payload);
+// close all columns and rewrite the manifest (processors stopped); the next
+// append reopens its partition from the files, which a successor hub may
+// have extended in between
+void store_flush(store_t *st);
+void store_close(store_t *st);
+
+// reader
+typedef struct {
+    char day[11];            // YYYY-MM-DD
+    char name[HUB_NAME_LEN];
+    int channels;
+    value_encoding_t encoding;
+    double scale, offset;
+    uint64_t rows;           // as of the last manifest update
+    int64_t min_ms, max_ms;
+} store_part_t;
+
+typedef struct {
+    char dir[HUB_PATH_LEN];
+    store_part_t *parts;     // sorted by name, then day
+    int num_parts;
+} store_manifest_t;
+
+// NULL (with a message) if DIR/MANIFEST is missing or invalid
+store_manifest_t *store_load(const char *dir);
+void store_manifest_free(store_manifest_t *m);
+
+// the partitions of one sensor: index of the first, count in *n
+int store_find(const store_manifest_t *m, const char *name, int *n);
+
+// a sensor config with the partition's schema (for encoding_unpack)
+void store_part_schema(const store_part_t *p, sensor_config_t *sc);
+
+// one partition's columns, memory-mapped read-only
+typedef struct {
+    const int64_t *ts;
+    const unsigned char *val;  // rows * channels * width bytes
+    size_t rows;
+    size_t row_size;
+    size_t ts_len, val_len;    // mapped lengths
+} store_columns_t;
+
+bool store_map(const store_manifest_t *m, const store_part_t *p, store_columns_t *out);
+void store_unmap(store_columns_t *c);
+
+#endif
@@ -0,0 +1,349 @@
+#define _POSIX_C_SOURCE 200809L
+#include "sweep.h"
+#include "window.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SWEEP_MAX_VALUES 100000   // per grid
+
+// state of one (window, hysteresis) pair over all thresholds
+typedef struct {
+    int prev;            // candidates in alert after the last sample (a prefix)
+    int64_t last_ms;
+    bool seen;
+    uint64_t *alerting;  // [p]: samples after which p candidates were in alert
+    int64_t *alert_ms;   // [p]: time to the next sample with p candidates in alert
+    int64_t *entered;    // episode starts, difference array over candidates
+} sweep_state_t;
+
+typedef struct {
+    sensor_config_t sc;  // the sensor with this window size
+    window_t w;
+    sweep_state_t *states; // per hysteresis value
+} sweep_window_t;
+
+typedef struct {
+    bool active;
+    double *thresholds;  // ascending, distinct
+    int num_thresholds;
+    double *hysteresis;
+    int num_hysteresis;
+    sweep_window_t *windows;
+    int num_windows;
+    unsigned long samples;
+} sweep_sensor_t;
+
+struct sweep {
+    const hub_config_t *cfg;
+    sweep_sensor_t *sensors;
+};
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// sort and drop duplicates
+static int sort_unique(double *v, int n) {
+    qsort(v, (size_t)n, sizeof(double), cmp_double);
+    int k = 0;
+    for (int i = 0; i < n; ++i) {
+        if (k == 0 || v[i] != v[k - 1]) v[k++] = v[i];
+    }
+    return k;
+}
+
+static bool parse_number(const char *s, double *out, const char *key) {
+    char *end;
+    *out = strtod(s, &end);
+    if (end == s || *end || isnan(*out)) {
+        fprintf(stderr, "sweep: bad number '%s' for %s\n", s, key);
+        return false;
+    }
+    return true;
+}
+
+// "a,b,c" or "start:stop:step" into a new sorted array
+static bool parse_grid(char *s, double **out, int *n, const char *key) {
+    double *v = NULL;
+    int count = 0;
+    char *c1 = strchr(s, ':');
+    if (c1) {
+        char *c2 = strchr(c1 + 1, ':');
+        double start, stop, step;
+        if (!c2) {
+            fprintf(stderr, "sweep: %s range must be start:stop:step\n", key);
+            return false;
+        }
+        *c1 = *c2 = '\0';
+        if (!parse_number(s, &start, key) || !parse_number(c1 + 1, &stop, key) ||
+            !parse_number(c2 + 1, &step, key)) return false;
+        double steps = floor((stop - start) / step + 1e-9);
+        if (!(step > 0) || !(stop >= start) || steps >= SWEEP_MAX_VALUES) {
+            fprintf(stderr, "sweep: bad %s range (at most %d values)\n", key, SWEEP_MAX_VALUES);
+            return false;
+        }
+        count = (int)steps + 1;
+        v = malloc(sizeof(double) * (size_t)count);
+        if (!v) return false;
+        for (int i = 0; i < count; ++i) v[i] = start + i * step;
+    } else {
+        v = malloc(sizeof(double) * SWEEP_MAX_VALUES);
+        if (!v) return false;
+        char *save = NULL;
+        for (char *tok = strtok_r(s, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+            if (count == SWEEP_MAX_VALUES || !parse_number(tok, &v[count], key)) {
+                free(v);
+                return false;
+            }
+            count++;
+        }
+        if (count == 0) {
+            fprintf(stderr, "sweep: empty %s\n", key);
+            free(v);
+            return false;
+        }
+    }
+    *out = v;
+    *n = sort_unique(v, count);
+    return true;
+}
+
+static bool state_init(sweep_state_t *st, int num_thresholds) {
+    size_t n = (size_t)num_thresholds + 1;
+    st->alerting = calloc(n, sizeof(uint64_t));
+    st->alert_ms = calloc(n, sizeof(int64_t));
+    st->entered = calloc(n, sizeof(int64_t));
+    return st->alerting && st->alert_ms && st->entered;
+}
+
+static bool parse_line(sweep_t *sw, char *line) {
+    const hub_config_t *cfg = sw->cfg;
+    char *save = NULL;
+    char *name = strtok_r(line, " \t", &save);
+    int sensor = config_sensor_index(cfg, name);
+    if (sensor < 0 || sw->sensors[sensor].active) {
+        fprintf(stderr, "sweep: unknown or repeated sensor '%s'\n", name);
+        return false;
+    }
+    const sensor_config_t *sc = &cfg->sensors[sensor];
+    sweep_sensor_t *ss = &sw->sensors[sensor];
+    ss->active = true;
+    double *windows = NULL;
+    int num_windows = 0;
+    for (char *tok = strtok_r(NULL, " \t", &save); tok; tok = strtok_r(NULL, " \t", &save)) {
+        char *eq = strchr(tok, '=');
+        if (!eq) {
+            fprintf(stderr, "sweep: expected key=value, got '%s'\n", tok);
+            goto fail;
+        }
+        *eq = '\0';
+        bool ok;
+        if (strcmp(tok, "thresholds") == 0 && !ss->thresholds) {
+            ok = parse_grid(eq + 1, &ss->thresholds, &ss->num_thresholds, tok);
+        } else if (strcmp(tok, "windows") == 0 && !windows) {
+            ok = parse_grid(eq + 1, &windows, &num_windows, tok);
+        } else if (strcmp(tok, "hysteresis") == 0 && !ss->hysteresis) {
+            ok = parse_grid(eq + 1, &ss->hysteresis, &ss->num_hysteresis, tok);
+        } else {
+            fprintf(stderr, "sweep: unknown or repeated key '%s'\n", tok);
+            ok = false;
+        }
+        if (!ok) goto fail;
+    }
+    // defaults: the sensor's own rule
+    if (!ss->thresholds) {
+        ss->thresholds = malloc(sizeof(double));
+        if (!ss->thresholds) goto fail;
+        ss->thresholds[0] = sc->threshold;
+        ss->num_thresholds = 1;
+    }
+    if (!ss->hysteresis) {
+        ss->hysteresis = calloc(1, sizeof(double));
+        if (!ss->hysteresis) goto fail;
+        ss->num_hysteresis = 1;
+    }
+    if (!windows) {
+        windows = malloc(sizeof(double));
+        if (!windows) goto fail;
+        windows[0] = sc->window;
+        num_windows = 1;
+    }
+    if (ss->hysteresis[0] < 0) {
+        fprintf(stderr, "sweep: %s: hysteresis must not be negative\n", name);
+        goto fail;
+    }
+    ss->windows = calloc((size_t)num_windows, sizeof(*ss->windows));
+    if (!ss->windows) goto fail;
+    ss->num_windows = num_windows;
+    for (int x = 0; x < num_windows; ++x) {
+        sweep_window_t *sx = &ss->windows[x];
+        if (windows[x] != floor(windows[x]) || windows[x] < 1 || windows[x] > 1000000) {
+            fprintf(stderr, "sweep: %s: windows must be whole numbers from 1 to 1000000\n", name);
+            goto fail;
+        }
+        sx->sc = *sc;
+        sx->sc.window = (int)windows[x];
+        sx->states = calloc((size_t)ss->num_hysteresis, sizeof(*sx->states));
+        if (!sx->states || !window_init(&sx->w, &sx->sc)) goto fail;
+        for (int k = 0; k < ss->num_hysteresis; ++k) {
+            if (!state_init(&sx->states[k], ss->num_thresholds)) goto fail;
+        }
+    }
+    free(windows);
+    return true;
+
+fail:
+    free(windows);
+    return false;
+}
+
+void sweep_free(sweep_t *sw) {
+    if (!sw) return;
+    for (int i = 0; sw->sensors && i < sw->cfg->num_sensors; ++i) {
+        sweep_sensor_t *ss = &sw->sensors[i];
+        for (int x = 0; ss->windows && x < ss->num_windows; ++x) {
+            sweep_window_t *sx = &ss->windows[x];
+            window_free(&sx->w);
+            for (int k = 0; sx->states && k < ss->num_hysteresis; ++k) {
+                free(sx->states[k].alerting);
+                free(sx->states[k].alert_ms);
+                free(sx->states[k].entered);
+            }
+            free(sx->states);
+        }
+        free(ss->windows);
+        free(ss->thresholds);
+        free(ss->hysteresis);
+    }
+    free(sw->sensors);
+    free(sw);
+}
+
+sweep_t *sweep_load(const hub_config_t *cfg, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "sweep: cannot open %s\n", path);
+        return NULL;
+    }
+    sweep_t *sw = calloc(1, sizeof(*sw));
+    if (sw) {
+        sw->cfg = cfg;
+        sw->sensors = calloc((size_t)cfg->num_sensors, sizeof(*sw->sensors));
+    }
+    bool ok = sw && sw->sensors;
+    char line[4096];
+    int lineno = 0, lines = 0;
+    while (ok && fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *s = line;
+        while (isspace((unsigned char)*s)) s++;
+        if (!*s) continue;
+        char *e = s + strlen(s);
+        while (e > s && isspace((unsigned char)e[-1])) *--e = '\0';
+        ok = parse_line(sw, s);
+        if (!ok) fprintf(stderr, "sweep: %s:%d: invalid line\n", path, lineno);
+        lines++;
+    }
+    fclose(f);
+    if (ok && lines == 0) {
+        fprintf(stderr, "sweep: %s lists no sensors\n", path);
+        ok = false;
+    }
+    if (!ok) {
+        sweep_free(sw);
+        return NULL;
+    }
+    return sw;
+}
+
+bool sweep_has(const sweep_t *sw, int sensor) {
+    return sw->sensors[sensor].active;
+}
+
+// number of thresholds below m (NaN exceeds none)
+static int count_below(const double *t, int n, double m) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (t[mid] < m) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void sweep_push(sweep_t *sw, int sensor, const void *payload, long ms_timestamp) {
+    sweep_sensor_t *ss = &sw->sensors[sensor];
+    ss->samples++;
+    for (int x = 0; x < ss->num_windows; ++x) {
+        sweep_window_t *sx = &ss->windows[x];
+        hub_vec_t value;
+        double metric;
+        window_update(&sx->w, &sx->sc, payload, &value, &metric);
+        bool full = sx->w.count == sx->sc.window;
+        int above = full ? count_below(ss->thresholds, ss->num_thresholds, metric) : 0;
+        for (int k = 0; k < ss->num_hysteresis; ++k) {
+            sweep_state_t *st = &sx->states[k];
+            // in alert: above the threshold, or still in alert and above threshold - h
+            int p = above;
+            if (full && st->prev > p && ss->hysteresis[k] > 0) {
+                int held = count_below(ss->thresholds, ss->num_thresholds, metric + ss->hysteresis[k]);
+                p = held < st->prev ? held : st->prev;
+                if (p < above) p = above;
+            }
+            if (st->seen) st->alert_ms[st->prev] += ms_timestamp - st->last_ms;
+            st->alerting[p]++;
+            if (p > st->prev) {
+                st->entered[st->prev]++;
+                st->entered[p]--;
+            }
+            st->prev = p;
+            st->last_ms = ms_timestamp;
+            st->seen = true;
+        }
+    }
+}
+
+bool sweep_write_csv(const sweep_t *sw, FILE *out) {
+    fprintf(out, "sensor,window,hysteresis,threshold,samples,alert_samples,episodes,alert_ms\n");
+    for (int i = 0; i < sw->cfg->num_sensors; ++i) {
+        const sweep_sensor_t *ss = &sw->sensors[i];
+        if (!ss->active) continue;
+        int n = ss->num_thresholds;
+        uint64_t *alerting = malloc(sizeof(uint64_t) * (size_t)(n + 1));
+        int64_t *alert_ms = malloc(sizeof(int64_t) * (size_t)(n + 1));
+        if (!alerting || !alert_ms) {
+            free(alerting);
+            free(alert_ms);
+            return false;
+        }
+        for (int x = 0; x < ss->num_windows; ++x) {
+            const sweep_window_t *sx = &ss->windows[x];
+            for (int k = 0; k < ss->num_hysteresis; ++k) {
+                const sweep_state_t *st = &sx->states[k];
+                // candidate j is in alert whenever more than j candidates are: suffix sums
+                alerting[n] = 0;
+                alert_ms[n] = 0;
+                for (int p = n; p > 0; --p) {
+                    alerting[p - 1] = alerting[p] + st->alerting[p];
+                    alert_ms[p - 1] = alert_ms[p] + st->alert_ms[p];
+                }
+                int64_t episodes = 0;
+                for (int j = 0; j < n; ++j) {
+                    episodes += st->entered[j];
+                    fprintf(out, "%s,%d,%.10g,%.10g,%lu,%llu,%lld,%lld\n", sw->cfg->sensors[i].name,
+                            sx->sc.window, ss->hysteresis[k], ss->thresholds[j], ss->samples,
+                            (unsigned long long)alerting[j], (long long)episodes, (long long)alert_ms[j]);
+                }
+            }
+        }
+        free(alerting);
+        free(alert_ms);
+    }
+    return !ferror(out);
+}
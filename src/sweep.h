@@ -0,0 +1,43 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+#include <stdbool.h>
+#include <stdio.h>
+#include "config.h"
+
+// Threshold sweep (--backtest --sweep FILE): evaluates a grid of candidate
+// rules per sensor in the same pass. The sweep file has one line per sensor:
+//
+//     TEMP thresholds=20:30:0.5 windows=5,10,20 hysteresis=0,0.5
+//
+// Each value is a comma list or start:stop:step (stop included). Missing
+// keys default to the sensor's threshold and window and to no hysteresis.
+// The sensor's rule and encoding come from --sensors as usual.
+//
+// With hysteresis h a candidate enters alert when the metric exceeds its
+// threshold and leaves once the metric drops to threshold - h or below.
+// Per candidate the sweep reports the alerting samples, the number of
+// episodes and the time spent in alert (from the first alerting sample to
+// the first sample that is not). With h = 0 and the sensor's own window
+// and threshold, the alerting samples are exactly the alerts the hub logs.
+//
+// Every window size keeps one window (src/window.h), shared by all its
+// thresholds and hysteresis values. The candidates in alert always form a
+// prefix of the sorted thresholds, so a sample costs two binary searches
+// per hysteresis value; per-candidate totals are histograms over the
+// prefix length, summed once at the end.
+typedef struct sweep sweep_t;
+
+// NULL (with a message) if the file is invalid
+sweep_t *sweep_load(const hub_config_t *cfg, const char *path);
+void sweep_free(sweep_t *sw);
+
+bool sweep_has(const sweep_t *sw, int sensor);
+
+// one sample of a swept sensor, packed in its encoding. Sensors are
+// independent: different threads may push different sensors.
+void sweep_push(sweep_t *sw, int sensor, const void *payload, long ms_timestamp);
+
+// CSV: sensor,window,hysteresis,threshold,samples,alert_samples,episodes,alert_ms
+bool sweep_write_csv(const sweep_t *sw, FILE *out);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef VEC_H
+#define VEC_H
+#include <math.h>
+#include <stdint.h>
+#include "config.h"
+
+// All channels of one sample in a single SIMD value (GCC vector extension;
+// one AVX register, or two SSE2/NEON registers). Unused lanes stay 0 so
+// window sums and magnitudes can run over all lanes unconditionally.
+// Alignment is lowered to that of double so the type can live in plain
+// malloc'ed arrays and queue slots. Helpers take pointers: passing the
+// type by value would depend on whether AVX is enabled (-Wpsabi).
+typedef double hub_vec_t __attribute__((vector_size(HUB_MAX_CHANNELS * sizeof(double)), aligned(sizeof(double))));
+
+// integer lanes for windows of integer-encoded sensors (exact sums)
+typedef int64_t hub_ivec_t __attribute__((vector_size(HUB_MAX_CHANNELS * sizeof(int64_t)), aligned(sizeof(int64_t))));
+
+static inline void ivec_load(hub_ivec_t *r, const int64_t *v, int n) {
+    *r = (hub_ivec_t){ 0 };
+    for (int c = 0; c < n && c < HUB_MAX_CHANNELS; ++c) (*r)[c] = v[c];
+}
+
+static inline void vec_load(hub_vec_t *r, const double *v, int n) {
+    *r = (hub_vec_t){ 0 };
+    for (int c = 0; c < n && c < HUB_MAX_CHANNELS; ++c) (*r)[c] = v[c];
+}
+
+// Euclidean norm over all lanes
+static inline double vec_norm(const hub_vec_t *v) {
+    hub_vec_t sq = *v * *v;
+    double s = 0;
+    for (int c = 0; c < HUB_MAX_CHANNELS; ++c) s += sq[c];
+    return sqrt(s);
+}
+
+// largest of the first n lanes
+static inline double vec_max(const hub_vec_t *v, int n) {
+    double m = (*v)[0];
+    for (int c = 1; c < n; ++c) m = (*v)[c] > m ? (*v)[c] : m;
+    return m;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "window.h"
+#include "encoding.h"
+#include <stdlib.h>
+
+bool window_init(window_t *w, const sensor_config_t *sc) {
+    *w = (window_t){ 0 };
+    if (encoding_is_integer(sc->encoding)) {
+        w->raw = calloc((size_t)sc->window, sizeof(hub_ivec_t));
+        if (!w->raw) return false;
+    } else {
+        w->values = calloc((size_t)sc->window, sizeof(hub_vec_t));
+        if (!w->values) return false;
+    }
+    if (sc->alert == ALERT_MAGNITUDE) {
+        w->mags = calloc((size_t)sc->window, sizeof(double));
+        if (!w->mags) return false;
+    }
+    if (sc->alert == ALERT_MEDIAN || sc->alert == ALERT_MAD) {
+        w->median = malloc(sizeof(median_window_t));
+        if (!w->median) return false;
+        if (!median_window_init(w->median, sc->window)) {
+            free(w->median);
+            w->median = NULL;
+            return false;
+        }
+    }
+    return true;
+}
+
+void window_free(window_t *w) {
+    free(w->values);
+    free(w->raw);
+    free(w->mags);
+    if (w->median) median_window_free(w->median);
+    free(w->median);
+    *w = (window_t){ 0 };
+}
+
+void window_push(window_t *w, const sensor_config_t *sc, const void *payload, const hub_vec_t *value) {
+    int size = sc->window;
+    if (w->count < size) {
+        // just add if window is not full yet
+        w->count++;
+    } else {
+        // window is full: subtract oldest
+        if (w->raw) w->isum -= w->raw[w->idx];
+        else w->sum -= w->values[w->idx];
+        if (w->mags) w->mag_sum -= w->mags[w->idx];
+    }
+    if (w->raw) {
+        int64_t r[HUB_MAX_CHANNELS];
+        encoding_unpack_raw(sc, payload, r);
+        ivec_load(&w->raw[w->idx], r, sc->channels);
+        w->isum += w->raw[w->idx];
+    } else {
+        w->values[w->idx] = *value;
+        w->sum += *value;
+    }
+    if (w->mags) {
+        double m = vec_norm(value);
+        w->mags[w->idx] = m;
+        w->mag_sum += m;
+    }
+    if (w->median) median_window_push(w->median, sc->channels > 1 ? vec_norm(value) : (*value)[0]);
+    w->idx = (w->idx + 1) % size;
+}
+
+void window_slot(const window_t *w, const sensor_config_t *sc, int k, double *out) {
+    for (int c = 0; c < sc->channels; ++c) {
+        out[c] = w->raw ? (double)w->raw[k][c] * sc->scale + sc->offset : w->values[k][c];
+    }
+}
+
+double window_metric(const window_t *w, const sensor_config_t *sc) {
+    if (sc->alert == ALERT_MAGNITUDE) return w->mag_sum / w->count;
+    if (sc->alert == ALERT_MEDIAN) return median_window_median(w->median);
+    if (sc->alert == ALERT_MAD) return median_window_mad(w->median);
+    hub_vec_t mean;
+    if (w->raw) {
+        mean = __builtin_convertvector(w->isum, hub_vec_t) * (sc->scale / w->count) + sc->offset;
+    } else {
+        mean = w->sum / (double)w->count;
+    }
+    return vec_max(&mean, sc->channels);
+}
+
+bool window_update(window_t *w, const sensor_config_t *sc, const void *payload, hub_vec_t *value, double *metric) {
+    double phys[HUB_MAX_CHANNELS];
+    encoding_unpack(sc, payload, phys);
+    vec_load(value, phys, sc->channels);
+    window_push(w, sc, payload, value);
+    *metric = window_metric(w, sc);
+    return w->count == sc->window && *metric > sc->threshold;
+}
@@ -0,0 +1,43 @@
+#ifndef WINDOW_H
+#define WINDOW_H
+#include <stdbool.h>
+#include "config.h"
+#include "median.h"
+#include "vec.h"
+
+// moving-average window of one sensor; only touched by the shard that owns the sensor.
+// Sums run over all channels at once: in raw integers for integer encodings
+// (exact, no drift), in doubles otherwise. mags is only kept for magnitude
+// alerts, median for median/MAD alerts.
+// Shared by hub.c, the backtest engine and the generated processors
+// (spec.h), which must keep the same state so checkpoints work in all modes.
+typedef struct {
+    hub_vec_t *values;   // float encodings
+    hub_ivec_t *raw;     // integer encodings
+    double *mags;
+    median_window_t *median;
+    int count;
+    int idx;
+    hub_vec_t sum;
+    hub_ivec_t isum;
+    double mag_sum;
+} window_t;
+
+// allocate the rings sc needs (window_free() also cleans up a failed init)
+bool window_init(window_t *w, const sensor_config_t *sc);
+void window_free(window_t *w);
+
+// add one sample (packed payload, and its decoded value) to the window
+void window_push(window_t *w, const sensor_config_t *sc, const void *payload, const hub_vec_t *value);
+
+// decoded value of window slot k
+void window_slot(const window_t *w, const sensor_config_t *sc, int k, double *out);
+
+// value the alert rule compares with the threshold
+double window_metric(const window_t *w, const sensor_config_t *sc);
+
+// the runtime processor's rule for one sample: decode the payload into
+// value, push it and compute the metric; true if the sample raises an alert
+bool window_update(window_t *w, const sensor_config_t *sc, const void *payload, hub_vec_t *value, double *metric);
+
+#endif
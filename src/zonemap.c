@@ -0,0 +1,238 @@
+#define _POSIX_C_SOURCE 200809L
+#include "zonemap.h"
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// aggregates of the open block, open addressing keyed by (type, kind)
+struct zonemap_writer {
+    FILE *f;
+    size_t block_bytes;
+    bool text;
+    bool started;
+    zonemap_block_t block;
+    zonemap_entry_t *slots;  // count == 0 = empty
+    size_t size, used;
+};
+
+static uint32_t hash_key(const char *type, int kind) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < 16 && type[i]; ++i) {
+        h ^= (unsigned char)type[i];
+        h *= 16777619u;
+    }
+    return (h ^ (uint32_t)kind) * 16777619u;
+}
+
+static bool same_key(const zonemap_entry_t *e, const char *type, int kind) {
+    return e->kind == kind && strncmp(e->type, type, sizeof(e->type)) == 0;
+}
+
+static int entry_cmp(const void *a, const void *b) {
+    const zonemap_entry_t *x = a, *y = b;
+    int c = strncmp(x->type, y->type, sizeof(x->type));
+    return c ? c : (int)x->kind - (int)y->kind;
+}
+
+static zonemap_entry_t *writer_lookup(zonemap_writer_t *zw, const char *type, int kind) {
+    if ((zw->used + 1) * 2 > zw->size) {
+        size_t size = zw->size ? zw->size * 2 : 64;
+        zonemap_entry_t *slots = calloc(size, sizeof(*slots));
+        if (!slots) return NULL;
+        for (size_t i = 0; i < zw->size; ++i) {
+            if (!zw->slots[i].count) continue;
+            size_t h = hash_key(zw->slots[i].type, zw->slots[i].kind) & (size - 1);
+            while (slots[h].count) h = (h + 1) & (size - 1);
+            slots[h] = zw->slots[i];
+        }
+        free(zw->slots);
+        zw->slots = slots;
+        zw->size = size;
+    }
+    size_t h = hash_key(type, kind) & (zw->size - 1);
+    while (zw->slots[h].count) {
+        if (same_key(&zw->slots[h], type, kind)) return &zw->slots[h];
+        h = (h + 1) & (zw->size - 1);
+    }
+    zonemap_entry_t *e = &zw->slots[h];
+    strncpy(e->type, type, sizeof(e->type) - 1);
+    e->kind = (uint8_t)kind;
+    e->min_ms = INT64_MAX;
+    e->max_ms = INT64_MIN;
+    e->min = INFINITY;
+    e->max = -INFINITY;
+    zw->used++;
+    return e;
+}
+
+zonemap_writer_t *zonemap_open(const char *log_path, size_t block_bytes, bool text) {
+    char path[HUB_PATH_LEN + 8];
+    snprintf(path, sizeof(path), "%s.zmap", log_path);
+    zonemap_writer_t *zw = calloc(1, sizeof(*zw));
+    if (!zw) return NULL;
+    zw->f = fopen(path, "ab");
+    if (!zw->f) {
+        free(zw);
+        return NULL;
+    }
+    zw->block_bytes = block_bytes ? block_bytes : 1;
+    zw->text = text;
+    fseek(zw->f, 0, SEEK_END);
+    if (ftell(zw->f) == 0) {
+        zonemap_header_t hdr = { ZONEMAP_MAGIC, ZONEMAP_VERSION, (uint32_t)block_bytes, 0 };
+        fwrite(&hdr, sizeof(hdr), 1, zw->f);
+        fflush(zw->f);
+    }
+    return zw;
+}
+
+void zonemap_start(zonemap_writer_t *zw, uint64_t offset) {
+    memset(&zw->block, 0, sizeof(zw->block));
+    zw->block.magic = ZONEMAP_MAGIC;
+    zw->block.offset = offset;
+    zw->started = true;
+}
+
+// append the open block and start the next one where it ends
+static void write_block(zonemap_writer_t *zw) {
+    if (zw->block.length == 0) return;
+    // compact the occupied slots and sort them for zonemap_find()
+    size_t n = 0;
+    for (size_t i = 0; i < zw->size; ++i) {
+        if (zw->slots[i].count) zw->slots[n++] = zw->slots[i];
+    }
+    qsort(zw->slots, n, sizeof(*zw->slots), entry_cmp);
+    zw->block.entries = (uint32_t)n;
+    fwrite(&zw->block, sizeof(zw->block), 1, zw->f);
+    fwrite(zw->slots, sizeof(*zw->slots), n, zw->f);
+    fflush(zw->f);
+
+    memset(zw->slots, 0, sizeof(*zw->slots) * zw->size);
+    zw->used = 0;
+    zw->block.offset += zw->block.length;
+    zw->block.length = 0;
+    zw->block.records = 0;
+}
+
+void zonemap_add(zonemap_writer_t *zw, const char *type, int kind, double value, int64_t ms_timestamp, size_t bytes) {
+    zonemap_entry_t *e = writer_lookup(zw, type, kind);
+    if (e) {
+        e->count++;
+        if (ms_timestamp < e->min_ms) e->min_ms = ms_timestamp;
+        if (ms_timestamp > e->max_ms) e->max_ms = ms_timestamp;
+        if (!isnan(value)) {
+            // text logs print 3 decimals (per channel, so up to 0.001 off a magnitude)
+            double margin = zw->text ? 0.001 + fabs(value) * 1e-15 : 0;
+            if (value - margin < e->min) e->min = value - margin;
+            if (value + margin > e->max) e->max = value + margin;
+        }
+    }
+    zw->block.length += bytes;
+    zw->block.records++;
+    if (zw->block.length >= zw->block_bytes) write_block(zw);
+}
+
+void zonemap_flush(zonemap_writer_t *zw) {
+    if (zw->started) write_block(zw);
+    zw->started = false;
+}
+
+void zonemap_close(zonemap_writer_t *zw) {
+    if (!zw) return;
+    zonemap_flush(zw);
+    fclose(zw->f);
+    free(zw->slots);
+    free(zw);
+}
+
+static int view_cmp(const void *a, const void *b) {
+    const zonemap_view_t *x = a, *y = b;
+    return x->hdr.offset < y->hdr.offset ? -1 : x->hdr.offset > y->hdr.offset;
+}
+
+zonemap_t *zonemap_load(const char *log_path) {
+    char path[HUB_PATH_LEN + 8];
+    snprintf(path, sizeof(path), "%s.zmap", log_path);
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    zonemap_t *zm = calloc(1, sizeof(*zm));
+    zonemap_header_t hdr;
+    if (!zm || fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != ZONEMAP_MAGIC || hdr.version != ZONEMAP_VERSION) {
+        fclose(f);
+        free(zm);
+        return NULL;
+    }
+    // read block headers and entries; entry pointers are fixed up once all are in
+    size_t cap_blocks = 0, cap_entries = 0, num_entries = 0;
+    zonemap_block_t b;
+    while (fread(&b, sizeof(b), 1, f) == 1 && b.magic == ZONEMAP_MAGIC) {
+        if (num_entries + b.entries > cap_entries) {
+            size_t cap = cap_entries ? cap_entries * 2 : 1024;
+            while (cap < num_entries + b.entries) cap *= 2;
+            zonemap_entry_t *e = realloc(zm->entries, cap * sizeof(*e));
+            if (!e) break;
+            zm->entries = e;
+            cap_entries = cap;
+        }
+        if (zm->num_blocks == cap_blocks) {
+            size_t cap = cap_blocks ? cap_blocks * 2 : 256;
+            zonemap_view_t *v = realloc(zm->blocks, cap * sizeof(*v));
+            if (!v) break;
+            zm->blocks = v;
+            cap_blocks = cap;
+        }
+        if (fread(zm->entries + num_entries, sizeof(zonemap_entry_t), b.entries, f) != b.entries) break;
+        zm->blocks[zm->num_blocks].hdr = b;
+        zm->blocks[zm->num_blocks].entries = (const zonemap_entry_t*)(uintptr_t)num_entries;
+        zm->num_blocks++;
+        num_entries += b.entries;
+    }
+    fclose(f);
+    for (size_t i = 0; i < zm->num_blocks; ++i) {
+        zm->blocks[i].entries = zm->entries + (uintptr_t)zm->blocks[i].entries;
+    }
+    qsort(zm->blocks, zm->num_blocks, sizeof(*zm->blocks), view_cmp);
+    // indexed prefix: blocks must tile the log from offset 0
+    uint64_t end = 0;
+    for (size_t i = 0; i < zm->num_blocks && zm->blocks[i].hdr.offset == end; ++i) {
+        end += zm->blocks[i].hdr.length;
+    }
+    zm->indexed_end = end;
+    return zm;
+}
+
+void zonemap_free(zonemap_t *zm) {
+    if (!zm) return;
+    free(zm->blocks);
+    free(zm->entries);
+    free(zm);
+}
+
+const zonemap_entry_t *zonemap_find(const zonemap_view_t *b, const char *type, int kind) {
+    zonemap_entry_t key;
+    memset(&key, 0, sizeof(key));
+    strncpy(key.type, type, sizeof(key.type) - 1);
+    key.kind = (uint8_t)kind;
+    return bsearch(&key, b->entries, b->hdr.entries, sizeof(key), entry_cmp);
+}
+
+static bool entry_may_match(const zonemap_entry_t *e, int64_t t0, int64_t t1, double v0, double v1) {
+    return e->max_ms >= t0 && e->min_ms <= t1 && e->max >= v0 && e->min <= v1;
+}
+
+bool zonemap_may_match(const zonemap_view_t *b, const char *type, int kind,
+                       int64_t t0, int64_t t1, double v0, double v1) {
+    if (type && kind) {
+        const zonemap_entry_t *e = zonemap_find(b, type, kind);
+        return e && entry_may_match(e, t0, t1, v0, v1);
+    }
+    for (uint32_t i = 0; i < b->hdr.entries; ++i) {
+        const zonemap_entry_t *e = &b->entries[i];
+        if (type && strncmp(e->type, type, sizeof(e->type)) != 0) continue;
+        if (kind && e->kind != kind) continue;
+        if (entry_may_match(e, t0, t1, v0, v1)) return true;
+    }
+    return false;
+}
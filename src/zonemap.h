@@ -0,0 +1,89 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Zone maps (--zone-map): a sidecar "<log>.zmap" that splits the log into
+// blocks of about --zone-block bytes and stores, per block, the count and
+// the value and time bounds of each (sensor, record kind) in it. A query
+// skips every block whose bounds cannot match its predicates. Blocks are
+// byte ranges, so text and binary logs are both covered; for text logs the
+// value bounds are widened by the rounding of the printed values.
+//
+// A block is appended (and flushed) once it is full, and the open block is
+// closed early when the hub stops or drains, so blocks can be shorter. Log
+// data after the last block is not indexed yet and must be scanned. Several
+// writers may append to one map in turn (handover); blocks are sorted by
+// offset on load.
+
+#define ZONEMAP_MAGIC 0x4d5a5348u   /* "HSZM" little-endian */
+#define ZONEMAP_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_bytes;    // target block size of the first writer
+    uint32_t reserved;
+} zonemap_header_t;
+
+// block header, followed by `entries` zonemap_entry_t sorted by (type, kind)
+typedef struct {
+    uint32_t magic;
+    uint32_t entries;
+    uint64_t offset;         // byte range [offset, offset + length) of the log
+    uint64_t length;
+    uint64_t records;        // log records in the range (sample + values = 1)
+} zonemap_block_t;
+
+typedef struct {
+    char type[16];
+    uint8_t kind;            // enum record_kind
+    uint8_t reserved[3];
+    uint32_t count;
+    int64_t min_ms, max_ms;
+    double min, max;         // record values (magnitude for vectors)
+} zonemap_entry_t;
+
+_Static_assert(sizeof(zonemap_block_t) == 32, "zonemap_block_t layout changed");
+_Static_assert(sizeof(zonemap_entry_t) == 56, "zonemap_entry_t layout changed");
+
+// writer (the hub, under its log lock)
+typedef struct zonemap_writer zonemap_writer_t;
+
+// append to (or create) the map of log_path; text = values are printed rounded
+zonemap_writer_t *zonemap_open(const char *log_path, size_t block_bytes, bool text);
+// the log offset of the next record; before the first zonemap_add() and after zonemap_flush()
+void zonemap_start(zonemap_writer_t *zw, uint64_t offset);
+// one record of `bytes` bytes was written to the log
+void zonemap_add(zonemap_writer_t *zw, const char *type, int kind, double value, int64_t ms_timestamp, size_t bytes);
+// close the open block, if any
+void zonemap_flush(zonemap_writer_t *zw);
+void zonemap_close(zonemap_writer_t *zw);
+
+// reader
+typedef struct {
+    zonemap_block_t hdr;
+    const zonemap_entry_t *entries;
+} zonemap_view_t;
+
+typedef struct {
+    zonemap_view_t *blocks;  // sorted by offset
+    size_t num_blocks;
+    zonemap_entry_t *entries;
+    uint64_t indexed_end;    // log bytes covered by blocks
+} zonemap_t;
+
+// NULL if the map does not exist or is damaged; a torn last block is dropped
+zonemap_t *zonemap_load(const char *log_path);
+void zonemap_free(zonemap_t *zm);
+
+// entry of (type, kind) in a block, NULL if the block has no such records
+const zonemap_entry_t *zonemap_find(const zonemap_view_t *b, const char *type, int kind);
+
+// false if block b has no record of type (NULL = any) and kind (0 = any)
+// with a timestamp in [t0, t1] and a value in [v0, v1]
+bool zonemap_may_match(const zonemap_view_t *b, const char *type, int kind,
+                       int64_t t0, int64_t t1, double v0, double v1);
+
+#endif
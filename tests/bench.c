@@ -0,0 +1,201 @@
+// benchmark suite: pushes a fixed number of samples through the hub and
+// prints one JSON object per scenario (end-to-end throughput and latency
+// percentiles of accepted hub_submit calls). tools/bench_gate.py
+// runs it repeatedly and compares against a stored baseline.
+//
+// usage: bench [scale] [logpath]    (scale multiplies the sample counts)
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/hub.h"
+#ifdef HUB_SPEC
+#include "../src/spec.h"
+#endif
+
+typedef struct {
+    const char *name;
+    int producers;
+    long samples; // per producer
+    int hubs;     // producers are spread over this many independent hubs
+    int channels; // >1: submit vector samples to a multi-channel sensor
+    bool spec;    // generated processor (make spec); the sensors must match its schema
+    int median;   // >0: submit to a sensor with a MAD alert over this many samples
+    int spectrum; // 1/2: submit to VIB, a block FFT / sliding DFT source with 2 bands
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "single_producer", 1, 100000, 1, 1, false, 0, 0 },
+    { "four_producers",  4,  25000, 1, 1, false, 0, 0 },
+    { "sixteen_producers", 16, 6250, 1, 1, false, 0, 0 },
+    { "four_hubs",       4,  25000, 4, 1, false, 0, 0 },
+    { "vector_producer", 1, 100000, 1, 3, false, 0, 0 },
+    { "median_4096",     1, 100000, 1, 1, false, 4096, 0 },
+    { "spectrum_block",  1, 100000, 1, 1, false, 0, 1 },
+    { "spectrum_sliding", 1, 100000, 1, 1, false, 0, 2 },
+#ifdef HUB_SPEC
+    // the same loads through the processor generated from config/sensors.conf
+    { "single_producer_spec", 1, 100000, 1, 1, true, 0, 0 },
+    { "four_producers_spec",  4,  25000, 1, 1, true, 0, 0 },
+    { "sixteen_producers_spec", 16, 6250, 1, 1, true, 0, 0 },
+    { "four_hubs_spec",       4,  25000, 4, 1, true, 0, 0 },
+#endif
+};
+
+#define MAX_HUBS 4
+
+typedef struct {
+    pthread_t tid;
+    hub_t *hub;
+    int channels;
+    bool median;
+    bool spectrum;
+    long samples;
+    long retries;
+    long *lat_ns;
+} producer_t;
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void *producer_main(void *arg) {
+    producer_t *p = (producer_t*)arg;
+    static const char *types[] = { "TEMP", "HUM", "PRESS" };
+    for (long i = 0; i < p->samples; ++i) {
+        // lossless: back off and retry while the queue is full, so every
+        // sample is processed and only accepted submissions are timed
+        for (;;) {
+            long t0 = now_ns();
+            bool ok;
+            if (p->spectrum) {
+                // 50 Hz sawtooth at a nominal 1 kHz
+                ok = hub_submit(p->hub, "VIB", (double)(i % 20), i);
+            } else if (p->median) {
+                ok = hub_submit(p->hub, "MED", 20.0 + (i * 7919 % 101) * 0.1, i);
+            } else if (p->channels > 1) {
+                double v[3] = { i % 17, i % 5, 9.81 };
+                ok = hub_submit_vector(p->hub, "ACC", v, p->channels, i);
+            } else {
+                ok = hub_submit(p->hub, types[i % 3], 20.0 + (i % 17), i);
+            }
+            p->lat_ns[i] = now_ns() - t0;
+            if (ok) break;
+            p->retries++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long*)a, y = *(const long*)b;
+    return (x > y) - (x < y);
+}
+
+static void run_scenario(const scenario_t *sc, double scale, const char *logpath) {
+    long per = (long)(sc->samples * scale);
+    if (per < 1) per = 1;
+    long total = per * sc->producers;
+    long *lat = malloc(sizeof(long) * (size_t)total);
+    producer_t *prods = calloc((size_t)sc->producers, sizeof(*prods));
+
+    static hub_config_t cfg[MAX_HUBS];
+    hub_t *hubs[MAX_HUBS];
+    hub_stats_t before[MAX_HUBS];
+    int nhubs = sc->hubs;
+    for (int k = 0; k < nhubs; ++k) {
+        config_defaults(&cfg[k]);
+        snprintf(cfg[k].log_path, sizeof(cfg[k].log_path), "%s.%d", logpath, k);
+        if (sc->channels > 1) {
+            sensor_config_t acc = { "ACC", 10, 0, 10, 8, 12.0, sc->channels, ALERT_MAGNITUDE, ENC_F64, 1.0, 0.0, { 0 } };
+            config_add_sensor(&cfg[k], &acc);
+        }
+        if (sc->median > 0) {
+            sensor_config_t med = { "MED", 10, 0, 10, sc->median, 5.0, 1, ALERT_MAD, ENC_F64, 1.0, 0.0, { 0 } };
+            config_add_sensor(&cfg[k], &med);
+        }
+        if (sc->spectrum > 0) {
+            sensor_config_t vib = { "VIB", 1, 0, 20, 8, 100.0, 1, ALERT_MEAN, ENC_F64, 1.0, 0.0,
+                                    { 1024, 256, sc->spectrum == 2, 1000.0, "", 0, 0 } };
+            sensor_config_t lo = { "VIB_50", 0, 0, 1, 4, 1e9, 1, ALERT_MEAN, ENC_F64, 1.0, 0.0,
+                                   { 0, 0, false, 0, "VIB", 40, 60 } };
+            sensor_config_t hi = { "VIB_HI", 0, 0, 1, 4, 1e9, 1, ALERT_MEAN, ENC_F64, 1.0, 0.0,
+                                   { 0, 0, false, 0, "VIB", 120, 500 } };
+            config_add_sensor(&cfg[k], &vib);
+            config_add_sensor(&cfg[k], &lo);
+            config_add_sensor(&cfg[k], &hi);
+        }
+#ifdef HUB_SPEC
+        hubs[k] = sc->spec ? hub_create_spec(&cfg[k], &hub_generated_spec) : hub_create(&cfg[k]);
+#else
+        hubs[k] = hub_create(&cfg[k]);
+#endif
+        if (!hubs[k]) {
+            fprintf(stderr, "hub_create failed\n");
+            exit(1);
+        }
+        hub_get_stats(hubs[k], &before[k]);
+        hub_start(hubs[k]);
+    }
+
+    long t0 = now_ns();
+    for (int i = 0; i < sc->producers; ++i) {
+        prods[i].hub = hubs[i % nhubs];
+        prods[i].channels = sc->channels;
+        prods[i].median = sc->median > 0;
+        prods[i].spectrum = sc->spectrum > 0;
+        prods[i].samples = per;
+        prods[i].lat_ns = lat + per * i;
+        pthread_create(&prods[i].tid, NULL, producer_main, &prods[i]);
+    }
+    for (int i = 0; i < sc->producers; ++i) pthread_join(prods[i].tid, NULL);
+
+    // wait for the processors to drain the queues
+    unsigned long processed = 0;
+    for (int k = 0; k < nhubs; ++k) {
+        hub_stats_t st;
+        for (;;) {
+            hub_get_stats(hubs[k], &st);
+            if (st.pending == 0) break;
+            nanosleep(&(struct timespec){ 0, 100000 }, NULL);
+        }
+        processed += st.processed - before[k].processed;
+    }
+    long elapsed = now_ns() - t0;
+    for (int k = 0; k < nhubs; ++k) {
+        hub_destroy(hubs[k]);
+        unlink(cfg[k].log_path);
+        config_free(&cfg[k]);
+    }
+
+    long retries = 0;
+    for (int i = 0; i < sc->producers; ++i) retries += prods[i].retries;
+    qsort(lat, (size_t)total, sizeof(long), cmp_long);
+    printf("{\"bench\": \"%s\", \"producers\": %d, \"samples\": %ld, "
+           "\"throughput\": %.1f, \"p50_ns\": %ld, \"p99_ns\": %ld, \"full_retries\": %ld}\n",
+           sc->name, sc->producers, total,
+           processed / (elapsed / 1e9),
+           lat[total / 2], lat[(long)(total * 0.99)], retries);
+    fflush(stdout);
+
+    free(prods);
+    free(lat);
+}
+
+int main(int argc, char **argv) {
+    double scale = argc > 1 ? atof(argv[1]) : 1.0;
+    const char *logpath = argc > 2 ? argv[2] : "/tmp/sensorhub-bench.log";
+    if (scale <= 0) scale = 1.0;
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+        run_scenario(&scenarios[i], scale, logpath);
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_aggregate_test.sh [duration_seconds]
+# runs two hubs side by side (one text log, one binary log), merges them with
+# --aggregate and checks that the merged stream is complete and time-ordered
+
+set -e
+
+DUR=${1:-3}
+DIR="data/aggtest"
+
+echo "TEST: running two sensorhubs for ${DUR}s and merging their logs"
+rm -rf "${DIR}"
+./sensorhub --test-duration "${DUR}" --log "${DIR}/hub1.log" > /dev/null &
+./sensorhub --test-duration "${DUR}" --log "${DIR}/hub2.log" --log-format binary > /dev/null
+wait
+
+./sensorhub --aggregate --aggregate-out "${DIR}/merged.log" "${DIR}/hub1.log" "${DIR}/hub2.log"
+
+set +e
+python3 - "${DIR}/hub1.log" "${DIR}/hub2.log" "${DIR}/merged.log" <<'PY'
+import os, sys
+hub1 = [l for l in open(sys.argv[1]) if l.startswith(("SAMPLE|", "ALERT|"))]
+hub2 = os.path.getsize(sys.argv[2]) // 40   # fixed-size binary records
+merged = [l.rstrip("\n").split("|") for l in open(sys.argv[3])]
+ts = [int(p[3]) for p in merged]
+ok = True
+if ts != sorted(ts):
+    print("ERROR: merged stream is not ordered by timestamp", file=sys.stderr)
+    ok = False
+if len(merged) != len(hub1) + hub2:
+    print(f"ERROR: merged {len(merged)} records, inputs have {len(hub1)} + {hub2}", file=sys.stderr)
+    ok = False
+print(f"merged records: {len(merged)} (hub1: {len(hub1)}, hub2: {hub2})")
+sys.exit(0 if ok else 1)
+PY
+RC=$?
+
+if [ $RC -eq 0 ]; then
+  echo "TEST: SUCCESS"
+else
+  echo "TEST: FAILURE (exit code $RC)"
+fi
+
+exit $RC
@@ -0,0 +1,108 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_alert_test.sh
+# delivers alerts to the stub webhook receiver (tools/alert_stub.py) and to a
+# command, both failing some deliveries, and checks that each received every
+# logged alert once, in log order, in batches, as valid JSON even for a
+# sensor name with a quote and a backslash. A receiver that answers slowly
+# must not slow the processors or the command's deliveries.
+
+set -e
+
+DIR="data/alerttest"
+rm -rf "${DIR}"
+mkdir -p "${DIR}"
+# ~30 alerts per second; the second name needs escaping in JSON
+printf 'A interval=20 base=10 span=50 window=2 threshold=30\nQ"B\\S interval=50 base=10 span=50 window=2 threshold=40\n' \
+  > "${DIR}/alerts.conf"
+
+echo "TEST: alert delivery against the hub log"
+set +e
+python3 - "${DIR}" <<'PY'
+import json, os, struct, subprocess, sys, time
+d = sys.argv[1]
+ok = True
+def check(cond, msg):
+    global ok
+    if not cond:
+        print("ERROR:", msg, file=sys.stderr)
+        ok = False
+
+def stub(out, *extra):
+    p = subprocess.Popen([sys.executable, "tools/alert_stub.py", "--out", out, *extra],
+                         stdout=subprocess.PIPE, text=True)
+    return p, int(p.stdout.readline().split()[-1])
+
+def hub(name, dur, extra):
+    log = f"{d}/{name}.bin"
+    t0 = time.monotonic()
+    r = subprocess.run(["./sensorhub", "--test-duration", str(dur), "--sensors", f"{d}/alerts.conf", "--log", log,
+                        "--log-format", "binary", *extra], capture_output=True, text=True)
+    alerts, samples = [], 0
+    data = open(log, "rb").read()
+    for pos in range(0, len(data) - 39, 40):
+        _, kind, _, t, value, ts = struct.unpack_from("<IBB2x16sdq", data, pos)
+        if kind == 2:
+            alerts.append((t.rstrip(b"\0").decode(), value, ts))
+        samples += kind == 1
+    counts = {}
+    for line in r.stdout.splitlines():
+        if line.startswith("Alerts to "):
+            target, rest = line[len("Alerts to "):].rsplit(": ", 1)
+            counts[target] = [int(w) for w in rest.replace(",", "").split() if w.isdigit()]
+    return alerts, samples, counts, time.monotonic() - t0, r.stderr
+
+def batches(path, status=None):
+    rows = [json.loads(l) for l in open(path)] if os.path.exists(path) else []
+    return [r["alerts"] for r in rows if status is None or r["status"] == status]
+
+def flat(bs):
+    return [(a["sensor"], a["value"], a["ms_timestamp"]) for b in bs for a in b]
+
+# every 4th request and the first two fail, the command's first run fails
+out, cmd_out = f"{d}/hook.jsonl", f"{d}/cmd.jsonl"
+p, port = stub(out, "--fail-first", "2", "--fail-every", "4")
+url = f"http://127.0.0.1:{port}/alerts"
+cmd = f"[ -e {d}/ran ] || {{ touch {d}/ran; exit 1; }}; cat >> {cmd_out}; echo $SENSORHUB_ALERTS >> {d}/cmd.n"
+alerts, _, counts, _, _ = hub("retry", 4, ["--alert-webhook", url, "--alert-command", cmd,
+                                           "--alert-linger", "1000", "--alert-batch", "16", "--alert-backoff", "20"])
+p.terminate()
+check(len(alerts) > 100, f"only {len(alerts)} alerts logged")
+sent, failed = batches(out, 200), batches(out, 503)
+check(flat(sent) == alerts, f"webhook: {len(flat(sent))} alerts received, {len(alerts)} logged")
+check(flat(batches(cmd_out)) == alerts, f"command: {len(flat(batches(cmd_out)))} alerts received, {len(alerts)} logged")
+sizes = [len(b) for b in sent]
+check(max(sizes) == 16 and len(sent) < len(alerts) / 4, f"batch sizes {sizes}")
+check([int(n) for n in open(f"{d}/cmd.n")] == [len(b) for b in batches(cmd_out)], "command: SENSORHUB_ALERTS")
+check(counts.get(url) == [len(alerts), 0, len(failed)], f"webhook counts {counts.get(url)}, {len(failed)} retries")
+check(counts.get(cmd) == [len(alerts), 0, 1], f"command counts {counts.get(cmd)}")
+print(f"{len(alerts)} alerts in {len(sent)} webhook batches after {len(failed)} retries")
+
+# a receiver taking 1 s per batch: the command and the processors keep up,
+# and stopping waits for the webhook only as long as the flush allows
+out, cmd_out = f"{d}/slow.jsonl", f"{d}/slow_cmd.jsonl"
+p, port = stub(out, "--delay", "1")
+url = f"http://127.0.0.1:{port}/alerts"
+cmd = f"cat >> {cmd_out}"
+alerts, samples, counts, elapsed, _ = hub("slow", 4, ["--alert-webhook", url, "--alert-command", cmd,
+                                                        "--alert-batch", "8"])
+p.terminate()
+check(flat(batches(cmd_out)) == alerts, f"command: {len(flat(batches(cmd_out)))} alerts received, {len(alerts)} logged")
+got = flat(batches(out))
+delivered, lost, _ = counts.get(url, [0, 0, 0])
+check(0 < len(got) == delivered < len(alerts) and got == alerts[:delivered],
+      f"webhook: {len(got)} alerts received, {delivered} delivered of {len(alerts)}")
+check(delivered + lost == len(alerts), f"webhook: {delivered} delivered + {lost} failed != {len(alerts)}")
+check(samples >= 4 * (50 + 20) * 0.9, f"only {samples} samples logged")
+check(elapsed < 4 + 3 + 1 + 1.5, f"the hub took {elapsed:.1f} s to stop")
+print(f"slow receiver: {delivered} of {len(alerts)} alerts, {samples} samples, stopped after {elapsed:.1f} s")
+sys.exit(0 if ok else 1)
+PY
+RC=$?
+
+if [ $RC -eq 0 ]; then
+  echo "TEST: SUCCESS"
+else
+  echo "TEST: FAILURE (exit code $RC)"
+fi
+
+exit $RC
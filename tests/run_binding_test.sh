@@ -0,0 +1,115 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_binding_test.sh
+# drives a hub through libsensorhub.so from Python (tools/sensorhub.py) and
+# checks that the NumPy history and rollup views are live and zero-copy
+
+set -e
+
+make -s lib
+python3 -c "import numpy" 2>/dev/null || { echo "TEST: SKIPPED (numpy not installed)"; exit 0; }
+echo "TEST: history rings and rollups through the Python binding"
+
+set +e
+PYTHONPATH=tools python3 - <<'PY'
+import sys, time
+import numpy as np
+from sensorhub import Hub
+
+ok = True
+def check(cond, msg):
+    global ok
+    if not cond:
+        print("ERROR:", msg, file=sys.stderr)
+        ok = False
+
+with Hub(["--log", "data/bindingtest/hub.log", "--history", "64", "--rollup-slots", "8"]) as hub:
+    check(hub.sensors() == ["TEMP", "HUM", "PRESS"], f"sensors {hub.sensors()}")
+    ring = hub.history("TEMP")
+    minutes = hub.rollup("TEMP", 1)
+    check(len(ring) == 64 and len(minutes) == 8, "ring sizes")
+    check(not ring.flags.owndata and not minutes.flags.owndata, "views own their data")
+
+    hub.start()
+    # 100 samples 100 ms apart: 10 one-second buckets, 1 one-minute bucket
+    for i in range(100):
+        while not hub.submit("TEMP", float(i), 60000 + i * 100):
+            time.sleep(0.001)
+    hub.drain()
+
+    # the arrays taken before any data was written now show it
+    check(hub.written("TEMP") == 100, f"written {hub.written('TEMP')}")
+    recent = hub.latest("TEMP", 1000)
+    check(len(recent) == 64, f"latest returned {len(recent)}")
+    check(list(recent["value"]) == [float(i) for i in range(36, 100)], "ring contents")
+    check(ring[99 % 64]["value"] == 99.0, "live view not updated")
+    check(np.shares_memory(ring, hub.history("TEMP")), "history views do not share memory")
+
+    check(hub.opened("TEMP", 0) == 10, f"1s buckets {hub.opened('TEMP', 0)}")
+    secs = hub.buckets("TEMP", 0, 8)
+    check(list(secs["count"]) == [10] * 8, "1s bucket counts")
+    check(secs[-1]["min"] == 90.0 and secs[-1]["max"] == 99.0, "1s bucket min/max")
+    check(hub.opened("TEMP", 1) == 1 and minutes[0]["count"] == 100, "1min bucket")
+    check(minutes[0]["sum"] == sum(range(100)) and minutes[0]["start_ms"] == 60000, "1min sum/start")
+    check(hub.written("HUM") == 0, "HUM should be empty")
+    check(hub.channels("TEMP").shape == (64, 1) and hub.channels("TEMP")[99 % 64, 0] == 99.0, "channel view")
+    st = hub.stats()
+    check(st["processed"] == 100 and st["pending"] == 0, f"stats {st}")
+
+# vector sensor: history holds magnitudes, channels() the components
+with Hub(["--log", "data/bindingtest/vec.log", "--sensors", "config/vector.conf"]) as hub:
+    hub.start()
+    check(hub.submit_vector("ACC", [3.0, 4.0, 12.0], 1000), "submit_vector")
+    hub.drain()
+    check(hub.latest("ACC", 1)["value"][0] == 13.0, "vector magnitude in history")
+    check(list(hub.channels("ACC")[0]) == [3.0, 4.0, 12.0], "vector channels")
+
+# integer encoding: the raw view is int16 and shares hub memory
+with Hub(["--log", "data/bindingtest/enc.log", "--sensors", "config/encoded.conf"]) as hub:
+    hub.start()
+    check(hub.submit("TEMP", 23.46, 1000), "submit TEMP")
+    hub.drain()
+    raw = hub.raw("TEMP")
+    check(raw.dtype == np.int16 and not raw.flags.owndata, f"raw dtype {raw.dtype}")
+    check(raw[0, 0] == 235 and abs(hub.channels("TEMP")[0, 0] - 23.5) < 1e-9, f"raw {raw[0, 0]}")
+
+# frames: three grids (500/700/1200 ms) aligned onto 1 s, values linear in time
+samples = sorted([(10000 + 500 * k, "TEMP", 1) for k in range(60)] +
+                 [(10100 + 700 * k, "HUM", 2) for k in range(40)] +
+                 [(10200 + 1200 * k, "PRESS", 3) for k in range(25)])
+last = min(max(t for t, s, _ in samples if s == name) for name in ("TEMP", "HUM", "PRESS"))
+grid = np.arange(11000, last + 1, 1000)
+for mode in ("hold", "linear"):
+    with Hub(["--log", f"data/bindingtest/frames-{mode}.log", "--frames", "TEMP,HUM,PRESS",
+              "--frame-ms", "1000", "--frame-mode", mode, "--frame-len", "16"]) as hub:
+        check(hub.frame_sensors() == (["TEMP", "HUM", "PRESS"], 1000), f"frame sensors {hub.frame_sensors()}")
+        times, values = hub.frame_ring()
+        hub.start()
+        for t, name, k in samples:
+            while not hub.submit(name, k * t / 1000.0, t):
+                time.sleep(0.001)
+        hub.drain()
+        check(hub.frames_written() == len(grid), f"{mode}: {hub.frames_written()} frames, expected {len(grid)}")
+        ts, rows = hub.frames(1000)
+        check(len(ts) == 16 and list(ts) == list(grid[-16:]), f"{mode}: frame times {list(ts)}")
+        expected = []
+        for T in ts:
+            row = []
+            for name, k in (("TEMP", 1), ("HUM", 2), ("PRESS", 3)):
+                if mode == "linear":
+                    row.append(k * T / 1000.0)
+                else:
+                    row.append(k * max(t for t, s, _ in samples if s == name and t <= T) / 1000.0)
+            expected.append(row)
+        check(rows.shape == (16, 3) and np.allclose(rows, expected), f"{mode}: frame values {rows[:2]}")
+        check(values[1, (hub.frames_written() - 1) % 16] == rows[-1, 1], f"{mode}: live view")
+        check(not values.flags.owndata and np.shares_memory(times, hub.frame_ring()[0]), f"{mode}: views copy")
+
+try:
+    Hub(["--log", "data/bindingtest/frames-bad.log", "--frames", "TEMP,NOPE"]).close()
+    check(False, "unknown frame sensor accepted")
+except RuntimeError:
+    pass
+
+print("TEST: SUCCESS" if ok else "TEST: FAILURE")
+sys.exit(0 if ok else 1)
+PY
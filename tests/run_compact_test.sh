@@ -0,0 +1,142 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_compact_test.sh
+# records segmented text and binary logs, keeps a copy of the raw segments,
+# lets a second hub compact them and checks the manifest, that the raw files
+# are gone, and that hubq returns the same records and aggregates from the
+# compacted segments as a brute-force filter over the copies
+
+set -e
+
+DIR="data/compacttest"
+
+echo "TEST: compacted segments against the raw ones"
+rm -rf "${DIR}"
+for FMT in text binary; do
+  ./sensorhub --test-duration 1 --benchmark --sensors config/vector.conf --log "${DIR}/${FMT}/hub.log" \
+              --log-format "${FMT}" --log-segment-mb 1 --zone-map > /dev/null &
+done
+wait
+for FMT in text binary; do
+  mkdir -p "${DIR}/${FMT}.raw"
+  cp "${DIR}/${FMT}"/hub.log.[0-9][0-9][0-9][0-9][0-9][0-9] "${DIR}/${FMT}.raw/"
+  ./sensorhub --test-duration 2 --sensors config/vector.conf --log "${DIR}/${FMT}/hub.log" --log-format "${FMT}" \
+              --compact --compact-age 0 > "${DIR}/${FMT}.out" &
+done
+wait
+
+set +e
+python3 - "${DIR}" <<'PY'
+import glob, math, os, re, shutil, struct, subprocess, sys
+d = sys.argv[1]
+ok = True
+def check(cond, msg):
+    global ok
+    if not cond:
+        print("ERROR:", msg, file=sys.stderr)
+        ok = False
+
+def records(path):
+    out = []
+    data = open(path, "rb").read()
+    if data[:1] == b"H":
+        for pos in range(0, len(data) - 39, 40):
+            _, kind, ch, t, value, ts = struct.unpack_from("<IBB2x16sdq", data, pos)
+            if kind == 3:
+                continue
+            vals = [value] if ch <= 1 else list(struct.unpack_from("<4d", data, pos + 48)[:ch])
+            out.append((kind, t.rstrip(b"\0").decode(), value, ts, vals))
+    else:
+        for line in data.decode().splitlines():
+            p = line.split("|")
+            vals = [float(v) for v in p[2].split(",")]
+            value = math.sqrt(sum(v * v for v in vals)) if len(vals) > 1 else vals[0]
+            out.append((1 if p[0] == "SAMPLE" else 2, p[1], value, int(p[3]), vals))
+    return out
+
+def line(r):
+    kind, t, _, ts, vals = r
+    if kind == 2:
+        return f"ALERT|{t}|{vals[0]:.3f}|{ts}|THRESHOLD_EXCEEDED"
+    return f"SAMPLE|{t}|{','.join(f'{v:.3f}' for v in vals)}|{ts}"
+
+def hubq(*args):
+    p = subprocess.run(["./hubq", "--explain", *args], capture_output=True, text=True)
+    if p.returncode != 0:
+        raise SystemExit(f"hubq {' '.join(args)} failed: {p.stderr}")
+    return p.stdout.splitlines(), p.stderr
+
+for fmt in ("text", "binary"):
+    log = f"{d}/{fmt}/hub.log"
+    raw = sorted(glob.glob(f"{d}/{fmt}.raw/hub.log.[0-9]*"))
+    left = [p for p in os.listdir(f"{d}/{fmt}") if re.fullmatch(r"hub\.log\.\d{6}(\.zmap|\.bloom)?", p)]
+    check(not left, f"{fmt}: raw files left after compaction: {left[:3]}")
+    manifest = [l.split() for l in open(f"{log}.compact") if l.startswith("seg ")]
+    check(len(manifest) == len(raw) and len(raw) > 1, f"{fmt}: {len(manifest)} compacted of {len(raw)} segments")
+    recs, raw_bytes, col_bytes = [], 0, 0
+    for path, m in zip(raw, manifest):
+        r = records(path)
+        kv = dict(x.split("=") for x in m[2:])
+        ts = [x[3] for x in r]
+        check(m[1] == path[-6:] and int(kv["records"]) == len(r) and int(kv["min"]) == min(ts) and int(kv["max"]) == max(ts),
+              f"{fmt}: manifest line {' '.join(m)} does not describe {path}")
+        raw_bytes += os.path.getsize(path)
+        col_bytes += os.path.getsize(f"{log}.{m[1]}.col")
+        recs += r
+    recs += records(log)
+
+    def same(name, got, want):
+        check(sorted(got) == sorted(want), f"{fmt} {name}: {len(got)} lines, expected {len(want)}")
+
+    got, _ = hubq("--sensor", "PRESS", "--kind", "sample", "--min", "1015", log)
+    same("PRESS >= 1015", got, [line(r) for r in recs if r[1] == "PRESS" and r[0] == 1 and r[2] >= 1015])
+    ts = sorted(r[3] for r in recs)
+    t0, t1 = ts[len(ts) * 2 // 5], ts[len(ts) * 9 // 20]
+    got, err = hubq("--sensor", "ACC,TEMP", "--from", str(t0), "--to", str(t1), log)
+    same("ACC,TEMP in time range", got, [line(r) for r in recs if r[1] in ("ACC", "TEMP") and t0 <= r[3] <= t1])
+    m = re.search(r"scanned (\d+) of (\d+) bytes", err)
+    check(m and int(m.group(1)) * 3 < int(m.group(2)), f"{fmt}: time range query read too much: {err.strip()}")
+    got, _ = hubq("--kind", "alert", log)
+    same("alerts", got, [line(r) for r in recs if r[0] == 2])
+
+    got, _ = hubq("--bucket", "250", "--kind", "sample", log)
+    agg = {}
+    for kind, t, v, ts_, _ in recs:
+        if kind == 1:
+            a = agg.setdefault((ts_ // 250 * 250, t), [0, v, v, 0.0])
+            a[0] += 1; a[1] = min(a[1], v); a[2] = max(a[2], v); a[3] += v
+    rows = [l.split(",") for l in got[1:]]
+    check(len(rows) == len(agg), f"{fmt} buckets: {len(rows)}, expected {len(agg)}")
+    for b, t, c, lo, hi, avg in rows:
+        c_, lo_, hi_, s_ = agg.get((int(b), t), (0, 0, 0, 0))
+        if int(c) != c_ or lo != f"{lo_:.3f}" or hi != f"{hi_:.3f}" or abs(float(avg) - s_ / c_) > 0.0015:
+            check(False, f"{fmt} bucket {b},{t}: {c},{lo},{hi},{avg}")
+            break
+    print(f"{fmt}: {len(raw)} segments, {raw_bytes} -> {col_bytes} bytes ({raw_bytes / col_bytes:.1f}x); time range query: {err.strip()}")
+
+    if fmt == "binary":
+        # a raw segment the manifest already lists (compactor stopped before deleting it) is not read twice
+        shutil.copy(raw[0], f"{d}/{fmt}/")
+        again, _ = hubq("--kind", "alert", log)
+        check(sorted(again) == sorted(line(r) for r in recs if r[0] == 2),
+              "binary: a listed raw segment was read as well")
+sys.exit(0 if ok else 1)
+PY
+RC=$?
+
+if [ $RC -eq 0 ]; then
+  # the next compactor run deletes the leftover
+  ./sensorhub --test-duration 1 --sensors config/vector.conf --log "${DIR}/binary/hub.log" --log-format binary \
+              --compact --compact-age 0 > /dev/null
+  if ls "${DIR}/binary/" | grep -qE '^hub\.log\.[0-9]{6}$'; then
+    echo "ERROR: leftover raw segment was not deleted" >&2
+    RC=1
+  fi
+fi
+
+if [ $RC -eq 0 ]; then
+  echo "TEST: SUCCESS"
+else
+  echo "TEST: FAILURE (exit code $RC)"
+fi
+
+exit $RC
@@ -0,0 +1,172 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_egress_test.sh
+# subscribes to the egress stream over the Unix socket and loopback TCP
+# with sensor filters and credit, and checks every stream against the log:
+# records in log order, each gap announced by a REC_DROPPED record of its
+# size. A subscriber that reads slowly must lose records without costing
+# the others any.
+
+set -e
+
+DIR="data/egresstest"
+rm -rf "${DIR}"
+mkdir -p "${DIR}"
+# ~6000 records per second: more than the slow subscriber reads
+for S in A B C D E F; do
+  echo "${S} interval=1 base=10 span=50 window=4 threshold=50 channels=2"
+done > "${DIR}/fast.conf"
+
+echo "TEST: egress stream against the hub log"
+set +e
+python3 - "${DIR}" <<'PY'
+import os, socket, struct, subprocess, sys, threading, time
+d = sys.argv[1]
+ok = True
+def check(cond, msg):
+    global ok
+    if not cond:
+        print("ERROR:", msg, file=sys.stderr)
+        ok = False
+
+def free_port():
+    s = socket.socket()
+    s.bind(("127.0.0.1", 0))
+    port = s.getsockname()[1]
+    s.close()
+    return port
+
+def parse(data):
+    out, pos = [], 0
+    while pos + 40 <= len(data):
+        magic, kind, ch, t, value, ts = struct.unpack_from("<IBB2x16sdq", data, pos)
+        if magic != 0x42485348:
+            raise SystemExit(f"bad frame at {pos}")
+        pos += 40
+        vals = (value,)
+        if kind == 1 and ch > 1:
+            if pos + 40 > len(data):
+                break   # cut off when the hub stopped
+            vals = struct.unpack_from("<4d", data, pos + 8)[:ch]
+            pos += 40
+        out.append((kind, t.rstrip(b"\0").decode(), ts, vals))
+    return out
+
+def logged(path):
+    data = open(path, "rb").read()
+    return [r for r in parse(data)]
+
+def connect(port, path):
+    if port:
+        return socket.create_connection(("127.0.0.1", port))
+    s = socket.socket(socket.AF_UNIX)
+    s.connect(path)
+    return s
+
+class Sub(threading.Thread):
+    # delay = seconds between 4 KiB reads (0 = as fast as possible)
+    def __init__(self, path, port, lines, delay=0.0):
+        super().__init__()
+        self.sock = connect(port, path)
+        self.sock.sendall("".join(l + "\n" for l in lines).encode())
+        self.delay, self.data = delay, bytearray()
+        self.start()
+    def send(self, line):
+        self.sock.sendall((line + "\n").encode())
+    def run(self):
+        while True:
+            b = self.sock.recv(4096 if self.delay else 1 << 20)
+            if not b:
+                break
+            self.data += b
+            if self.delay:
+                time.sleep(self.delay)
+
+def walk(name, got, want, complete=True):
+    # got must be the rest of want from its first record on, with announced
+    # gaps (complete: up to the end); returns (received, dropped). Records
+    # missed before the first credit arrived are not counted.
+    first = next((k for k, r in enumerate(got) if r[0] != 4), None)
+    if first is None or got[first] not in want:
+        check(False, f"{name}: no records or not logged")
+        return 0, 0
+    i = want.index(got[first])
+    recv, dropped = 0, 0
+    for r in got[first:]:
+        if r[0] == 4:
+            i += int(r[3][0])
+            dropped += int(r[3][0])
+        elif i < len(want) and r == want[i]:
+            i += 1
+            recv += 1
+        else:
+            check(False, f"{name}: record {recv + dropped} is {r}, log has {want[i] if i < len(want) else 'nothing'}")
+            return recv, dropped
+    check(i == len(want) or not complete, f"{name}: stream ends after {i} of {len(want)} records")
+    return recv, dropped
+
+def run(conf, dur, extra):
+    sock, port = f"{d}/egress.sock", free_port()
+    log = f"{d}/{os.path.basename(conf)}.bin"
+    hub = subprocess.Popen(["./sensorhub", "--test-duration", str(dur), "--sensors", conf, "--log", log,
+                            "--log-format", "binary", "--egress-socket", sock, "--egress-port", str(port), *extra],
+                           stdout=subprocess.DEVNULL)
+    for _ in range(100):
+        if os.path.exists(sock):
+            break
+        time.sleep(0.02)
+    return hub, sock, port, log
+
+# filters, both transports and credit at the configured sensor rates
+hub, sock, port, log = run("config/vector.conf", 3, [])
+subs = {
+    "unix ACC,TEMP": Sub(sock, None, ["SUB ACC,TEMP", "CREDIT 1000000"]),
+    "tcp all": Sub(None, port, ["CREDIT 1000000"]),
+    "tcp HUM,NOPE": Sub(None, port, ["SUB *", "SUB HUM,NOPE", "CREDIT 1000000"]),
+    "credit 5+5": Sub(sock, None, ["SUB ACC", "CREDIT 5"]),
+}
+time.sleep(2)
+subs["credit 5+5"].send("CREDIT 5")
+hub.wait()
+for s in subs.values():
+    s.join()
+rec = logged(log)
+want = {"unix ACC,TEMP": ("ACC", "TEMP"), "tcp all": None, "tcp HUM,NOPE": ("HUM",), "credit 5+5": ("ACC",)}
+for name, s in subs.items():
+    got = parse(bytes(s.data))
+    w = [r for r in rec if want[name] is None or r[1] in want[name]]
+    recv, dropped = walk(name, got, w)
+    if name == "credit 5+5":
+        kinds = [r[0] for r in got]
+        kinds = kinds[kinds.index(1):]
+        check(recv == 10 and dropped > 0 and kinds[5] == 4, f"{name}: {recv} received, {dropped} dropped")
+    else:
+        check(recv > 0 and dropped == 0, f"{name}: {recv} received, {dropped} dropped")
+    print(f"{name}: {recv} records, {dropped} dropped")
+
+# one subscriber reading 40 KiB/s (~500 records) must not cost the others any
+hub, sock, port, log = run(f"{d}/fast.conf", 3, ["--egress-buffer", "64"])
+fast = [Sub(sock, None, ["CREDIT 100000000"]), Sub(None, port, ["SUB A,F", "CREDIT 100000000"])]
+slow = Sub(sock, None, ["CREDIT 100000000"], delay=0.1)
+hub.wait()
+for s in fast + [slow]:
+    s.join()
+rec = logged(log)
+for name, s, w in (("fast all", fast[0], rec), ("fast A,F", fast[1], [r for r in rec if r[1] in ("A", "F")])):
+    recv, dropped = walk(name, parse(bytes(s.data)), w)
+    check(recv + dropped > len(w) // 2 and dropped == 0, f"{name}: {recv} received, {dropped} dropped")
+    print(f"{name}: {recv} records, {dropped} dropped")
+# what it had not read when the hub stopped is lost unannounced
+recv, dropped = walk("slow", parse(bytes(slow.data)), rec, complete=False)
+check(dropped > 0 and recv > 0, f"slow: {recv} received, {dropped} dropped of {len(rec)}")
+print(f"slow: {recv} records, {dropped} dropped of {len(rec)}")
+sys.exit(0 if ok else 1)
+PY
+RC=$?
+
+if [ $RC -eq 0 ]; then
+  echo "TEST: SUCCESS"
+else
+  echo "TEST: FAILURE (exit code $RC)"
+fi
+
+exit $RC
@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_encoding_test.sh [duration_seconds]
+# runs a hub whose sensors use integer encodings (config/encoded.conf) and
+# checks that logged values sit on each sensor's scale grid and that the
+# alerts match window means recomputed from the log
+
+set -e
+
+DUR=${1:-3}
+DIR="data/encodingtest"
+
+echo "TEST: running sensorhub with integer-encoded sensors for ${DUR}s"
+rm -rf "${DIR}"
+./sensorhub --test-duration "${DUR}" --sensors config/encoded.conf --log "${DIR}/text.log" > /dev/null
+
+set +e
+python3 - "${DIR}/text.log" <<'PY'
+import sys
+# name: (window, threshold, scale, offset), as in config/encoded.conf
+SENSORS = {"TEMP": (5, 28.0, 0.1, 0.0), "HUM": (5, 50.0, 1.0, 0.0), "PRESS": (5, 1005.0, 0.01, 1000.0)}
+samples = {s: [] for s in SENSORS}
+alerts = {s: {} for s in SENSORS}
+for line in open(sys.argv[1]):
+    p = line.rstrip("\n").split("|")
+    if len(p) < 4 or p[1] not in SENSORS:
+        continue
+    if p[0] == "SAMPLE":
+        samples[p[1]].append((int(p[3]), float(p[2])))
+    elif p[0] == "ALERT":
+        alerts[p[1]][int(p[3])] = float(p[2])
+ok = True
+for name, (window, threshold, scale, offset) in SENSORS.items():
+    s = samples[name]
+    off_grid = [v for _, v in s if abs((v - offset) / scale - round((v - offset) / scale)) > 1e-6]
+    expected = {}
+    for i in range(window - 1, len(s)):
+        m = sum(v for _, v in s[i - window + 1:i + 1]) / window
+        if m > threshold:
+            expected[s[i][0]] = m
+    # the last sample may still have been queued at shutdown
+    missing = [ts for ts in expected if ts not in alerts[name] and ts != s[-1][0]]
+    extra = [ts for ts in alerts[name] if ts not in expected]
+    wrong = [ts for ts in alerts[name] if ts in expected and abs(alerts[name][ts] - expected[ts]) > 0.001]
+    print(f"{name}: {len(s)} samples, {len(alerts[name])} alerts, {len(expected)} expected")
+    if not s or off_grid or missing or extra or wrong:
+        print(f"ERROR: {name}: off_grid={off_grid[:5]} missing={missing[:5]} extra={extra[:5]} wrong={wrong[:5]}",
+              file=sys.stderr)
+        ok = False
+print("TEST: SUCCESS" if ok else "TEST: FAILURE")
+sys.exit(0 if ok else 1)
+PY
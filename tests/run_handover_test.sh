@@ -0,0 +1,149 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_handover_test.sh
+# starts a hub with an ingest socket, streams numbered samples into it from an
+# external producer, hands the hub over to a second process mid-stream and
+# checks that every sample was logged exactly once by one of the two. Then
+# hands over two full-rate hubs sharing one segmented log (--log-segment-mb)
+# and checks that the segments kept their size, time order and filters
+
+set -e
+
+DIR="data/handovertest"
+SOCK_DIR=$(mktemp -d)
+INGEST="${SOCK_DIR}/ingest.sock"
+HANDOVER="${SOCK_DIR}/handover.sock"
+trap 'rm -rf "${SOCK_DIR}"' EXIT
+
+echo "TEST: handing over a hub while an external producer is sending"
+rm -rf "${DIR}"
+mkdir -p "${DIR}"
+
+./sensorhub --log "${DIR}/old.log" --ingest-socket "${INGEST}" --handover-socket "${HANDOVER}" \
+            --test-duration 30 > "${DIR}/old.out" 2>&1 &
+OLD=$!
+sleep 0.5
+
+# external producer: numbered samples for 3 seconds, prints how many it sent
+python3 - "${INGEST}" > "${DIR}/sent.txt" <<'PY' &
+import socket, sys, time
+s = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+n, end = 0, time.time() + 3
+while time.time() < end:
+    s.sendto(f"EXT|{n}|{n}".encode(), sys.argv[1])
+    n += 1
+    time.sleep(0.0005)
+print(n)
+PY
+PROD=$!
+
+sleep 1
+./sensorhub --log "${DIR}/new.log" --ingest-socket "${INGEST}" --handover-socket "${HANDOVER}" \
+            --takeover --test-duration 4 > "${DIR}/new.out" 2>&1 &
+NEW=$!
+
+wait ${PROD}
+set +e
+wait ${OLD}; RC_OLD=$?
+wait ${NEW}; RC_NEW=$?
+
+python3 - "${DIR}" <<'PY'
+import sys
+d = sys.argv[1]
+sent = int(open(f"{d}/sent.txt").read())
+seen, per = [], {}
+for name in ("old", "new"):
+    for line in open(f"{d}/{name}.log"):
+        p = line.split("|")
+        if p[0] == "SAMPLE" and p[1] == "EXT":
+            seen.append(int(p[3]))
+            per[name] = per.get(name, 0) + 1
+print(f"sent {sent}, logged by old {per.get('old', 0)}, by new {per.get('new', 0)}")
+ok = True
+if "Handed over." not in open(f"{d}/old.out").read():
+    print("ERROR: old process did not hand over", file=sys.stderr)
+    ok = False
+if sorted(seen) != list(range(sent)):
+    missing = sent - len(set(seen))
+    print(f"ERROR: {missing} samples missing, {len(seen) - len(set(seen))} duplicated", file=sys.stderr)
+    ok = False
+sys.exit(0 if ok else 1)
+PY
+RC=$?
+[ $RC_OLD -ne 0 ] && RC=1
+[ $RC_NEW -ne 0 ] && RC=1
+
+# the old hub rotates the shared log several times a second, so it rotates
+# between the new hub opening the log and taking over
+echo "TEST: handing over a hub that shares a segmented log"
+./sensorhub --benchmark --log "${DIR}/seg/hub.log" --log-segment-mb 1 --handover-socket "${HANDOVER}" \
+            --test-duration 30 > "${DIR}/seg_old.out" 2>&1 &
+OLD=$!
+sleep 1.5
+./sensorhub --benchmark --log "${DIR}/seg/hub.log" --log-segment-mb 1 --handover-socket "${HANDOVER}" \
+            --takeover --test-duration 2 > "${DIR}/seg_new.out" 2>&1
+RC_NEW=$?
+wait ${OLD}; RC_OLD=$?
+[ $RC_OLD -ne 0 ] && RC=1
+[ $RC_NEW -ne 0 ] && RC=1
+
+python3 - "${DIR}" <<'PY' || RC=1
+import glob, os, struct, sys
+d = sys.argv[1]
+log = f"{d}/seg/hub.log"
+
+def fnv64(name):
+    h = 14695981039346656037
+    for c in name.encode()[:15]:
+        h = ((h ^ c) * 1099511628211) & (2**64 - 1)
+    return h
+
+def may_contain(path, name):
+    data = open(path, "rb").read()
+    _, _, probes, _, bits = struct.unpack_from("<4IQ", data, 0)
+    words = struct.unpack_from(f"<{bits // 64}Q", data, 24)
+    h = fnv64(name)
+    h1, h2 = h & 0xffffffff, (h >> 32) | 1
+    return all(words[b // 64] >> (b % 64) & 1 for b in ((h1 + i * h2) % bits for i in range(probes)))
+
+ok = True
+def check(cond, msg):
+    global ok
+    if not cond:
+        print("ERROR:", msg, file=sys.stderr)
+        ok = False
+
+check("Handed over." in open(f"{d}/seg_old.out").read(), "old process did not hand over")
+segs = sorted(p for p in glob.glob(log + ".[0-9]*") if p[-6:].isdigit())
+check(len(segs) >= 4, f"only {len(segs)} segments")
+# per sensor: [first, last] sample timestamp of each file, oldest file first
+ranges = []
+for path in segs + [log]:
+    r, names = {}, set()
+    for line in open(path):
+        p = line.split("|")
+        names.add(p[1])
+        if p[0] == "SAMPLE":
+            lo, hi = r.get(p[1], (1 << 62, 0))
+            r[p[1]] = (min(lo, int(p[3])), max(hi, int(p[3])))
+    ranges.append((path, r))
+    if path == log:
+        continue
+    # a segment is closed by the first record that takes it past 1 MiB
+    size = os.path.getsize(path)
+    check(1 << 20 <= size < (1 << 20) + 256, f"{path}: {size} bytes")
+    check(os.path.exists(path + ".bloom") and all(may_contain(path + ".bloom", n) for n in names),
+          f"{path}: Bloom filter misses names")
+for (a, ra), (b, rb) in zip(ranges, ranges[1:]):
+    for name in ra.keys() & rb.keys():
+        check(ra[name][1] <= rb[name][0], f"{name}: {a} ends at {ra[name][1]}, {b} starts at {rb[name][0]}")
+print(f"{len(segs)} segments")
+sys.exit(0 if ok else 1)
+PY
+
+if [ $RC -eq 0 ]; then
+  echo "TEST: SUCCESS"
+else
+  echo "TEST: FAILURE (exit code $RC)"
+fi
+
+exit $RC
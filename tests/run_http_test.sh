@@ -0,0 +1,213 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_http_test.sh
+# queries a running hub over HTTP (one keep-alive connection, pipelined and
+# concurrent requests) and checks history points, time ranges, rollups and
+# the binary responses against the samples in the hub's log, then hammers a
+# small history ring under benchmark load: no response may hold overwritten
+# points or torn buckets. Sensor names with quotes must give valid JSON.
+
+set -e
+
+DIR="data/httptest"
+rm -rf "${DIR}"
+
+echo "TEST: HTTP API against the hub log"
+set +e
+python3 - "${DIR}" <<'PY'
+import http.client, json, math, socket, struct, subprocess, sys, threading, time, urllib.parse
+d = sys.argv[1]
+ok = True
+def check(cond, msg):
+    global ok
+    if not cond:
+        print("ERROR:", msg, file=sys.stderr)
+        ok = False
+
+s = socket.socket()
+s.bind(("127.0.0.1", 0))
+port = s.getsockname()[1]
+s.close()
+log = f"{d}/hub.bin"
+hub = subprocess.Popen(["./sensorhub", "--test-duration", "5", "--sensors", "config/vector.conf", "--log", log,
+                        "--log-format", "binary", "--history", "32", "--http-port", str(port)],
+                       stdout=subprocess.DEVNULL)
+time.sleep(3.5)
+
+conn = http.client.HTTPConnection("127.0.0.1", port)
+conn.connect()
+sock = conn.sock
+def get(path, status=200):
+    conn.request("GET", path)
+    r = conn.getresponse()
+    body = r.read()
+    check(r.status == status, f"{path}: status {r.status}, expected {status}")
+    check(conn.sock is sock, f"{path}: connection was not kept alive")
+    return json.loads(body) if r.getheader("Content-Type") == "application/json" else body
+
+info = get("/sensors")
+check([x["name"] for x in info["sensors"]] == ["TEMP", "HUM", "PRESS", "ACC"], f"sensors {info}")
+check(info["tiers"] == [1000, 60000, 3600000], f"tiers {info['tiers']}")
+latest = get("/latest?sensor=TEMP,ACC")
+check(sorted(latest) == ["ACC", "TEMP"] and len(latest["ACC"]) == 5, f"latest {latest}")
+
+acc = get("/history?sensor=ACC")["points"]
+check(len(acc) == 31, f"ACC: {len(acc)} points from a ring of 32")
+last10 = get("/history?sensor=ACC&n=10")["points"]
+check(len(last10) == 10 and last10[0][0] >= acc[-10][0], "ACC: n=10")
+t0, t1 = acc[-12][0], acc[-4][0]
+ranged = get(f"/history?sensor=ACC&from={t0}&to={t1}")["points"]
+binary = get(f"/history?sensor=ACC&from={t0}&to={t1}&format=binary")
+pts = [struct.unpack_from("<qd", binary, i) for i in range(0, len(binary), 16)]
+check(len(ranged) == 9 and [p[0] for p in ranged] == [p[0] for p in acc[-12:-3]], f"ACC range: {len(ranged)} points")
+check([(p[0], p[1]) for p in ranged] == [(t, float(f"{v:.15g}")) for t, v in pts], "ACC: binary and JSON differ")
+temp = get("/rollup?sensor=ACC&tier=0")
+rbin = get("/rollup?sensor=ACC&tier=0&format=binary")
+rb = [struct.unpack_from("<qqddd", rbin, i) for i in range(0, len(rbin), 40)]
+# a bucket may have closed in between
+check(len(rb) in (len(temp["buckets"]), len(temp["buckets"]) + 1)
+      and [tuple(b[:2]) for b in temp["buckets"]] == [b[:2] for b in rb][:len(temp["buckets"])],
+      "ACC rollup: binary and JSON differ")
+ranged_b = get(f"/rollup?sensor=ACC&from={rb[1][0] + 500}&to={rb[2][0]}")["buckets"]
+check([b[0] for b in ranged_b] == [rb[1][0], rb[2][0]], f"ACC rollup range: {[b[0] for b in ranged_b]}")
+
+get("/history?sensor=NOPE", 404)
+get("/rollup?sensor=ACC&tier=7", 400)
+get("/history?sensor=ACC&n=x", 400)
+get("/nothing", 404)
+
+# pipelined requests are answered in order; Connection: close ends the connection
+p = socket.create_connection(("127.0.0.1", port))
+p.sendall(b"GET /history?sensor=TEMP&n=1 HTTP/1.1\r\nHost: x\r\n\r\n"
+          b"GET /history?sensor=HUM&n=2 HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n")
+data = b""
+while True:
+    b = p.recv(65536)
+    if not b:
+        break
+    data += b
+parts = data.split(b"HTTP/1.1 200 OK")
+check(len(parts) == 3 and b'"TEMP"' in parts[1] and b'"HUM"' in parts[2] and b"Connection: close" in parts[2],
+      f"pipelined responses: {data[:300]}")
+
+# concurrent clients while the hub runs
+errors = []
+def client():
+    c = http.client.HTTPConnection("127.0.0.1", port)
+    for _ in range(200):
+        c.request("GET", "/history?sensor=ACC&format=binary")
+        r = c.getresponse()
+        if r.status != 200 or len(r.read()) != 31 * 16:
+            errors.append(r.status)
+threads = [threading.Thread(target=client) for _ in range(8)]
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+check(not errors, f"concurrent clients: {len(errors)} bad responses")
+hub.wait()
+
+# everything served must be what was logged
+logged = {}
+data = open(log, "rb").read()
+for pos in range(0, len(data) - 39, 40):
+    _, kind, ch, t, value, ts = struct.unpack_from("<IBB2x16sdq", data, pos)
+    if kind == 1:
+        vals = list(struct.unpack_from("<4d", data, pos + 48)[:ch]) if ch > 1 else []
+        logged.setdefault(t.rstrip(b"\0").decode(), []).append([ts, value] + vals)
+def same(a, b):
+    return a[0] == b[0] and len(a) == len(b) and all(abs(x - y) < 1e-9 * max(1, abs(y)) for x, y in zip(a[1:], b[1:]))
+seq = logged["ACC"]
+i = next((k for k, r in enumerate(seq) if r[0] == acc[0][0]), None)
+check(i is not None and all(same(p, r) for p, r in zip(acc, seq[i:i + len(acc)])), "ACC history is not a run of logged samples")
+check(same(latest["TEMP"], [x for x in logged["TEMP"] if x[0] == latest["TEMP"][0]][0]), "TEMP latest")
+# the open bucket is not served: every bucket is complete
+for start, count, lo, hi, mean in temp["buckets"]:
+    v = [r[1] for r in seq if start <= r[0] < start + 1000]
+    check(count == len(v) and math.isclose(lo, min(v)) and math.isclose(hi, max(v))
+          and math.isclose(mean, sum(v) / len(v)), f"ACC bucket {start}: {count} {lo} {hi} {mean}")
+print(f"{len(acc)} history points, {len(temp['buckets'])} buckets and 1600 concurrent responses checked")
+
+# benchmark load wraps a 64-point ring every millisecond or so: responses
+# must never hold overwritten points, whatever the processors do meanwhile
+log = f"{d}/bench.bin"
+hub = subprocess.Popen(["./sensorhub", "--benchmark", "--test-duration", "3", "--log", log, "--log-format", "binary",
+                        "--history", "64", "--http-port", str(port)], stdout=subprocess.DEVNULL)
+time.sleep(0.5)
+got = {"binary": [], "json": [], "rollup": []}
+status = {}
+def hammer(kind, path, until):
+    c = http.client.HTTPConnection("127.0.0.1", port)
+    while time.monotonic() < until:
+        try:
+            c.request("GET", path)
+            r = c.getresponse()
+            body = r.read()
+        except (ConnectionError, http.client.HTTPException):
+            status["reset"] = status.get("reset", 0) + 1
+            c.close()
+            c = http.client.HTTPConnection("127.0.0.1", port)
+            continue
+        status[r.status] = status.get(r.status, 0) + 1
+        if r.status == 200:
+            got[kind].append(body)
+until = time.monotonic() + 2
+threads = [threading.Thread(target=hammer, args=a + (until,)) for a in (
+    ("binary", "/history?sensor=TEMP&n=32&format=binary"), ("binary", "/history?sensor=TEMP&n=63&format=binary"),
+    ("json", "/history?sensor=HUM&n=63"), ("rollup", "/rollup?sensor=PRESS"))]
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+hub.wait()
+check(all(got.values()) and set(status) <= {200, 503, "reset"}, f"under load: {status}")
+data = open(log, "rb").read()
+samples = b"".join(struct.pack("<qd", ts, value) for _, kind, _, t, value, ts in
+                   (struct.unpack_from("<IBB2x16sdq", data, pos) for pos in range(0, len(data) - 39, 40))
+                   if kind == 1 and t.startswith(b"TEMP\0"))
+def logged_run(body):
+    k = samples.find(body)
+    while k >= 0 and k % 16:
+        k = samples.find(body, k + 1)
+    return k >= 0
+torn = sum(not logged_run(b) for b in got["binary"][:300])
+check(torn == 0, f"{torn} binary histories are not runs of logged samples")
+for body in got["json"]:
+    ts = [pt[0] for pt in json.loads(body)["points"]]
+    check(len(ts) == 63 and ts == sorted(ts), f"JSON history out of order: {ts}")
+for body in got["rollup"]:
+    for start, count, lo, hi, mean in json.loads(body)["buckets"]:
+        check(count > 0 and lo <= mean * (1 + 1e-12) and mean <= hi * (1 + 1e-12), f"torn bucket {start}")
+print(f"under load: {status}, {min(len(got['binary']), 300)} binary histories checked against the log")
+
+# sensor names may hold quotes and backslashes: every response stays valid JSON
+names = ['Q"A', 'B\\S']
+open(f"{d}/names.conf", "w").write("".join(f"{n} interval=50 base=10 span=5\n" for n in names))
+hub = subprocess.Popen(["./sensorhub", "--test-duration", "3", "--sensors", f"{d}/names.conf", "--log", f"{d}/names.log",
+                        "--http-port", str(port)], stdout=subprocess.DEVNULL)
+time.sleep(1.5)
+c = http.client.HTTPConnection("127.0.0.1", port)
+def get_json(path):
+    c.request("GET", path)
+    try:
+        return json.loads(c.getresponse().read())
+    except ValueError as e:
+        check(False, f"{path}: {e}")
+        return {}
+check([s.get("name") for s in get_json("/sensors").get("sensors", [])] == names, "names in /sensors")
+check(sorted(get_json("/latest")) == sorted(names), "names in /latest")
+for n in names:
+    q = urllib.parse.quote(n, safe="")
+    check(get_json(f"/history?sensor={q}").get("sensor") == n, f"{n} in /history")
+    check(get_json(f"/rollup?sensor={q}").get("sensor") == n, f"{n} in /rollup")
+hub.wait()
+sys.exit(0 if ok else 1)
+PY
+RC=$?
+
+if [ $RC -eq 0 ]; then
+  echo "TEST: SUCCESS"
+else
+  echo "TEST: FAILURE (exit code $RC)"
+fi
+
+exit $RC
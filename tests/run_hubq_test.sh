@@ -0,0 +1,114 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_hubq_test.sh [duration_seconds]
+# records segmented, zone-mapped text and binary logs and checks hubq's
+# records and per-bucket aggregates against a brute-force filter in Python,
+# and that selective queries skip segments and blocks
+
+set -e
+
+DUR=${1:-1}
+DIR="data/hubqtest"
+
+echo "TEST: hubq against a brute-force filter"
+rm -rf "${DIR}"
+for FMT in text binary; do
+  ./sensorhub --test-duration "${DUR}" --benchmark --sensors config/vector.conf --log "${DIR}/${FMT}.log" \
+              --log-format "${FMT}" --log-segment-mb 2 --zone-map --zone-block 16 > /dev/null &
+done
+wait
+
+set +e
+python3 - "${DIR}" <<'PY'
+import glob, math, re, struct, subprocess, sys
+d = sys.argv[1]
+
+def records(log):
+    files = sorted(p for p in glob.glob(log + ".*") if re.fullmatch(r"\d{6}", p[len(log) + 1:])) + [log]
+    out = []
+    for path in files:
+        data = open(path, "rb").read()
+        if data[:1] == b"H":
+            for pos in range(0, len(data) - 39, 40):
+                _, kind, ch, t, value, ts = struct.unpack_from("<IBB2x16sdq", data, pos)
+                if kind == 3:
+                    continue
+                vals = [value]
+                if ch > 1:
+                    vals = list(struct.unpack_from("<4d", data, pos + 48)[:ch])
+                out.append((kind, t.rstrip(b"\0").decode(), value, ts, vals))
+        else:
+            for line in data.decode().splitlines():
+                p = line.split("|")
+                vals = [float(v) for v in p[2].split(",")]
+                value = math.sqrt(sum(v * v for v in vals)) if len(vals) > 1 else vals[0]
+                out.append((1 if p[0] == "SAMPLE" else 2, p[1], value, int(p[3]), vals))
+    return out, len(files)
+
+def line(r):
+    kind, t, _, ts, vals = r
+    if kind == 2:
+        return f"ALERT|{t}|{vals[0]:.3f}|{ts}|THRESHOLD_EXCEEDED"
+    return f"SAMPLE|{t}|{','.join(f'{v:.3f}' for v in vals)}|{ts}"
+
+def hubq(*args):
+    p = subprocess.run(["./hubq", "--explain", *args], capture_output=True, text=True)
+    if p.returncode != 0:
+        raise SystemExit(f"hubq {' '.join(args)} failed: {p.stderr}")
+    return p.stdout.splitlines(), p.stderr
+
+ok = True
+def check(name, got, want):
+    global ok
+    if got != want:
+        print(f"ERROR: {name}: {len(got)} lines, expected {len(want)}", file=sys.stderr)
+        for g, w in zip(got, want):
+            if g != w:
+                print(f"  first difference: {g!r} vs {w!r}", file=sys.stderr)
+                break
+        ok = False
+
+for fmt in ("text", "binary"):
+    log = f"{d}/{fmt}.log"
+    recs, nfiles = records(log)
+    ts = sorted(r[3] for r in recs)
+    t0, t1 = ts[len(ts) * 2 // 5], ts[len(ts) * 9 // 20]
+
+    got, _ = hubq("--sensor", "PRESS", "--kind", "sample", "--min", "1015", log)
+    check(f"{fmt} PRESS >= 1015", got, [line(r) for r in recs if r[1] == "PRESS" and r[0] == 1 and r[2] >= 1015])
+
+    got, err = hubq("--sensor", "ACC,TEMP", "--from", str(t0), "--to", str(t1), log)
+    check(f"{fmt} ACC,TEMP in time range", got, [line(r) for r in recs if r[1] in ("ACC", "TEMP") and t0 <= r[3] <= t1])
+    m = re.search(r"blocks (\d+) \((\d+) skipped", err)
+    print(f"{fmt}: {len(recs)} records in {nfiles} files; time range query: {err.strip()}")
+    if not m or int(m.group(2)) * 2 < int(m.group(1)):
+        print(f"ERROR: {fmt}: time range query skipped too few blocks", file=sys.stderr)
+        ok = False
+
+    got, _ = hubq("--kind", "alert", "--max", "30", "--limit", "50", log)
+    check(f"{fmt} alerts <= 30, first 50", got, [line(r) for r in recs if r[0] == 2 and r[2] <= 30][:50])
+
+    got, _ = hubq("--bucket", "250", "--kind", "sample", log)
+    agg = {}
+    for kind, t, v, ts_, _ in recs:
+        if kind == 1:
+            a = agg.setdefault((ts_ // 250 * 250, t), [0, v, v, 0.0])
+            a[0] += 1; a[1] = min(a[1], v); a[2] = max(a[2], v); a[3] += v
+    want = ["bucket_ms,sensor,count,min,max,avg"] + [f"{b},{t},{c},{lo:.3f},{hi:.3f},{s / c:.3f}" for (b, t), (c, lo, hi, s) in sorted(agg.items())]
+    check(f"{fmt} buckets", got, want)
+
+    _, err = hubq("--sensor", "NOPE", log)
+    m = re.search(r"files (\d+) \((\d+) skipped", err)
+    if not m or int(m.group(2)) != nfiles - 1:
+        print(f"ERROR: {fmt}: unknown sensor should skip all {nfiles - 1} closed segments: {err.strip()}", file=sys.stderr)
+        ok = False
+sys.exit(0 if ok else 1)
+PY
+RC=$?
+
+if [ $RC -eq 0 ]; then
+  echo "TEST: SUCCESS"
+else
+  echo "TEST: FAILURE (exit code $RC)"
+fi
+
+exit $RC
@@ -0,0 +1,54 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_median_test.sh [duration_seconds]
+# runs a hub with median and MAD alert rules (config/robust.conf) and
+# recomputes the window medians / MADs from the logged samples
+
+set -e
+
+DUR=${1:-3}
+DIR="data/mediantest"
+
+echo "TEST: running sensorhub with median/MAD alerts for ${DUR}s"
+rm -rf "${DIR}"
+./sensorhub --test-duration "${DUR}" --sensors config/robust.conf --log "${DIR}/text.log" > /dev/null
+
+set +e
+python3 - "${DIR}/text.log" <<'PY'
+import math, sys
+from statistics import median
+# name: (window, threshold, rule), as in config/robust.conf
+SENSORS = {"TEMP": (5, 28.0, "median"), "HUM": (64, 13.5, "mad"),
+           "PRESS": (6, 1005.0, "median"), "ACC": (7, 3.0, "mad")}
+samples = {s: [] for s in SENSORS}
+alerts = {s: {} for s in SENSORS}
+for line in open(sys.argv[1]):
+    p = line.rstrip("\n").split("|")
+    if len(p) < 4 or p[1] not in SENSORS:
+        continue
+    if p[0] == "SAMPLE":
+        vals = [float(v) for v in p[2].split(",")]
+        # scalar input of the rule: the value, or the magnitude of a vector
+        samples[p[1]].append((int(p[3]), math.sqrt(sum(v * v for v in vals)) if len(vals) > 1 else vals[0]))
+    elif p[0] == "ALERT":
+        alerts[p[1]][int(p[3])] = float(p[2])
+ok = True
+for name, (window, threshold, rule) in SENSORS.items():
+    s = samples[name]
+    expected = {}
+    for i in range(window - 1, len(s)):
+        w = [v for _, v in s[i - window + 1:i + 1]]
+        med = median(w)
+        m = med if rule == "median" else median(abs(v - med) for v in w)
+        if m > threshold:
+            expected[s[i][0]] = m
+    # the last sample may still have been queued at shutdown
+    missing = [ts for ts in expected if ts not in alerts[name] and ts != s[-1][0]]
+    extra = [ts for ts in alerts[name] if ts not in expected]
+    wrong = [ts for ts in alerts[name] if ts in expected and abs(alerts[name][ts] - expected[ts]) > 0.001]
+    print(f"{name} ({rule}): {len(s)} samples, {len(alerts[name])} alerts, {len(expected)} expected")
+    if not s or not expected or missing or extra or wrong:
+        print(f"ERROR: {name}: missing={missing[:5]} extra={extra[:5]} wrong={wrong[:5]}", file=sys.stderr)
+        ok = False
+print("TEST: SUCCESS" if ok else "TEST: FAILURE")
+sys.exit(0 if ok else 1)
+PY
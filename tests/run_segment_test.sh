@@ -0,0 +1,113 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_segment_test.sh
+# runs a hub with --log-segment-mb 1 while an external producer sends 3000
+# distinct sensor names, then checks the rotated segments: numbering, sizes,
+# per-segment zone maps, and Bloom filters with no false negatives and a
+# false positive rate close to the 1% they are sized for
+
+set -e
+
+DIR="data/segmenttest"
+SOCK_DIR=$(mktemp -d)
+INGEST="${SOCK_DIR}/ingest.sock"
+trap 'rm -rf "${SOCK_DIR}"' EXIT
+
+echo "TEST: log segments with Bloom filters of their sensor names"
+rm -rf "${DIR}"
+./sensorhub --log "${DIR}/hub.log" --log-segment-mb 1 --zone-map --zone-block 64 \
+            --ingest-socket "${INGEST}" --queue-size 65536 --test-duration 5 > /dev/null &
+HUB=$!
+sleep 0.5
+
+# 3000 names, each in a run of ~40 KiB of log so the segments hold different names
+python3 - "${INGEST}" <<'PY'
+import socket, sys, time
+s = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+for i in range(120000):
+    s.sendto(f"EXT{i // 40}|{i % 97}|{i}".encode(), sys.argv[1])
+    if i % 500 == 0:
+        time.sleep(0.002)
+PY
+
+set +e
+wait ${HUB}
+RC_HUB=$?
+
+python3 - "${DIR}/hub.log" <<'PY'
+import glob, os, random, re, string, struct, sys
+log = sys.argv[1]
+
+def fnv64(name):
+    h = 14695981039346656037
+    for c in name.encode()[:15]:
+        h = ((h ^ c) * 1099511628211) & (2**64 - 1)
+    return h
+
+def bloom_load(path):
+    data = open(path, "rb").read()
+    magic, version, probes, names, bits = struct.unpack_from("<4IQ", data, 0)
+    assert magic == 0x46425348 and version == 1
+    words = struct.unpack_from(f"<{bits // 64}Q", data, 24)
+    return probes, names, bits, words
+
+def may_contain(bloom, name):
+    probes, _, bits, words = bloom
+    h = fnv64(name)
+    h1, h2 = h & 0xffffffff, (h >> 32) | 1
+    return all(words[b // 64] >> (b % 64) & 1 for b in ((h1 + i * h2) % bits for i in range(probes)))
+
+def tiles(path):
+    data = open(path + ".zmap", "rb").read()
+    pos, end = 16, 0
+    while pos < len(data):
+        _, n, off, length, _ = struct.unpack_from("<IIQQQ", data, pos)
+        if off != end:
+            return False
+        end, pos = off + length, pos + 32 + 56 * n
+    return end == os.path.getsize(path)
+
+segs = sorted(p for p in glob.glob(log + ".*") if re.fullmatch(r"\d{6}", p[len(log) + 1:]))
+ok = len(segs) >= 2
+if not ok:
+    print(f"ERROR: {len(segs)} segments", file=sys.stderr)
+all_names = set()
+positives = tests = 0
+for k, seg in enumerate(segs):
+    if seg != f"{log}.{k + 1:06d}":
+        print(f"ERROR: unexpected segment {seg}", file=sys.stderr)
+        ok = False
+    size = os.path.getsize(seg)
+    if not (1 << 20) <= size < (1 << 20) + 256:
+        print(f"ERROR: {seg} has {size} bytes", file=sys.stderr)
+        ok = False
+    if not tiles(seg):
+        print(f"ERROR: zone map of {seg} does not cover it", file=sys.stderr)
+        ok = False
+    names = {l.split("|")[1] for l in open(seg)}
+    all_names |= names
+    bloom = bloom_load(seg + ".bloom")
+    if bloom[1] != len(names) or not all(may_contain(bloom, n) for n in names):
+        print(f"ERROR: {seg}: filter of {bloom[1]} names misses some of {len(names)}", file=sys.stderr)
+        ok = False
+    # names of other segments, and names the hub never saw
+    others = [f"EXT{i}" for i in range(3000) if f"EXT{i}" not in names]
+    others += ["".join(random.choice(string.ascii_uppercase) for _ in range(8)) for _ in range(2000)]
+    positives += sum(may_contain(bloom, n) for n in others)
+    tests += len(others)
+fp = positives / max(tests, 1)
+print(f"{len(segs)} segments, {len(all_names)} names, false positive rate {fp:.4f}")
+if fp > 0.03:
+    print("ERROR: false positive rate above 3%", file=sys.stderr)
+    ok = False
+sys.exit(0 if ok else 1)
+PY
+RC=$?
+[ $RC_HUB -ne 0 ] && RC=1
+
+if [ $RC -eq 0 ]; then
+  echo "TEST: SUCCESS"
+else
+  echo "TEST: FAILURE (exit code $RC)"
+fi
+
+exit $RC
@@ -0,0 +1,78 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_spec_test.sh [duration_seconds]
+# builds sensorhub with processors generated from config/encoded.conf,
+# config/vector.conf and config/robust.conf (make spec) and checks that each
+# produces the same samples and alerts as the runtime processor; a sensor
+# file that differs from the schema must fall back to the runtime processor
+
+set -e
+
+DUR=${1:-3}
+DIR="data/spectest"
+rm -rf "${DIR}"
+mkdir -p "${DIR}"
+
+for schema in encoded vector robust; do
+    echo "TEST: generated processor for config/${schema}.conf (${DUR}s)"
+    if ! make -s spec SCHEMA="config/${schema}.conf" SPEC_DIR="build/spec-${schema}" > "${DIR}/build.log" 2>&1; then
+        cat "${DIR}/build.log"
+        echo "TEST: FAILURE"
+        exit 1
+    fi
+    "build/spec-${schema}/sensorhub" --test-duration "${DUR}" --sensors "config/${schema}.conf" \
+        --log "${DIR}/${schema}.spec.log" > /dev/null 2> "${DIR}/${schema}.spec.err" &
+    ./sensorhub --test-duration "${DUR}" --sensors "config/${schema}.conf" \
+        --log "${DIR}/${schema}.runtime.log" > /dev/null
+    wait
+    if [ -s "${DIR}/${schema}.spec.err" ]; then
+        cat "${DIR}/${schema}.spec.err"
+        echo "TEST: FAILURE"
+        exit 1
+    fi
+done
+
+# default sensors against the encoded schema: warns and still runs
+build/spec-encoded/sensorhub --test-duration 1 --log "${DIR}/fallback.log" > /dev/null 2> "${DIR}/fallback.err"
+if ! grep -q "using the runtime processor" "${DIR}/fallback.err" || ! grep -q "^SAMPLE|TEMP" "${DIR}/fallback.log"; then
+    echo "ERROR: no fallback to the runtime processor" >&2
+    echo "TEST: FAILURE"
+    exit 1
+fi
+
+set +e
+python3 - "${DIR}" encoded vector robust <<'PY'
+import sys
+from collections import defaultdict
+
+def events(path):
+    # per sensor: sample values and alert values in log order
+    samples, alerts = defaultdict(list), defaultdict(list)
+    for line in open(path):
+        p = line.rstrip("\n").split("|")
+        if len(p) < 4:
+            continue
+        if p[0] == "SAMPLE":
+            samples[p[1]].append(p[2])
+        elif p[0] == "ALERT":
+            alerts[p[1]].append(p[2])
+    return samples, alerts
+
+ok = True
+d = sys.argv[1]
+for schema in sys.argv[2:]:
+    spec = events(f"{d}/{schema}.spec.log")
+    runtime = events(f"{d}/{schema}.runtime.log")
+    for kind, a, b in (("samples", spec[0], runtime[0]), ("alerts", spec[1], runtime[1])):
+        for name in sorted(set(a) | set(b)):
+            # the runs stop at slightly different points: one must be a prefix of the other
+            n = min(len(a[name]), len(b[name]))
+            if a[name][:n] != b[name][:n]:
+                print(f"ERROR: {schema} {name} {kind} differ: {a[name][:n][:5]} vs {b[name][:n][:5]}", file=sys.stderr)
+                ok = False
+        print(f"{schema}: {kind} " + ", ".join(f"{k}={len(v)}" for k, v in sorted(a.items())))
+    if not spec[1]:
+        print(f"ERROR: {schema}: no alerts", file=sys.stderr)
+        ok = False
+print("TEST: SUCCESS" if ok else "TEST: FAILURE")
+sys.exit(0 if ok else 1)
+PY
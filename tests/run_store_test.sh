@@ -0,0 +1,116 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_store_test.sh [duration_seconds]
+# records binary logs and column stores (integer encodings, a 3-axis sensor,
+# a second run appending to the first store), checks that each sensor's
+# stored rows are its logged samples in order, that the manifest matches the
+# files, and that --backtest --store fires the same alerts as the logs
+
+set -e
+
+DUR=${1:-2}
+DIR="data/storetest"
+
+echo "TEST: column store against the hub logs"
+rm -rf "${DIR}"
+./sensorhub --test-duration "${DUR}" --sensors config/encoded.conf --log "${DIR}/encoded1.bin" --log-format binary \
+            --store "${DIR}/encoded" > /dev/null &
+./sensorhub --test-duration "${DUR}" --sensors config/vector.conf --log "${DIR}/vector.bin" --log-format binary \
+            --store "${DIR}/vector" > /dev/null
+wait
+./sensorhub --test-duration 1 --sensors config/encoded.conf --log "${DIR}/encoded2.bin" --log-format binary \
+            --store "${DIR}/encoded" > /dev/null
+
+for S in encoded vector; do
+  LOGS=$(ls "${DIR}/${S}"*.bin)
+  ./sensorhub --backtest --sensors "config/${S}.conf" --shards 2 --store "${DIR}/${S}" --log-format binary \
+              --backtest-out "${DIR}/${S}.store.alerts" 2> /dev/null
+  ./sensorhub --backtest --sensors "config/${S}.conf" --log-format binary \
+              --backtest-out "${DIR}/${S}.log.alerts" ${LOGS} 2> /dev/null
+done
+
+set +e
+python3 - "${DIR}" <<'PY'
+import glob, struct, sys
+d = sys.argv[1]
+ok = True
+def check(cond, msg):
+    global ok
+    if not cond:
+        print("ERROR:", msg, file=sys.stderr)
+        ok = False
+
+def records(paths):
+    out = []
+    for path in paths:
+        data = open(path, "rb").read()
+        for pos in range(0, len(data) - 39, 40):
+            _, kind, ch, t, value, ts = struct.unpack_from("<IBB2x16sdq", data, pos)
+            if kind == 3:
+                continue
+            vals = [value] if ch <= 1 else list(struct.unpack_from("<4d", data, pos + 48)[:ch])
+            out.append((kind, t.rstrip(b"\0").decode(), ts, vals))
+    return out
+
+fmt = {"f64": "d", "f32": "f", "i32": "i", "i16": "h"}
+for store in ("encoded", "vector"):
+    logged = {}
+    for kind, t, ts, vals in records(sorted(glob.glob(f"{d}/{store}*.bin"))):
+        if kind == 1:
+            logged.setdefault(t, []).append((ts, vals))
+    parts = {}
+    for line in open(f"{d}/{store}/MANIFEST"):
+        if line.startswith("#"):
+            continue
+        f = line.split()
+        kv = dict(x.split("=") for x in f[3:])
+        parts.setdefault(f[2], []).append((f[1], kv))
+    check(sorted(parts) == sorted(logged), f"{store}: stored sensors {sorted(parts)}, logged {sorted(logged)}")
+    last = {}
+    for name, ps in parts.items():
+        rows = []
+        for day, kv in sorted(ps):
+            ch, enc = int(kv["channels"]), kv["encoding"]
+            scale, offset = float(kv["scale"]), float(kv["offset"])
+            ts = open(f"{d}/{store}/{day}/{name}.ts", "rb").read()
+            val = open(f"{d}/{store}/{day}/{name}.val", "rb").read()
+            n = len(ts) // 8
+            check(int(kv["rows"]) == n and len(val) == n * ch * struct.calcsize(fmt[enc]),
+                  f"{store}/{day}/{name}: manifest rows {kv['rows']}, files {len(ts)} and {len(val)} bytes")
+            t = struct.unpack(f"<{n}q", ts)
+            v = struct.unpack(f"<{n * ch}{fmt[enc]}", val)
+            check(n == 0 or (int(kv["min"]) == min(t) and int(kv["max"]) == max(t)), f"{store}/{day}/{name}: time bounds")
+            for i in range(n):
+                vals = [x * scale + offset if enc[0] == "i" else x for x in v[i * ch:(i + 1) * ch]]
+                rows.append((t[i], vals))
+        want = logged.get(name, [])
+        # samples still queued at shutdown are logged but never processed
+        check(0 < len(rows) <= len(want) and len(want) - len(rows) < 16,
+              f"{store}/{name}: {len(rows)} rows stored, {len(want)} samples logged")
+        tol = 1e-4 if store == "vector" else 0.006
+        for i, ((t, v), (lt, lv)) in enumerate(zip(rows, want)):
+            if t != lt or any(abs(a - b) > tol * max(1, abs(b)) for a, b in zip(v, lv)):
+                check(False, f"{store}/{name}: row {i} is {t} {v}, logged {lt} {lv}")
+                break
+        if rows:
+            last[name] = rows[-1][0]
+
+    def alerts(path):
+        out = []
+        for kind, t, ts, vals in records([path]):
+            if kind == 2 and ts <= last.get(t, -1):
+                out.append((t, ts, round(vals[0], 6)))
+        return sorted(out)
+    got, want = alerts(f"{d}/{store}.store.alerts"), alerts(f"{d}/{store}.log.alerts")
+    check(got == want and len(want) > 0, f"{store}: {len(got)} alerts from the store, {len(want)} from the logs")
+    print(f"{store}: {sum(len(p) for p in parts.values())} partitions, {len(got)} alerts match")
+sys.exit(0 if ok else 1)
+PY
+RC=$?
+
+if [ $RC -eq 0 ]; then
+  echo "TEST: SUCCESS"
+else
+  echo "TEST: FAILURE (exit code $RC)"
+fi
+
+exit $RC
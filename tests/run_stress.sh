@@ -0,0 +1,44 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_stress.sh [rounds] [producers]
+# runs every sanitizer build of tests/stress.c (built by `make stress`) with
+# random seeds; any sanitizer report, accounting mismatch or hang fails the run
+
+set -e
+
+ROUNDS=${1:-5}
+PRODUCERS=${2:-64}
+TIMEOUT=90          # seconds per round before it counts as a hang
+BINS="build/stress-tsan build/stress-asan"
+
+export TSAN_OPTIONS="halt_on_error=1 exitcode=66"
+export ASAN_OPTIONS="halt_on_error=1 detect_leaks=1"
+export UBSAN_OPTIONS="halt_on_error=1 print_stacktrace=1"
+
+mkdir -p build
+FAIL=0
+for BIN in ${BINS}; do
+  for i in $(seq 1 "${ROUNDS}"); do
+    SEED=${RANDOM}${RANDOM}
+    echo "STRESS: ${BIN} round ${i}/${ROUNDS} seed ${SEED}"
+    set +e
+    timeout "${TIMEOUT}" "./${BIN}" "${PRODUCERS}" "${SEED}" "build/stress.log"
+    RC=$?
+    set -e
+    if [ $RC -eq 124 ]; then
+      echo "STRESS: ${BIN} HUNG (seed ${SEED})"
+      FAIL=1
+    elif [ $RC -ne 0 ]; then
+      echo "STRESS: ${BIN} FAILED with exit code ${RC} (seed ${SEED})"
+      FAIL=1
+    fi
+  done
+done
+rm -f build/stress.log.*
+
+if [ $FAIL -eq 0 ]; then
+  echo "STRESS: SUCCESS"
+else
+  echo "STRESS: FAILURE"
+fi
+
+exit $FAIL
@@ -0,0 +1,55 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_vector_test.sh [duration_seconds]
+# runs a hub with a 3-channel sensor (config/vector.conf) in text and binary
+# log format and recomputes the magnitude alerts from the logged samples
+
+set -e
+
+DUR=${1:-3}
+DIR="data/vectortest"
+
+echo "TEST: running sensorhub with a 3-channel sensor for ${DUR}s"
+rm -rf "${DIR}"
+./sensorhub --test-duration "${DUR}" --sensors config/vector.conf --log "${DIR}/text.log" > /dev/null &
+./sensorhub --test-duration "${DUR}" --sensors config/vector.conf --log "${DIR}/bin.log" --log-format binary > /dev/null
+wait
+# the aggregator reads the binary log back into text
+./sensorhub --aggregate --aggregate-out "${DIR}/bin.txt" "${DIR}/bin.log" 2> /dev/null
+
+set +e
+python3 - "${DIR}/text.log" "${DIR}/bin.txt" <<'PY'
+import math, sys
+WINDOW, THRESHOLD = 3, 12.0
+ok = True
+for path in sys.argv[1:]:
+    samples, alerts = [], {}
+    for line in open(path):
+        p = line.rstrip("\n").split("|")
+        if len(p) < 4 or p[1] != "ACC":
+            continue
+        if p[0] == "SAMPLE":
+            vals = [float(v) for v in p[2].split(",")]
+            if len(vals) != 3:
+                print(f"ERROR: {path}: ACC sample with {len(vals)} channels", file=sys.stderr)
+                ok = False
+            samples.append((int(p[3]), vals))
+        elif p[0] == "ALERT":
+            alerts[int(p[3])] = float(p[2])
+    # mean of the last WINDOW magnitudes after every sample
+    mags = [math.sqrt(sum(v * v for v in vals)) for _, vals in samples]
+    expected = {}
+    for i in range(WINDOW - 1, len(samples)):
+        m = sum(mags[i - WINDOW + 1:i + 1]) / WINDOW
+        if m > THRESHOLD:
+            expected[samples[i][0]] = m
+    # the last samples may still have been queued at shutdown
+    missing = [ts for ts in expected if ts not in alerts and ts != samples[-1][0]]
+    extra = [ts for ts in alerts if ts not in expected]
+    wrong = [ts for ts in alerts if ts in expected and abs(alerts[ts] - expected[ts]) > 0.001]
+    print(f"{path}: {len(samples)} ACC samples, {len(alerts)} alerts, {len(expected)} expected")
+    if not samples or not expected or missing or extra or wrong:
+        print(f"ERROR: {path}: missing={missing[:5]} extra={extra[:5]} wrong={wrong[:5]}", file=sys.stderr)
+        ok = False
+print("TEST: SUCCESS" if ok else "TEST: FAILURE")
+sys.exit(0 if ok else 1)
+PY
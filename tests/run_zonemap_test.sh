@@ -0,0 +1,97 @@
+#!/usr/bin/env bash
+# usage: ./tests/run_zonemap_test.sh [duration_seconds]
+# runs hubs with --zone-map (text and binary logs, small blocks) and checks
+# every zone map block against the log records in its byte range
+
+set -e
+
+DUR=${1:-1}
+DIR="data/zonemaptest"
+
+echo "TEST: zone maps of text and binary logs"
+rm -rf "${DIR}"
+./sensorhub --test-duration "${DUR}" --log "${DIR}/text.log" --zone-map --zone-block 1 --benchmark \
+            --sensors config/vector.conf > /dev/null &
+./sensorhub --test-duration "${DUR}" --log "${DIR}/bin.log" --log-format binary --zone-map --zone-block 4 --benchmark \
+            --sensors config/vector.conf > /dev/null
+wait
+
+set +e
+python3 - "${DIR}/text.log" "${DIR}/bin.log" <<'PY'
+import math, os, struct, sys
+
+def load_zmap(path):
+    data = open(path + ".zmap", "rb").read()
+    magic, version, block_bytes, _ = struct.unpack_from("<4I", data, 0)
+    assert magic == 0x4d5a5348 and version == 1, "bad zone map header"
+    pos, blocks = 16, []
+    while pos < len(data):
+        magic, n, off, length, records = struct.unpack_from("<IIQQQ", data, pos)
+        assert magic == 0x4d5a5348, "bad block magic"
+        pos += 32
+        entries = {}
+        for _ in range(n):
+            t, kind, count, t0, t1, v0, v1 = struct.unpack_from("<16sB3xIqqdd", data, pos)
+            entries[(t.rstrip(b"\0").decode(), kind)] = (count, t0, t1, v0, v1)
+            pos += 56
+        blocks.append((off, length, records, entries))
+    return block_bytes, blocks
+
+def text_records(chunk):
+    for line in chunk.decode().splitlines():
+        p = line.split("|")
+        vals = [float(v) for v in p[2].split(",")]
+        value = math.sqrt(sum(v * v for v in vals)) if len(vals) > 1 else vals[0]
+        yield p[1], 1 if p[0] == "SAMPLE" else 2, value, int(p[3])
+
+def binary_records(chunk):
+    for pos in range(0, len(chunk), 40):
+        magic, kind, _, t, value, ts = struct.unpack_from("<IBB2x16sdq", chunk, pos)
+        if kind != 3:
+            yield t.rstrip(b"\0").decode(), kind, value, ts
+
+ok = True
+for path, reader, slack in ((sys.argv[1], text_records, 0.002), (sys.argv[2], binary_records, 0.0)):
+    log = open(path, "rb").read()
+    block_bytes, blocks = load_zmap(path)
+    end = 0
+    for off, length, records, entries in blocks:
+        if off != end:
+            print(f"ERROR: {path}: block at {off}, expected {end}", file=sys.stderr)
+            ok = False
+            break
+        end = off + length
+        if length > block_bytes + 160:
+            print(f"ERROR: {path}: block of {length} bytes", file=sys.stderr)
+            ok = False
+        seen = {}
+        n = 0
+        for t, kind, value, ts in reader(log[off:end]):
+            c, t0, t1, v0, v1 = seen.get((t, kind), (0, ts, ts, value, value))
+            seen[(t, kind)] = (c + 1, min(t0, ts), max(t1, ts), min(v0, value), max(v1, value))
+            n += 1
+        if set(seen) != set(entries):
+            print(f"ERROR: {path}: block {off}: entries {sorted(entries)} vs {sorted(seen)}", file=sys.stderr)
+            ok = False
+            continue
+        for key, (c, t0, t1, v0, v1) in seen.items():
+            zc, zt0, zt1, zv0, zv1 = entries[key]
+            # bounds must contain the logged values and be tight up to text rounding
+            if (zc, zt0, zt1) != (c, t0, t1) or not (v0 - slack <= zv0 <= v0 and v1 <= zv1 <= v1 + slack):
+                print(f"ERROR: {path}: block {off} {key}: {entries[key]} vs {(c, t0, t1, v0, v1)}", file=sys.stderr)
+                ok = False
+    if end != len(log):
+        print(f"ERROR: {path}: blocks cover {end} of {len(log)} bytes", file=sys.stderr)
+        ok = False
+    print(f"{os.path.basename(path)}: {len(blocks)} blocks over {len(log)} bytes")
+sys.exit(0 if ok else 1)
+PY
+RC=$?
+
+if [ $RC -eq 0 ]; then
+  echo "TEST: SUCCESS"
+else
+  echo "TEST: FAILURE (exit code $RC)"
+fi
+
+exit $RC
@@ -0,0 +1,137 @@
+// stress driver: many producers hammer hub_submit at full speed while the
+// processors are stopped at a random moment. Producers are spread over one or
+// two independent hubs, each checked on its own. Built with -fsanitize=thread and
+// -fsanitize=address,undefined by `make stress`.
+//
+// usage: stress [producers] [seed] [logpath]
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../src/hub.h"
+
+#define MIN_RUN_MS 200
+#define MAX_RUN_MS 1500
+#define WATCHDOG_S 60
+
+static atomic_int stop_producers = 0;
+
+#define MAX_HUBS 2
+
+typedef struct {
+    pthread_t tid;
+    hub_t *hub;
+    int hub_idx;
+    unsigned seed;
+    unsigned long submitted;
+} producer_t;
+
+static void *producer_main(void *arg) {
+    producer_t *p = (producer_t*)arg;
+    static const char *types[] = { "TEMP", "HUM", "PRESS", "BOGUS" };
+    long ts = 0;
+    while (!atomic_load(&stop_producers)) {
+        int r = rand_r(&p->seed);
+        hub_submit(p->hub, types[r % 4], 20.0 + (r % 1000), ts++);
+        p->submitted++;
+    }
+    return NULL;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+int main(int argc, char **argv) {
+    int nprod = argc > 1 ? atoi(argv[1]) : 64;
+    unsigned seed = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10) : (unsigned)time(NULL);
+    const char *logpath = argc > 3 ? argv[3] : "/tmp/sensorhub-stress.log";
+    if (nprod < 1) nprod = 1;
+
+    // a hang anywhere (lost wakeup, deadlock on shutdown) kills the run
+    alarm(WATCHDOG_S);
+
+    srand(seed);
+    int run_ms = MIN_RUN_MS + rand() % (MAX_RUN_MS - MIN_RUN_MS);
+    // stop the processor before, together with, or after the producers
+    int order = rand() % 3;
+    int nshards = 1 + rand() % 3;
+    int nhubs = 1 + rand() % MAX_HUBS;
+    printf("STRESS: producers=%d seed=%u run_ms=%d order=%d shards=%d hubs=%d\n", nprod, seed, run_ms, order, nshards, nhubs);
+
+    static hub_config_t cfg[MAX_HUBS];
+    hub_t *hubs[MAX_HUBS];
+    for (int k = 0; k < nhubs; ++k) {
+        config_defaults(&cfg[k]);
+        snprintf(cfg[k].log_path, sizeof(cfg[k].log_path), "%s.%d", logpath, k);
+        cfg[k].shards = nshards;
+        hubs[k] = hub_create(&cfg[k]);
+        if (!hubs[k] || !hub_start(hubs[k])) {
+            fprintf(stderr, "hub_create failed\n");
+            return 1;
+        }
+    }
+
+    producer_t *prods = calloc((size_t)nprod, sizeof(*prods));
+    for (int i = 0; i < nprod; ++i) {
+        prods[i].seed = seed + (unsigned)i;
+        prods[i].hub_idx = i % nhubs;
+        prods[i].hub = hubs[i % nhubs];
+        pthread_create(&prods[i].tid, NULL, producer_main, &prods[i]);
+    }
+
+    sleep_ms(run_ms);
+    if (order == 0) {
+        for (int k = 0; k < nhubs; ++k) hub_stop(hubs[k]);
+        sleep_ms(rand() % 100);
+    }
+    atomic_store(&stop_producers, 1);
+    if (order == 1) for (int k = 0; k < nhubs; ++k) hub_stop(hubs[k]);
+    for (int i = 0; i < nprod; ++i) pthread_join(prods[i].tid, NULL);
+    if (order == 2) {
+        sleep_ms(rand() % 100);
+        for (int k = 0; k < nhubs; ++k) hub_stop(hubs[k]);
+    }
+
+    int ok = 1;
+    for (int k = 0; k < nhubs; ++k) {
+        hub_stats_t st;
+        hub_get_stats(hubs[k], &st);
+        hub_destroy(hubs[k]);
+        config_free(&cfg[k]);
+
+        unsigned long total = 0;
+        for (int i = 0; i < nprod; ++i) {
+            if (prods[i].hub_idx == k) total += prods[i].submitted;
+        }
+
+        printf("STRESS: hub=%d submitted=%lu enqueued=%lu dropped=%lu processed=%lu pending=%lu\n",
+               k, st.submitted, st.enqueued, st.dropped, st.processed, st.pending);
+
+        if (st.submitted != total) {
+            fprintf(stderr, "ERROR: hub %d counted %lu submissions, producers made %lu\n", k, st.submitted, total);
+            ok = 0;
+        }
+        if (st.enqueued + st.dropped != st.submitted) {
+            fprintf(stderr, "ERROR: hub %d: enqueued + dropped != submitted\n", k);
+            ok = 0;
+        }
+        if (st.processed + st.pending != st.enqueued) {
+            fprintf(stderr, "ERROR: hub %d: processed + pending != enqueued\n", k);
+            ok = 0;
+        }
+        if (st.dropped == 0) {
+            printf("STRESS: warning: hub %d queue never filled, queue-full path not exercised\n", k);
+        }
+    }
+    free(prods);
+
+    printf(ok ? "STRESS: OK\n" : "STRESS: FAILED\n");
+    return ok ? 0 : 1;
+}
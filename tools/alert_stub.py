@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""
+Stub webhook receiver for sensorhub alert delivery (--alert-webhook). Used by
+tests/run_alert_test.sh, but can also be run by hand to watch alerts.
+
+Usage:
+    python3 tools/alert_stub.py [--port N] [--out FILE] [--fail-first N]
+                                [--fail-every N] [--delay S]
+
+Listens on 127.0.0.1:N (0 = any free port) and prints "listening on PORT"
+once ready. Every POSTed batch is appended to FILE (default stdout) as one
+JSON line: {"n": request number, "status": status sent, "alerts": [...]}.
+The first --fail-first requests and every --fail-every-th one after them are
+answered with 503, so the hub has to retry them; --delay holds each response
+back for S seconds, like a slow receiver. Runs until killed.
+"""
+
+import argparse
+import json
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+parser.add_argument("--port", type=int, default=0)
+parser.add_argument("--out", default="-")
+parser.add_argument("--fail-first", type=int, default=0)
+parser.add_argument("--fail-every", type=int, default=0)
+parser.add_argument("--delay", type=float, default=0.0)
+args = parser.parse_args()
+
+out = sys.stdout if args.out == "-" else open(args.out, "a")
+lock = threading.Lock()
+requests = 0
+
+
+class Handler(BaseHTTPRequestHandler):
+    def do_POST(self):
+        global requests
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        with lock:
+            requests += 1
+            n = requests
+        fail = n <= args.fail_first or (args.fail_every and (n - args.fail_first) % args.fail_every == 0)
+        status = 503 if fail else 200
+        if args.delay:
+            time.sleep(args.delay)
+        try:
+            alerts = json.loads(body)["alerts"]
+        except (ValueError, KeyError):
+            alerts, status = None, 400
+        with lock:
+            out.write(json.dumps({"n": n, "status": status, "alerts": alerts}) + "\n")
+            out.flush()
+        self.send_response(status)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def log_message(self, fmt, *a):
+        pass
+
+
+server = HTTPServer(("127.0.0.1", args.port), Handler)
+print(f"listening on {server.server_address[1]}", flush=True)
+try:
+    server.serve_forever()
+except KeyboardInterrupt:
+    pass
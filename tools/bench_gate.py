@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""
+Performance regression gate for virtual-sensor-hub. Runs the benchmark suite
+(build/bench, built by `make bench`) several times, computes the median and a
+95% confidence interval per metric, and compares against a stored baseline.
+
+Usage:
+    python3 tools/bench_gate.py [--runs 7] [--threshold 0.10]
+                                [--baseline tests/bench_baseline.json]
+                                [--update-baseline] [--bench build/bench]
+
+Checks (per benchmark scenario):
+1. median throughput must not drop more than `threshold` below the baseline
+2. median p99 submit latency must not rise more than `threshold` above it
+A metric only fails the gate when its confidence interval also excludes the
+baseline value; a median past the threshold with an overlapping interval is
+reported as noise so that a rerun (or more --runs) can settle it.
+Returns 0 on success, 1 on a regression, 2 on usage/setup errors.
+"""
+
+import argparse
+import json
+import platform
+import random
+import statistics
+import subprocess
+import sys
+from pathlib import Path
+
+METRICS = {
+    # metric: +1 if higher is better, -1 if lower is better
+    "throughput": +1,
+    "p99_ns": -1,
+}
+
+
+def run_suite(bench, scale):
+    out = subprocess.run([bench, str(scale)], check=True, capture_output=True, text=True).stdout
+    results = {}
+    for line in out.splitlines():
+        line = line.strip()
+        if line.startswith("{"):
+            rec = json.loads(line)
+            results[rec["bench"]] = rec
+    return results
+
+
+def median_ci(values, iters=2000, conf=0.95):
+    """median with a bootstrap percentile confidence interval"""
+    med = statistics.median(values)
+    if len(values) < 3:
+        return med, min(values), max(values)
+    rng = random.Random(12345)
+    boots = sorted(statistics.median(rng.choices(values, k=len(values))) for _ in range(iters))
+    lo = boots[int((1 - conf) / 2 * iters)]
+    hi = boots[int((1 + conf) / 2 * iters) - 1]
+    return med, lo, hi
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare benchmark medians against a stored baseline.")
+    parser.add_argument("--bench", default="build/bench", help="benchmark binary (default: build/bench)")
+    parser.add_argument("--runs", type=int, default=7, help="number of suite runs (default: 7)")
+    parser.add_argument("--scale", type=float, default=1.0, help="sample-count multiplier passed to the suite")
+    parser.add_argument("--threshold", type=float, default=0.10, help="allowed relative regression (default: 0.10)")
+    parser.add_argument("--baseline", default="tests/bench_baseline.json", help="baseline JSON file")
+    parser.add_argument("--update-baseline", action="store_true", help="write the measured medians as the new baseline")
+    args = parser.parse_args()
+
+    if not Path(args.bench).exists():
+        print(f"[error] benchmark binary not found: {args.bench} (run `make bench`)", file=sys.stderr)
+        sys.exit(2)
+
+    samples = {}
+    for i in range(args.runs):
+        print(f"run {i + 1}/{args.runs}...", file=sys.stderr)
+        for name, rec in run_suite(args.bench, args.scale).items():
+            for m in METRICS:
+                samples.setdefault(name, {}).setdefault(m, []).append(float(rec[m]))
+
+    current = {}
+    intervals = {}
+    print(f"{'benchmark':<20} {'metric':<12} {'median':>14} {'95% CI':>29}")
+    for name in sorted(samples):
+        current[name] = {}
+        for m in METRICS:
+            med, lo, hi = median_ci(samples[name][m])
+            current[name][m] = med
+            intervals[(name, m)] = (lo, hi)
+            print(f"{name:<20} {m:<12} {med:>14.1f}   [{lo:>12.1f}, {hi:>12.1f}]")
+
+    if args.update_baseline:
+        doc = {"host": platform.node(), "runs": args.runs, "scale": args.scale, "benchmarks": current}
+        Path(args.baseline).write_text(json.dumps(doc, indent=2, sort_keys=True) + "\n")
+        print(f"\nBaseline written: {args.baseline}")
+        sys.exit(0)
+
+    try:
+        baseline = json.loads(Path(args.baseline).read_text())["benchmarks"]
+    except FileNotFoundError:
+        print(f"[error] baseline not found: {args.baseline} (use --update-baseline)", file=sys.stderr)
+        sys.exit(2)
+
+    print("")
+    ok = True
+    for name in sorted(current):
+        if name not in baseline:
+            print(f"  {name}: no baseline entry, skipped")
+            continue
+        for m, sign in METRICS.items():
+            base = baseline[name][m]
+            cur = current[name][m]
+            change = (cur - base) / base if base else 0.0
+            lo, hi = intervals[(name, m)]
+            past = -sign * change > args.threshold
+            excludes = hi < base if sign > 0 else lo > base
+            regressed = past and excludes
+            tag = "REGRESSION" if regressed else ("noise? (CI overlaps baseline)" if past else "ok")
+            print(f"  {name} {m}: baseline {base:.1f} -> {cur:.1f} ({change:+.1%}) {tag}")
+            ok = ok and not regressed
+
+    if not ok:
+        print(f"\nGATE FAILED (threshold {args.threshold:.0%})", file=sys.stderr)
+        sys.exit(1)
+    print("\nGATE PASSED")
+    sys.exit(0)
+
+
+if __name__ == "__main__":
+    main()
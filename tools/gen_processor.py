@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+"""
+Generate a processor specialized for one sensor schema (see src/spec.h).
+
+    python3 tools/gen_processor.py config/sensors.conf -o build/spec/processor.c
+
+The schema is a sensor file as read by --sensors. The output defines
+hub_generated_spec: sensor lookup is a switch on the name, and each sensor
+gets its own window update with the window size, threshold, channel count
+and encoding as constants. The generated code keeps window_t exactly as the
+runtime processor does, so alerts and checkpoints are identical.
+"""
+
+import argparse
+import math
+import sys
+
+# defaults and keys as in parse_sensor_line() (src/config.c)
+DEFAULTS = {"interval": 1000, "base": 0.0, "span": 1, "window": 5, "threshold": math.inf,
+            "channels": 1, "alert": "mean", "encoding": "f64", "scale": 1.0, "offset": 0.0,
+            "fft": 0, "hop": 0, "spectrum": "block", "rate": 0.0, "source": "", "band": ""}
+INT_KEYS = {"interval": (0, 86400000), "span": (1, 1000000), "window": (1, 1000000), "channels": (1, 4),
+            "fft": (4, 65536), "hop": (1, 1000000)}
+CHOICES = {"alert": ("mean", "magnitude", "median", "mad"), "encoding": ("f64", "f32", "i32", "i16"),
+           "spectrum": ("block", "sliding")}
+# spectral keys: band energies are computed outside the window code, so they
+# are accepted but not compiled in (the config check in src/config.c applies)
+STR_KEYS = ("source", "band")
+C_ENCODING = {"f64": "ENC_F64", "f32": "ENC_F32", "i32": "ENC_I32", "i16": "ENC_I16"}
+C_INT = {"i32": "int32_t", "i16": "int16_t"}
+C_ALERT = {"mean": "ALERT_MEAN", "magnitude": "ALERT_MAGNITUDE", "median": "ALERT_MEDIAN", "mad": "ALERT_MAD"}
+NAME_LEN = 16   # HUB_NAME_LEN
+MAX_CHANNELS = 4
+
+
+def parse_schema(path):
+    sensors = []
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            tokens = line.split("#", 1)[0].split()
+            if not tokens:
+                continue
+            where = f"{path}:{lineno}"
+            name = tokens[0]
+            if len(name) >= NAME_LEN or any(s["name"] == name for s in sensors):
+                sys.exit(f"{where}: bad or duplicate sensor name {name}")
+            s = dict(DEFAULTS, name=name)
+            for tok in tokens[1:]:
+                key, eq, val = tok.partition("=")
+                if not eq or key not in DEFAULTS:
+                    sys.exit(f"{where}: bad sensor key '{tok}'")
+                if key in INT_KEYS:
+                    lo, hi = INT_KEYS[key]
+                    s[key] = int(val)
+                    if not lo <= s[key] <= hi:
+                        sys.exit(f"{where}: {key} out of range")
+                elif key in STR_KEYS:
+                    s[key] = val
+                elif key in CHOICES:
+                    if val not in CHOICES[key]:
+                        sys.exit(f"{where}: {key} must be one of {', '.join(CHOICES[key])}")
+                    s[key] = val
+                else:
+                    s[key] = float(val)
+            if not s["scale"] > 0:
+                sys.exit(f"{where}: scale must be positive")
+            sensors.append(s)
+    if not sensors:
+        sys.exit(f"{path}: defines no sensors")
+    return sensors
+
+
+def c_double(v):
+    # repr() round-trips, so the constants equal what strtod() gives the runtime config
+    if math.isinf(v):
+        return "HUGE_VAL" if v > 0 else "-HUGE_VAL"
+    return repr(float(v))
+
+
+def lanes(values):
+    return "{ " + ", ".join(values + ["0"] * (MAX_CHANNELS - len(values))) + " }"
+
+
+def emit_process(out, i, s):
+    n, ch, enc = s["window"], s["channels"], s["encoding"]
+    integer = enc in C_INT
+    out.append(f"// {s['name']}: window {n}, {ch} channel(s), {enc}, alert={s['alert']} > {s['threshold']:g}")
+    out.append(f"static inline bool process_{i}(window_t *w, const void *payload, hub_vec_t *value, double *metric) {{")
+    if integer:
+        out.append(f"    {C_INT[enc]} r[{ch}];")
+        out.append("    memcpy(r, payload, sizeof(r));")
+        out.append(f"    hub_ivec_t raw = {lanes([f'r[{c}]' for c in range(ch)])};")
+        scale, offset = c_double(s["scale"]), c_double(s["offset"])
+        out.append(f"    *value = (hub_vec_t){lanes([f'(double)r[{c}] * {scale} + {offset}' for c in range(ch)])};")
+    else:
+        ctype = "float" if enc == "f32" else "double"
+        out.append(f"    {ctype} v[{ch}];")
+        out.append("    memcpy(v, payload, sizeof(v));")
+        out.append(f"    *value = (hub_vec_t){lanes([f'v[{c}]' for c in range(ch)])};")
+    mags = s["alert"] == "magnitude"
+    robust = s["alert"] in ("median", "mad")
+    out.append(f"    if (w->count < {n}) {{")
+    out.append("        w->count++;")
+    out.append("    } else {")
+    out.append(f"        w->{'isum' if integer else 'sum'} -= w->{'raw' if integer else 'values'}[w->idx];")
+    if mags:
+        out.append("        w->mag_sum -= w->mags[w->idx];")
+    out.append("    }")
+    if integer:
+        out.append("    w->raw[w->idx] = raw;")
+        out.append("    w->isum += raw;")
+    else:
+        out.append("    w->values[w->idx] = *value;")
+        out.append("    w->sum += *value;")
+    if mags:
+        out.append("    double m = vec_norm(value);")
+        out.append("    w->mags[w->idx] = m;")
+        out.append("    w->mag_sum += m;")
+    if robust:
+        out.append(f"    median_window_push(w->median, {'vec_norm(value)' if ch > 1 else '(*value)[0]'});")
+    out.append(f"    w->idx = w->idx == {n - 1} ? 0 : w->idx + 1;")
+    out.append(f"    if (w->count < {n}) return false;")
+    # same expressions as window_metric() so the metrics match bit for bit
+    if mags:
+        out.append(f"    *metric = w->mag_sum / {n};")
+    elif robust:
+        out.append(f"    *metric = median_window_{'median' if s['alert'] == 'median' else 'mad'}(w->median);")
+    else:
+        if integer:
+            out.append(f"    hub_vec_t mean = __builtin_convertvector(w->isum, hub_vec_t) * ({scale} / {n}) + {offset};")
+        else:
+            out.append(f"    hub_vec_t mean = w->sum / (double){n};")
+        out.append("    double m = mean[0];")
+        for c in range(1, ch):
+            out.append(f"    if (mean[{c}] > m) m = mean[{c}];")
+        out.append("    *metric = m;")
+    out.append(f"    return *metric > {c_double(s['threshold'])};")
+    out.append("}")
+    out.append("")
+
+
+def emit_index(out, sensors):
+    out.append("static int sensor_index(const char *type) {")
+    out.append("    switch (type[0]) {")
+    first = {}
+    for i, s in enumerate(sensors):
+        first.setdefault(s["name"][0], []).append((i, s["name"]))
+    for ch, entries in first.items():
+        out.append(f"    case {c_char(ch)}:")
+        for i, name in entries:
+            out.append(f"        if (strcmp(type + 1, {c_str(name[1:])}) == 0) return {i};")
+        out.append("        break;")
+    out.append("    }")
+    out.append("    return -1;")
+    out.append("}")
+    out.append("")
+
+
+def c_str(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def c_char(ch):
+    return "'\\''" if ch == "'" else "'\\\\'" if ch == "\\" else f"'{ch}'"
+
+
+def generate(schema, sensors):
+    out = [f"// generated by tools/gen_processor.py from {schema}; do not edit",
+           "#include <math.h>",
+           "#include <stdint.h>",
+           "#include <string.h>",
+           '#include "spec.h"',
+           "",
+           "static const sensor_config_t sensors[] = {"]
+    for s in sensors:
+        out.append(f"    {{ {c_str(s['name'])}, {s['interval']}, {c_double(s['base'])}, {s['span']}, {s['window']}, "
+                   f"{c_double(s['threshold'])}, {s['channels']}, "
+                   f"{C_ALERT[s['alert']]}, "
+                   f"{C_ENCODING[s['encoding']]}, {c_double(s['scale'])}, {c_double(s['offset'])}, {{ 0 }} }},")
+    out.append("};")
+    out.append("")
+    emit_index(out, sensors)
+    for i, s in enumerate(sensors):
+        emit_process(out, i, s)
+    out.append("static bool process(window_t *w, int sensor, const void *payload, hub_vec_t *value, double *metric) {")
+    out.append("    switch (sensor) {")
+    for i in range(len(sensors)):
+        out.append(f"    case {i}: return process_{i}(w, payload, value, metric);")
+    out.append("    }")
+    out.append("    return false;")
+    out.append("}")
+    out.append("")
+    out.append("const hub_spec_t hub_generated_spec = {")
+    out.append(f"    {c_str(schema)}, sensors, {len(sensors)}, sensor_index, process,")
+    out.append("};")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("schema", help="sensor file (config/sensors.conf format)")
+    ap.add_argument("-o", "--output", default="-", help="C file to write (default stdout)")
+    args = ap.parse_args()
+    code = generate(args.schema, parse_schema(args.schema))
+    if args.output == "-":
+        sys.stdout.write(code)
+    else:
+        with open(args.output, "w") as f:
+            f.write(code)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+"""
+ctypes binding for libsensorhub.so (build with `make lib`).
+
+Runs a hub inside the Python process and exposes each sensor's history ring
+and rollup tiers as NumPy arrays that point straight into hub memory: no
+copies, and the arrays change as the processors write.
+
+    from sensorhub import Hub
+    with Hub(["--log", "/tmp/hub.log"]) as hub:
+        hub.start()
+        hub.submit("TEMP", 25.0, 1000)
+        ring = hub.history("TEMP")          # live view, dtype [ms_timestamp, value]
+        raw = hub.raw("ACC")                # live (capacity, channels) view in the stored encoding
+        axes = hub.channels("ACC")          # the same, decoded to physical values (copy for integers)
+        recent = hub.latest("TEMP", 100)    # ordered copy of the newest 100 points
+        minutes = hub.rollup("TEMP", 1)     # live view of the 1-minute buckets
+        ts, rows = hub.frames(100)          # with --frames: aligned (100, columns) matrix
+
+The library is looked up in $SENSORHUB_LIB, then build/libsensorhub.so next
+to this repository.
+"""
+
+import ctypes
+import os
+from pathlib import Path
+
+import numpy as np
+
+API_VERSION = 1
+
+# must match hub_point_t / hub_bucket_t in src/history.h
+POINT_DTYPE = np.dtype([("ms_timestamp", "<i8"), ("value", "<f8")])
+BUCKET_DTYPE = np.dtype([("start_ms", "<i8"), ("count", "<i8"),
+                         ("min", "<f8"), ("max", "<f8"), ("sum", "<f8")])
+# value_encoding_t in src/config.h
+ENCODING_DTYPES = [np.dtype("<f8"), np.dtype("<f4"), np.dtype("<i4"), np.dtype("<i2")]
+
+
+class Stats(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_ulong) for name in
+                ("submitted", "enqueued", "dropped", "processed", "pending")]
+
+
+def _load(path=None):
+    if path is None:
+        path = os.environ.get("SENSORHUB_LIB") or \
+            str(Path(__file__).resolve().parent.parent / "build" / "libsensorhub.so")
+    lib = ctypes.CDLL(path)
+    vp, c_int, c_size_p = ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_size_t)
+    sigs = {
+        "hub_api_version": ([], c_int),
+        "config_new": ([c_int, ctypes.POINTER(ctypes.c_char_p)], vp),
+        "config_delete": ([vp], None),
+        "hub_create": ([vp], vp),
+        "hub_start": ([vp], ctypes.c_bool),
+        "hub_submit": ([vp, ctypes.c_char_p, ctypes.c_double, ctypes.c_long], ctypes.c_bool),
+        "hub_submit_vector": ([vp, ctypes.c_char_p, ctypes.POINTER(ctypes.c_double), c_int, ctypes.c_long],
+                              ctypes.c_bool),
+        "hub_stop": ([vp], None),
+        "hub_drain": ([vp], None),
+        "hub_destroy": ([vp], None),
+        "hub_get_stats": ([vp, ctypes.POINTER(Stats)], None),
+        "hub_checkpoint": ([vp], ctypes.c_bool),
+        "hub_sensor_count": ([vp], c_int),
+        "hub_sensor_index": ([vp, ctypes.c_char_p], c_int),
+        "hub_sensor_name": ([vp, c_int], ctypes.c_char_p),
+        "hub_history_points": ([vp, c_int, c_size_p], vp),
+        "hub_history_written": ([vp, c_int], ctypes.c_uint64),
+        "hub_history_raw": ([vp, c_int, c_size_p, ctypes.POINTER(c_int)], vp),
+        "hub_sensor_encoding": ([vp, c_int, ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_double)], c_int),
+        "hub_rollup_buckets": ([vp, c_int, c_int, c_size_p], vp),
+        "hub_rollup_opened": ([vp, c_int, c_int], ctypes.c_uint64),
+        "hub_rollup_tiers": ([], c_int),
+        "hub_rollup_width_ms": ([c_int], ctypes.c_long),
+        "hub_frame_columns": ([vp, ctypes.POINTER(ctypes.c_long)], c_int),
+        "hub_frame_sensor": ([vp, c_int], c_int),
+        "hub_frame_times": ([vp, c_size_p], vp),
+        "hub_frame_values": ([vp, c_size_p], vp),
+        "hub_frames_written": ([vp], ctypes.c_uint64),
+    }
+    for name, (args, res) in sigs.items():
+        fn = getattr(lib, name)
+        fn.argtypes = args
+        fn.restype = res
+    if lib.hub_api_version() != API_VERSION:
+        raise RuntimeError(f"{path}: API version {lib.hub_api_version()}, binding expects {API_VERSION}")
+    return lib
+
+
+def _view(addr, count, dtype):
+    """NumPy array over count items of dtype at addr, sharing the memory."""
+    buf = (ctypes.c_char * (count * dtype.itemsize)).from_address(addr)
+    arr = np.frombuffer(buf, dtype=dtype)
+    arr.flags.writeable = False
+    return arr
+
+
+def _ordered(view, total, n):
+    """Copy of the newest min(n, total, len(view)) ring entries, oldest first."""
+    cap = len(view)
+    n = min(n, total, cap)
+    idx = (np.arange(total - n, total) % cap) if n else np.empty(0, dtype=np.int64)
+    return view[idx]
+
+
+class Hub:
+    """One hub instance; options are the sensorhub command-line options."""
+
+    def __init__(self, options=(), lib=None):
+        self._lib = lib or _load()
+        argv = [b"sensorhub"] + [str(o).encode() for o in options]
+        self._argv = (ctypes.c_char_p * len(argv))(*argv)
+        self._cfg = self._lib.config_new(len(argv), self._argv)
+        if not self._cfg:
+            raise ValueError(f"invalid hub options: {list(options)}")
+        self._hub = self._lib.hub_create(self._cfg)
+        if not self._hub:
+            self._lib.config_delete(self._cfg)
+            raise RuntimeError("hub_create failed")
+        self.tiers = self._lib.hub_rollup_tiers()
+        self.tier_width_ms = [self._lib.hub_rollup_width_ms(t) for t in range(self.tiers)]
+
+    def close(self):
+        # the views returned below must not be used after this
+        if self._hub:
+            self._lib.hub_destroy(self._hub)
+            self._lib.config_delete(self._cfg)
+            self._hub = self._cfg = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def start(self):
+        if not self._lib.hub_start(self._hub):
+            raise RuntimeError("hub_start failed")
+
+    def stop(self):
+        self._lib.hub_stop(self._hub)
+
+    def drain(self):
+        self._lib.hub_drain(self._hub)
+
+    def submit(self, sensor, value, ms_timestamp):
+        return self._lib.hub_submit(self._hub, sensor.encode(), value, ms_timestamp)
+
+    def submit_vector(self, sensor, values, ms_timestamp):
+        arr = (ctypes.c_double * len(values))(*values)
+        return self._lib.hub_submit_vector(self._hub, sensor.encode(), arr, len(values), ms_timestamp)
+
+    def checkpoint(self):
+        return self._lib.hub_checkpoint(self._hub)
+
+    def stats(self):
+        st = Stats()
+        self._lib.hub_get_stats(self._hub, ctypes.byref(st))
+        return {name: getattr(st, name) for name, _ in Stats._fields_}
+
+    def sensors(self):
+        return [self._lib.hub_sensor_name(self._hub, i).decode()
+                for i in range(self._lib.hub_sensor_count(self._hub))]
+
+    def _index(self, sensor):
+        i = self._lib.hub_sensor_index(self._hub, sensor.encode())
+        if i < 0:
+            raise KeyError(sensor)
+        return i
+
+    def history(self, sensor):
+        """Live, read-only view of the whole history ring (slot order)."""
+        n = ctypes.c_size_t()
+        addr = self._lib.hub_history_points(self._hub, self._index(sensor), ctypes.byref(n))
+        return _view(addr, n.value, POINT_DTYPE)
+
+    def encoding(self, sensor):
+        """(dtype, scale, offset) of the stored channel values."""
+        scale, offset = ctypes.c_double(), ctypes.c_double()
+        enc = self._lib.hub_sensor_encoding(self._hub, self._index(sensor), ctypes.byref(scale), ctypes.byref(offset))
+        return ENCODING_DTYPES[enc], scale.value, offset.value
+
+    def raw(self, sensor):
+        """Live (capacity, channels) view of the channel values as stored, same slots as history()."""
+        n, ch = ctypes.c_size_t(), ctypes.c_int()
+        addr = self._lib.hub_history_raw(self._hub, self._index(sensor), ctypes.byref(n), ctypes.byref(ch))
+        dtype = self.encoding(sensor)[0]
+        return _view(addr, n.value * ch.value, dtype).reshape(n.value, ch.value)
+
+    def channels(self, sensor):
+        """Physical channel values: raw() itself for f64, decoded otherwise."""
+        dtype, scale, offset = self.encoding(sensor)
+        raw = self.raw(sensor)
+        if dtype.kind == "f":
+            return raw if dtype.itemsize == 8 else raw.astype(np.float64)
+        return raw * scale + offset
+
+    def written(self, sensor):
+        """Points ever written; entry k is in history slot k % len(ring)."""
+        return self._lib.hub_history_written(self._hub, self._index(sensor))
+
+    def latest(self, sensor, n):
+        return _ordered(self.history(sensor), self.written(sensor), n)
+
+    def rollup(self, sensor, tier):
+        """Live, read-only view of one rollup tier's bucket ring (slot order)."""
+        if not 0 <= tier < self.tiers:
+            raise IndexError(tier)
+        n = ctypes.c_size_t()
+        addr = self._lib.hub_rollup_buckets(self._hub, self._index(sensor), tier, ctypes.byref(n))
+        return _view(addr, n.value, BUCKET_DTYPE)
+
+    def opened(self, sensor, tier):
+        """Buckets ever opened in a tier; the newest one is still filling."""
+        return self._lib.hub_rollup_opened(self._hub, self._index(sensor), tier)
+
+    def buckets(self, sensor, tier, n):
+        return _ordered(self.rollup(sensor, tier), self.opened(sensor, tier), n)
+
+    def frame_sensors(self):
+        """(sensor names in column order, period in ms) of the frame stream; ([], 0) if off."""
+        period = ctypes.c_long()
+        cols = self._lib.hub_frame_columns(self._hub, ctypes.byref(period))
+        names = [self._lib.hub_sensor_name(self._hub, self._lib.hub_frame_sensor(self._hub, c)).decode()
+                 for c in range(cols)]
+        return names, period.value
+
+    def frame_ring(self):
+        """Live views (times, values) of the frame ring: values is (columns, capacity), one row per sensor."""
+        cols = len(self.frame_sensors()[0])
+        if not cols:
+            raise ValueError("hub has no --frames")
+        n = ctypes.c_size_t()
+        times = _view(self._lib.hub_frame_times(self._hub, ctypes.byref(n)), n.value, np.dtype("<i8"))
+        values = _view(self._lib.hub_frame_values(self._hub, ctypes.byref(n)), cols * n.value, np.dtype("<f8"))
+        return times, values.reshape(cols, n.value)
+
+    def frames_written(self):
+        return self._lib.hub_frames_written(self._hub)
+
+    def frames(self, n):
+        """Copies of the newest n frames, oldest first: (times, (n, columns) matrix)."""
+        times, values = self.frame_ring()
+        total, cap = self.frames_written(), len(times)
+        n = min(n, total, cap)
+        idx = np.arange(total - n, total) % cap
+        return times[idx], values[:, idx].T.copy()